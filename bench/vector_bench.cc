@@ -0,0 +1,306 @@
+/* Copyright (c) 2017, 2024, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License, version 2.0, for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA */
+
+/*
+  Micro-benchmark of the kernels behind the component UDFs, linked without
+  the server:
+
+    vector_operations_bench [--csv] [--min-time=MS] [--dims=D1,D2,...]
+
+  Every operation is timed on every instruction set the CPU supports, for
+  every dimension (3 to 16383 by default), and reported in ns per call and
+  in GB/s of vector data read and written. The `text` rows time the path the
+  element-wise UDFs used before they wrote binary results: the result is
+  printed as text and parsed back into floats.
+
+  With --csv the results are printed as isa,op,dim,ns_per_op,gb_per_s lines
+  that can be compared between two builds of the component.
+*/
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "vector_kernels.h"
+#include "vector_quantization.h"
+
+namespace {
+
+struct options {
+  bool csv = false;
+  double min_time = 0.1;  // seconds per measurement
+  std::vector<uint32_t> dims{3, 16, 128, 384, 768, 1536, 4096, 16383};
+};
+
+/* Keeps the results alive so the measured calls are not optimized out. */
+volatile double sink;
+
+void keep(vector_kernels::op_status status) {
+  sink = static_cast<int>(status);
+}
+
+/*
+  Returns the time of one call of f in ns, doubling the number of calls
+  until they take at least min_time.
+*/
+template <class F>
+double measure(const options &opt, F &&f) {
+  using clock = std::chrono::steady_clock;
+  f();  // warm up the caches
+  for (uint64_t calls = 1;; calls *= 2) {
+    clock::time_point start = clock::now();
+    for (uint64_t i = 0; i < calls; i++) f();
+    std::chrono::duration<double> elapsed = clock::now() - start;
+    if (elapsed.count() >= opt.min_time)
+      return elapsed.count() * 1e9 / static_cast<double>(calls);
+  }
+}
+
+void report(const options &opt, const char *isa, const char *op,
+            uint32_t dim, double ns, double bytes) {
+  if (opt.csv)
+    printf("%s,%s,%u,%.2f,%.2f\n", isa, op, dim, ns, bytes / ns);
+  else
+    printf("%-13s %-22s %6u %12.1f %9.2f\n", isa, op, dim, ns, bytes / ns);
+}
+
+/*
+  The text round trip of the original element-wise UDFs: the float result
+  is written as a "[x,y,...]" string and parsed back, as VECTOR_TO_STRING
+  and STRING_TO_VECTOR do.
+*/
+void text_round_trip(uint32_t dim, const float *values, std::string *text,
+                     float *parsed) {
+  char number[32];
+  text->clear();
+  text->push_back('[');
+  for (uint32_t i = 0; i < dim; i++) {
+    if (i > 0) text->push_back(',');
+    int length = snprintf(number, sizeof(number), "%.5e", values[i]);
+    text->append(number, length);
+  }
+  text->push_back(']');
+
+  const char *pos = text->c_str() + 1;
+  for (uint32_t i = 0; i < dim; i++) {
+    char *end;
+    parsed[i] = strtof(pos, &end);
+    pos = end + 1;
+  }
+}
+
+void run(const options &opt, uint32_t dim) {
+  std::mt19937 rng(dim);
+  std::uniform_real_distribution<float> values(-1.0f, 1.0f);
+  std::uniform_real_distribution<float> divisors(0.5f, 1.5f);
+  std::vector<float> a(dim), b(dim), result(dim), parsed(dim);
+  for (uint32_t i = 0; i < dim; i++) {
+    a[i] = values(rng);
+    b[i] = divisors(rng);
+  }
+  const char *va = reinterpret_cast<const char *>(a.data());
+  const char *vb = reinterpret_cast<const char *>(b.data());
+  char *vr = reinterpret_cast<char *>(result.data());
+
+  std::vector<char> code_a(vector_quantization::int8_bytes(dim));
+  std::vector<char> code_b(vector_quantization::int8_bytes(dim));
+  std::vector<char> bits_a(vector_quantization::binary_bytes(dim));
+  std::vector<char> bits_b(vector_quantization::binary_bytes(dim));
+  vector_quantization::quantize_int8(dim, va, code_a.data());
+  vector_quantization::quantize_int8(dim, vb, code_b.data());
+  vector_quantization::quantize_binary(dim, va, bits_a.data());
+  vector_quantization::quantize_binary(dim, vb, bits_b.data());
+
+  /* A sparse vector of every fourth element of a, dotted with b. */
+  std::vector<uint32_t> sparse_indexes;
+  std::vector<float> sparse_values;
+  for (uint32_t i = 0; i < dim; i += 4) {
+    sparse_indexes.push_back(i);
+    sparse_values.push_back(a[i]);
+  }
+  const uint32_t nnz = static_cast<uint32_t>(sparse_indexes.size());
+
+  std::vector<uint16_t> half_a(dim), half_b(dim), half_r(dim);
+  std::vector<double> acc(dim + 8);
+  double *acc_aligned = reinterpret_cast<double *>(
+      (reinterpret_cast<uintptr_t>(acc.data()) + 63) & ~uintptr_t{63});
+  std::string text;
+
+  /* Running moments, and four rows of a covariance update by 32 rows. */
+  std::vector<double> mean(dim), m2(dim);
+  std::vector<float> low(dim), high(dim);
+  const uint32_t block_rows = 32;
+  std::vector<double> block(size_t{block_rows} * dim, 0.5);
+  std::vector<double> matrix(size_t{vector_kernels::rank_update_rows} * dim);
+
+  const double vec_bytes = dim * sizeof(float);
+  const double half_bytes = dim * sizeof(uint16_t);
+
+  vector_kernels::isa best = vector_kernels::detect();
+  for (vector_kernels::isa target :
+       {vector_kernels::isa::scalar, vector_kernels::isa::sse2,
+        vector_kernels::isa::avx2, vector_kernels::isa::avx512,
+        vector_kernels::isa::avx512_vnni}) {
+    if (vector_kernels::select(target)) continue;
+    const vector_kernels::kernel_table &k = vector_kernels::active();
+    const char *isa = vector_kernels::isa_name(target);
+    double ns;
+
+    if (target == vector_kernels::isa::scalar) {
+      ns = measure(opt, [&] {
+        for (uint32_t i = 0; i < dim; i++) result[i] = a[i] + b[i];
+        text_round_trip(dim, result.data(), &text, parsed.data());
+        sink = parsed[0];
+      });
+      report(opt, "text", "addition", dim, ns, 3 * vec_bytes);
+    }
+
+    ns = measure(opt, [&] { keep(k.addition(dim, va, vb, vr)); });
+    report(opt, isa, "addition", dim, ns, 3 * vec_bytes);
+    ns = measure(opt, [&] { keep(k.subtraction(dim, va, vb, vr)); });
+    report(opt, isa, "subtraction", dim, ns, 3 * vec_bytes);
+    ns = measure(opt, [&] { keep(k.multiplication(dim, va, vb, vr)); });
+    report(opt, isa, "multiplication", dim, ns, 3 * vec_bytes);
+    ns = measure(opt, [&] { keep(k.division(dim, va, vb, vr)); });
+    report(opt, isa, "division", dim, ns, 3 * vec_bytes);
+    ns = measure(opt, [&] { keep(k.axpy(dim, 0.5f, va, vb, vr)); });
+    report(opt, isa, "axpy", dim, ns, 3 * vec_bytes);
+    ns = measure(opt, [&] { sink = k.dot(dim, va, vb); });
+    report(opt, isa, "dot", dim, ns, 2 * vec_bytes);
+    ns = measure(opt, [&] { sink = k.l2_squared(dim, va, vb); });
+    report(opt, isa, "l2", dim, ns, 2 * vec_bytes);
+    ns = measure(opt, [&] { sink = k.l1(dim, va, vb); });
+    report(opt, isa, "l1", dim, ns, 2 * vec_bytes);
+    ns = measure(opt, [&] { sink = k.cosine(dim, va, vb).dot; });
+    report(opt, isa, "cosine", dim, ns, 2 * vec_bytes);
+
+    /* The kernels compiled for this dimension, if it is specialized. */
+    const vector_kernels::dimension_kernels fixed =
+        vector_kernels::for_dimension(dim);
+    if (fixed.dot != k.dot) {
+      ns = measure(opt, [&] { keep(fixed.addition(dim, va, vb, vr)); });
+      report(opt, isa, "addition fixed", dim, ns, 3 * vec_bytes);
+      ns = measure(opt, [&] { sink = fixed.dot(dim, va, vb); });
+      report(opt, isa, "dot fixed", dim, ns, 2 * vec_bytes);
+      ns = measure(opt, [&] { sink = fixed.l2_squared(dim, va, vb); });
+      report(opt, isa, "l2 fixed", dim, ns, 2 * vec_bytes);
+      ns = measure(opt, [&] { sink = fixed.cosine(dim, va, vb).dot; });
+      report(opt, isa, "cosine fixed", dim, ns, 2 * vec_bytes);
+    }
+    ns = measure(opt, [&] {
+      k.accumulate(dim, va, acc_aligned);
+      sink = acc_aligned[0];
+    });
+    report(opt, isa, "accumulate", dim, ns, vec_bytes);
+
+    k.fp16.narrow(dim, va, reinterpret_cast<char *>(half_a.data()));
+    k.fp16.narrow(dim, vb, reinterpret_cast<char *>(half_b.data()));
+    const char *ha = reinterpret_cast<const char *>(half_a.data());
+    const char *hb = reinterpret_cast<const char *>(half_b.data());
+    char *hr = reinterpret_cast<char *>(half_r.data());
+    ns = measure(opt, [&] { keep(k.fp16.addition(dim, ha, hb, hr)); });
+    report(opt, isa, "fp16 addition", dim, ns, 3 * half_bytes);
+    ns = measure(opt, [&] { sink = k.fp16.dot(dim, ha, hb); });
+    report(opt, isa, "fp16 dot", dim, ns, 2 * half_bytes);
+    ns = measure(opt, [&] { keep(k.fp16.narrow(dim, va, hr)); });
+    report(opt, isa, "fp16 narrow", dim, ns, vec_bytes + half_bytes);
+
+    const size_t header = vector_quantization::int8_header_size;
+    ns = measure(opt, [&] {
+      sink = k.int8_dot(dim, code_a.data() + header, code_b.data() + header);
+    });
+    report(opt, isa, "int8 dot", dim, ns, 2.0 * dim);
+    ns = measure(opt, [&] {
+      sink = k.hamming(bits_a.size(), bits_a.data(), bits_b.data());
+    });
+    report(opt, isa, "hamming", dim, ns, 2.0 * bits_a.size());
+    ns = measure(opt, [&] {
+      sink = k.gather_dot(
+          nnz, reinterpret_cast<const char *>(sparse_indexes.data()),
+          reinterpret_cast<const char *>(sparse_values.data()), vb);
+    });
+    report(opt, isa, "sparse dot", dim, ns, 3.0 * nnz * sizeof(float));
+    ns = measure(opt, [&] {
+      k.moments(dim, va, 1e-6, mean.data(), m2.data(), low.data(),
+                high.data());
+    });
+    report(opt, isa, "moments", dim, ns, vec_bytes + 6.0 * vec_bytes * 2);
+    ns = measure(opt, [&] {
+      k.rank_update(dim, 0, block_rows, block.data(), matrix.data());
+    });
+    report(opt, isa, "rank update", dim, ns,
+           (block.size() + 2.0 * matrix.size()) * sizeof(double));
+  }
+  vector_kernels::select(best);
+}
+
+bool parse_options(int argc, char **argv, options *opt) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--csv") {
+      opt->csv = true;
+    } else if (arg.rfind("--min-time=", 0) == 0) {
+      opt->min_time = atof(arg.c_str() + 11) / 1000.0;
+      if (!(opt->min_time > 0)) return true;
+    } else if (arg.rfind("--dims=", 0) == 0) {
+      opt->dims.clear();
+      const char *pos = arg.c_str() + 7;
+      while (*pos != '\0') {
+        char *end;
+        unsigned long dim = strtoul(pos, &end, 10);
+        if (end == pos || dim == 0 || dim > 16383) return true;
+        opt->dims.push_back(static_cast<uint32_t>(dim));
+        pos = *end == ',' ? end + 1 : end;
+        if (*end != ',' && *end != '\0') return true;
+      }
+    } else {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  options opt;
+  if (parse_options(argc, argv, &opt)) {
+    fprintf(stderr,
+            "usage: %s [--csv] [--min-time=MS] [--dims=D1,D2,...]\n",
+            argv[0]);
+    return 1;
+  }
+
+  if (opt.csv)
+    printf("isa,op,dim,ns_per_op,gb_per_s\n");
+  else
+    printf("%-13s %-22s %6s %12s %9s\n", "isa", "op", "dim", "ns/op",
+           "GB/s");
+  for (uint32_t dim : opt.dims) run(opt, dim);
+  return 0;
+}
@@ -0,0 +1,135 @@
+-- SQL-level benchmark of the component UDFs against the JavaScript functions
+-- of js/vector_operations.sql, on the same rows.
+--
+-- Requires the component and the JavaScript functions to be installed:
+--
+--   mysql> INSTALL COMPONENT "file://component_vector_operations";
+--   $ mysql < js/vector_operations.sql
+--   $ mysql < bench/vector_bench.sql
+--
+-- then, for 10000 rows of 128 dimensions, 3 runs of every query:
+--
+--   mysql> CALL vector_bench.run(10000, 128, 3);
+--
+-- The JavaScript functions take VARCHAR(15000) arguments, which limits the
+-- comparison to about 1000 dimensions. Every query is run `runs` times and
+-- the best time is kept; `scan` is the cost of reading the rows, included in
+-- all the other timings.
+
+CREATE DATABASE IF NOT EXISTS vector_bench;
+USE vector_bench;
+
+DROP PROCEDURE IF EXISTS populate;
+DROP PROCEDURE IF EXISTS measure;
+DROP PROCEDURE IF EXISTS run;
+
+DELIMITER $$
+
+CREATE PROCEDURE populate(IN row_count INT, IN dim INT)
+BEGIN
+  DECLARE i INT DEFAULT 0;
+  DECLARE j INT;
+  DECLARE a, b TEXT;
+
+  DROP TABLE IF EXISTS vectors;
+  CREATE TABLE vectors (
+    id INT PRIMARY KEY,
+    v1 VECTOR(16383) NOT NULL,
+    v2 VECTOR(16383) NOT NULL,
+    t1 TEXT NOT NULL,
+    t2 TEXT NOT NULL
+  );
+
+  WHILE i < row_count DO
+    SET j = 1, a = ROUND(RAND() * 2 - 1, 6),
+        b = ROUND(RAND() + 0.5, 6);
+    WHILE j < dim DO
+      SET a = CONCAT(a, ',', ROUND(RAND() * 2 - 1, 6)),
+          b = CONCAT(b, ',', ROUND(RAND() + 0.5, 6)),
+          j = j + 1;
+    END WHILE;
+    SET a = CONCAT('[', a, ']'), b = CONCAT('[', b, ']');
+    INSERT INTO vectors
+      VALUES (i, STRING_TO_VECTOR(a), STRING_TO_VECTOR(b), a, b);
+    SET i = i + 1;
+  END WHILE;
+END$$
+
+-- Runs `query` (a SELECT ... INTO @sink) `runs` times and records the best
+-- time in the results table.
+CREATE PROCEDURE measure(IN label VARCHAR(64), IN query TEXT, IN runs INT)
+BEGIN
+  DECLARE i INT DEFAULT 0;
+  DECLARE best BIGINT DEFAULT NULL;
+  DECLARE elapsed BIGINT;
+  DECLARE row_count INT;
+
+  SET @bench_query = query;
+  PREPARE statement FROM @bench_query;
+  WHILE i < runs DO
+    SET @bench_start = NOW(6);
+    EXECUTE statement;
+    SET elapsed = TIMESTAMPDIFF(MICROSECOND, @bench_start, NOW(6));
+    SET best = IF(best IS NULL OR elapsed < best, elapsed, best);
+    SET i = i + 1;
+  END WHILE;
+  DEALLOCATE PREPARE statement;
+
+  SELECT COUNT(*) INTO row_count FROM vectors;
+  INSERT INTO results VALUES (label, best / 1000, best * 1000 / row_count);
+END$$
+
+CREATE PROCEDURE run(IN row_count INT, IN dim INT, IN runs INT)
+BEGIN
+  CALL populate(row_count, dim);
+
+  DROP TEMPORARY TABLE IF EXISTS results;
+  CREATE TEMPORARY TABLE results (
+    query VARCHAR(64),
+    total_ms DECIMAL(12, 3),
+    ns_per_row DECIMAL(14, 1)
+  );
+
+  CALL measure('scan',
+    'SELECT SUM(LENGTH(v1) + LENGTH(v2)) INTO @sink FROM vectors', runs);
+  CALL measure('scan (text)',
+    'SELECT SUM(LENGTH(t1) + LENGTH(t2)) INTO @sink FROM vectors', runs);
+
+  CALL measure('VECTOR_ADDITION',
+    'SELECT SUM(LENGTH(VECTOR_ADDITION(v1, v2))) INTO @sink FROM vectors',
+    runs);
+  CALL measure('vector_addition_js',
+    'SELECT SUM(LENGTH(vector_addition_js(t1, t2))) INTO @sink FROM vectors',
+    runs);
+  CALL measure('VECTOR_SUBTRACTION',
+    'SELECT SUM(LENGTH(VECTOR_SUBTRACTION(v1, v2))) INTO @sink FROM vectors',
+    runs);
+  CALL measure('vector_subtraction_js',
+    'SELECT SUM(LENGTH(vector_subtraction_js(t1, t2))) INTO @sink
+       FROM vectors', runs);
+  CALL measure('VECTOR_MULTIPLICATION',
+    'SELECT SUM(LENGTH(VECTOR_MULTIPLICATION(v1, v2))) INTO @sink
+       FROM vectors', runs);
+  CALL measure('vector_multiplication_js',
+    'SELECT SUM(LENGTH(vector_multiplication_js(t1, t2))) INTO @sink
+       FROM vectors', runs);
+  CALL measure('VECTOR_DIVISION',
+    'SELECT SUM(LENGTH(VECTOR_DIVISION(v1, v2))) INTO @sink FROM vectors',
+    runs);
+  CALL measure('vector_division_js',
+    'SELECT SUM(LENGTH(vector_division_js(t1, t2))) INTO @sink FROM vectors',
+    runs);
+
+  -- The text round trip a client of the JavaScript functions pays for.
+  CALL measure('VECTOR_TO_STRING(VECTOR_ADDITION)',
+    'SELECT SUM(LENGTH(VECTOR_TO_STRING(VECTOR_ADDITION(v1, v2)))) INTO @sink
+       FROM vectors', runs);
+  CALL measure('VECTOR_L2',
+    'SELECT SUM(VECTOR_L2(v1, v2)) INTO @sink FROM vectors', runs);
+  CALL measure('VECTOR_COSINE',
+    'SELECT SUM(VECTOR_COSINE(v1, v2)) INTO @sink FROM vectors', runs);
+
+  SELECT * FROM results;
+END$$
+
+DELIMITER ;
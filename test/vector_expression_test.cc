@@ -0,0 +1,126 @@
+/* Copyright (c) 2017, 2024, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License, version 2.0, for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA */
+
+/*
+  Tests of the VECTOR_EVAL expression compiler, linked without the server:
+
+    vector_expression_test
+
+  Prints every failed check and exits with 1 if there is one.
+*/
+
+#include <cstdio>
+#include <string>
+
+#include "vector_expression.h"
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const char *what) {
+  if (condition) return;
+  fprintf(stderr, "FAILED: %s\n", what);
+  failures++;
+}
+
+/* Compiles `text` over two inputs, returning the error or "". */
+std::string compile(const std::string &text) {
+  vector_expression expression;
+  std::string error;
+  if (!expression.compile(text.data(), text.size(), 2, &error)) return "";
+  return error.empty() ? "unknown error" : error;
+}
+
+/* The error starts with `message`, before " at position ...". */
+bool fails_with(const std::string &error, const std::string &message) {
+  return error.compare(0, message.size(), message) == 0;
+}
+
+void test_evaluate() {
+  vector_expression expression;
+  std::string error;
+  const std::string text = "clamp(a*2 - -b, 0, 10) / (1 + 1)";
+  check(!expression.compile(text.data(), text.size(), 2, &error),
+        "compile a valid expression");
+
+  const float a[3] = {1, 4, -3};
+  const float b[3] = {2, 5, 1};
+  const char *inputs[2] = {reinterpret_cast<const char *>(a),
+                           reinterpret_cast<const char *>(b)};
+  float result[3];
+  check(expression.evaluate(3, inputs, reinterpret_cast<char *>(result)) ==
+            vector_kernels::op_status::ok,
+        "evaluate a valid expression");
+  check(result[0] == 2 && result[1] == 5 && result[2] == 0,
+        "values of a valid expression");
+}
+
+void test_nesting() {
+  /* Within the depth limit, however the levels are nested. */
+  check(compile(std::string(100, '(') + "a" + std::string(100, ')')).empty(),
+        "100 nested parentheses");
+  check(compile(std::string(100, '-') + "a").empty(), "100 unary minus");
+  check(compile(std::string(100, '+') + "a").empty(), "100 unary plus");
+
+  /* Deep enough to overflow the stack of a server thread if unbounded. */
+  const size_t deep = 100000;
+  check(fails_with(compile(std::string(deep, '(') + "a" +
+                           std::string(deep, ')')),
+                   "expression too complex"),
+        "deeply nested parentheses");
+  check(fails_with(compile(std::string(deep, '-') + "a"),
+                   "expression too complex"),
+        "deeply nested unary minus");
+  check(fails_with(compile(std::string(deep, '+') + "1"),
+                   "expression too complex"),
+        "deeply nested unary plus");
+
+  std::string functions;
+  for (size_t i = 0; i < deep; i++) functions += "abs(";
+  functions += "a" + std::string(deep, ')');
+  check(fails_with(compile(functions), "expression too complex"),
+        "deeply nested function calls");
+}
+
+void test_errors() {
+  check(fails_with(compile("a +"), "unexpected end of expression"),
+        "missing operand");
+  check(fails_with(compile("(a"), "expected ')'"), "unclosed parenthesis");
+  check(fails_with(compile("c"), "unknown input vector"), "unknown input");
+  check(fails_with(compile("sqrt(a)"), "unknown function"),
+        "unknown function");
+}
+
+}  // namespace
+
+int main() {
+  test_evaluate();
+  test_nesting();
+  test_errors();
+  if (failures != 0) {
+    fprintf(stderr, "%d checks failed\n", failures);
+    return 1;
+  }
+  printf("all checks passed\n");
+  return 0;
+}
@@ -0,0 +1,622 @@
+/* Copyright (c) 2017, 2024, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License, version 2.0, for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA */
+
+/*
+  Tests of the SIMD kernels against the scalar ones, linked without the
+  server:
+
+    vector_kernels_test
+
+  Every kernel table the CPU supports is compared with the scalar table on
+  unaligned vectors of lengths exercising the tails of the loops, and on the
+  dimensions of the specialized kernels. The element-wise kernels, the
+  integer ones and the conversions must match exactly, the reductions within
+  the rounding of their different summation orders. The fp16 and bf16
+  conversions are also checked against a reference rounding to nearest
+  even. Prints every failed check and exits with 1 if there is one.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "vector_kernels.h"
+
+namespace {
+
+using vector_kernels::cosine_terms;
+using vector_kernels::dimension_kernels;
+using vector_kernels::element_kernels;
+using vector_kernels::isa;
+using vector_kernels::kernel_table;
+using vector_kernels::op_status;
+
+int failures = 0;
+
+void check(bool condition, const char *target, const char *what,
+           uint32_t length) {
+  if (condition) return;
+  fprintf(stderr, "FAILED: %s %s, length %u\n", target, what, length);
+  failures++;
+}
+
+/*
+  a and b agree within the rounding of a sum whose terms have the absolute
+  values summing to `magnitude`.
+*/
+bool close(double a, double b, double magnitude, double tolerance) {
+  return a == b || std::fabs(a - b) <= tolerance * magnitude;
+}
+
+/* Relative tolerances of the float and double reductions. */
+constexpr double float_tolerance = 1e-5;
+constexpr double double_tolerance = 1e-12;
+
+/* The lengths of the loop tails, then a few larger odd ones. */
+std::vector<uint32_t> test_lengths() {
+  std::vector<uint32_t> lengths;
+  for (uint32_t n = 0; n <= 70; n++) lengths.push_back(n);
+  for (uint32_t n : {127, 128, 129, 255, 257, 1000, 1023, 1025, 4099})
+    lengths.push_back(n);
+  return lengths;
+}
+
+constexpr uint32_t max_length = 4099;
+
+uint64_t random_state = 0x853c49e6748fea9bULL;
+
+uint32_t next_random() {
+  random_state =
+      random_state * 6364136223846793005ULL + 1442695040888963407ULL;
+  return static_cast<uint32_t>(random_state >> 32);
+}
+
+/* Uniform in [-1, 1), never zero. */
+float random_float() {
+  float x = static_cast<float>(static_cast<int32_t>(next_random())) / 2.1e9f;
+  return x == 0 ? 0.5f : x;
+}
+
+float float_from_bits(uint32_t bits) {
+  float f;
+  memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+uint32_t bits_from_float(float f) {
+  uint32_t bits;
+  memcpy(&bits, &f, sizeof(bits));
+  return bits;
+}
+
+/* Reference conversions of IEEE binary16, rounding to nearest even. */
+float float_from_fp16(uint16_t h) {
+  const float sign = (h & 0x8000) ? -1.0f : 1.0f;
+  const int exponent = (h >> 10) & 0x1f;
+  const int mantissa = h & 0x3ff;
+  if (exponent == 0x1f)
+    return mantissa == 0 ? sign * HUGE_VALF : std::nanf("");
+  if (exponent == 0) return sign * std::ldexp(float(mantissa), -24);
+  return sign * std::ldexp(float(mantissa + 0x400), exponent - 25);
+}
+
+uint16_t fp16_from_float(float f) {
+  const uint32_t x = bits_from_float(f);
+  const uint16_t sign = (x >> 16) & 0x8000;
+  const uint32_t magnitude = x & 0x7fffffff;
+  if (magnitude > 0x7f800000) return sign | 0x7e00;
+  /* 65520 and above round to the infinity. */
+  if (magnitude >= 0x477ff000) return sign | 0x7c00;
+  if (magnitude < 0x38800000) {
+    /* Subnormal: an exact multiple of 2^-24 once scaled, then rounded. */
+    return sign | static_cast<uint16_t>(std::nearbyint(
+                      std::fabs(f) * 16777216.0f));
+  }
+  const uint32_t mantissa = magnitude & 0x7fffff;
+  uint32_t h = (((magnitude >> 23) - 127 + 15) << 10) | (mantissa >> 13);
+  const uint32_t rest = mantissa & 0x1fff;
+  if (rest > 0x1000 || (rest == 0x1000 && (h & 1))) h++;
+  return sign | static_cast<uint16_t>(h);
+}
+
+float float_from_bf16(uint16_t h) { return float_from_bits(uint32_t{h} << 16); }
+
+uint16_t bf16_from_float(float f) {
+  const uint32_t x = bits_from_float(f);
+  if ((x & 0x7fffffff) > 0x7f800000) return (x >> 16) | 0x40;
+  return static_cast<uint16_t>((x + 0x7fff + ((x >> 16) & 1)) >> 16);
+}
+
+bool same_bits(float a, float b) {
+  return bits_from_float(a) == bits_from_float(b) ||
+         (std::isnan(a) && std::isnan(b));
+}
+
+/*
+  Random operands, one element past 64-byte aligned buffers so that the
+  kernels see unaligned vectors.
+*/
+struct operands {
+  std::vector<float> storage1 = std::vector<float>(max_length + 1);
+  std::vector<float> storage2 = std::vector<float>(max_length + 1);
+  float *a = storage1.data() + 1;
+  float *b = storage2.data() + 1;
+
+  operands() {
+    for (uint32_t i = 0; i < max_length; i++) {
+      a[i] = random_float();
+      b[i] = random_float();
+    }
+  }
+  const char *vec1() const { return reinterpret_cast<const char *>(a); }
+  const char *vec2() const { return reinterpret_cast<const char *>(b); }
+
+  /* Sum of the absolute values of the terms of every float reduction. */
+  double magnitude(uint32_t n) const {
+    double sum = 0;
+    for (uint32_t i = 0; i < n; i++) {
+      const double x = std::fabs(a[i]), y = std::fabs(b[i]);
+      sum += (x + y) * (x + y) + x + y;
+    }
+    return sum;
+  }
+};
+
+/* Compares the float element-wise and distance kernels of n elements. */
+template <class Kernels>
+void compare_float_kernels(const char *target, const Kernels &tested,
+                           const Kernels &reference, const operands &in,
+                           uint32_t n) {
+  std::vector<float> expected(n + 1), result(n + 1);
+  char *expected_out = reinterpret_cast<char *>(expected.data() + 1);
+  char *result_out = reinterpret_cast<char *>(result.data() + 1);
+  const struct {
+    const char *name;
+    vector_kernels::elementwise_fn tested, reference;
+  } elementwise[] = {
+      {"addition", tested.addition, reference.addition},
+      {"subtraction", tested.subtraction, reference.subtraction},
+      {"multiplication", tested.multiplication, reference.multiplication},
+      {"division", tested.division, reference.division},
+  };
+  for (const auto &op : elementwise) {
+    const op_status expected_status =
+        op.reference(n, in.vec1(), in.vec2(), expected_out);
+    check(op.tested(n, in.vec1(), in.vec2(), result_out) == expected_status,
+          target, op.name, n);
+    check(memcmp(expected_out, result_out, n * sizeof(float)) == 0, target,
+          op.name, n);
+  }
+
+  const double magnitude = in.magnitude(n);
+  const struct {
+    const char *name;
+    vector_kernels::reduction_fn tested, reference;
+  } reductions[] = {
+      {"dot", tested.dot, reference.dot},
+      {"l2_squared", tested.l2_squared, reference.l2_squared},
+      {"l1", tested.l1, reference.l1},
+  };
+  for (const auto &op : reductions)
+    check(close(op.tested(n, in.vec1(), in.vec2()),
+                op.reference(n, in.vec1(), in.vec2()), magnitude,
+                float_tolerance),
+          target, op.name, n);
+
+  const cosine_terms expected_terms = reference.cosine(n, in.vec1(), in.vec2());
+  const cosine_terms terms = tested.cosine(n, in.vec1(), in.vec2());
+  check(close(terms.dot, expected_terms.dot, magnitude, float_tolerance) &&
+            close(terms.norm1, expected_terms.norm1, magnitude,
+                  float_tolerance) &&
+            close(terms.norm2, expected_terms.norm2, magnitude,
+                  float_tolerance),
+        target, "cosine", n);
+  const cosine_terms dot_norm = tested.dot_norm(n, in.vec1(), in.vec2());
+  check(close(dot_norm.dot, expected_terms.dot, magnitude, float_tolerance) &&
+            close(dot_norm.norm1, expected_terms.norm1, magnitude,
+                  float_tolerance),
+        target, "dot_norm", n);
+}
+
+void compare_fused(const char *target, const kernel_table &tested,
+                   const kernel_table &scalar, const operands &in,
+                   uint32_t n) {
+  const float s = 0.75f;
+  std::vector<float> expected(n), result(n);
+  const struct {
+    const char *name;
+    vector_kernels::fused_fn tested, reference;
+  } fused[] = {
+      {"scale", tested.scale, scalar.scale},
+      {"axpy", tested.axpy, scalar.axpy},
+      {"lerp", tested.lerp, scalar.lerp},
+  };
+  for (const auto &op : fused) {
+    const op_status expected_status =
+        op.reference(n, s, in.vec1(), in.vec2(),
+                     reinterpret_cast<char *>(expected.data()));
+    check(op.tested(n, s, in.vec1(), in.vec2(),
+                    reinterpret_cast<char *>(result.data())) ==
+              expected_status,
+          target, op.name, n);
+    /* A single FMA rounds once where the scalar kernel rounds twice. */
+    bool equal = true;
+    for (uint32_t i = 0; i < n; i++)
+      equal &= close(result[i], expected[i],
+                     std::fabs(in.a[i]) + std::fabs(in.b[i]), 1e-6);
+    check(equal, target, op.name, n);
+  }
+}
+
+void compare_statuses(const char *target, const kernel_table &tested,
+                      const kernel_table &scalar) {
+  /* A zero divisor and an overflow, each at every position of a tail. */
+  for (uint32_t n = 1; n <= 40; n++) {
+    for (uint32_t position = 0; position < n; position++) {
+      std::vector<float> a(n, 2.0f), b(n, 1.0f), result(n);
+      const char *vec1 = reinterpret_cast<const char *>(a.data());
+      const char *vec2 = reinterpret_cast<const char *>(b.data());
+      char *out = reinterpret_cast<char *>(result.data());
+      b[position] = 0;
+      check(tested.division(n, vec1, vec2, out) ==
+                scalar.division(n, vec1, vec2, out),
+            target, "division by zero", n);
+      b[position] = 1;
+      a[position] = 3e38f;
+      check(tested.addition(n, vec1, vec1, out) ==
+                scalar.addition(n, vec1, vec1, out),
+            target, "addition overflow", n);
+      check(tested.scale(n, 4.0f, vec1, vec2, out) ==
+                scalar.scale(n, 4.0f, vec1, vec2, out),
+            target, "scale overflow", n);
+    }
+  }
+}
+
+/* 64-byte aligned doubles, as accumulate_fn expects. */
+struct aligned_doubles {
+  std::vector<double> storage;
+  double *data;
+
+  explicit aligned_doubles(size_t n) : storage(n + 8, 0.0) {
+    void *p = storage.data();
+    size_t space = storage.size() * sizeof(double);
+    data = static_cast<double *>(std::align(64, n * sizeof(double), p, space));
+  }
+};
+
+void compare_accumulate_and_moments(const char *target,
+                                    const kernel_table &tested,
+                                    const kernel_table &scalar,
+                                    const operands &in, uint32_t n) {
+  aligned_doubles expected(n), result(n);
+  for (uint32_t i = 0; i < n; i++) expected.data[i] = result.data[i] = i;
+  scalar.accumulate(n, in.vec1(), expected.data);
+  tested.accumulate(n, in.vec1(), result.data);
+  check(memcmp(expected.data, result.data, n * sizeof(double)) == 0, target,
+        "accumulate", n);
+
+  std::vector<double> expected_mean(n, 0.25), mean(n, 0.25);
+  std::vector<double> expected_m2(n, 1.0), m2(n, 1.0);
+  std::vector<float> expected_min(n, 0.0f), min(n, 0.0f);
+  std::vector<float> expected_max(n, 0.0f), max(n, 0.0f);
+  scalar.moments(n, in.vec1(), 1.0 / 3, expected_mean.data(),
+                 expected_m2.data(), expected_min.data(),
+                 expected_max.data());
+  tested.moments(n, in.vec1(), 1.0 / 3, mean.data(), m2.data(), min.data(),
+                 max.data());
+  bool equal = expected_min == min && expected_max == max;
+  for (uint32_t i = 0; i < n; i++)
+    equal &= close(mean[i], expected_mean[i], 2, double_tolerance) &&
+             close(m2[i], expected_m2[i], 2, double_tolerance);
+  check(equal, target, "moments", n);
+}
+
+void compare_codes(const char *target, const kernel_table &tested,
+                   const kernel_table &scalar, uint32_t n) {
+  std::vector<char> code1(n + 1), code2(n + 1);
+  for (uint32_t i = 0; i <= n; i++) {
+    code1[i] = static_cast<char>(next_random());
+    code2[i] = static_cast<char>(next_random());
+  }
+  /* The extremes of the signed bytes. */
+  if (n > 1) {
+    code1[1] = code2[1] = -128;
+    code1[n] = 127;
+  }
+  check(tested.int8_dot(n, code1.data() + 1, code2.data() + 1) ==
+            scalar.int8_dot(n, code1.data() + 1, code2.data() + 1),
+        target, "int8_dot", n);
+  check(tested.hamming(n, code1.data() + 1, code2.data() + 1) ==
+            scalar.hamming(n, code1.data() + 1, code2.data() + 1),
+        target, "hamming", n);
+}
+
+void compare_gather_and_panel(const char *target, const kernel_table &tested,
+                              const kernel_table &scalar, const operands &in,
+                              uint32_t n) {
+  /* A sparse vector of n elements over a dense one of max_length. */
+  std::vector<uint32_t> indexes(n);
+  double magnitude = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    indexes[i] = next_random() % max_length;
+    magnitude += std::fabs(double{in.a[i]} * in.b[indexes[i]]);
+  }
+  const char *index_data = reinterpret_cast<const char *>(indexes.data());
+  check(close(tested.gather_dot(n, index_data, in.vec1(), in.vec2()),
+              scalar.gather_dot(n, index_data, in.vec1(), in.vec2()),
+              magnitude, float_tolerance),
+        target, "gather_dot", n);
+
+  /* A panel of n columns. */
+  const uint32_t rows = vector_kernels::panel_rows;
+  std::vector<float> storage(size_t{n} * rows + 16);
+  void *p = storage.data();
+  size_t space = storage.size() * sizeof(float);
+  float *panel = static_cast<float *>(
+      std::align(64, size_t{n} * rows * sizeof(float), p, space));
+  for (size_t i = 0; i < size_t{n} * rows; i++) panel[i] = random_float();
+  float expected[rows], result[rows];
+  std::fill(std::begin(expected), std::end(expected), 1.0f);
+  std::fill(std::begin(result), std::end(result), 1.0f);
+  scalar.panel_gemv(n, panel, in.vec1(), expected);
+  tested.panel_gemv(n, panel, in.vec1(), result);
+  bool equal = true;
+  for (uint32_t r = 0; r < rows; r++) {
+    double row_magnitude = 1;
+    for (uint32_t j = 0; j < n; j++)
+      row_magnitude += std::fabs(panel[j * rows + r] * in.a[j]);
+    equal &= close(result[r], expected[r], row_magnitude, float_tolerance);
+  }
+  check(equal, target, "panel_gemv", n);
+}
+
+void compare_rank_update(const char *target, const kernel_table &tested,
+                         const kernel_table &scalar) {
+  for (uint32_t n : {1, 3, 4, 5, 8, 9, 17, 31, 64, 67}) {
+    for (uint32_t block_rows : {1, 2, 7}) {
+      std::vector<double> block(size_t{block_rows} * n);
+      for (double &x : block) x = random_float();
+      std::vector<double> expected(size_t{n} * n, 0.5), result = expected;
+      for (uint32_t first = 0; first < n;
+           first += vector_kernels::rank_update_rows) {
+        scalar.rank_update(n, first, block_rows, block.data(),
+                           expected.data());
+        tested.rank_update(n, first, block_rows, block.data(), result.data());
+      }
+      /* Only the upper triangle is defined. */
+      bool equal = true;
+      for (uint32_t i = 0; i < n; i++)
+        for (uint32_t j = i; j < n; j++)
+          equal &= close(result[size_t{i} * n + j],
+                         expected[size_t{i} * n + j], block_rows + 1,
+                         double_tolerance);
+      check(equal, target, "rank_update", n);
+    }
+  }
+}
+
+/* The kernels specialized for a dimension against the scalar ones. */
+void compare_specialized(const char *target, const kernel_table &tested,
+                         const kernel_table &scalar, const operands &in) {
+  const dimension_kernels generic = {0,
+                                     scalar.addition,
+                                     scalar.subtraction,
+                                     scalar.multiplication,
+                                     scalar.division,
+                                     scalar.dot,
+                                     scalar.l2_squared,
+                                     scalar.l1,
+                                     scalar.cosine,
+                                     scalar.dot_norm};
+  for (size_t i = 0; i < std::size(vector_kernels::specialized_dimensions);
+       i++) {
+    const uint32_t n = vector_kernels::specialized_dimensions[i];
+    const dimension_kernels kernels = vector_kernels::for_dimension(n);
+    check(kernels.dimension == n, target, "for_dimension", n);
+    if (tested.specialized != nullptr)
+      check(kernels.dot == tested.specialized[i].dot, target,
+            "for_dimension of a specialized dimension", n);
+    compare_float_kernels(target, kernels, generic, in, n);
+  }
+}
+
+/*
+  The 16-bit element kernels of `tested` against the scalar ones and the
+  reference conversions.
+*/
+void compare_element_kernels(const char *target, const char *type,
+                             const element_kernels &tested,
+                             const element_kernels &scalar,
+                             float (*widen)(uint16_t),
+                             uint16_t (*narrow)(float)) {
+  std::string what;
+
+  /* Every 16-bit value widens exactly. */
+  std::vector<uint16_t> all(65536);
+  for (uint32_t i = 0; i < all.size(); i++) all[i] = static_cast<uint16_t>(i);
+  std::vector<float> widened(all.size());
+  tested.widen(all.size(), reinterpret_cast<const char *>(all.data()),
+               reinterpret_cast<char *>(widened.data()));
+  bool equal = true;
+  for (uint32_t i = 0; i < all.size(); i++)
+    equal &= same_bits(widened[i], widen(all[i]));
+  what = std::string(type) + " widen";
+  check(equal, target, what.c_str(), all.size());
+
+  /*
+    Narrowing rounds to nearest even: the floats halfway between two 16-bit
+    values and their neighbours, subnormals and random ones.
+  */
+  std::vector<float> floats;
+  for (uint32_t i = 0; i < 65536; i += 7) {
+    const float low = widen(static_cast<uint16_t>(i));
+    const float high = widen(static_cast<uint16_t>(i + 1));
+    if (!std::isfinite(low) || !std::isfinite(high)) continue;
+    const float halfway = low + (high - low) / 2;
+    floats.push_back(halfway);
+    floats.push_back(std::nextafter(halfway, HUGE_VALF));
+    floats.push_back(std::nextafter(halfway, -HUGE_VALF));
+  }
+  for (float f : {0.0f, -0.0f, 1e-10f, -6e-8f, 3e-8f, 65504.0f, 65519.0f})
+    floats.push_back(f);
+  for (uint32_t i = 0; i < 1000; i++) floats.push_back(random_float() * 1e3f);
+  const uint32_t count = static_cast<uint32_t>(floats.size());
+  std::vector<uint16_t> narrowed(count);
+  what = std::string(type) + " narrow rounding";
+  check(tested.narrow(count, reinterpret_cast<const char *>(floats.data()),
+                      reinterpret_cast<char *>(narrowed.data())) ==
+            op_status::ok,
+        target, what.c_str(), count);
+  equal = true;
+  for (uint32_t i = 0; i < count; i++)
+    equal &= narrowed[i] == narrow(floats[i]);
+  check(equal, target, what.c_str(), count);
+
+  /*
+    Floats out of the range of fp16 or bf16 and NaN, each in a vector long
+    enough for the SIMD loops: the conversion stops at the first vector of
+    elements out of range.
+  */
+  for (float f :
+       {65520.0f, -1e30f, 3.4e38f, -HUGE_VALF, HUGE_VALF, std::nanf("")}) {
+    const std::vector<float> copies(33, f);
+    const char *data = reinterpret_cast<const char *>(copies.data());
+    std::vector<uint16_t> result(copies.size()), expected(copies.size());
+    const op_status status =
+        tested.narrow(copies.size(), data, reinterpret_cast<char *>(
+                                               result.data()));
+    what = std::string(type) + " narrow out of range";
+    check(status == scalar.narrow(copies.size(), data,
+                                  reinterpret_cast<char *>(expected.data())),
+          target, what.c_str(), copies.size());
+    const float rounded = widen(narrow(f));
+    check((status == op_status::ok) == std::isfinite(rounded) &&
+              same_bits(widen(result[0]), rounded),
+          target, what.c_str(), copies.size());
+  }
+
+  /* The element-wise and distance kernels, on every tail. */
+  for (uint32_t n : test_lengths()) {
+    std::vector<uint16_t> a(n + 1), b(n + 1);
+    double magnitude = 0;
+    for (uint32_t i = 0; i <= n; i++) {
+      a[i] = narrow(random_float());
+      b[i] = narrow(random_float());
+      if (widen(b[i]) == 0) b[i] = narrow(0.5f);
+      const double x = std::fabs(widen(a[i])), y = std::fabs(widen(b[i]));
+      if (i < n) magnitude += (x + y) * (x + y) + x + y;
+    }
+    /* One element past the start, so that the vectors are unaligned. */
+    const char *vec1 = reinterpret_cast<const char *>(a.data() + 1);
+    const char *vec2 = reinterpret_cast<const char *>(b.data() + 1);
+    std::vector<uint16_t> expected(n), result(n);
+    char *expected_out = reinterpret_cast<char *>(expected.data());
+    char *result_out = reinterpret_cast<char *>(result.data());
+    const struct {
+      const char *name;
+      vector_kernels::elementwise_fn tested, reference;
+    } elementwise[] = {
+        {"addition", tested.addition, scalar.addition},
+        {"subtraction", tested.subtraction, scalar.subtraction},
+        {"multiplication", tested.multiplication, scalar.multiplication},
+        {"division", tested.division, scalar.division},
+    };
+    for (const auto &op : elementwise) {
+      what = std::string(type) + " " + op.name;
+      check(op.tested(n, vec1, vec2, result_out) ==
+                    op.reference(n, vec1, vec2, expected_out) &&
+                expected == result,
+            target, what.c_str(), n);
+    }
+    const struct {
+      const char *name;
+      vector_kernels::reduction_fn tested, reference;
+    } reductions[] = {
+        {"dot", tested.dot, scalar.dot},
+        {"l2_squared", tested.l2_squared, scalar.l2_squared},
+        {"l1", tested.l1, scalar.l1},
+    };
+    for (const auto &op : reductions) {
+      what = std::string(type) + " " + op.name;
+      check(close(op.tested(n, vec1, vec2), op.reference(n, vec1, vec2),
+                  magnitude, float_tolerance),
+            target, what.c_str(), n);
+    }
+    const cosine_terms expected_terms = scalar.cosine(n, vec1, vec2);
+    const cosine_terms terms = tested.cosine(n, vec1, vec2);
+    what = std::string(type) + " cosine";
+    check(close(terms.dot, expected_terms.dot, magnitude, float_tolerance) &&
+              close(terms.norm1, expected_terms.norm1, magnitude,
+                    float_tolerance) &&
+              close(terms.norm2, expected_terms.norm2, magnitude,
+                    float_tolerance),
+          target, what.c_str(), n);
+  }
+}
+
+void compare_tables(const kernel_table &tested, const kernel_table &scalar) {
+  const char *target = vector_kernels::isa_name(tested.target);
+  const operands in;
+  for (uint32_t n : test_lengths()) {
+    compare_float_kernels(target, tested, scalar, in, n);
+    compare_fused(target, tested, scalar, in, n);
+    compare_accumulate_and_moments(target, tested, scalar, in, n);
+    compare_codes(target, tested, scalar, n);
+    compare_gather_and_panel(target, tested, scalar, in, n);
+  }
+  compare_statuses(target, tested, scalar);
+  compare_rank_update(target, tested, scalar);
+  compare_specialized(target, tested, scalar, in);
+  compare_element_kernels(target, "fp16", tested.fp16, scalar.fp16,
+                          float_from_fp16, fp16_from_float);
+  compare_element_kernels(target, "bf16", tested.bf16, scalar.bf16,
+                          float_from_bf16, bf16_from_float);
+}
+
+}  // namespace
+
+int main() {
+  vector_kernels::select(isa::scalar);
+  const kernel_table &scalar = vector_kernels::active();
+  /* The scalar conversions are checked against the reference ones too. */
+  compare_tables(scalar, scalar);
+  for (isa target : {isa::sse2, isa::avx2, isa::avx512, isa::avx512_vnni}) {
+    if (vector_kernels::select(target)) {
+      printf("%s: not supported, skipped\n", vector_kernels::isa_name(target));
+      continue;
+    }
+    compare_tables(vector_kernels::active(), scalar);
+    printf("%s: compared\n", vector_kernels::isa_name(target));
+  }
+  if (failures != 0) {
+    fprintf(stderr, "%d checks failed\n", failures);
+    return 1;
+  }
+  printf("all checks passed\n");
+  return 0;
+}
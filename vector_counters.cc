@@ -0,0 +1,135 @@
+/* Copyright (c) 2017, 2024, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License, version 2.0, for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA */
+
+#include "vector_counters.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+
+namespace vector_counters {
+
+namespace {
+
+const char *const error_names[error_kinds] = {
+    "size_mismatch", "division_by_zero", "out_of_range", "out_of_memory",
+    "other"};
+
+const char *const latency_names[latency_buckets] = {
+    "under_1us", "under_10us", "under_100us", "under_1ms", "under_10ms",
+    "over_10ms"};
+
+/* Appends to a buffer of fixed size, dropping what does not fit. */
+struct json_writer {
+  char *pos;
+  char *end;
+
+  template <class... Args>
+  void append(const char *format, Args... args) {
+    if (pos >= end) return;
+    int length = snprintf(pos, end - pos, format, args...);
+    pos = length < 0 || length >= end - pos ? end : pos + length;
+  }
+
+  /* Appends , "name": {"names[0]": values[0], ...}. */
+  void append_object(const char *name, const char *const *names,
+                     const uint64_t *values, size_t count) {
+    append(", \"%s\": {", name);
+    for (size_t i = 0; i < count; i++)
+      append(i == 0 ? "\"%s\": %" PRIu64 : ", \"%s\": %" PRIu64, names[i],
+             values[i]);
+    append("}");
+  }
+};
+
+}  // namespace
+
+void totals::to_json(char *buffer, size_t size) const {
+  if (size == 0) return;
+  buffer[0] = '\0';
+  json_writer json{buffer, buffer + size};
+  json.append("{\"calls\": %" PRIu64, calls);
+  json.append_object("errors", error_names, errors, error_kinds);
+  json.append(", \"bytes_in\": %" PRIu64 ", \"bytes_out\": %" PRIu64
+              ", \"time_ns\": %" PRIu64,
+              bytes_in, bytes_out, nanoseconds);
+  json.append_object("latency", latency_names, latency, latency_buckets);
+  json.append("}");
+}
+
+registry::registry()
+    : m_shards(new function_counters[shard_count * max_functions]()) {
+  m_names.reserve(max_functions);
+
+  /* Measures the rate of the ticks against the clock for a millisecond. */
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  uint64_t start_ticks = ticks();
+  std::chrono::nanoseconds elapsed;
+  do {
+    elapsed = std::chrono::steady_clock::now() - start;
+  } while (elapsed < std::chrono::milliseconds(1));
+  m_tick_ns = static_cast<double>(elapsed.count()) /
+              static_cast<double>(std::max<uint64_t>(ticks() - start_ticks, 1));
+  for (size_t i = 0; i < latency_buckets - 1; i++)
+    m_tick_bounds[i] =
+        static_cast<uint64_t>(static_cast<double>(latency_bounds[i]) /
+                              m_tick_ns);
+}
+
+uint32_t registry::add(const char *name) {
+  std::lock_guard<std::mutex> guard(m_lock);
+  uint32_t slot = m_size.load(std::memory_order_relaxed);
+  if (slot == max_functions) return max_functions;
+  m_names.emplace_back(name);
+  m_size.store(slot + 1, std::memory_order_release);
+  return slot;
+}
+
+uint32_t registry::shard() {
+  static std::atomic<uint32_t> next_shard{0};
+  thread_local const uint32_t shard =
+      next_shard.fetch_add(1, std::memory_order_relaxed) % shard_count;
+  return shard;
+}
+
+totals registry::read(uint32_t slot) const {
+  totals sum;
+  if (slot >= max_functions) return sum;
+  for (uint32_t s = 0; s < shard_count; s++) {
+    const function_counters &c = m_shards[s * max_functions + slot];
+    for (size_t i = 0; i < error_kinds; i++)
+      sum.errors[i] += c.values[errors + i].load(std::memory_order_relaxed);
+    sum.bytes_in += c.values[input].load(std::memory_order_relaxed);
+    sum.bytes_out += c.values[output].load(std::memory_order_relaxed);
+    sum.nanoseconds += c.values[time].load(std::memory_order_relaxed);
+    for (size_t i = 0; i < latency_buckets; i++)
+      sum.latency[i] += c.values[latency + i].load(std::memory_order_relaxed);
+  }
+  for (size_t i = 0; i < latency_buckets; i++) sum.calls += sum.latency[i];
+  sum.nanoseconds =
+      static_cast<uint64_t>(static_cast<double>(sum.nanoseconds) * m_tick_ns);
+  return sum;
+}
+
+}  // namespace vector_counters
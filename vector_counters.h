@@ -0,0 +1,171 @@
+/* Copyright (c) 2017, 2024, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License, version 2.0, for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA */
+
+#ifndef VECTOR_COUNTERS_H
+#define VECTOR_COUNTERS_H
+
+/*
+  Per-function performance counters of the component UDFs: calls, errors by
+  kind, bytes read and written, and the time spent, in total and as a
+  latency histogram.
+
+  The counters are kept in shards, every thread updating the shard it was
+  assigned on its first call with relaxed atomic additions, so concurrent
+  calls do not contend on the same cache lines. They are only summed over
+  the shards when they are read. The calls are timed with the time stamp
+  counter on x86-64, cheaper to read than the system clock, the ticks being
+  converted to nanoseconds when the counters are read.
+*/
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+namespace vector_counters {
+
+/* A timestamp in ticks of an unspecified constant rate. */
+inline uint64_t ticks() {
+#if defined(__x86_64__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+enum class error_kind {
+  none,
+  size_mismatch,
+  division_by_zero,
+  out_of_range,
+  out_of_memory,
+  other
+};
+
+constexpr size_t error_kinds = 5;  // the kinds after none
+
+/* Upper bounds of the latency buckets in ns, the last one is unbounded. */
+constexpr uint64_t latency_bounds[] = {1000, 10000, 100000, 1000000,
+                                       10000000};
+constexpr size_t latency_buckets = std::size(latency_bounds) + 1;
+
+/* Functions that can be counted, and threads updating distinct shards. */
+constexpr uint32_t max_functions = 64;
+constexpr uint32_t shard_count = 32;
+
+/* The counters of a function summed over the shards. */
+struct totals {
+  uint64_t calls = 0;
+  uint64_t errors[error_kinds] = {};
+  uint64_t bytes_in = 0;
+  uint64_t bytes_out = 0;
+  uint64_t nanoseconds = 0;
+  uint64_t latency[latency_buckets] = {};
+
+  /*
+    Writes the totals as a JSON object of at most `size` bytes to `buffer`,
+    truncated if it is too small.
+  */
+  void to_json(char *buffer, size_t size) const;
+};
+
+class registry {
+ public:
+  registry();
+
+  registry(const registry &) = delete;
+  registry &operator=(const registry &) = delete;
+
+  /*
+    Adds the counters of function `name` and returns their slot, or
+    max_functions if all the slots are used.
+  */
+  uint32_t add(const char *name);
+
+  uint32_t size() const { return m_size.load(std::memory_order_acquire); }
+  const std::string &name(uint32_t slot) const { return m_names[slot]; }
+
+  /* Counts a call of the function of `slot` that took `elapsed` ticks(). */
+  void record(uint32_t slot, uint64_t elapsed, uint64_t bytes_in,
+              uint64_t bytes_out, error_kind error) {
+    if (slot >= max_functions) return;
+    function_counters &c = m_shards[shard() * max_functions + slot];
+    size_t bucket = 0;
+    while (bucket < latency_buckets - 1 && elapsed >= m_tick_bounds[bucket])
+      bucket++;
+    c.values[latency + bucket].fetch_add(1, std::memory_order_relaxed);
+    c.values[time].fetch_add(elapsed, std::memory_order_relaxed);
+    if (bytes_in != 0)
+      c.values[input].fetch_add(bytes_in, std::memory_order_relaxed);
+    if (bytes_out != 0)
+      c.values[output].fetch_add(bytes_out, std::memory_order_relaxed);
+    if (error != error_kind::none)
+      c.values[errors + static_cast<size_t>(error) - 1].fetch_add(
+          1, std::memory_order_relaxed);
+  }
+
+  totals read(uint32_t slot) const;
+
+ private:
+  /* Indexes of the counters in function_counters::values. */
+  enum : size_t {
+    errors = 0,
+    input = errors + error_kinds,
+    output,
+    time,
+    latency,
+    counter_count = latency + latency_buckets
+  };
+
+  /* The calls are the sum of the latency buckets, not counted apart. */
+  struct alignas(64) function_counters {
+    std::atomic<uint64_t> values[counter_count];
+  };
+
+  /* The shard of the calling thread. */
+  static uint32_t shard();
+
+  /* Nanoseconds per tick, and latency_bounds in ticks. */
+  double m_tick_ns;
+  uint64_t m_tick_bounds[latency_buckets - 1];
+
+  std::unique_ptr<function_counters[]> m_shards;
+  std::mutex m_lock;  // add()
+  std::vector<std::string> m_names;
+  std::atomic<uint32_t> m_size{0};
+};
+
+}  // namespace vector_counters
+
+#endif /* VECTOR_COUNTERS_H */
@@ -0,0 +1,417 @@
+/* Copyright (c) 2017, 2024, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License, version 2.0, for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA */
+
+#include "vector_expression.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <new>
+#include <string>
+
+/*
+  Recursive descent parser building the expression tree, folding constant
+  subexpressions as the nodes are created:
+
+    expr    := term (('+' | '-') term)*
+    term    := unary (('*' | '/') unary)*
+    unary   := '-' unary | primary
+    primary := number | input | function '(' expr (',' expr)* ')'
+             | '(' expr ')'
+
+  The parse functions return the index of the node in `nodes`, or -1 after
+  setting `error`. Every level of nesting, of parentheses, function
+  arguments or unary operators, goes through unary(), which bounds the
+  recursion to max_depth levels whatever the number of nodes: parentheses
+  and unary '+' add no node.
+*/
+class vector_expression::parser {
+ public:
+  enum class node_kind { constant, input, unary, binary };
+
+  struct node {
+    node_kind kind;
+    opcode op;
+    float value;         // constant
+    unsigned int input;  // input
+    int left;
+    int right;
+  };
+
+  parser(const char *text, size_t length, unsigned int n_inputs,
+         std::string *error)
+      : m_pos(text), m_end(text + length), m_begin(text),
+        m_n_inputs(n_inputs), m_error(error) {}
+
+  int parse() {
+    int root = expr();
+    if (root < 0) return -1;
+    skip_spaces();
+    if (m_pos != m_end) return fail("unexpected character");
+    return root;
+  }
+
+  std::vector<node> nodes;
+
+ private:
+  static constexpr size_t max_nodes = 2 * max_instructions;
+  static constexpr unsigned int max_depth = 128;
+
+  void skip_spaces() {
+    while (m_pos < m_end && (*m_pos == ' ' || *m_pos == '\t' ||
+                             *m_pos == '\n' || *m_pos == '\r'))
+      m_pos++;
+  }
+
+  bool accept(char c) {
+    skip_spaces();
+    if (m_pos < m_end && *m_pos == c) {
+      m_pos++;
+      return true;
+    }
+    return false;
+  }
+
+  int fail(const char *message) {
+    *m_error = std::string(message) + " at position " +
+               std::to_string(m_pos - m_begin + 1);
+    return -1;
+  }
+
+  int add(const node &n) {
+    if (nodes.size() >= max_nodes) return fail("expression too complex");
+    nodes.push_back(n);
+    return static_cast<int>(nodes.size() - 1);
+  }
+
+  int constant(float value) {
+    return add({node_kind::constant, opcode::mov, value, 0, -1, -1});
+  }
+
+  static float fold(opcode op, float a, float b) {
+    switch (op) {
+      case opcode::mov:
+        return a;
+      case opcode::neg:
+        return -a;
+      case opcode::abs:
+        return std::fabs(a);
+      case opcode::add:
+        return a + b;
+      case opcode::sub:
+        return a - b;
+      case opcode::mul:
+        return a * b;
+      case opcode::div:
+        return a / b;
+      case opcode::min:
+        return std::min(a, b);
+      case opcode::max:
+        return std::max(a, b);
+    }
+    return 0;
+  }
+
+  int unary_node(opcode op, int child) {
+    if (child < 0) return -1;
+    if (nodes[child].kind == node_kind::constant)
+      return constant(fold(op, nodes[child].value, 0));
+    return add({node_kind::unary, op, 0, 0, child, -1});
+  }
+
+  int binary_node(opcode op, int left, int right) {
+    if (left < 0 || right < 0) return -1;
+    if (nodes[left].kind == node_kind::constant &&
+        nodes[right].kind == node_kind::constant)
+      return constant(fold(op, nodes[left].value, nodes[right].value));
+    return add({node_kind::binary, op, 0, 0, left, right});
+  }
+
+  int expr() {
+    int left = term();
+    while (left >= 0) {
+      if (accept('+'))
+        left = binary_node(opcode::add, left, term());
+      else if (accept('-'))
+        left = binary_node(opcode::sub, left, term());
+      else
+        break;
+    }
+    return left;
+  }
+
+  int term() {
+    int left = unary();
+    while (left >= 0) {
+      if (accept('*'))
+        left = binary_node(opcode::mul, left, unary());
+      else if (accept('/'))
+        left = binary_node(opcode::div, left, unary());
+      else
+        break;
+    }
+    return left;
+  }
+
+  int unary() {
+    if (m_depth == max_depth) return fail("expression too complex");
+    m_depth++;
+    int result;
+    if (accept('-'))
+      result = unary_node(opcode::neg, unary());
+    else if (accept('+'))
+      result = unary();
+    else
+      result = primary();
+    m_depth--;
+    return result;
+  }
+
+  /* Parses the n comma separated arguments of a function. */
+  bool arguments(int *args, unsigned int n) {
+    if (!accept('(')) {
+      fail("expected '('");
+      return false;
+    }
+    for (unsigned int i = 0; i < n; i++) {
+      if (i > 0 && !accept(',')) {
+        fail("expected ','");
+        return false;
+      }
+      args[i] = expr();
+      if (args[i] < 0) return false;
+    }
+    if (!accept(')')) {
+      fail("expected ')'");
+      return false;
+    }
+    return true;
+  }
+
+  int primary() {
+    skip_spaces();
+    if (m_pos == m_end) return fail("unexpected end of expression");
+
+    if (accept('(')) {
+      int inner = expr();
+      if (inner < 0) return -1;
+      if (!accept(')')) return fail("expected ')'");
+      return inner;
+    }
+
+    if ((*m_pos >= '0' && *m_pos <= '9') || *m_pos == '.') {
+      float value;
+      auto parsed = std::from_chars(m_pos, m_end, value);
+      if (parsed.ec != std::errc()) return fail("invalid number");
+      m_pos = parsed.ptr;
+      return constant(value);
+    }
+
+    const char *name = m_pos;
+    while (m_pos < m_end &&
+           std::isalpha(static_cast<unsigned char>(*m_pos)))
+      m_pos++;
+    size_t name_length = m_pos - name;
+    if (name_length == 0) return fail("unexpected character");
+
+    skip_spaces();
+    if (m_pos < m_end && *m_pos == '(') {
+      int args[3];
+      std::string function(name, name_length);
+      if (function == "abs") {
+        if (!arguments(args, 1)) return -1;
+        return unary_node(opcode::abs, args[0]);
+      }
+      if (function == "min" || function == "max") {
+        if (!arguments(args, 2)) return -1;
+        return binary_node(function == "min" ? opcode::min : opcode::max,
+                           args[0], args[1]);
+      }
+      if (function == "clamp") {
+        if (!arguments(args, 3)) return -1;
+        return binary_node(opcode::min,
+                           binary_node(opcode::max, args[0], args[1]),
+                           args[2]);
+      }
+      m_pos = name;
+      return fail("unknown function");
+    }
+
+    unsigned int input = std::tolower(static_cast<unsigned char>(*name)) - 'a';
+    if (name_length != 1 || input >= m_n_inputs) {
+      m_pos = name;
+      return fail("unknown input vector");
+    }
+    return add({node_kind::input, opcode::mov, 0, input, -1, -1});
+  }
+
+  const char *m_pos;
+  const char *m_end;
+  const char *m_begin;
+  unsigned int m_n_inputs;
+  std::string *m_error;
+  unsigned int m_depth = 0;  // nested unary() calls
+};
+
+bool vector_expression::compile(const char *text, size_t length,
+                                unsigned int n_inputs, std::string *error) {
+  m_program.clear();
+  m_constants.clear();
+  m_inputs = std::min(n_inputs, max_inputs);
+  m_registers = 0;
+  m_used_inputs = 0;
+
+  try {
+    parser p(text, length, m_inputs, error);
+    int root = p.parse();
+    if (root < 0) return true;
+
+    /*
+      Register allocation follows the evaluation stack: the result of a node
+      evaluated at depth d goes to register d, so a binary node only keeps
+      its left operand alive while its right operand is evaluated.
+    */
+    bool failed = false;
+    auto gen = [&](auto &self, int index, unsigned int depth) -> operand {
+      const parser::node &n = p.nodes[index];
+      switch (n.kind) {
+        case parser::node_kind::constant:
+          m_constants.push_back(n.value);
+          return {operand_kind::constant,
+                  static_cast<unsigned int>(m_constants.size() - 1)};
+        case parser::node_kind::input:
+          m_used_inputs |= 1u << n.input;
+          return {operand_kind::input, n.input};
+        case parser::node_kind::unary: {
+          operand a = self(self, n.left, depth);
+          m_program.push_back({n.op, depth, a, a});
+          break;
+        }
+        case parser::node_kind::binary: {
+          operand a = self(self, n.left, depth);
+          operand b = self(self, n.right,
+                           depth + (a.kind == operand_kind::reg ? 1 : 0));
+          m_program.push_back({n.op, depth, a, b});
+          break;
+        }
+      }
+      if (depth >= max_registers) failed = true;
+      m_registers = std::max(m_registers, depth + 1);
+      return {operand_kind::reg, depth};
+    };
+
+    operand result = gen(gen, root, 0);
+    if (result.kind != operand_kind::reg)
+      m_program.push_back({opcode::mov, 0, result, result});
+    m_registers = std::max(m_registers, 1u);
+
+    if (failed || m_program.size() > max_instructions) {
+      *error = "expression too complex";
+      return true;
+    }
+
+    m_register_blocks.assign(m_registers * block_size, 0.0f);
+    m_input_blocks.assign(m_inputs * block_size, 0.0f);
+    m_constant_blocks.resize(m_constants.size() * block_size);
+    for (size_t i = 0; i < m_constants.size(); i++)
+      std::fill_n(m_constant_blocks.begin() + i * block_size, block_size,
+                  m_constants[i]);
+  } catch (const std::bad_alloc &) {
+    *error = "Out of memory";
+    return true;
+  }
+  return false;
+}
+
+const float *vector_expression::block_of(const operand &op) const {
+  switch (op.kind) {
+    case operand_kind::reg:
+      return &m_register_blocks[op.index * block_size];
+    case operand_kind::input:
+      return &m_input_blocks[op.index * block_size];
+    case operand_kind::constant:
+      return &m_constant_blocks[op.index * block_size];
+  }
+  return nullptr;
+}
+
+vector_kernels::op_status vector_expression::evaluate(
+    uint32_t vec_dim, const char *const *inputs, char *result) {
+  bool out_of_range = false;
+
+  for (uint32_t start = 0; start < vec_dim; start += block_size) {
+    const uint32_t n = std::min(block_size, vec_dim - start);
+
+    for (unsigned int i = 0; i < m_inputs; i++) {
+      if (m_used_inputs & (1u << i))
+        memcpy(&m_input_blocks[i * block_size],
+               inputs[i] + start * sizeof(float), n * sizeof(float));
+    }
+
+    /* Each instruction is a simple loop the compiler vectorizes. */
+    for (const instruction &ins : m_program) {
+      float *d = &m_register_blocks[ins.dst * block_size];
+      const float *a = block_of(ins.a);
+      const float *b = block_of(ins.b);
+      switch (ins.op) {
+        case opcode::mov:
+          for (uint32_t i = 0; i < n; i++) d[i] = a[i];
+          break;
+        case opcode::neg:
+          for (uint32_t i = 0; i < n; i++) d[i] = -a[i];
+          break;
+        case opcode::abs:
+          for (uint32_t i = 0; i < n; i++) d[i] = std::fabs(a[i]);
+          break;
+        case opcode::add:
+          for (uint32_t i = 0; i < n; i++) d[i] = a[i] + b[i];
+          break;
+        case opcode::sub:
+          for (uint32_t i = 0; i < n; i++) d[i] = a[i] - b[i];
+          break;
+        case opcode::mul:
+          for (uint32_t i = 0; i < n; i++) d[i] = a[i] * b[i];
+          break;
+        case opcode::div:
+          for (uint32_t i = 0; i < n; i++) d[i] = a[i] / b[i];
+          break;
+        case opcode::min:
+          for (uint32_t i = 0; i < n; i++) d[i] = b[i] < a[i] ? b[i] : a[i];
+          break;
+        case opcode::max:
+          for (uint32_t i = 0; i < n; i++) d[i] = a[i] < b[i] ? b[i] : a[i];
+          break;
+      }
+    }
+
+    const float *r = &m_register_blocks[0];
+    bool bad = false;
+    for (uint32_t i = 0; i < n; i++) bad |= !std::isfinite(r[i]);
+    out_of_range |= bad;
+    memcpy(result + start * sizeof(float), r, n * sizeof(float));
+  }
+
+  return out_of_range ? vector_kernels::op_status::out_of_range
+                      : vector_kernels::op_status::ok;
+}
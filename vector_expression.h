@@ -0,0 +1,106 @@
+/* Copyright (c) 2017, 2024, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License, version 2.0, for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA */
+
+#ifndef VECTOR_EXPRESSION_H
+#define VECTOR_EXPRESSION_H
+
+/*
+  Element-wise vector expressions of VECTOR_EVAL.
+
+  An expression such as "a*0.3 + b*0.7 - c" is compiled once into a small
+  register-based bytecode: the single letters a, b, c, ... name the input
+  vectors (a is the first one), numbers are scalars broadcast to every
+  dimension, and the operators are + - * / (and unary -) with the functions
+  min(x, y), max(x, y), abs(x) and clamp(x, lo, hi). Constant subexpressions
+  are folded at compile time.
+
+  evaluate() runs the program over blocks of `block_size` dimensions, so the
+  registers of a block stay in L1 and every input is read exactly once.
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "vector_kernels.h"
+
+class vector_expression {
+ public:
+  static constexpr uint32_t block_size = 256;
+  static constexpr unsigned int max_inputs = 26;
+  static constexpr unsigned int max_registers = 32;
+  static constexpr size_t max_instructions = 256;
+
+  /*
+    Compiles `text` for n_inputs input vectors. Returns true and sets `error`
+    if the expression is invalid or uses more inputs than n_inputs.
+  */
+  bool compile(const char *text, size_t length, unsigned int n_inputs,
+               std::string *error);
+
+  /* Number of input vectors the expression reads. */
+  unsigned int inputs() const { return m_inputs; }
+
+  /*
+    Evaluates the expression over vec_dim dimensions of the (unaligned)
+    inputs into result. Returns op_status::out_of_range if an element of the
+    result is not finite.
+  */
+  vector_kernels::op_status evaluate(uint32_t vec_dim,
+                                     const char *const *inputs,
+                                     char *result);
+
+ private:
+  enum class opcode { mov, neg, abs, add, sub, mul, div, min, max };
+
+  enum class operand_kind { reg, input, constant };
+
+  struct operand {
+    operand_kind kind;
+    unsigned int index;  // register, input or constant number
+  };
+
+  struct instruction {
+    opcode op;
+    unsigned int dst;
+    operand a;
+    operand b;
+  };
+
+  class parser;
+
+  const float *block_of(const operand &op) const;
+
+  std::vector<instruction> m_program;
+  std::vector<float> m_constants;
+  unsigned int m_inputs = 0;
+  unsigned int m_registers = 0;
+  uint32_t m_used_inputs = 0;  // bit i set if input i is read
+
+  /* Per-block working memory: registers, loaded inputs, constants. */
+  std::vector<float> m_register_blocks;
+  std::vector<float> m_input_blocks;
+  std::vector<float> m_constant_blocks;
+};
+
+#endif /* VECTOR_EXPRESSION_H */
@@ -0,0 +1,419 @@
+/* Copyright (c) 2017, 2024, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License, version 2.0, for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA */
+
+#include "vector_index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <queue>
+
+#include "vector_kernels.h"
+#include "vector_random.h"
+
+struct hnsw_index::node {
+  node(long long row_id, uint32_t node_level, const char *vec,
+       size_t vec_bytes, uint32_t m)
+      : id(row_id), level(node_level), data(new char[vec_bytes]),
+        links(node_level + 1) {
+    memcpy(data.get(), vec, vec_bytes);
+    links[0].reserve(2 * m + 1);
+    for (uint32_t l = 1; l <= node_level; l++) links[l].reserve(m + 1);
+  }
+
+  const long long id;
+  const uint32_t level;
+  const std::unique_ptr<char[]> data;  // the floats of the vector
+  std::mutex lock;                     // links
+  std::vector<std::vector<uint32_t>> links;
+};
+
+/*
+  Visited marks of a search: node n was visited by the current search if
+  marks[n] == epoch, so the marks are only cleared when the epoch wraps
+  around. The index keeps the marks of its finished searches for the next
+  ones, up to max_free_marks of them, and accounts their memory.
+*/
+struct hnsw_index::visited_marks {
+  std::vector<uint32_t> marks;
+  uint32_t epoch = 0;
+
+  /* Marks node n, returning true if it was already visited. */
+  bool visit(uint32_t n) {
+    if (marks[n] == epoch) return true;
+    marks[n] = epoch;
+    return false;
+  }
+};
+
+/* The marks of a search, taken from the index and given back to it. */
+class hnsw_index::visited_lease {
+ public:
+  /* Marks for the `nodes` nodes of index. Throws std::bad_alloc on OOM. */
+  visited_lease(const hnsw_index &index, size_t nodes) : m_index(index) {
+    {
+      std::lock_guard<std::mutex> guard(index.m_marks_lock);
+      if (!index.m_free_marks.empty()) {
+        m_marks = std::move(index.m_free_marks.back());
+        index.m_free_marks.pop_back();
+      }
+    }
+    if (m_marks == nullptr) m_marks.reset(new visited_marks());
+    if (m_marks->marks.size() < nodes) {
+      index.release_marks(m_marks->marks.size() * sizeof(uint32_t));
+      m_marks->marks = std::vector<uint32_t>();
+      m_marks->marks.resize(nodes, 0);
+      m_marks->epoch = 0;
+      index.account_marks(nodes * sizeof(uint32_t));
+    }
+    if (++m_marks->epoch == 0) {
+      std::fill(m_marks->marks.begin(), m_marks->marks.end(), 0);
+      m_marks->epoch = 1;
+    }
+  }
+
+  ~visited_lease() {
+    if (m_marks == nullptr) return;
+    std::lock_guard<std::mutex> guard(m_index.m_marks_lock);
+    if (m_index.m_free_marks.size() < max_free_marks) {
+      try {
+        m_index.m_free_marks.push_back(std::move(m_marks));
+        return;
+      } catch (const std::bad_alloc &) {
+      }
+    }
+    m_index.release_marks(m_marks->marks.size() * sizeof(uint32_t));
+  }
+
+  visited_lease(const visited_lease &) = delete;
+  visited_lease &operator=(const visited_lease &) = delete;
+
+  visited_marks *operator->() const { return m_marks.get(); }
+
+ private:
+  const hnsw_index &m_index;
+  std::unique_ptr<visited_marks> m_marks;
+};
+
+hnsw_index::hnsw_index(uint32_t vec_dim, index_memory *memory, uint32_t m,
+                       uint32_t ef_construction)
+    : m_vec_dim(vec_dim), m_m(std::max(m, 2u)),
+      m_ef_construction(std::max(ef_construction, m)),
+      m_level_factor(1.0 / std::log(static_cast<double>(std::max(m, 2u)))),
+      m_memory(memory) {}
+
+hnsw_index::~hnsw_index() {
+  m_memory->release(m_memory_used.load() + m_marks_used.load());
+}
+
+void hnsw_index::account_marks(size_t bytes) const {
+  m_memory->reserve(bytes, SIZE_MAX);
+  m_marks_used += bytes;
+}
+
+void hnsw_index::release_marks(size_t bytes) const {
+  m_memory->release(bytes);
+  m_marks_used -= bytes;
+}
+
+size_t hnsw_index::size() const {
+  std::shared_lock<std::shared_mutex> guard(m_lock);
+  return m_nodes.size();
+}
+
+float hnsw_index::distance(const char *query, uint32_t n) const {
+  return vector_kernels::active().l2_squared(m_vec_dim, query,
+                                             m_nodes[n]->data.get());
+}
+
+uint32_t hnsw_index::random_level() {
+  double u;
+  {
+    std::lock_guard<std::mutex> guard(m_random_lock);
+    u = vector_random::next_uniform(&m_random_state);
+  }
+  /* In (0, 1], for the logarithm. */
+  u += 0x1.0p-53;
+  double level = -std::log(u) * m_level_factor;
+  return level >= max_level ? max_level : static_cast<uint32_t>(level);
+}
+
+/* Estimate of the heap memory of a node of the given level. */
+size_t hnsw_index::node_bytes(uint32_t level) const {
+  size_t links = 2 * m_m + 1 + level * (m_m + 1);
+  return sizeof(node) + m_vec_dim * sizeof(float) +
+         links * sizeof(uint32_t) +
+         (level + 1) * sizeof(std::vector<uint32_t>) +
+         sizeof(std::unique_ptr<node>) +
+         4 * sizeof(void *);  // id map entry
+}
+
+/* Moves greedily toward the query on levels from_level down to to_level. */
+uint32_t hnsw_index::greedy_descend(const char *query, uint32_t entry,
+                                    int from_level, int to_level) const {
+  uint32_t current = entry;
+  float current_distance = distance(query, current);
+  std::vector<uint32_t> links;
+  for (int level = from_level; level >= to_level; level--) {
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      {
+        node &n = *m_nodes[current];
+        std::lock_guard<std::mutex> guard(n.lock);
+        links = n.links[level];
+      }
+      for (uint32_t next : links) {
+        float d = distance(query, next);
+        if (d < current_distance) {
+          current = next;
+          current_distance = d;
+          changed = true;
+        }
+      }
+    }
+  }
+  return current;
+}
+
+/*
+  Best-first search of one level from `entry`, keeping the ef nearest nodes
+  found; returns them in no particular order.
+*/
+std::vector<hnsw_index::candidate> hnsw_index::search_level(
+    const char *query, uint32_t entry, uint32_t ef, int level) const {
+  std::priority_queue<candidate, std::vector<candidate>,
+                      std::greater<candidate>>
+      frontier;                                // nearest first
+  std::priority_queue<candidate> nearest;      // farthest first
+  visited_lease visited(*this, m_nodes.size());
+
+  visited->visit(entry);
+  float d = distance(query, entry);
+  frontier.emplace(d, entry);
+  nearest.emplace(d, entry);
+
+  std::vector<uint32_t> links;
+  while (!frontier.empty()) {
+    candidate c = frontier.top();
+    if (c.first > nearest.top().first && nearest.size() >= ef) break;
+    frontier.pop();
+
+    {
+      node &n = *m_nodes[c.second];
+      std::lock_guard<std::mutex> guard(n.lock);
+      links = n.links[level];
+    }
+    for (uint32_t next : links) {
+      if (visited->visit(next)) continue;
+      d = distance(query, next);
+      if (nearest.size() < ef || d < nearest.top().first) {
+        frontier.emplace(d, next);
+        nearest.emplace(d, next);
+        if (nearest.size() > ef) nearest.pop();
+      }
+    }
+  }
+
+  std::vector<candidate> result;
+  result.reserve(nearest.size());
+  while (!nearest.empty()) {
+    result.push_back(nearest.top());
+    nearest.pop();
+  }
+  return result;
+}
+
+/*
+  Neighbor selection heuristic: a candidate is kept only if it is nearer to
+  the base node than to every neighbor already kept, which favors links in
+  different directions over a cluster of close nodes.
+*/
+std::vector<uint32_t> hnsw_index::select_neighbors(
+    std::vector<candidate> candidates, uint32_t max_links) const {
+  std::sort(candidates.begin(), candidates.end());
+  std::vector<uint32_t> selected;
+  selected.reserve(max_links);
+  for (const candidate &c : candidates) {
+    if (selected.size() >= max_links) break;
+    const char *vec = m_nodes[c.second]->data.get();
+    bool keep = true;
+    for (uint32_t s : selected) {
+      if (distance(vec, s) < c.first) {
+        keep = false;
+        break;
+      }
+    }
+    if (keep) selected.push_back(c.second);
+  }
+  return selected;
+}
+
+/* Adds the link from -> to on `level`, pruning the links of `from` if full. */
+void hnsw_index::link(uint32_t from, uint32_t to, int level) {
+  node &n = *m_nodes[from];
+  const uint32_t max_links = level == 0 ? 2 * m_m : m_m;
+  std::lock_guard<std::mutex> guard(n.lock);
+  std::vector<uint32_t> &links = n.links[level];
+  if (std::find(links.begin(), links.end(), to) != links.end()) return;
+  if (links.size() < max_links) {
+    links.push_back(to);
+    return;
+  }
+
+  std::vector<candidate> candidates;
+  candidates.reserve(links.size() + 1);
+  const char *vec = n.data.get();
+  for (uint32_t l : links) candidates.emplace_back(distance(vec, l), l);
+  candidates.emplace_back(distance(vec, to), to);
+  std::vector<uint32_t> selected = select_neighbors(candidates, max_links);
+  links.assign(selected.begin(), selected.end());
+}
+
+hnsw_index::add_status hnsw_index::add(long long id, const char *vec,
+                                       size_t memory_limit) {
+  const uint32_t level = random_level();
+  const size_t bytes = node_bytes(level);
+  if (m_memory->reserve(bytes, memory_limit)) return add_status::memory_limit;
+
+  uint32_t n;
+  uint32_t entry;
+  int top_level;
+  try {
+    std::unique_ptr<node> new_node(
+        new node(id, level, vec, m_vec_dim * sizeof(float), m_m));
+
+    std::unique_lock<std::shared_mutex> guard(m_lock);
+    if (m_ids.count(id) > 0) {
+      m_memory->release(bytes);
+      return add_status::duplicate_id;
+    }
+    n = static_cast<uint32_t>(m_nodes.size());
+    m_nodes.push_back(std::move(new_node));
+    try {
+      m_ids.emplace(id, n);
+    } catch (...) {
+      m_nodes.pop_back();
+      throw;
+    }
+    m_memory_used += bytes;
+
+    if (m_top_level < 0) {
+      m_entry = n;
+      m_top_level = level;
+      return add_status::ok;
+    }
+    entry = m_entry;
+    top_level = m_top_level;
+  } catch (const std::bad_alloc &) {
+    m_memory->release(bytes);
+    return add_status::out_of_memory;
+  }
+
+  try {
+    std::shared_lock<std::shared_mutex> guard(m_lock);
+    const char *data = m_nodes[n]->data.get();
+    uint32_t current =
+        greedy_descend(data, entry, top_level, static_cast<int>(level) + 1);
+    for (int l = std::min(static_cast<int>(level), top_level); l >= 0; l--) {
+      std::vector<candidate> candidates =
+          search_level(data, current, m_ef_construction, l);
+      std::vector<uint32_t> neighbors = select_neighbors(candidates, m_m);
+      {
+        node &self = *m_nodes[n];
+        std::lock_guard<std::mutex> links_guard(self.lock);
+        self.links[l] = neighbors;
+      }
+      for (uint32_t neighbor : neighbors) link(neighbor, n, l);
+      current = std::min_element(candidates.begin(), candidates.end())->second;
+    }
+  } catch (const std::bad_alloc &) {
+    /* The node stays, with the links placed before the failure. */
+    return add_status::out_of_memory;
+  }
+
+  if (static_cast<int>(level) > top_level) {
+    std::unique_lock<std::shared_mutex> guard(m_lock);
+    if (static_cast<int>(level) > m_top_level) {
+      m_entry = n;
+      m_top_level = level;
+    }
+  }
+  return add_status::ok;
+}
+
+std::vector<hnsw_index::neighbor> hnsw_index::search(const char *query,
+                                                     uint32_t k,
+                                                     uint32_t ef) const {
+  std::vector<neighbor> result;
+  std::shared_lock<std::shared_mutex> guard(m_lock);
+  if (m_top_level < 0 || k == 0) return result;
+
+  uint32_t current = greedy_descend(query, m_entry, m_top_level, 1);
+  std::vector<candidate> candidates =
+      search_level(query, current, std::max(ef, k), 0);
+  std::sort(candidates.begin(), candidates.end());
+  if (candidates.size() > k) candidates.resize(k);
+
+  result.reserve(candidates.size());
+  for (const candidate &c : candidates)
+    result.emplace_back(std::sqrt(static_cast<double>(c.first)),
+                        m_nodes[c.second]->id);
+  return result;
+}
+
+std::shared_ptr<hnsw_index> vector_index_registry::find(
+    const std::string &name) const {
+  std::shared_lock<std::shared_mutex> guard(m_lock);
+  auto it = m_indexes.find(name);
+  return it == m_indexes.end() ? nullptr : it->second;
+}
+
+std::shared_ptr<hnsw_index> vector_index_registry::find_or_create(
+    const std::string &name, uint32_t vec_dim) {
+  std::shared_ptr<hnsw_index> index = find(name);
+  if (index != nullptr) return index;
+
+  std::unique_lock<std::shared_mutex> guard(m_lock);
+  std::shared_ptr<hnsw_index> &slot = m_indexes[name];
+  if (slot == nullptr) {
+    try {
+      slot = std::make_shared<hnsw_index>(vec_dim, &m_memory);
+    } catch (...) {
+      m_indexes.erase(name);
+      throw;
+    }
+  }
+  return slot;
+}
+
+bool vector_index_registry::drop(const std::string &name) {
+  std::shared_ptr<hnsw_index> index;
+  std::unique_lock<std::shared_mutex> guard(m_lock);
+  auto it = m_indexes.find(name);
+  if (it == m_indexes.end()) return true;
+  index = std::move(it->second);
+  m_indexes.erase(it);
+  return false;
+}
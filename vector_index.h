@@ -0,0 +1,208 @@
+/* Copyright (c) 2017, 2024, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License, version 2.0, for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA */
+
+#ifndef VECTOR_INDEX_H
+#define VECTOR_INDEX_H
+
+/*
+  In-memory approximate nearest neighbor indexes of VECTOR_INDEX_ADD and
+  VECTOR_INDEX_SEARCH.
+
+  An hnsw_index is a Hierarchical Navigable Small World graph (Malkov and
+  Yashunin): every vector is a node linked to its nearest neighbors on level
+  0 and, with a geometrically decreasing probability, on the sparser upper
+  levels. A search descends greedily from the single node of the top level
+  and explores level 0 with a candidate list of `ef` nodes, so it visits
+  O(log n) nodes instead of scanning them all. The distance is the euclidean
+  (L2) distance, computed with the kernels selected for the CPU.
+
+  Concurrency: searches and inserts run in parallel. The node array, the id
+  map and the entry point are guarded by a shared mutex, only held
+  exclusively to append a node; the links of every node have their own
+  mutex, held while they are copied or updated.
+
+  The memory of all the indexes is accounted in an index_memory budget, so
+  an insert fails instead of exceeding the configured limit. The visited
+  marks of the searches, 4 bytes per node, are owned by the index and
+  reused: they are accounted too, without failing the searches.
+*/
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/* Memory used by the indexes, shared by all of them. */
+class index_memory {
+ public:
+  /*
+    Accounts `bytes` more if the total stays within `limit`; returns true if
+    it would not.
+  */
+  bool reserve(size_t bytes, size_t limit) {
+    size_t used = m_used.load(std::memory_order_relaxed);
+    do {
+      if (used + bytes > limit) return true;
+    } while (!m_used.compare_exchange_weak(used, used + bytes,
+                                           std::memory_order_relaxed));
+    return false;
+  }
+
+  void release(size_t bytes) {
+    m_used.fetch_sub(bytes, std::memory_order_relaxed);
+  }
+
+  size_t used() const { return m_used.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<size_t> m_used{0};
+};
+
+class hnsw_index {
+ public:
+  /* A search result: the L2 distance to the query and the id of the row. */
+  typedef std::pair<double, long long> neighbor;
+
+  enum class add_status { ok, duplicate_id, memory_limit, out_of_memory };
+
+  static constexpr uint32_t default_m = 16;
+  static constexpr uint32_t default_ef_construction = 200;
+  static constexpr uint32_t max_level = 16;
+
+  /*
+    An index of vectors of vec_dim floats. Every node keeps up to m links
+    per upper level and 2 * m on level 0; ef_construction is the candidate
+    list size of the searches placing a new node.
+  */
+  hnsw_index(uint32_t vec_dim, index_memory *memory,
+             uint32_t m = default_m,
+             uint32_t ef_construction = default_ef_construction);
+  ~hnsw_index();
+
+  hnsw_index(const hnsw_index &) = delete;
+  hnsw_index &operator=(const hnsw_index &) = delete;
+
+  uint32_t dimensions() const { return m_vec_dim; }
+
+  /* Number of vectors in the index. */
+  size_t size() const;
+
+  /* Bytes accounted for this index, its visited marks included. */
+  size_t memory() const {
+    return m_memory_used.load() + m_marks_used.load();
+  }
+
+  /*
+    Inserts the vector of row `id` (vec_dim floats, unaligned). Fails if the
+    id is already indexed or if the accounted memory of all the indexes
+    would exceed memory_limit bytes.
+  */
+  add_status add(long long id, const char *vec, size_t memory_limit);
+
+  /*
+    Returns the (approximately) k nearest rows to `query`, sorted by
+    ascending distance, exploring `ef` candidates (at least k) on level 0.
+    Throws std::bad_alloc on OOM.
+  */
+  std::vector<neighbor> search(const char *query, uint32_t k,
+                               uint32_t ef) const;
+
+ private:
+  struct node;
+  struct visited_marks;
+  class visited_lease;
+  typedef std::pair<float, uint32_t> candidate;  // distance, node
+
+  /* Visited marks kept for the next searches, beyond those running. */
+  static constexpr size_t max_free_marks = 16;
+
+  float distance(const char *query, uint32_t n) const;
+  uint32_t random_level();
+  size_t node_bytes(uint32_t level) const;
+  uint32_t greedy_descend(const char *query, uint32_t entry, int from_level,
+                          int to_level) const;
+  std::vector<candidate> search_level(const char *query, uint32_t entry,
+                                      uint32_t ef, int level) const;
+  std::vector<uint32_t> select_neighbors(std::vector<candidate> candidates,
+                                         uint32_t max_links) const;
+  void link(uint32_t from, uint32_t to, int level);
+  void account_marks(size_t bytes) const;
+  void release_marks(size_t bytes) const;
+
+  const uint32_t m_vec_dim;
+  const uint32_t m_m;
+  const uint32_t m_ef_construction;
+  const double m_level_factor;
+  index_memory *const m_memory;
+  std::atomic<size_t> m_memory_used{0};
+
+  mutable std::shared_mutex m_lock;  // nodes, ids, entry point
+  std::vector<std::unique_ptr<node>> m_nodes;
+  std::unordered_map<long long, uint32_t> m_ids;
+  uint32_t m_entry = 0;
+  int m_top_level = -1;  // -1 while the index is empty
+
+  std::mutex m_random_lock;
+  uint64_t m_random_state = 0x9e3779b97f4a7c15ULL;
+
+  mutable std::mutex m_marks_lock;  // free marks
+  mutable std::vector<std::unique_ptr<visited_marks>> m_free_marks;
+  mutable std::atomic<size_t> m_marks_used{0};
+};
+
+/*
+  The named indexes of the component, created by their first insert and
+  destroyed by VECTOR_INDEX_DROP or when the component is uninstalled.
+*/
+class vector_index_registry {
+ public:
+  /* The index named `name`, or nullptr if it does not exist. */
+  std::shared_ptr<hnsw_index> find(const std::string &name) const;
+
+  /*
+    The index named `name`, created for vec_dim dimensions if it does not
+    exist. Throws std::bad_alloc on OOM.
+  */
+  std::shared_ptr<hnsw_index> find_or_create(const std::string &name,
+                                             uint32_t vec_dim);
+
+  /*
+    Removes the index; its memory is released once the searches still using
+    it are done. Returns true if it does not exist.
+  */
+  bool drop(const std::string &name);
+
+  index_memory &memory() { return m_memory; }
+
+ private:
+  index_memory m_memory;
+  mutable std::shared_mutex m_lock;
+  std::unordered_map<std::string, std::shared_ptr<hnsw_index>> m_indexes;
+};
+
+#endif /* VECTOR_INDEX_H */
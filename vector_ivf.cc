@@ -0,0 +1,427 @@
+/* Copyright (c) 2017, 2024, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License, version 2.0, for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA */
+
+#include "vector_ivf.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include "vector_kernels.h"
+#include "vector_kmeans.h"
+
+namespace vector_ivf {
+
+namespace {
+
+constexpr uint64_t section_alignment = 64;
+
+uint64_t align_section(uint64_t offset) {
+  return (offset + section_alignment - 1) & ~(section_alignment - 1);
+}
+
+std::string system_error(const char *what, const std::string &path,
+                         int code = errno) {
+  return std::string(what) + " " + path + ": " + strerror(code);
+}
+
+/*
+  Creates and opens a file named `prefix` followed by a unique suffix, so
+  that concurrent builds of the same index never write to the same file.
+  Returns the descriptor or -1, `path` being set to the name in both cases.
+*/
+int create_unique(const std::string &prefix, std::string *path) {
+  *path = prefix + ".XXXXXX";
+  return mkostemp(&(*path)[0], O_CLOEXEC);
+}
+
+/* The kernels read their operands unaligned. */
+float l2_squared(uint32_t vec_dim, const void *vec1, const void *vec2) {
+  return vector_kernels::active().l2_squared(
+      vec_dim, static_cast<const char *>(vec1),
+      static_cast<const char *>(vec2));
+}
+
+/* The centroid nearest to vec. */
+uint32_t nearest_centroid(uint32_t vec_dim, const void *vec,
+                          const float *centroids, uint32_t k) {
+  uint32_t best = 0;
+  float best_distance = HUGE_VALF;
+  for (uint32_t c = 0; c < k; c++) {
+    float d = l2_squared(vec_dim, vec, centroids + size_t{c} * vec_dim);
+    if (d < best_distance) {
+      best_distance = d;
+      best = c;
+    }
+  }
+  return best;
+}
+
+/* Asks the kernel to read ahead the pages of [begin, begin + bytes). */
+void prefetch(const void *begin, size_t bytes) {
+  static const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+  uintptr_t start = reinterpret_cast<uintptr_t>(begin) & ~(page_size - 1);
+  uintptr_t end = reinterpret_cast<uintptr_t>(begin) + bytes;
+  if (bytes > 0)
+    madvise(reinterpret_cast<void *>(start), end - start, MADV_WILLNEED);
+}
+
+}  // namespace
+
+std::shared_ptr<index_file> index_file::open(const std::string &path,
+                                             std::string *error) {
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    *error = system_error("cannot open", path);
+    return nullptr;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    *error = system_error("cannot stat", path);
+    close(fd);
+    return nullptr;
+  }
+  if (static_cast<uint64_t>(st.st_size) < sizeof(file_header)) {
+    close(fd);
+    *error = "not a vector index file: " + path;
+    return nullptr;
+  }
+  void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    *error = system_error("cannot map", path);
+    return nullptr;
+  }
+
+  std::shared_ptr<index_file> file(new (std::nothrow) index_file());
+  if (file == nullptr) {
+    munmap(map, st.st_size);
+    *error = "Out of memory";
+    return nullptr;
+  }
+  file->m_map = static_cast<const char *>(map);
+  file->m_map_size = st.st_size;
+  file->m_device = st.st_dev;
+  file->m_inode = st.st_ino;
+  file->m_mtime = st.st_mtim;
+
+  /* Validate the layout before trusting any offset of the header. */
+  const uint64_t size = st.st_size;
+  const file_header *h = reinterpret_cast<const file_header *>(map);
+  const uint64_t vector_bytes = uint64_t{h->vec_dim} * sizeof(float);
+  bool valid =
+      memcmp(h->magic, file_magic, sizeof(file_magic)) == 0 &&
+      h->vec_dim > 0 && h->vec_dim <= UINT16_MAX && h->lists > 0 &&
+      h->lists <= max_lists && h->vectors <= size / vector_bytes &&
+      h->centroids_offset % section_alignment == 0 &&
+      h->list_start_offset % section_alignment == 0 &&
+      h->ids_offset % section_alignment == 0 &&
+      h->data_offset % section_alignment == 0 &&
+      h->centroids_offset >= sizeof(file_header) &&
+      h->centroids_offset <= size &&
+      size - h->centroids_offset >= h->lists * vector_bytes &&
+      h->list_start_offset <= size &&
+      size - h->list_start_offset >= (h->lists + 1) * sizeof(uint64_t) &&
+      h->ids_offset <= size &&
+      size - h->ids_offset >= h->vectors * sizeof(int64_t) &&
+      h->data_offset <= size &&
+      size - h->data_offset >= h->vectors * vector_bytes;
+  if (valid) {
+    const uint64_t *list_start =
+        reinterpret_cast<const uint64_t *>(file->m_map + h->list_start_offset);
+    valid = list_start[0] == 0 && list_start[h->lists] == h->vectors;
+    for (uint32_t l = 0; valid && l < h->lists; l++)
+      valid = list_start[l] <= list_start[l + 1];
+  }
+  if (!valid) {
+    *error = "not a vector index file: " + path;
+    return nullptr;
+  }
+
+  file->m_header = h;
+  file->m_centroids =
+      reinterpret_cast<const float *>(file->m_map + h->centroids_offset);
+  file->m_list_start =
+      reinterpret_cast<const uint64_t *>(file->m_map + h->list_start_offset);
+  file->m_ids = reinterpret_cast<const int64_t *>(file->m_map + h->ids_offset);
+  file->m_data = reinterpret_cast<const float *>(file->m_map + h->data_offset);
+
+  /* Only the probed lists are read, prefetched explicitly by search(). */
+  madvise(map, size, MADV_RANDOM);
+  return file;
+}
+
+index_file::~index_file() {
+  if (m_map != nullptr) munmap(const_cast<char *>(m_map), m_map_size);
+}
+
+bool index_file::is_current(const std::string &path) const {
+  struct stat st;
+  return stat(path.c_str(), &st) == 0 && st.st_dev == m_device &&
+         st.st_ino == m_inode && st.st_mtim.tv_sec == m_mtime.tv_sec &&
+         st.st_mtim.tv_nsec == m_mtime.tv_nsec &&
+         static_cast<size_t>(st.st_size) == m_map_size;
+}
+
+std::vector<index_file::neighbor> index_file::search(const char *query,
+                                                     uint32_t k,
+                                                     uint32_t nprobe) const {
+  const uint32_t vec_dim = m_header->vec_dim;
+
+  std::vector<std::pair<float, uint32_t>> ranked(m_header->lists);
+  for (uint32_t l = 0; l < m_header->lists; l++)
+    ranked[l] = {l2_squared(vec_dim, query,
+                            m_centroids + size_t{l} * vec_dim),
+                 l};
+  nprobe = std::min(nprobe, m_header->lists);
+  std::partial_sort(ranked.begin(), ranked.begin() + nprobe, ranked.end());
+
+  for (uint32_t p = 0; p < nprobe; p++) {
+    uint64_t start = m_list_start[ranked[p].second];
+    uint64_t count = m_list_start[ranked[p].second + 1] - start;
+    prefetch(m_ids + start, count * sizeof(int64_t));
+    prefetch(m_data + start * vec_dim, count * vec_dim * sizeof(float));
+  }
+
+  /* Max-heap of the k nearest vectors found so far. */
+  std::vector<std::pair<float, uint64_t>> heap;
+  heap.reserve(k);
+  for (uint32_t p = 0; p < nprobe; p++) {
+    uint64_t end = m_list_start[ranked[p].second + 1];
+    for (uint64_t v = m_list_start[ranked[p].second]; v < end; v++) {
+      float d = l2_squared(vec_dim, query, m_data + v * vec_dim);
+      if (heap.size() < k) {
+        heap.emplace_back(d, v);
+        std::push_heap(heap.begin(), heap.end());
+      } else if (d < heap.front().first) {
+        std::pop_heap(heap.begin(), heap.end());
+        heap.back() = {d, v};
+        std::push_heap(heap.begin(), heap.end());
+      }
+    }
+  }
+  std::sort_heap(heap.begin(), heap.end());
+
+  std::vector<neighbor> result;
+  result.reserve(heap.size());
+  for (const auto &entry : heap)
+    result.emplace_back(std::sqrt(static_cast<double>(entry.first)),
+                        m_ids[entry.second]);
+  return result;
+}
+
+std::shared_ptr<index_file> file_cache::open(const std::string &path,
+                                             std::string *error) {
+  std::shared_ptr<index_file> file;
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    auto it = m_files.find(path);
+    if (it != m_files.end()) file = it->second;
+  }
+  if (file != nullptr && file->is_current(path)) return file;
+
+  file = index_file::open(path, error);
+  if (file == nullptr) return nullptr;
+  try {
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_files[path] = file;
+  } catch (const std::bad_alloc &) {
+    /* Still usable, only not cached. */
+  }
+  return file;
+}
+
+bool builder::start(const std::string &path, uint32_t vec_dim,
+                    uint32_t lists, size_t sample_bytes, std::string *error) {
+  reset();
+  m_path = path;
+  int fd = create_unique(path + ".spill", &m_spill_path);
+  if (fd >= 0) {
+    m_spill = fdopen(fd, "w+b");
+    if (m_spill == nullptr) {
+      close(fd);
+      unlink(m_spill_path.c_str());
+      fd = -1;
+    }
+  }
+  if (fd < 0) {
+    *error = system_error("cannot create", m_spill_path);
+    return true;
+  }
+  /* Removed now, so a crash or a killed statement leaves nothing behind. */
+  unlink(m_spill_path.c_str());
+
+  m_vec_dim = vec_dim;
+  m_training.start(vec_dim, lists, training_iterations, 1, sample_bytes);
+  return false;
+}
+
+bool builder::add(long long id, const char *vec, std::string *error) {
+  const size_t vec_bytes = m_vec_dim * sizeof(float);
+  int64_t id64 = id;
+  if (fwrite(&id64, sizeof(id64), 1, m_spill) != 1 ||
+      fwrite(vec, vec_bytes, 1, m_spill) != 1) {
+    *error = system_error("cannot write", m_spill_path);
+    return true;
+  }
+
+  try {
+    m_training.add(vec);
+  } catch (const std::bad_alloc &) {
+    *error = "Out of memory";
+    return true;
+  }
+  m_count++;
+  return false;
+}
+
+bool builder::finish(vector_parallel::thread_pool *workers,
+                     std::string *error) {
+  const uint64_t vector_bytes = uint64_t{m_vec_dim} * sizeof(float);
+  std::vector<char> trained;
+  try {
+    m_training.finish(workers, &trained);
+    m_training.reset();
+  } catch (const std::bad_alloc &) {
+    *error = "Out of memory";
+    return true;
+  }
+  const float *centroids = reinterpret_cast<const float *>(trained.data());
+  const uint32_t lists = static_cast<uint32_t>(trained.size() / vector_bytes);
+
+  file_header header;
+  memcpy(header.magic, file_magic, sizeof(file_magic));
+  header.vec_dim = m_vec_dim;
+  header.lists = lists;
+  header.vectors = m_count;
+  header.centroids_offset = align_section(sizeof(file_header));
+  header.list_start_offset =
+      align_section(header.centroids_offset + lists * vector_bytes);
+  header.ids_offset = align_section(header.list_start_offset +
+                                    (lists + 1) * sizeof(uint64_t));
+  header.data_offset =
+      align_section(header.ids_offset + m_count * sizeof(int64_t));
+  const uint64_t file_size = header.data_offset + m_count * vector_bytes;
+
+  std::vector<uint32_t> assignment;
+  std::vector<uint64_t> list_start;
+  std::vector<char> record(sizeof(int64_t) + vector_bytes);
+  const char *record_vec = record.data() + sizeof(int64_t);
+  try {
+    assignment.resize(m_count);
+    list_start.assign(lists + 1, 0);
+  } catch (const std::bad_alloc &) {
+    *error = "Out of memory";
+    return true;
+  }
+
+  /* First pass over the spilled vectors: assign them to their list. */
+  if (fflush(m_spill) != 0 || fseek(m_spill, 0, SEEK_SET) != 0) {
+    *error = system_error("cannot read", m_spill_path);
+    return true;
+  }
+  for (uint64_t i = 0; i < m_count; i++) {
+    if (fread(record.data(), record.size(), 1, m_spill) != 1) {
+      *error = system_error("cannot read", m_spill_path);
+      return true;
+    }
+    assignment[i] = nearest_centroid(m_vec_dim, record_vec, centroids, lists);
+    list_start[assignment[i] + 1]++;
+  }
+  for (uint32_t l = 0; l < lists; l++) list_start[l + 1] += list_start[l];
+
+  /*
+    The blocks of the file are allocated before it is mapped: writing to a
+    hole of the mapping that the file system cannot back raises SIGBUS.
+  */
+  std::string tmp_path;
+  int fd = create_unique(m_path + ".tmp", &tmp_path);
+  if (fd < 0) {
+    *error = system_error("cannot create", tmp_path);
+    return true;
+  }
+  int code = fchmod(fd, 0640) != 0 ? errno : 0;
+  if (code == 0) code = posix_fallocate(fd, 0, file_size);
+  void *map = MAP_FAILED;
+  if (code == 0) {
+    map = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) code = errno;
+  }
+  if (code != 0) {
+    *error = system_error("cannot write", tmp_path, code);
+    close(fd);
+    unlink(tmp_path.c_str());
+    return true;
+  }
+
+  char *out = static_cast<char *>(map);
+  memcpy(out, &header, sizeof(header));
+  memcpy(out + header.centroids_offset, centroids, trained.size());
+  memcpy(out + header.list_start_offset, list_start.data(),
+         list_start.size() * sizeof(uint64_t));
+  char *ids = out + header.ids_offset;
+  char *data = out + header.data_offset;
+
+  /* Second pass: write every vector at the cursor of its list. */
+  bool failed = fseek(m_spill, 0, SEEK_SET) != 0;
+  for (uint64_t i = 0; !failed && i < m_count; i++) {
+    if (fread(record.data(), record.size(), 1, m_spill) != 1) {
+      failed = true;
+      break;
+    }
+    uint64_t position = list_start[assignment[i]]++;
+    memcpy(ids + position * sizeof(int64_t), record.data(), sizeof(int64_t));
+    memcpy(data + position * vector_bytes, record_vec, vector_bytes);
+  }
+  if (failed) *error = system_error("cannot read", m_spill_path);
+
+  munmap(map, file_size);
+  if (!failed && fsync(fd) != 0) {
+    *error = system_error("cannot write", tmp_path);
+    failed = true;
+  }
+  close(fd);
+  if (!failed && rename(tmp_path.c_str(), m_path.c_str()) != 0) {
+    *error = system_error("cannot rename", tmp_path);
+    failed = true;
+  }
+  if (failed) unlink(tmp_path.c_str());
+  reset();
+  return failed;
+}
+
+void builder::reset() {
+  if (m_spill != nullptr) fclose(m_spill);
+  m_spill = nullptr;
+  m_count = 0;
+  m_training.reset();
+}
+
+}  // namespace vector_ivf
@@ -0,0 +1,192 @@
+/* Copyright (c) 2017, 2024, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License, version 2.0, for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA */
+
+#ifndef VECTOR_IVF_H
+#define VECTOR_IVF_H
+
+/*
+  On-disk IVF-Flat indexes of VECTOR_IVF_BUILD and VECTOR_IVF_SEARCH.
+
+  The vectors are partitioned into lists by their nearest centroid, the
+  centroids being trained by k-means. A search ranks the centroids and only
+  scans the vectors of the `nprobe` nearest lists.
+
+  Every index is a single file, memory-mapped read-only so the collection
+  does not have to fit in memory:
+
+    file_header
+    float    centroids[lists][vec_dim]
+    uint64_t list_start[lists + 1]   vector number of the start of each list
+    int64_t  ids[vectors]            in list order
+    float    data[vectors][vec_dim]  in list order
+
+  every section starting on a 64 bytes boundary. The vectors of a list are
+  contiguous, so probing a list is a sequential read that the kernel is told
+  to prefetch.
+*/
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "vector_kmeans.h"
+#include "vector_parallel.h"
+
+namespace vector_ivf {
+
+constexpr char file_magic[8] = {'V', 'E', 'C', 'I', 'V', 'F', '0', '1'};
+constexpr uint32_t max_lists = 65536;
+
+struct file_header {
+  char magic[8];
+  uint32_t vec_dim;
+  uint32_t lists;
+  uint64_t vectors;
+  uint64_t centroids_offset;
+  uint64_t list_start_offset;
+  uint64_t ids_offset;
+  uint64_t data_offset;
+};
+
+/* A mapped index file. */
+class index_file {
+ public:
+  /* A search result: the L2 distance to the query and the id of the row. */
+  typedef std::pair<double, long long> neighbor;
+
+  /*
+    Maps the index file at `path`; returns nullptr and sets `error` if it
+    cannot be opened or is not a valid index.
+  */
+  static std::shared_ptr<index_file> open(const std::string &path,
+                                          std::string *error);
+  ~index_file();
+
+  index_file(const index_file &) = delete;
+  index_file &operator=(const index_file &) = delete;
+
+  uint32_t dimensions() const { return m_header->vec_dim; }
+  uint32_t lists() const { return m_header->lists; }
+  uint64_t size() const { return m_header->vectors; }
+
+  /* True if this is the mapping of the file currently at path. */
+  bool is_current(const std::string &path) const;
+
+  /*
+    Returns the k nearest rows to `query` among the vectors of the nprobe
+    lists with the nearest centroids, sorted by ascending distance. Throws
+    std::bad_alloc on OOM.
+  */
+  std::vector<neighbor> search(const char *query, uint32_t k,
+                               uint32_t nprobe) const;
+
+ private:
+  index_file() = default;
+
+  const char *m_map = nullptr;
+  size_t m_map_size = 0;
+  const file_header *m_header = nullptr;
+  const float *m_centroids = nullptr;
+  const uint64_t *m_list_start = nullptr;
+  const int64_t *m_ids = nullptr;
+  const float *m_data = nullptr;
+  dev_t m_device = 0;
+  ino_t m_inode = 0;
+  timespec m_mtime{};
+};
+
+/*
+  The index files opened by the searches, mapped once and kept until the
+  component is uninstalled. A file rebuilt at the same path is mapped again
+  on its next search. The lock only covers the lookup in the map: the file
+  is checked and mapped outside it.
+*/
+class file_cache {
+ public:
+  std::shared_ptr<index_file> open(const std::string &path,
+                                   std::string *error);
+
+ private:
+  std::mutex m_lock;
+  std::map<std::string, std::shared_ptr<index_file>> m_files;
+};
+
+/*
+  Builds an index file from a stream of vectors. The vectors are spilled to
+  a temporary file next to the index as they are added, only a sample of
+  them being kept in memory by a vector_kmeans::clustering to train the
+  centroids, so the collection does not have to fit in memory. The index
+  is written to a temporary file renamed over `path` at the end, so a
+  search never sees a partial index. The temporary files have unique names:
+  concurrent builds of the same index do not corrupt each other, the last
+  one renamed replacing the others.
+*/
+class builder {
+ public:
+  static constexpr uint32_t training_iterations = 10;
+
+  ~builder() { reset(); }
+
+  /*
+    Starts an index of `lists` lists at `path`, the training sample taking
+    at most sample_bytes. Returns true on error.
+  */
+  bool start(const std::string &path, uint32_t vec_dim, uint32_t lists,
+             size_t sample_bytes, std::string *error);
+
+  bool started() const { return m_spill != nullptr; }
+  uint32_t dimensions() const { return m_vec_dim; }
+  uint64_t count() const { return m_count; }
+
+  /* Adds the vector of row id (vec_dim floats). Returns true on error. */
+  bool add(long long id, const char *vec, std::string *error);
+
+  /*
+    Trains the centroids with vector_kmeans on the threads of `workers` and
+    writes the index. Returns true on error.
+  */
+  bool finish(vector_parallel::thread_pool *workers, std::string *error);
+
+  /* Discards the vectors added and the temporary files. */
+  void reset();
+
+ private:
+  std::string m_path;
+  std::string m_spill_path;
+  FILE *m_spill = nullptr;
+  uint32_t m_vec_dim = 0;
+  uint64_t m_count = 0;
+  vector_kmeans::clustering m_training;
+};
+
+}  // namespace vector_ivf
+
+#endif /* VECTOR_IVF_H */
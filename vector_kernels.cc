@@ -0,0 +1,1974 @@
+/* Copyright (c) 2017, 2024, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License, version 2.0, for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA */
+
+#include "vector_kernels.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <initializer_list>
+#include <iterator>
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__))
+#define VECTOR_KERNELS_X86 1
+#include <immintrin.h>
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2,fma,f16c")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+#define TARGET_AVX512_VNNI \
+  __attribute__((target("avx512f,avx512bw,avx512vnni,avx512vpopcntdq")))
+
+/*
+  The GCC 12 headers pass _mm512_undefined_*() values to the builtins of
+  some AVX-512 intrinsics (_mm512_cvtph_ps, _mm512_cvtepu16_epi32,
+  _mm512_reduce_add_ps, ...), which -Wuninitialized and
+  -Wmaybe-uninitialized report once inlined. These false positives would
+  break -Werror builds, so they are silenced around the code calling them.
+*/
+#if defined(__GNUC__) && !defined(__clang__)
+#define AVX512_UNINITIALIZED_WARNINGS_OFF               \
+  _Pragma("GCC diagnostic push")                        \
+  _Pragma("GCC diagnostic ignored \"-Wuninitialized\"") \
+  _Pragma("GCC diagnostic ignored \"-Wmaybe-uninitialized\"")
+#define AVX512_UNINITIALIZED_WARNINGS_ON _Pragma("GCC diagnostic pop")
+#else
+#define AVX512_UNINITIALIZED_WARNINGS_OFF
+#define AVX512_UNINITIALIZED_WARNINGS_ON
+#endif
+#endif
+
+namespace vector_kernels {
+
+namespace {
+
+inline float load_float(const char *vec, uint32_t i) {
+  float value;
+  memcpy(&value, vec + i * sizeof(float), sizeof(float));
+  return value;
+}
+
+inline void store_float(char *vec, uint32_t i, float value) {
+  memcpy(vec + i * sizeof(float), &value, sizeof(float));
+}
+
+/*
+  Element types of the vectors. Every element type widens to float on load
+  and narrows back on store, so that the kernels templated on it compute in
+  float whatever the storage. store() returns the value as stored, which is
+  what the finiteness checks look at: a float too large for a half precision
+  element is stored as an infinity.
+*/
+
+struct fp32_element {
+  static constexpr size_t size = sizeof(float);
+
+  static float load(const char *vec, uint32_t i) { return load_float(vec, i); }
+  static float store(char *vec, uint32_t i, float value) {
+    store_float(vec, i, value);
+    return value;
+  }
+#ifdef VECTOR_KERNELS_X86
+  TARGET_AVX2 static __m256 load_avx2(const char *vec, uint32_t i) {
+    return _mm256_loadu_ps(reinterpret_cast<const float *>(vec) + i);
+  }
+  TARGET_AVX2 static __m256 store_avx2(char *vec, uint32_t i, __m256 value) {
+    _mm256_storeu_ps(reinterpret_cast<float *>(vec) + i, value);
+    return value;
+  }
+  TARGET_AVX512 static __m512 load_avx512(const char *vec, uint32_t i) {
+    return _mm512_loadu_ps(reinterpret_cast<const float *>(vec) + i);
+  }
+  /* Inactive lanes of the partial loads are 0. */
+  TARGET_AVX512 static __m512 load_avx512(const char *vec, uint32_t i,
+                                          __mmask16 mask) {
+    return _mm512_maskz_loadu_ps(mask,
+                                 reinterpret_cast<const float *>(vec) + i);
+  }
+  TARGET_AVX512 static __m512 store_avx512(char *vec, uint32_t i,
+                                           __m512 value) {
+    _mm512_storeu_ps(reinterpret_cast<float *>(vec) + i, value);
+    return value;
+  }
+  TARGET_AVX512 static __m512 store_avx512(char *vec, uint32_t i,
+                                           __mmask16 mask, __m512 value) {
+    _mm512_mask_storeu_ps(reinterpret_cast<float *>(vec) + i, mask, value);
+    return value;
+  }
+#endif
+};
+
+inline uint16_t load_half(const char *vec, uint32_t i) {
+  uint16_t value;
+  memcpy(&value, vec + i * sizeof(uint16_t), sizeof(uint16_t));
+  return value;
+}
+
+inline void store_half(char *vec, uint32_t i, uint16_t value) {
+  memcpy(vec + i * sizeof(uint16_t), &value, sizeof(uint16_t));
+}
+
+inline float float_from_bits(uint32_t bits) {
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+inline uint32_t float_bits(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+/*
+  The partial AVX-512 loads and stores of the 16-bit types go through a
+  buffer: masked 16-bit moves would need AVX512BW.
+*/
+#ifdef VECTOR_KERNELS_X86
+TARGET_AVX512 inline __m256i load_halves_partial(const char *vec, uint32_t i,
+                                                 __mmask16 mask) {
+  alignas(32) uint16_t buffer[16] = {};
+  memcpy(buffer, vec + i * sizeof(uint16_t),
+         __builtin_popcount(mask) * sizeof(uint16_t));
+  return _mm256_load_si256(reinterpret_cast<const __m256i *>(buffer));
+}
+
+TARGET_AVX512 inline void store_halves_partial(char *vec, uint32_t i,
+                                               __mmask16 mask,
+                                               __m256i halves) {
+  alignas(32) uint16_t buffer[16];
+  _mm256_store_si256(reinterpret_cast<__m256i *>(buffer), halves);
+  memcpy(vec + i * sizeof(uint16_t), buffer,
+         __builtin_popcount(mask) * sizeof(uint16_t));
+}
+#endif
+
+/* IEEE 754 binary16: 1 sign, 5 exponent and 10 mantissa bits. */
+struct fp16_element {
+  static constexpr size_t size = sizeof(uint16_t);
+
+  static float load(const char *vec, uint32_t i) {
+    uint16_t h = load_half(vec, i);
+    uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+    uint32_t exponent = (h >> 10) & 0x1f;
+    uint32_t mantissa = h & 0x3ff;
+    if (exponent == 0) {
+      /* Zero or subnormal: mantissa * 2^-24. */
+      float value = static_cast<float>(mantissa) * 0x1p-24f;
+      return float_from_bits(float_bits(value) | sign);
+    }
+    if (exponent == 31)
+      return float_from_bits(sign | 0x7f800000 | (mantissa << 13));
+    return float_from_bits(sign | ((exponent + 112) << 23) | (mantissa << 13));
+  }
+
+  /* Rounds to nearest even, as the F16C conversions do. */
+  static float store(char *vec, uint32_t i, float value) {
+    uint32_t bits = float_bits(value);
+    uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+    bits &= 0x7fffffff;
+    uint16_t h;
+    if (bits >= 0x7f800000) {
+      h = bits > 0x7f800000 ? 0x7e00 : 0x7c00;
+    } else if (bits >= 0x477ff000) {
+      h = 0x7c00; /* rounds above 65504 */
+    } else if (bits < 0x38800000) {
+      /* Subnormal: the rounding of |value| * 2^24 is the mantissa. */
+      h = static_cast<uint16_t>(
+          std::nearbyint(float_from_bits(bits) * 0x1p24f));
+    } else {
+      bits += 0xfff + ((bits >> 13) & 1);
+      h = static_cast<uint16_t>((bits - (112u << 23)) >> 13);
+    }
+    h |= sign;
+    store_half(vec, i, h);
+    return load(vec, i);
+  }
+#ifdef VECTOR_KERNELS_X86
+  TARGET_AVX2 static __m256 load_avx2(const char *vec, uint32_t i) {
+    return _mm256_cvtph_ps(_mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(vec + i * size)));
+  }
+  TARGET_AVX2 static __m256 store_avx2(char *vec, uint32_t i, __m256 value) {
+    __m128i halves = _mm256_cvtps_ph(value, _MM_FROUND_TO_NEAREST_INT);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(vec + i * size), halves);
+    return _mm256_cvtph_ps(halves);
+  }
+  AVX512_UNINITIALIZED_WARNINGS_OFF
+  TARGET_AVX512 static __m512 load_avx512(const char *vec, uint32_t i) {
+    return _mm512_cvtph_ps(_mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(vec + i * size)));
+  }
+  TARGET_AVX512 static __m512 load_avx512(const char *vec, uint32_t i,
+                                          __mmask16 mask) {
+    return _mm512_cvtph_ps(load_halves_partial(vec, i, mask));
+  }
+  TARGET_AVX512 static __m512 store_avx512(char *vec, uint32_t i,
+                                           __m512 value) {
+    __m256i halves = _mm512_cvtps_ph(value, _MM_FROUND_TO_NEAREST_INT);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(vec + i * size), halves);
+    return _mm512_cvtph_ps(halves);
+  }
+  TARGET_AVX512 static __m512 store_avx512(char *vec, uint32_t i,
+                                           __mmask16 mask, __m512 value) {
+    __m256i halves = _mm512_cvtps_ph(value, _MM_FROUND_TO_NEAREST_INT);
+    store_halves_partial(vec, i, mask, halves);
+    return _mm512_cvtph_ps(halves);
+  }
+  AVX512_UNINITIALIZED_WARNINGS_ON
+#endif
+};
+
+/*
+  bfloat16: the upper half of a float. Widening is a shift; narrowing rounds
+  to nearest even by adding 0x7fff plus the lowest kept bit, NaNs being kept
+  quiet NaNs.
+*/
+struct bf16_element {
+  static constexpr size_t size = sizeof(uint16_t);
+
+  static float load(const char *vec, uint32_t i) {
+    return float_from_bits(static_cast<uint32_t>(load_half(vec, i)) << 16);
+  }
+  static float store(char *vec, uint32_t i, float value) {
+    uint32_t bits = float_bits(value);
+    uint16_t h;
+    if (std::isnan(value))
+      h = static_cast<uint16_t>((bits >> 16) | 0x40);
+    else
+      h = static_cast<uint16_t>((bits + 0x7fff + ((bits >> 16) & 1)) >> 16);
+    store_half(vec, i, h);
+    return load(vec, i);
+  }
+#ifdef VECTOR_KERNELS_X86
+  TARGET_AVX2 static __m256i narrow(__m256 value) {
+    __m256i bits = _mm256_castps_si256(value);
+    __m256i lsb =
+        _mm256_and_si256(_mm256_srli_epi32(bits, 16), _mm256_set1_epi32(1));
+    __m256i rounded = _mm256_add_epi32(
+        bits, _mm256_add_epi32(lsb, _mm256_set1_epi32(0x7fff)));
+    __m256i nan =
+        _mm256_castps_si256(_mm256_cmp_ps(value, value, _CMP_UNORD_Q));
+    return _mm256_blendv_epi8(_mm256_srli_epi32(rounded, 16),
+                              _mm256_set1_epi32(0x7fc0), nan);
+  }
+  TARGET_AVX2 static __m256 load_avx2(const char *vec, uint32_t i) {
+    __m256i halves = _mm256_cvtepu16_epi32(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(vec + i * size)));
+    return _mm256_castsi256_ps(_mm256_slli_epi32(halves, 16));
+  }
+  TARGET_AVX2 static __m256 store_avx2(char *vec, uint32_t i, __m256 value) {
+    __m256i halves = narrow(value);
+    /* packus works per 128-bit lane: gather the two packed quarters. */
+    __m256i packed = _mm256_permute4x64_epi64(
+        _mm256_packus_epi32(halves, halves), _MM_SHUFFLE(3, 1, 2, 0));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(vec + i * size),
+                     _mm256_castsi256_si128(packed));
+    return _mm256_castsi256_ps(_mm256_slli_epi32(halves, 16));
+  }
+  AVX512_UNINITIALIZED_WARNINGS_OFF
+  TARGET_AVX512 static __m512i narrow(__m512 value) {
+    __m512i bits = _mm512_castps_si512(value);
+    __m512i lsb =
+        _mm512_and_si512(_mm512_srli_epi32(bits, 16), _mm512_set1_epi32(1));
+    __m512i rounded = _mm512_add_epi32(
+        bits, _mm512_add_epi32(lsb, _mm512_set1_epi32(0x7fff)));
+    __mmask16 nan = _mm512_cmp_ps_mask(value, value, _CMP_UNORD_Q);
+    return _mm512_mask_mov_epi32(_mm512_srli_epi32(rounded, 16), nan,
+                                 _mm512_set1_epi32(0x7fc0));
+  }
+  TARGET_AVX512 static __m512 widen(__m256i halves) {
+    return _mm512_castsi512_ps(
+        _mm512_slli_epi32(_mm512_cvtepu16_epi32(halves), 16));
+  }
+  TARGET_AVX512 static __m512 load_avx512(const char *vec, uint32_t i) {
+    return widen(_mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(vec + i * size)));
+  }
+  TARGET_AVX512 static __m512 load_avx512(const char *vec, uint32_t i,
+                                          __mmask16 mask) {
+    return widen(load_halves_partial(vec, i, mask));
+  }
+  TARGET_AVX512 static __m512 store_avx512(char *vec, uint32_t i,
+                                           __m512 value) {
+    __m512i halves = narrow(value);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(vec + i * size),
+                        _mm512_cvtepi32_epi16(halves));
+    return _mm512_castsi512_ps(_mm512_slli_epi32(halves, 16));
+  }
+  TARGET_AVX512 static __m512 store_avx512(char *vec, uint32_t i,
+                                           __mmask16 mask, __m512 value) {
+    __m512i halves = narrow(value);
+    store_halves_partial(vec, i, mask, _mm512_cvtepi32_epi16(halves));
+    return _mm512_castsi512_ps(_mm512_slli_epi32(halves, 16));
+  }
+  AVX512_UNINITIALIZED_WARNINGS_ON
+#endif
+};
+
+/*
+  Operators of the element-wise kernels, one overload per register width.
+  checks_zero tells the kernels to test the second operand for zeros.
+*/
+
+struct add_op {
+  static constexpr bool checks_zero = false;
+  static float apply(float a, float b) { return a + b; }
+#ifdef VECTOR_KERNELS_X86
+  TARGET_SSE2 static __m128 apply(__m128 a, __m128 b) {
+    return _mm_add_ps(a, b);
+  }
+  TARGET_AVX2 static __m256 apply(__m256 a, __m256 b) {
+    return _mm256_add_ps(a, b);
+  }
+  TARGET_AVX512 static __m512 apply(__m512 a, __m512 b) {
+    return _mm512_add_ps(a, b);
+  }
+#endif
+};
+
+struct sub_op {
+  static constexpr bool checks_zero = false;
+  static float apply(float a, float b) { return a - b; }
+#ifdef VECTOR_KERNELS_X86
+  TARGET_SSE2 static __m128 apply(__m128 a, __m128 b) {
+    return _mm_sub_ps(a, b);
+  }
+  TARGET_AVX2 static __m256 apply(__m256 a, __m256 b) {
+    return _mm256_sub_ps(a, b);
+  }
+  TARGET_AVX512 static __m512 apply(__m512 a, __m512 b) {
+    return _mm512_sub_ps(a, b);
+  }
+#endif
+};
+
+struct mul_op {
+  static constexpr bool checks_zero = false;
+  static float apply(float a, float b) { return a * b; }
+#ifdef VECTOR_KERNELS_X86
+  TARGET_SSE2 static __m128 apply(__m128 a, __m128 b) {
+    return _mm_mul_ps(a, b);
+  }
+  TARGET_AVX2 static __m256 apply(__m256 a, __m256 b) {
+    return _mm256_mul_ps(a, b);
+  }
+  TARGET_AVX512 static __m512 apply(__m512 a, __m512 b) {
+    return _mm512_mul_ps(a, b);
+  }
+#endif
+};
+
+struct div_op {
+  static constexpr bool checks_zero = true;
+  static float apply(float a, float b) { return a / b; }
+#ifdef VECTOR_KERNELS_X86
+  TARGET_SSE2 static __m128 apply(__m128 a, __m128 b) {
+    return _mm_div_ps(a, b);
+  }
+  TARGET_AVX2 static __m256 apply(__m256 a, __m256 b) {
+    return _mm256_div_ps(a, b);
+  }
+  TARGET_AVX512 static __m512 apply(__m512 a, __m512 b) {
+    return _mm512_div_ps(a, b);
+  }
+#endif
+};
+
+inline op_status make_status(bool has_zero, bool out_of_range) {
+  if (has_zero) return op_status::division_by_zero;
+  if (out_of_range) return op_status::out_of_range;
+  return op_status::ok;
+}
+
+/*
+  Scalar loop over [from, vec_dim); also used for the tail of the SIMD
+  kernels. The checks are accumulated without branching.
+*/
+template <class Op, class E = fp32_element>
+inline void elementwise_tail(uint32_t from, uint32_t vec_dim,
+                             const char *vec1, const char *vec2, char *result,
+                             bool *has_zero, bool *out_of_range) {
+  bool zero = false, bad = false;
+  for (uint32_t i = from; i < vec_dim; i++) {
+    float a = E::load(vec1, i);
+    float b = E::load(vec2, i);
+    if (Op::checks_zero) zero |= (b == 0);
+    bad |= !std::isfinite(E::store(result, i, Op::apply(a, b)));
+  }
+  *has_zero |= zero;
+  *out_of_range |= bad;
+}
+
+template <class Op, class E = fp32_element>
+op_status elementwise_scalar(uint32_t vec_dim, const char *vec1,
+                             const char *vec2, char *result) {
+  bool has_zero = false, out_of_range = false;
+  elementwise_tail<Op, E>(0, vec_dim, vec1, vec2, result, &has_zero,
+                          &out_of_range);
+  return make_status(has_zero, out_of_range);
+}
+
+/*
+  Operators of the fused kernels: f(s, a, b) for each register width.
+*/
+
+struct scale_op {
+  static float apply(float s, float a, float) { return s * a; }
+#ifdef VECTOR_KERNELS_X86
+  TARGET_SSE2 static __m128 apply(__m128 s, __m128 a, __m128) {
+    return _mm_mul_ps(s, a);
+  }
+  TARGET_AVX2 static __m256 apply(__m256 s, __m256 a, __m256) {
+    return _mm256_mul_ps(s, a);
+  }
+  TARGET_AVX512 static __m512 apply(__m512 s, __m512 a, __m512) {
+    return _mm512_mul_ps(s, a);
+  }
+#endif
+};
+
+struct axpy_op {
+  static float apply(float s, float a, float b) { return std::fma(s, a, b); }
+#ifdef VECTOR_KERNELS_X86
+  TARGET_SSE2 static __m128 apply(__m128 s, __m128 a, __m128 b) {
+    return _mm_add_ps(_mm_mul_ps(s, a), b);
+  }
+  TARGET_AVX2 static __m256 apply(__m256 s, __m256 a, __m256 b) {
+    return _mm256_fmadd_ps(s, a, b);
+  }
+  TARGET_AVX512 static __m512 apply(__m512 s, __m512 a, __m512 b) {
+    return _mm512_fmadd_ps(s, a, b);
+  }
+#endif
+};
+
+struct lerp_op {
+  static float apply(float s, float a, float b) {
+    return std::fma(s, b - a, a);
+  }
+#ifdef VECTOR_KERNELS_X86
+  TARGET_SSE2 static __m128 apply(__m128 s, __m128 a, __m128 b) {
+    return _mm_add_ps(_mm_mul_ps(s, _mm_sub_ps(b, a)), a);
+  }
+  TARGET_AVX2 static __m256 apply(__m256 s, __m256 a, __m256 b) {
+    return _mm256_fmadd_ps(s, _mm256_sub_ps(b, a), a);
+  }
+  TARGET_AVX512 static __m512 apply(__m512 s, __m512 a, __m512 b) {
+    return _mm512_fmadd_ps(s, _mm512_sub_ps(b, a), a);
+  }
+#endif
+};
+
+template <class Op>
+inline void fused_tail(uint32_t from, uint32_t vec_dim, float s,
+                       const char *vec1, const char *vec2, char *result,
+                       bool *out_of_range) {
+  bool bad = false;
+  for (uint32_t i = from; i < vec_dim; i++) {
+    float value = Op::apply(s, load_float(vec1, i), load_float(vec2, i));
+    bad |= !std::isfinite(value);
+    store_float(result, i, value);
+  }
+  *out_of_range |= bad;
+}
+
+template <class Op>
+op_status fused_scalar(uint32_t vec_dim, float s, const char *vec1,
+                       const char *vec2, char *result) {
+  bool out_of_range = false;
+  fused_tail<Op>(0, vec_dim, s, vec1, vec2, result, &out_of_range);
+  return make_status(false, out_of_range);
+}
+
+/*
+  Operators of the reduction kernels: acc + f(a, b) for each register width.
+*/
+
+struct dot_op {
+  static float apply(float acc, float a, float b) { return acc + a * b; }
+#ifdef VECTOR_KERNELS_X86
+  TARGET_SSE2 static __m128 apply(__m128 acc, __m128 a, __m128 b) {
+    return _mm_add_ps(acc, _mm_mul_ps(a, b));
+  }
+  TARGET_AVX2 static __m256 apply(__m256 acc, __m256 a, __m256 b) {
+    return _mm256_fmadd_ps(a, b, acc);
+  }
+  TARGET_AVX512 static __m512 apply(__m512 acc, __m512 a, __m512 b) {
+    return _mm512_fmadd_ps(a, b, acc);
+  }
+#endif
+};
+
+struct l2_squared_op {
+  static float apply(float acc, float a, float b) {
+    float d = a - b;
+    return acc + d * d;
+  }
+#ifdef VECTOR_KERNELS_X86
+  TARGET_SSE2 static __m128 apply(__m128 acc, __m128 a, __m128 b) {
+    __m128 d = _mm_sub_ps(a, b);
+    return _mm_add_ps(acc, _mm_mul_ps(d, d));
+  }
+  TARGET_AVX2 static __m256 apply(__m256 acc, __m256 a, __m256 b) {
+    __m256 d = _mm256_sub_ps(a, b);
+    return _mm256_fmadd_ps(d, d, acc);
+  }
+  TARGET_AVX512 static __m512 apply(__m512 acc, __m512 a, __m512 b) {
+    __m512 d = _mm512_sub_ps(a, b);
+    return _mm512_fmadd_ps(d, d, acc);
+  }
+#endif
+};
+
+struct l1_op {
+  static float apply(float acc, float a, float b) {
+    return acc + std::fabs(a - b);
+  }
+#ifdef VECTOR_KERNELS_X86
+  TARGET_SSE2 static __m128 apply(__m128 acc, __m128 a, __m128 b) {
+    __m128 d = _mm_sub_ps(a, b);
+    return _mm_add_ps(acc, _mm_andnot_ps(_mm_set1_ps(-0.0f), d));
+  }
+  TARGET_AVX2 static __m256 apply(__m256 acc, __m256 a, __m256 b) {
+    __m256 d = _mm256_sub_ps(a, b);
+    return _mm256_add_ps(acc, _mm256_andnot_ps(_mm256_set1_ps(-0.0f), d));
+  }
+  TARGET_AVX512 static __m512 apply(__m512 acc, __m512 a, __m512 b) {
+    return _mm512_add_ps(acc, _mm512_abs_ps(_mm512_sub_ps(a, b)));
+  }
+#endif
+};
+
+template <class Op, class E = fp32_element>
+double reduce_scalar(uint32_t vec_dim, const char *vec1, const char *vec2) {
+  float acc[4] = {0, 0, 0, 0};
+  uint32_t i = 0;
+  for (; i + 4 <= vec_dim; i += 4) {
+    for (uint32_t j = 0; j < 4; j++)
+      acc[j] = Op::apply(acc[j], E::load(vec1, i + j), E::load(vec2, i + j));
+  }
+  for (; i < vec_dim; i++)
+    acc[0] = Op::apply(acc[0], E::load(vec1, i), E::load(vec2, i));
+  return static_cast<double>(acc[0] + acc[1]) + (acc[2] + acc[3]);
+}
+
+/*
+  The cosine kernels are instantiated with and without the norm of vec2; the
+  latter is used when vec2 is a constant whose norm is already known.
+*/
+template <bool with_norm2, class E = fp32_element>
+cosine_terms cosine_scalar(uint32_t vec_dim, const char *vec1,
+                           const char *vec2) {
+  float dot = 0, norm1 = 0, norm2 = 0;
+  for (uint32_t i = 0; i < vec_dim; i++) {
+    float a = E::load(vec1, i);
+    float b = E::load(vec2, i);
+    dot += a * b;
+    norm1 += a * a;
+    if (with_norm2) norm2 += b * b;
+  }
+  return {dot, norm1, norm2};
+}
+
+void accumulate_scalar(uint32_t vec_dim, const char *vec, double *acc) {
+  for (uint32_t i = 0; i < vec_dim; i++) acc[i] += load_float(vec, i);
+}
+
+template <class From, class To>
+op_status convert_scalar(uint32_t vec_dim, const char *src, char *dst) {
+  bool bad = false;
+  for (uint32_t i = 0; i < vec_dim; i++)
+    bad |= !std::isfinite(To::store(dst, i, From::load(src, i)));
+  return make_status(false, bad);
+}
+
+int64_t int8_dot_scalar(uint32_t n, const char *code1, const char *code2) {
+  const int8_t *a = reinterpret_cast<const int8_t *>(code1);
+  const int8_t *b = reinterpret_cast<const int8_t *>(code2);
+  int64_t dot = 0;
+  for (uint32_t i = 0; i < n; i++) dot += int32_t{a[i]} * b[i];
+  return dot;
+}
+
+uint64_t hamming_scalar(size_t bytes, const char *code1, const char *code2) {
+  uint64_t distance = 0;
+  size_t i = 0;
+  for (; i + 8 <= bytes; i += 8) {
+    uint64_t a, b;
+    memcpy(&a, code1 + i, 8);
+    memcpy(&b, code2 + i, 8);
+    distance += __builtin_popcountll(a ^ b);
+  }
+  for (; i < bytes; i++)
+    distance += __builtin_popcount(static_cast<unsigned char>(code1[i] ^
+                                                              code2[i]));
+  return distance;
+}
+
+void panel_gemv_scalar(uint32_t cols, const float *panel, const char *vec,
+                       float *result) {
+  float acc[panel_rows] = {};
+  for (uint32_t j = 0; j < cols; j++) {
+    float x = load_float(vec, j);
+    for (uint32_t r = 0; r < panel_rows; r++)
+      acc[r] += panel[j * panel_rows + r] * x;
+  }
+  for (uint32_t r = 0; r < panel_rows; r++) result[r] += acc[r];
+}
+
+double gather_dot_scalar(uint32_t nnz, const char *indexes,
+                         const char *values, const char *dense) {
+  double sum = 0;
+  for (uint32_t i = 0; i < nnz; i++) {
+    uint32_t index;
+    memcpy(&index, indexes + i * sizeof(uint32_t), sizeof(index));
+    sum += static_cast<double>(load_float(values, i)) *
+           static_cast<double>(load_float(dense, index));
+  }
+  return sum;
+}
+
+void moments_scalar(uint32_t vec_dim, const char *vec, double inv_count,
+                    double *mean, double *m2, float *min, float *max) {
+  for (uint32_t i = 0; i < vec_dim; i++) {
+    float x = load_float(vec, i);
+    double delta = x - mean[i];
+    mean[i] += delta * inv_count;
+    m2[i] += delta * (x - mean[i]);
+    min[i] = std::min(min[i], x);
+    max[i] = std::max(max[i], x);
+  }
+}
+
+/* The columns [begin, n) of rank_update_fn. */
+void rank_update_columns(uint32_t n, uint32_t first, uint32_t begin,
+                         uint32_t rows, const double *block, double *matrix) {
+  const uint32_t last = std::min(n, first + rank_update_rows);
+  for (uint32_t r = 0; r < rows; r++) {
+    const double *row = block + size_t{r} * n;
+    for (uint32_t i = first; i < last; i++) {
+      double *y = matrix + size_t{i} * n;
+      const double a = row[i];
+      for (uint32_t j = begin; j < n; j++) y[j] += a * row[j];
+    }
+  }
+}
+
+void rank_update_scalar(uint32_t n, uint32_t first, uint32_t rows,
+                        const double *block, double *matrix) {
+  rank_update_columns(n, first, first, rows, block, matrix);
+}
+
+#ifdef VECTOR_KERNELS_X86
+
+/*
+  The SIMD kernels detect non-finite results by OR-ing (r - r) into an
+  accumulator: it is +0.0 for every finite r and NaN otherwise, so the
+  accumulator stays all-zero bits as long as every result is finite.
+*/
+
+template <class Op>
+TARGET_SSE2 op_status elementwise_sse2(uint32_t vec_dim, const char *vec1,
+                                       const char *vec2, char *result) {
+  const float *a = reinterpret_cast<const float *>(vec1);
+  const float *b = reinterpret_cast<const float *>(vec2);
+  float *r = reinterpret_cast<float *>(result);
+  const __m128 zero = _mm_setzero_ps();
+  __m128 zeros = _mm_setzero_ps();
+  __m128 bad = _mm_setzero_ps();
+
+  uint32_t i = 0;
+  for (; i + 4 <= vec_dim; i += 4) {
+    __m128 va = _mm_loadu_ps(a + i);
+    __m128 vb = _mm_loadu_ps(b + i);
+    if (Op::checks_zero) zeros = _mm_or_ps(zeros, _mm_cmpeq_ps(vb, zero));
+    __m128 vr = Op::apply(va, vb);
+    bad = _mm_or_ps(bad, _mm_sub_ps(vr, vr));
+    _mm_storeu_ps(r + i, vr);
+  }
+
+  bool has_zero = _mm_movemask_ps(zeros) != 0;
+  bool out_of_range =
+      _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_castps_si128(bad),
+                                        _mm_setzero_si128())) != 0xFFFF;
+  elementwise_tail<Op>(i, vec_dim, vec1, vec2, result, &has_zero,
+                       &out_of_range);
+  return make_status(has_zero, out_of_range);
+}
+
+template <class Op, class E = fp32_element, uint32_t N = 0>
+TARGET_AVX2 op_status elementwise_avx2(uint32_t vec_dim, const char *vec1,
+                                       const char *vec2, char *result) {
+  if (N != 0) vec_dim = N;
+  const __m256 zero = _mm256_setzero_ps();
+  __m256 zeros = _mm256_setzero_ps();
+  __m256 bad = _mm256_setzero_ps();
+
+  uint32_t i = 0;
+  for (; i + 8 <= vec_dim; i += 8) {
+    __m256 va = E::load_avx2(vec1, i);
+    __m256 vb = E::load_avx2(vec2, i);
+    if (Op::checks_zero)
+      zeros = _mm256_or_ps(zeros, _mm256_cmp_ps(vb, zero, _CMP_EQ_OQ));
+    __m256 vr = E::store_avx2(result, i, Op::apply(va, vb));
+    bad = _mm256_or_ps(bad, _mm256_sub_ps(vr, vr));
+  }
+
+  bool has_zero = _mm256_movemask_ps(zeros) != 0;
+  bool out_of_range = !_mm256_testz_si256(_mm256_castps_si256(bad),
+                                          _mm256_castps_si256(bad));
+  elementwise_tail<Op, E>(i, vec_dim, vec1, vec2, result, &has_zero,
+                          &out_of_range);
+  return make_status(has_zero, out_of_range);
+}
+
+/* AVX-512 handles the tail with masked loads and stores. */
+template <class Op, class E = fp32_element, uint32_t N = 0>
+TARGET_AVX512 op_status elementwise_avx512(uint32_t vec_dim, const char *vec1,
+                                           const char *vec2, char *result) {
+  if (N != 0) vec_dim = N;
+  const __m512 zero = _mm512_setzero_ps();
+  const __m512 one = _mm512_set1_ps(1.0f);
+  __mmask16 zeros = 0;
+  __mmask16 bad = 0;
+
+  uint32_t i = 0;
+  for (; i + 16 <= vec_dim; i += 16) {
+    __m512 va = E::load_avx512(vec1, i);
+    __m512 vb = E::load_avx512(vec2, i);
+    if (Op::checks_zero) zeros |= _mm512_cmp_ps_mask(vb, zero, _CMP_EQ_OQ);
+    __m512 vr = E::store_avx512(result, i, Op::apply(va, vb));
+    __m512 vd = _mm512_sub_ps(vr, vr);
+    bad |= _mm512_cmp_ps_mask(vd, vd, _CMP_UNORD_Q);
+  }
+  if (i < vec_dim) {
+    __mmask16 mask = static_cast<__mmask16>((1u << (vec_dim - i)) - 1);
+    /* Inactive lanes compute 1 <op> 1, which is finite for every op. */
+    __m512 va = _mm512_mask_blend_ps(mask, one, E::load_avx512(vec1, i, mask));
+    __m512 vb = _mm512_mask_blend_ps(mask, one, E::load_avx512(vec2, i, mask));
+    if (Op::checks_zero) zeros |= _mm512_cmp_ps_mask(vb, zero, _CMP_EQ_OQ);
+    __m512 vr = E::store_avx512(result, i, mask, Op::apply(va, vb));
+    __m512 vd = _mm512_sub_ps(vr, vr);
+    bad |= _mm512_cmp_ps_mask(vd, vd, _CMP_UNORD_Q);
+  }
+
+  return make_status(zeros != 0, bad != 0);
+}
+
+template <class Op>
+TARGET_SSE2 op_status fused_sse2(uint32_t vec_dim, float s, const char *vec1,
+                                 const char *vec2, char *result) {
+  const float *a = reinterpret_cast<const float *>(vec1);
+  const float *b = reinterpret_cast<const float *>(vec2);
+  float *r = reinterpret_cast<float *>(result);
+  const __m128 vs = _mm_set1_ps(s);
+  __m128 bad = _mm_setzero_ps();
+
+  uint32_t i = 0;
+  for (; i + 4 <= vec_dim; i += 4) {
+    __m128 vr = Op::apply(vs, _mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+    bad = _mm_or_ps(bad, _mm_sub_ps(vr, vr));
+    _mm_storeu_ps(r + i, vr);
+  }
+
+  bool out_of_range =
+      _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_castps_si128(bad),
+                                        _mm_setzero_si128())) != 0xFFFF;
+  fused_tail<Op>(i, vec_dim, s, vec1, vec2, result, &out_of_range);
+  return make_status(false, out_of_range);
+}
+
+template <class Op>
+TARGET_AVX2 op_status fused_avx2(uint32_t vec_dim, float s, const char *vec1,
+                                 const char *vec2, char *result) {
+  const float *a = reinterpret_cast<const float *>(vec1);
+  const float *b = reinterpret_cast<const float *>(vec2);
+  float *r = reinterpret_cast<float *>(result);
+  const __m256 vs = _mm256_set1_ps(s);
+  __m256 bad = _mm256_setzero_ps();
+
+  uint32_t i = 0;
+  for (; i + 8 <= vec_dim; i += 8) {
+    __m256 vr =
+        Op::apply(vs, _mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+    bad = _mm256_or_ps(bad, _mm256_sub_ps(vr, vr));
+    _mm256_storeu_ps(r + i, vr);
+  }
+
+  bool out_of_range = !_mm256_testz_si256(_mm256_castps_si256(bad),
+                                          _mm256_castps_si256(bad));
+  fused_tail<Op>(i, vec_dim, s, vec1, vec2, result, &out_of_range);
+  return make_status(false, out_of_range);
+}
+
+template <class Op>
+TARGET_AVX512 op_status fused_avx512(uint32_t vec_dim, float s,
+                                     const char *vec1, const char *vec2,
+                                     char *result) {
+  const float *a = reinterpret_cast<const float *>(vec1);
+  const float *b = reinterpret_cast<const float *>(vec2);
+  float *r = reinterpret_cast<float *>(result);
+  const __m512 vs = _mm512_set1_ps(s);
+  __mmask16 bad = 0;
+
+  uint32_t i = 0;
+  for (; i + 16 <= vec_dim; i += 16) {
+    __m512 vr =
+        Op::apply(vs, _mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+    __m512 vd = _mm512_sub_ps(vr, vr);
+    bad |= _mm512_cmp_ps_mask(vd, vd, _CMP_UNORD_Q);
+    _mm512_storeu_ps(r + i, vr);
+  }
+  if (i < vec_dim) {
+    __mmask16 mask = static_cast<__mmask16>((1u << (vec_dim - i)) - 1);
+    __m512 vr = Op::apply(vs, _mm512_maskz_loadu_ps(mask, a + i),
+                          _mm512_maskz_loadu_ps(mask, b + i));
+    __m512 vd = _mm512_sub_ps(vr, vr);
+    bad |= _mm512_mask_cmp_ps_mask(mask, vd, vd, _CMP_UNORD_Q);
+    _mm512_mask_storeu_ps(r + i, mask, vr);
+  }
+
+  return make_status(false, bad != 0);
+}
+
+TARGET_SSE2 inline float horizontal_sum(__m128 v) {
+  __m128 shuf = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+  __m128 sums = _mm_add_ps(v, shuf);
+  shuf = _mm_movehl_ps(shuf, sums);
+  return _mm_cvtss_f32(_mm_add_ss(sums, shuf));
+}
+
+TARGET_AVX2 inline float horizontal_sum(__m256 v) {
+  return horizontal_sum(
+      _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1)));
+}
+
+AVX512_UNINITIALIZED_WARNINGS_OFF
+TARGET_AVX512 inline float horizontal_sum(__m512 v) {
+  return _mm512_reduce_add_ps(v);
+}
+AVX512_UNINITIALIZED_WARNINGS_ON
+
+/*
+  The SIMD reductions keep four independent accumulators so that consecutive
+  FMAs do not wait on each other's latency.
+*/
+
+template <class Op>
+TARGET_SSE2 double reduce_sse2(uint32_t vec_dim, const char *vec1,
+                               const char *vec2) {
+  const float *a = reinterpret_cast<const float *>(vec1);
+  const float *b = reinterpret_cast<const float *>(vec2);
+  __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+  __m128 acc2 = _mm_setzero_ps(), acc3 = _mm_setzero_ps();
+
+  uint32_t i = 0;
+  for (; i + 16 <= vec_dim; i += 16) {
+    acc0 = Op::apply(acc0, _mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+    acc1 = Op::apply(acc1, _mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4));
+    acc2 = Op::apply(acc2, _mm_loadu_ps(a + i + 8), _mm_loadu_ps(b + i + 8));
+    acc3 =
+        Op::apply(acc3, _mm_loadu_ps(a + i + 12), _mm_loadu_ps(b + i + 12));
+  }
+  for (; i + 4 <= vec_dim; i += 4)
+    acc0 = Op::apply(acc0, _mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+
+  float tail = 0;
+  for (; i < vec_dim; i++)
+    tail = Op::apply(tail, load_float(vec1, i), load_float(vec2, i));
+  __m128 acc = _mm_add_ps(_mm_add_ps(acc0, acc1), _mm_add_ps(acc2, acc3));
+  return static_cast<double>(horizontal_sum(acc)) + tail;
+}
+
+template <class Op, class E = fp32_element, uint32_t N = 0>
+TARGET_AVX2 double reduce_avx2(uint32_t vec_dim, const char *vec1,
+                               const char *vec2) {
+  if (N != 0) vec_dim = N;
+  __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+  __m256 acc2 = _mm256_setzero_ps(), acc3 = _mm256_setzero_ps();
+
+  uint32_t i = 0;
+  for (; i + 32 <= vec_dim; i += 32) {
+    acc0 = Op::apply(acc0, E::load_avx2(vec1, i), E::load_avx2(vec2, i));
+    acc1 = Op::apply(acc1, E::load_avx2(vec1, i + 8),
+                     E::load_avx2(vec2, i + 8));
+    acc2 = Op::apply(acc2, E::load_avx2(vec1, i + 16),
+                     E::load_avx2(vec2, i + 16));
+    acc3 = Op::apply(acc3, E::load_avx2(vec1, i + 24),
+                     E::load_avx2(vec2, i + 24));
+  }
+  for (; i + 8 <= vec_dim; i += 8)
+    acc0 = Op::apply(acc0, E::load_avx2(vec1, i), E::load_avx2(vec2, i));
+
+  float tail = 0;
+  for (; i < vec_dim; i++)
+    tail = Op::apply(tail, E::load(vec1, i), E::load(vec2, i));
+  __m256 acc =
+      _mm256_add_ps(_mm256_add_ps(acc0, acc1), _mm256_add_ps(acc2, acc3));
+  return static_cast<double>(horizontal_sum(acc)) + tail;
+}
+
+template <class Op, class E = fp32_element, uint32_t N = 0>
+TARGET_AVX512 double reduce_avx512(uint32_t vec_dim, const char *vec1,
+                                   const char *vec2) {
+  if (N != 0) vec_dim = N;
+  __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+  __m512 acc2 = _mm512_setzero_ps(), acc3 = _mm512_setzero_ps();
+
+  uint32_t i = 0;
+  for (; i + 64 <= vec_dim; i += 64) {
+    acc0 = Op::apply(acc0, E::load_avx512(vec1, i), E::load_avx512(vec2, i));
+    acc1 = Op::apply(acc1, E::load_avx512(vec1, i + 16),
+                     E::load_avx512(vec2, i + 16));
+    acc2 = Op::apply(acc2, E::load_avx512(vec1, i + 32),
+                     E::load_avx512(vec2, i + 32));
+    acc3 = Op::apply(acc3, E::load_avx512(vec1, i + 48),
+                     E::load_avx512(vec2, i + 48));
+  }
+  for (; i + 16 <= vec_dim; i += 16)
+    acc0 = Op::apply(acc0, E::load_avx512(vec1, i), E::load_avx512(vec2, i));
+  if (i < vec_dim) {
+    /* Inactive lanes load 0 on both sides and contribute nothing. */
+    __mmask16 mask = static_cast<__mmask16>((1u << (vec_dim - i)) - 1);
+    acc1 = Op::apply(acc1, E::load_avx512(vec1, i, mask),
+                     E::load_avx512(vec2, i, mask));
+  }
+
+  __m512 acc =
+      _mm512_add_ps(_mm512_add_ps(acc0, acc1), _mm512_add_ps(acc2, acc3));
+  return horizontal_sum(acc);
+}
+
+template <bool with_norm2>
+TARGET_SSE2 cosine_terms cosine_sse2(uint32_t vec_dim, const char *vec1,
+                                     const char *vec2) {
+  const float *a = reinterpret_cast<const float *>(vec1);
+  const float *b = reinterpret_cast<const float *>(vec2);
+  __m128 dot = _mm_setzero_ps(), norm1 = _mm_setzero_ps();
+  __m128 norm2 = _mm_setzero_ps();
+
+  uint32_t i = 0;
+  for (; i + 4 <= vec_dim; i += 4) {
+    __m128 va = _mm_loadu_ps(a + i);
+    __m128 vb = _mm_loadu_ps(b + i);
+    dot = _mm_add_ps(dot, _mm_mul_ps(va, vb));
+    norm1 = _mm_add_ps(norm1, _mm_mul_ps(va, va));
+    if (with_norm2) norm2 = _mm_add_ps(norm2, _mm_mul_ps(vb, vb));
+  }
+
+  cosine_terms terms = cosine_scalar<with_norm2>(
+      vec_dim - i, vec1 + i * sizeof(float), vec2 + i * sizeof(float));
+  terms.dot += horizontal_sum(dot);
+  terms.norm1 += horizontal_sum(norm1);
+  terms.norm2 += horizontal_sum(norm2);
+  return terms;
+}
+
+template <bool with_norm2, class E = fp32_element, uint32_t N = 0>
+TARGET_AVX2 cosine_terms cosine_avx2(uint32_t vec_dim, const char *vec1,
+                                     const char *vec2) {
+  if (N != 0) vec_dim = N;
+  __m256 dot0 = _mm256_setzero_ps(), dot1 = _mm256_setzero_ps();
+  __m256 norm10 = _mm256_setzero_ps(), norm11 = _mm256_setzero_ps();
+  __m256 norm20 = _mm256_setzero_ps(), norm21 = _mm256_setzero_ps();
+
+  uint32_t i = 0;
+  for (; i + 16 <= vec_dim; i += 16) {
+    __m256 va0 = E::load_avx2(vec1, i), va1 = E::load_avx2(vec1, i + 8);
+    __m256 vb0 = E::load_avx2(vec2, i), vb1 = E::load_avx2(vec2, i + 8);
+    dot0 = _mm256_fmadd_ps(va0, vb0, dot0);
+    dot1 = _mm256_fmadd_ps(va1, vb1, dot1);
+    norm10 = _mm256_fmadd_ps(va0, va0, norm10);
+    norm11 = _mm256_fmadd_ps(va1, va1, norm11);
+    if (with_norm2) {
+      norm20 = _mm256_fmadd_ps(vb0, vb0, norm20);
+      norm21 = _mm256_fmadd_ps(vb1, vb1, norm21);
+    }
+  }
+  for (; i + 8 <= vec_dim; i += 8) {
+    __m256 va = E::load_avx2(vec1, i);
+    __m256 vb = E::load_avx2(vec2, i);
+    dot0 = _mm256_fmadd_ps(va, vb, dot0);
+    norm10 = _mm256_fmadd_ps(va, va, norm10);
+    if (with_norm2) norm20 = _mm256_fmadd_ps(vb, vb, norm20);
+  }
+
+  cosine_terms terms = cosine_scalar<with_norm2, E>(
+      vec_dim - i, vec1 + i * E::size, vec2 + i * E::size);
+  terms.dot += horizontal_sum(_mm256_add_ps(dot0, dot1));
+  terms.norm1 += horizontal_sum(_mm256_add_ps(norm10, norm11));
+  terms.norm2 += horizontal_sum(_mm256_add_ps(norm20, norm21));
+  return terms;
+}
+
+template <bool with_norm2, class E = fp32_element, uint32_t N = 0>
+TARGET_AVX512 cosine_terms cosine_avx512(uint32_t vec_dim, const char *vec1,
+                                         const char *vec2) {
+  if (N != 0) vec_dim = N;
+  __m512 dot0 = _mm512_setzero_ps(), dot1 = _mm512_setzero_ps();
+  __m512 norm10 = _mm512_setzero_ps(), norm11 = _mm512_setzero_ps();
+  __m512 norm20 = _mm512_setzero_ps(), norm21 = _mm512_setzero_ps();
+
+  uint32_t i = 0;
+  for (; i + 32 <= vec_dim; i += 32) {
+    __m512 va0 = E::load_avx512(vec1, i);
+    __m512 va1 = E::load_avx512(vec1, i + 16);
+    __m512 vb0 = E::load_avx512(vec2, i);
+    __m512 vb1 = E::load_avx512(vec2, i + 16);
+    dot0 = _mm512_fmadd_ps(va0, vb0, dot0);
+    dot1 = _mm512_fmadd_ps(va1, vb1, dot1);
+    norm10 = _mm512_fmadd_ps(va0, va0, norm10);
+    norm11 = _mm512_fmadd_ps(va1, va1, norm11);
+    if (with_norm2) {
+      norm20 = _mm512_fmadd_ps(vb0, vb0, norm20);
+      norm21 = _mm512_fmadd_ps(vb1, vb1, norm21);
+    }
+  }
+  while (i < vec_dim) {
+    uint32_t left = vec_dim - i;
+    __mmask16 mask =
+        left >= 16 ? 0xFFFF : static_cast<__mmask16>((1u << left) - 1);
+    __m512 va = E::load_avx512(vec1, i, mask);
+    __m512 vb = E::load_avx512(vec2, i, mask);
+    dot0 = _mm512_fmadd_ps(va, vb, dot0);
+    norm10 = _mm512_fmadd_ps(va, va, norm10);
+    if (with_norm2) norm20 = _mm512_fmadd_ps(vb, vb, norm20);
+    i += 16;
+  }
+
+  return {horizontal_sum(_mm512_add_ps(dot0, dot1)),
+          horizontal_sum(_mm512_add_ps(norm10, norm11)),
+          horizontal_sum(_mm512_add_ps(norm20, norm21))};
+}
+
+TARGET_SSE2 void accumulate_sse2(uint32_t vec_dim, const char *vec,
+                                 double *acc) {
+  const float *v = reinterpret_cast<const float *>(vec);
+  uint32_t i = 0;
+  for (; i + 4 <= vec_dim; i += 4) {
+    __m128 f = _mm_loadu_ps(v + i);
+    _mm_storeu_pd(acc + i, _mm_add_pd(_mm_loadu_pd(acc + i), _mm_cvtps_pd(f)));
+    _mm_storeu_pd(acc + i + 2, _mm_add_pd(_mm_loadu_pd(acc + i + 2),
+                                          _mm_cvtps_pd(_mm_movehl_ps(f, f))));
+  }
+  for (; i < vec_dim; i++) acc[i] += load_float(vec, i);
+}
+
+TARGET_AVX2 void accumulate_avx2(uint32_t vec_dim, const char *vec,
+                                 double *acc) {
+  const float *v = reinterpret_cast<const float *>(vec);
+  uint32_t i = 0;
+  for (; i + 8 <= vec_dim; i += 8) {
+    __m256d lo = _mm256_cvtps_pd(_mm_loadu_ps(v + i));
+    __m256d hi = _mm256_cvtps_pd(_mm_loadu_ps(v + i + 4));
+    _mm256_storeu_pd(acc + i, _mm256_add_pd(_mm256_loadu_pd(acc + i), lo));
+    _mm256_storeu_pd(acc + i + 4,
+                     _mm256_add_pd(_mm256_loadu_pd(acc + i + 4), hi));
+  }
+  for (; i < vec_dim; i++) acc[i] += load_float(vec, i);
+}
+
+AVX512_UNINITIALIZED_WARNINGS_OFF
+TARGET_AVX512 void accumulate_avx512(uint32_t vec_dim, const char *vec,
+                                     double *acc) {
+  const float *v = reinterpret_cast<const float *>(vec);
+  uint32_t i = 0;
+  for (; i + 16 <= vec_dim; i += 16) {
+    __m512 f = _mm512_loadu_ps(v + i);
+    __m512d lo = _mm512_cvtps_pd(_mm512_castps512_ps256(f));
+    __m512d hi = _mm512_cvtps_pd(_mm256_castpd_ps(
+        _mm512_extractf64x4_pd(_mm512_castps_pd(f), 1)));
+    _mm512_storeu_pd(acc + i, _mm512_add_pd(_mm512_loadu_pd(acc + i), lo));
+    _mm512_storeu_pd(acc + i + 8,
+                     _mm512_add_pd(_mm512_loadu_pd(acc + i + 8), hi));
+  }
+  for (; i < vec_dim; i++) acc[i] += load_float(vec, i);
+}
+AVX512_UNINITIALIZED_WARNINGS_ON
+
+template <class From, class To>
+TARGET_AVX2 op_status convert_avx2(uint32_t vec_dim, const char *src,
+                                   char *dst) {
+  __m256 bad = _mm256_setzero_ps();
+  uint32_t i = 0;
+  for (; i + 8 <= vec_dim; i += 8) {
+    __m256 vr = To::store_avx2(dst, i, From::load_avx2(src, i));
+    bad = _mm256_or_ps(bad, _mm256_sub_ps(vr, vr));
+  }
+  if (!_mm256_testz_si256(_mm256_castps_si256(bad), _mm256_castps_si256(bad)))
+    return op_status::out_of_range;
+  return convert_scalar<From, To>(vec_dim - i, src + i * From::size,
+                                  dst + i * To::size);
+}
+
+template <class From, class To>
+TARGET_AVX512 op_status convert_avx512(uint32_t vec_dim, const char *src,
+                                       char *dst) {
+  __mmask16 bad = 0;
+  uint32_t i = 0;
+  for (; i + 16 <= vec_dim; i += 16) {
+    __m512 vr = To::store_avx512(dst, i, From::load_avx512(src, i));
+    __m512 vd = _mm512_sub_ps(vr, vr);
+    bad |= _mm512_cmp_ps_mask(vd, vd, _CMP_UNORD_Q);
+  }
+  if (i < vec_dim) {
+    __mmask16 mask = static_cast<__mmask16>((1u << (vec_dim - i)) - 1);
+    __m512 vr = To::store_avx512(dst, i, mask, From::load_avx512(src, i, mask));
+    __m512 vd = _mm512_sub_ps(vr, vr);
+    bad |= _mm512_mask_cmp_ps_mask(mask, vd, vd, _CMP_UNORD_Q);
+  }
+  return make_status(false, bad != 0);
+}
+
+/*
+  SSE2 has no sign extension of bytes: unpacking a byte with itself and
+  shifting the 16-bit lanes right by 8 does it.
+*/
+TARGET_SSE2 int64_t int8_dot_sse2(uint32_t n, const char *code1,
+                                  const char *code2) {
+  __m128i acc = _mm_setzero_si128();
+  uint32_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(code1 + i));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(code2 + i));
+    __m128i a_lo = _mm_srai_epi16(_mm_unpacklo_epi8(a, a), 8);
+    __m128i a_hi = _mm_srai_epi16(_mm_unpackhi_epi8(a, a), 8);
+    __m128i b_lo = _mm_srai_epi16(_mm_unpacklo_epi8(b, b), 8);
+    __m128i b_hi = _mm_srai_epi16(_mm_unpackhi_epi8(b, b), 8);
+    acc = _mm_add_epi32(acc, _mm_madd_epi16(a_lo, b_lo));
+    acc = _mm_add_epi32(acc, _mm_madd_epi16(a_hi, b_hi));
+  }
+  alignas(16) int32_t lanes[4];
+  _mm_store_si128(reinterpret_cast<__m128i *>(lanes), acc);
+  return int64_t{lanes[0]} + lanes[1] + lanes[2] + lanes[3] +
+         int8_dot_scalar(n - i, code1 + i, code2 + i);
+}
+
+TARGET_AVX2 int64_t int8_dot_avx2(uint32_t n, const char *code1,
+                                  const char *code2) {
+  __m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
+  uint32_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    __m256i a = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(code1 + i));
+    __m256i b = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(code2 + i));
+    acc0 = _mm256_add_epi32(
+        acc0, _mm256_madd_epi16(
+                  _mm256_cvtepi8_epi16(_mm256_castsi256_si128(a)),
+                  _mm256_cvtepi8_epi16(_mm256_castsi256_si128(b))));
+    acc1 = _mm256_add_epi32(
+        acc1, _mm256_madd_epi16(
+                  _mm256_cvtepi8_epi16(_mm256_extracti128_si256(a, 1)),
+                  _mm256_cvtepi8_epi16(_mm256_extracti128_si256(b, 1))));
+  }
+  alignas(32) int32_t lanes[8];
+  _mm256_store_si256(reinterpret_cast<__m256i *>(lanes),
+                     _mm256_add_epi32(acc0, acc1));
+  int64_t dot = 0;
+  for (int32_t lane : lanes) dot += lane;
+  return dot + int8_dot_scalar(n - i, code1 + i, code2 + i);
+}
+
+/*
+  Population count of the bytes of v: the count of each nibble is looked up
+  with a byte shuffle, then the bytes are summed per 64-bit lane.
+*/
+TARGET_AVX2 inline __m256i popcount_avx2(__m256i v) {
+  const __m256i lookup =
+      _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1,
+                       1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i low_mask = _mm256_set1_epi8(0x0f);
+  __m256i lo = _mm256_and_si256(v, low_mask);
+  __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+  __m256i counts = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo),
+                                   _mm256_shuffle_epi8(lookup, hi));
+  return _mm256_sad_epu8(counts, _mm256_setzero_si256());
+}
+
+TARGET_AVX2 uint64_t hamming_avx2(size_t bytes, const char *code1,
+                                  const char *code2) {
+  __m256i acc = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + 32 <= bytes; i += 32) {
+    __m256i a = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(code1 + i));
+    __m256i b = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(code2 + i));
+    acc = _mm256_add_epi64(acc, popcount_avx2(_mm256_xor_si256(a, b)));
+  }
+  alignas(32) uint64_t lanes[4];
+  _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), acc);
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+         hamming_scalar(bytes - i, code1 + i, code2 + i);
+}
+
+/*
+  VPDPBUSD multiplies unsigned by signed bytes, so code1 is biased by 128
+  (flipping its sign bit) and 128 * sum(code2), accumulated by a second
+  VPDPBUSD against a vector of ones, is subtracted at the end.
+*/
+AVX512_UNINITIALIZED_WARNINGS_OFF
+TARGET_AVX512_VNNI int64_t int8_dot_avx512_vnni(uint32_t n, const char *code1,
+                                                const char *code2) {
+  const __m512i sign = _mm512_set1_epi8(static_cast<char>(0x80));
+  const __m512i ones = _mm512_set1_epi8(1);
+  __m512i dot = _mm512_setzero_si512(), sum = _mm512_setzero_si512();
+  uint32_t i = 0;
+  for (; i + 64 <= n; i += 64) {
+    __m512i a = _mm512_loadu_si512(code1 + i);
+    __m512i b = _mm512_loadu_si512(code2 + i);
+    dot = _mm512_dpbusd_epi32(dot, _mm512_xor_si512(a, sign), b);
+    sum = _mm512_dpbusd_epi32(sum, ones, b);
+  }
+  if (i < n) {
+    /* Inactive lanes load 0 in b and contribute nothing. */
+    __mmask64 mask = (~0ULL) >> (64 - (n - i));
+    __m512i a = _mm512_maskz_loadu_epi8(mask, code1 + i);
+    __m512i b = _mm512_maskz_loadu_epi8(mask, code2 + i);
+    dot = _mm512_dpbusd_epi32(dot, _mm512_xor_si512(a, sign), b);
+    sum = _mm512_dpbusd_epi32(sum, ones, b);
+  }
+  return int64_t{_mm512_reduce_add_epi32(dot)} -
+         128 * int64_t{_mm512_reduce_add_epi32(sum)};
+}
+
+TARGET_AVX512_VNNI uint64_t hamming_avx512_vnni(size_t bytes,
+                                                const char *code1,
+                                                const char *code2) {
+  __m512i acc = _mm512_setzero_si512();
+  size_t i = 0;
+  for (; i + 64 <= bytes; i += 64) {
+    __m512i a = _mm512_loadu_si512(code1 + i);
+    __m512i b = _mm512_loadu_si512(code2 + i);
+    acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(_mm512_xor_si512(a, b)));
+  }
+  if (i < bytes) {
+    __mmask64 mask = (~0ULL) >> (64 - (bytes - i));
+    __m512i a = _mm512_maskz_loadu_epi8(mask, code1 + i);
+    __m512i b = _mm512_maskz_loadu_epi8(mask, code2 + i);
+    acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(_mm512_xor_si512(a, b)));
+  }
+  return _mm512_reduce_add_epi64(acc);
+}
+AVX512_UNINITIALIZED_WARNINGS_ON
+
+/*
+  The panel kernels keep the panel_rows sums in registers, with two sets of
+  accumulators for the even and odd columns to hide the latency of the
+  additions.
+*/
+TARGET_SSE2 void panel_gemv_sse2(uint32_t cols, const float *panel,
+                                 const char *vec, float *result) {
+  __m128 acc[8];
+  for (__m128 &a : acc) a = _mm_setzero_ps();
+  uint32_t j = 0;
+  for (; j + 2 <= cols; j += 2) {
+    const float *column = panel + j * panel_rows;
+    __m128 x0 = _mm_set1_ps(load_float(vec, j));
+    __m128 x1 = _mm_set1_ps(load_float(vec, j + 1));
+    for (int r = 0; r < 4; r++) {
+      acc[r] = _mm_add_ps(
+          acc[r], _mm_mul_ps(_mm_load_ps(column + 4 * r), x0));
+      acc[r + 4] = _mm_add_ps(
+          acc[r + 4],
+          _mm_mul_ps(_mm_load_ps(column + panel_rows + 4 * r), x1));
+    }
+  }
+  if (j < cols) {
+    __m128 x = _mm_set1_ps(load_float(vec, j));
+    for (int r = 0; r < 4; r++)
+      acc[r] = _mm_add_ps(
+          acc[r], _mm_mul_ps(_mm_load_ps(panel + j * panel_rows + 4 * r), x));
+  }
+  for (int r = 0; r < 4; r++)
+    _mm_storeu_ps(result + 4 * r,
+                  _mm_add_ps(_mm_loadu_ps(result + 4 * r),
+                             _mm_add_ps(acc[r], acc[r + 4])));
+}
+
+TARGET_AVX2 void panel_gemv_avx2(uint32_t cols, const float *panel,
+                                 const char *vec, float *result) {
+  __m256 lo0 = _mm256_setzero_ps(), hi0 = _mm256_setzero_ps();
+  __m256 lo1 = _mm256_setzero_ps(), hi1 = _mm256_setzero_ps();
+  uint32_t j = 0;
+  for (; j + 2 <= cols; j += 2) {
+    const float *column = panel + j * panel_rows;
+    __m256 x0 = _mm256_set1_ps(load_float(vec, j));
+    __m256 x1 = _mm256_set1_ps(load_float(vec, j + 1));
+    lo0 = _mm256_fmadd_ps(_mm256_load_ps(column), x0, lo0);
+    hi0 = _mm256_fmadd_ps(_mm256_load_ps(column + 8), x0, hi0);
+    lo1 = _mm256_fmadd_ps(_mm256_load_ps(column + 16), x1, lo1);
+    hi1 = _mm256_fmadd_ps(_mm256_load_ps(column + 24), x1, hi1);
+  }
+  if (j < cols) {
+    const float *column = panel + j * panel_rows;
+    __m256 x = _mm256_set1_ps(load_float(vec, j));
+    lo0 = _mm256_fmadd_ps(_mm256_load_ps(column), x, lo0);
+    hi0 = _mm256_fmadd_ps(_mm256_load_ps(column + 8), x, hi0);
+  }
+  _mm256_storeu_ps(result, _mm256_add_ps(_mm256_loadu_ps(result),
+                                         _mm256_add_ps(lo0, lo1)));
+  _mm256_storeu_ps(result + 8, _mm256_add_ps(_mm256_loadu_ps(result + 8),
+                                             _mm256_add_ps(hi0, hi1)));
+}
+
+TARGET_AVX512 void panel_gemv_avx512(uint32_t cols, const float *panel,
+                                     const char *vec, float *result) {
+  __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+  __m512 acc2 = _mm512_setzero_ps(), acc3 = _mm512_setzero_ps();
+  uint32_t j = 0;
+  for (; j + 4 <= cols; j += 4) {
+    const float *column = panel + j * panel_rows;
+    acc0 = _mm512_fmadd_ps(_mm512_load_ps(column),
+                           _mm512_set1_ps(load_float(vec, j)), acc0);
+    acc1 = _mm512_fmadd_ps(_mm512_load_ps(column + 16),
+                           _mm512_set1_ps(load_float(vec, j + 1)), acc1);
+    acc2 = _mm512_fmadd_ps(_mm512_load_ps(column + 32),
+                           _mm512_set1_ps(load_float(vec, j + 2)), acc2);
+    acc3 = _mm512_fmadd_ps(_mm512_load_ps(column + 48),
+                           _mm512_set1_ps(load_float(vec, j + 3)), acc3);
+  }
+  for (; j < cols; j++)
+    acc0 = _mm512_fmadd_ps(_mm512_load_ps(panel + j * panel_rows),
+                           _mm512_set1_ps(load_float(vec, j)), acc0);
+  __m512 sum = _mm512_add_ps(_mm512_add_ps(acc0, acc1),
+                             _mm512_add_ps(acc2, acc3));
+  _mm512_storeu_ps(result, _mm512_add_ps(_mm512_loadu_ps(result), sum));
+}
+
+TARGET_AVX2 double gather_dot_avx2(uint32_t nnz, const char *indexes,
+                                   const char *values, const char *dense) {
+  const float *base = reinterpret_cast<const float *>(dense);
+  __m256 acc = _mm256_setzero_ps();
+  uint32_t i = 0;
+  for (; i + 8 <= nnz; i += 8) {
+    __m256i index = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(indexes + i * sizeof(uint32_t)));
+    acc = _mm256_fmadd_ps(
+        _mm256_loadu_ps(reinterpret_cast<const float *>(values) + i),
+        _mm256_i32gather_ps(base, index, sizeof(float)), acc);
+  }
+  return horizontal_sum(acc) +
+         gather_dot_scalar(nnz - i, indexes + i * sizeof(uint32_t),
+                           values + i * sizeof(float), dense);
+}
+
+AVX512_UNINITIALIZED_WARNINGS_OFF
+TARGET_AVX512 double gather_dot_avx512(uint32_t nnz, const char *indexes,
+                                       const char *values, const char *dense) {
+  const float *base = reinterpret_cast<const float *>(dense);
+  __m512 acc = _mm512_setzero_ps();
+  uint32_t i = 0;
+  for (; i + 16 <= nnz; i += 16) {
+    __m512i index = _mm512_loadu_si512(indexes + i * sizeof(uint32_t));
+    acc = _mm512_fmadd_ps(
+        _mm512_loadu_ps(values + i * sizeof(float)),
+        _mm512_i32gather_ps(index, base, sizeof(float)), acc);
+  }
+  if (i < nnz) {
+    /* The masked lanes gather nothing, and so read no index past nnz. */
+    __mmask16 mask = static_cast<__mmask16>((1u << (nnz - i)) - 1);
+    __m512i index =
+        _mm512_maskz_loadu_epi32(mask, indexes + i * sizeof(uint32_t));
+    acc = _mm512_fmadd_ps(
+        _mm512_maskz_loadu_ps(mask, values + i * sizeof(float)),
+        _mm512_mask_i32gather_ps(_mm512_setzero_ps(), mask, index, base,
+                                 sizeof(float)),
+        acc);
+  }
+  return horizontal_sum(acc);
+}
+AVX512_UNINITIALIZED_WARNINGS_ON
+
+TARGET_AVX2 void moments_avx2(uint32_t vec_dim, const char *vec,
+                              double inv_count, double *mean, double *m2,
+                              float *min, float *max) {
+  const float *v = reinterpret_cast<const float *>(vec);
+  const __m256d inv = _mm256_set1_pd(inv_count);
+  uint32_t i = 0;
+  for (; i + 4 <= vec_dim; i += 4) {
+    __m128 f = _mm_loadu_ps(v + i);
+    __m256d x = _mm256_cvtps_pd(f);
+    __m256d previous = _mm256_loadu_pd(mean + i);
+    __m256d delta = _mm256_sub_pd(x, previous);
+    __m256d current = _mm256_fmadd_pd(delta, inv, previous);
+    _mm256_storeu_pd(mean + i, current);
+    _mm256_storeu_pd(m2 + i,
+                     _mm256_fmadd_pd(delta, _mm256_sub_pd(x, current),
+                                     _mm256_loadu_pd(m2 + i)));
+    _mm_storeu_ps(min + i, _mm_min_ps(_mm_loadu_ps(min + i), f));
+    _mm_storeu_ps(max + i, _mm_max_ps(_mm_loadu_ps(max + i), f));
+  }
+  moments_scalar(vec_dim - i, vec + i * sizeof(float), inv_count, mean + i,
+                 m2 + i, min + i, max + i);
+}
+
+AVX512_UNINITIALIZED_WARNINGS_OFF
+TARGET_AVX512 void moments_avx512(uint32_t vec_dim, const char *vec,
+                                  double inv_count, double *mean, double *m2,
+                                  float *min, float *max) {
+  const float *v = reinterpret_cast<const float *>(vec);
+  const __m512d inv = _mm512_set1_pd(inv_count);
+  uint32_t i = 0;
+  for (; i + 8 <= vec_dim; i += 8) {
+    __m256 f = _mm256_loadu_ps(v + i);
+    __m512d x = _mm512_cvtps_pd(f);
+    __m512d previous = _mm512_loadu_pd(mean + i);
+    __m512d delta = _mm512_sub_pd(x, previous);
+    __m512d current = _mm512_fmadd_pd(delta, inv, previous);
+    _mm512_storeu_pd(mean + i, current);
+    _mm512_storeu_pd(m2 + i,
+                     _mm512_fmadd_pd(delta, _mm512_sub_pd(x, current),
+                                     _mm512_loadu_pd(m2 + i)));
+    _mm256_storeu_ps(min + i, _mm256_min_ps(_mm256_loadu_ps(min + i), f));
+    _mm256_storeu_ps(max + i, _mm256_max_ps(_mm256_loadu_ps(max + i), f));
+  }
+  moments_scalar(vec_dim - i, vec + i * sizeof(float), inv_count, mean + i,
+                 m2 + i, min + i, max + i);
+}
+AVX512_UNINITIALIZED_WARNINGS_ON
+
+/*
+  The rank updates keep 8 (AVX2) or 16 (AVX-512) columns of the four matrix
+  rows in eight accumulators; every block row loads these columns once and
+  broadcasts its four elements on the rows. The last rows of the triangle,
+  fewer than four columns long, are left to the scalar kernel.
+*/
+
+TARGET_AVX2 void rank_update_avx2(uint32_t n, uint32_t first, uint32_t rows,
+                                  const double *block, double *matrix) {
+  if (first + rank_update_rows > n) {
+    rank_update_scalar(n, first, rows, block, matrix);
+    return;
+  }
+  double *y0 = matrix + size_t{first} * n;
+  double *y1 = y0 + n;
+  double *y2 = y1 + n;
+  double *y3 = y2 + n;
+  uint32_t j = first;
+  for (; j + 8 <= n; j += 8) {
+    __m256d a0 = _mm256_loadu_pd(y0 + j), b0 = _mm256_loadu_pd(y0 + j + 4);
+    __m256d a1 = _mm256_loadu_pd(y1 + j), b1 = _mm256_loadu_pd(y1 + j + 4);
+    __m256d a2 = _mm256_loadu_pd(y2 + j), b2 = _mm256_loadu_pd(y2 + j + 4);
+    __m256d a3 = _mm256_loadu_pd(y3 + j), b3 = _mm256_loadu_pd(y3 + j + 4);
+    for (uint32_t r = 0; r < rows; r++) {
+      const double *row = block + size_t{r} * n;
+      __m256d lo = _mm256_loadu_pd(row + j);
+      __m256d hi = _mm256_loadu_pd(row + j + 4);
+      __m256d c = _mm256_broadcast_sd(row + first);
+      a0 = _mm256_fmadd_pd(c, lo, a0);
+      b0 = _mm256_fmadd_pd(c, hi, b0);
+      c = _mm256_broadcast_sd(row + first + 1);
+      a1 = _mm256_fmadd_pd(c, lo, a1);
+      b1 = _mm256_fmadd_pd(c, hi, b1);
+      c = _mm256_broadcast_sd(row + first + 2);
+      a2 = _mm256_fmadd_pd(c, lo, a2);
+      b2 = _mm256_fmadd_pd(c, hi, b2);
+      c = _mm256_broadcast_sd(row + first + 3);
+      a3 = _mm256_fmadd_pd(c, lo, a3);
+      b3 = _mm256_fmadd_pd(c, hi, b3);
+    }
+    _mm256_storeu_pd(y0 + j, a0);
+    _mm256_storeu_pd(y0 + j + 4, b0);
+    _mm256_storeu_pd(y1 + j, a1);
+    _mm256_storeu_pd(y1 + j + 4, b1);
+    _mm256_storeu_pd(y2 + j, a2);
+    _mm256_storeu_pd(y2 + j + 4, b2);
+    _mm256_storeu_pd(y3 + j, a3);
+    _mm256_storeu_pd(y3 + j + 4, b3);
+  }
+  rank_update_columns(n, first, j, rows, block, matrix);
+}
+
+TARGET_AVX512 void rank_update_avx512(uint32_t n, uint32_t first,
+                                      uint32_t rows, const double *block,
+                                      double *matrix) {
+  if (first + rank_update_rows > n) {
+    rank_update_scalar(n, first, rows, block, matrix);
+    return;
+  }
+  double *y0 = matrix + size_t{first} * n;
+  double *y1 = y0 + n;
+  double *y2 = y1 + n;
+  double *y3 = y2 + n;
+  uint32_t j = first;
+  for (; j + 16 <= n; j += 16) {
+    __m512d a0 = _mm512_loadu_pd(y0 + j), b0 = _mm512_loadu_pd(y0 + j + 8);
+    __m512d a1 = _mm512_loadu_pd(y1 + j), b1 = _mm512_loadu_pd(y1 + j + 8);
+    __m512d a2 = _mm512_loadu_pd(y2 + j), b2 = _mm512_loadu_pd(y2 + j + 8);
+    __m512d a3 = _mm512_loadu_pd(y3 + j), b3 = _mm512_loadu_pd(y3 + j + 8);
+    for (uint32_t r = 0; r < rows; r++) {
+      const double *row = block + size_t{r} * n;
+      __m512d lo = _mm512_loadu_pd(row + j);
+      __m512d hi = _mm512_loadu_pd(row + j + 8);
+      __m512d c = _mm512_set1_pd(row[first]);
+      a0 = _mm512_fmadd_pd(c, lo, a0);
+      b0 = _mm512_fmadd_pd(c, hi, b0);
+      c = _mm512_set1_pd(row[first + 1]);
+      a1 = _mm512_fmadd_pd(c, lo, a1);
+      b1 = _mm512_fmadd_pd(c, hi, b1);
+      c = _mm512_set1_pd(row[first + 2]);
+      a2 = _mm512_fmadd_pd(c, lo, a2);
+      b2 = _mm512_fmadd_pd(c, hi, b2);
+      c = _mm512_set1_pd(row[first + 3]);
+      a3 = _mm512_fmadd_pd(c, lo, a3);
+      b3 = _mm512_fmadd_pd(c, hi, b3);
+    }
+    _mm512_storeu_pd(y0 + j, a0);
+    _mm512_storeu_pd(y0 + j + 8, b0);
+    _mm512_storeu_pd(y1 + j, a1);
+    _mm512_storeu_pd(y1 + j + 8, b1);
+    _mm512_storeu_pd(y2 + j, a2);
+    _mm512_storeu_pd(y2 + j + 8, b2);
+    _mm512_storeu_pd(y3 + j, a3);
+    _mm512_storeu_pd(y3 + j + 8, b3);
+  }
+  /* Up to 15 columns left, in one or two masked chunks of 8. */
+  for (; j < n; j += 8) {
+    __mmask8 mask =
+        static_cast<__mmask8>(n - j >= 8 ? 0xff : (1u << (n - j)) - 1);
+    __m512d a0 = _mm512_maskz_loadu_pd(mask, y0 + j);
+    __m512d a1 = _mm512_maskz_loadu_pd(mask, y1 + j);
+    __m512d a2 = _mm512_maskz_loadu_pd(mask, y2 + j);
+    __m512d a3 = _mm512_maskz_loadu_pd(mask, y3 + j);
+    for (uint32_t r = 0; r < rows; r++) {
+      const double *row = block + size_t{r} * n;
+      __m512d lo = _mm512_maskz_loadu_pd(mask, row + j);
+      a0 = _mm512_fmadd_pd(_mm512_set1_pd(row[first]), lo, a0);
+      a1 = _mm512_fmadd_pd(_mm512_set1_pd(row[first + 1]), lo, a1);
+      a2 = _mm512_fmadd_pd(_mm512_set1_pd(row[first + 2]), lo, a2);
+      a3 = _mm512_fmadd_pd(_mm512_set1_pd(row[first + 3]), lo, a3);
+    }
+    _mm512_mask_storeu_pd(y0 + j, mask, a0);
+    _mm512_mask_storeu_pd(y1 + j, mask, a1);
+    _mm512_mask_storeu_pd(y2 + j, mask, a2);
+    _mm512_mask_storeu_pd(y3 + j, mask, a3);
+  }
+}
+
+#endif /* VECTOR_KERNELS_X86 */
+
+/*
+  Kernels of the 16-bit element types. SSE2 has no conversion instructions,
+  so the SSE2 kernels of these types are the scalar ones.
+*/
+template <class E>
+constexpr element_kernels scalar_element_kernels = {
+    .addition = elementwise_scalar<add_op, E>,
+    .subtraction = elementwise_scalar<sub_op, E>,
+    .multiplication = elementwise_scalar<mul_op, E>,
+    .division = elementwise_scalar<div_op, E>,
+    .dot = reduce_scalar<dot_op, E>,
+    .l2_squared = reduce_scalar<l2_squared_op, E>,
+    .l1 = reduce_scalar<l1_op, E>,
+    .cosine = cosine_scalar<true, E>,
+    .widen = convert_scalar<E, fp32_element>,
+    .narrow = convert_scalar<fp32_element, E>,
+};
+
+#ifdef VECTOR_KERNELS_X86
+template <class E>
+constexpr element_kernels avx2_element_kernels = {
+    .addition = elementwise_avx2<add_op, E>,
+    .subtraction = elementwise_avx2<sub_op, E>,
+    .multiplication = elementwise_avx2<mul_op, E>,
+    .division = elementwise_avx2<div_op, E>,
+    .dot = reduce_avx2<dot_op, E>,
+    .l2_squared = reduce_avx2<l2_squared_op, E>,
+    .l1 = reduce_avx2<l1_op, E>,
+    .cosine = cosine_avx2<true, E>,
+    .widen = convert_avx2<E, fp32_element>,
+    .narrow = convert_avx2<fp32_element, E>,
+};
+
+template <class E>
+constexpr element_kernels avx512_element_kernels = {
+    .addition = elementwise_avx512<add_op, E>,
+    .subtraction = elementwise_avx512<sub_op, E>,
+    .multiplication = elementwise_avx512<mul_op, E>,
+    .division = elementwise_avx512<div_op, E>,
+    .dot = reduce_avx512<dot_op, E>,
+    .l2_squared = reduce_avx512<l2_squared_op, E>,
+    .l1 = reduce_avx512<l1_op, E>,
+    .cosine = cosine_avx512<true, E>,
+    .widen = convert_avx512<E, fp32_element>,
+    .narrow = convert_avx512<fp32_element, E>,
+};
+
+/*
+  The float kernels compiled for each of specialized_dimensions, in that
+  order.
+*/
+template <uint32_t N>
+constexpr dimension_kernels avx2_dimension_kernels = {
+    .dimension = N,
+    .addition = elementwise_avx2<add_op, fp32_element, N>,
+    .subtraction = elementwise_avx2<sub_op, fp32_element, N>,
+    .multiplication = elementwise_avx2<mul_op, fp32_element, N>,
+    .division = elementwise_avx2<div_op, fp32_element, N>,
+    .dot = reduce_avx2<dot_op, fp32_element, N>,
+    .l2_squared = reduce_avx2<l2_squared_op, fp32_element, N>,
+    .l1 = reduce_avx2<l1_op, fp32_element, N>,
+    .cosine = cosine_avx2<true, fp32_element, N>,
+    .dot_norm = cosine_avx2<false, fp32_element, N>,
+};
+
+template <uint32_t N>
+constexpr dimension_kernels avx512_dimension_kernels = {
+    .dimension = N,
+    .addition = elementwise_avx512<add_op, fp32_element, N>,
+    .subtraction = elementwise_avx512<sub_op, fp32_element, N>,
+    .multiplication = elementwise_avx512<mul_op, fp32_element, N>,
+    .division = elementwise_avx512<div_op, fp32_element, N>,
+    .dot = reduce_avx512<dot_op, fp32_element, N>,
+    .l2_squared = reduce_avx512<l2_squared_op, fp32_element, N>,
+    .l1 = reduce_avx512<l1_op, fp32_element, N>,
+    /*
+      Measured slower than the generic kernel: GCC loads vec2 twice in the
+      unrolled loop.
+    */
+    .cosine = cosine_avx512<true>,
+    .dot_norm = cosine_avx512<false, fp32_element, N>,
+};
+
+const dimension_kernels avx2_specialized[] = {
+    avx2_dimension_kernels<384>,  avx2_dimension_kernels<512>,
+    avx2_dimension_kernels<768>,  avx2_dimension_kernels<1024>,
+    avx2_dimension_kernels<1536>, avx2_dimension_kernels<3072>};
+
+const dimension_kernels avx512_specialized[] = {
+    avx512_dimension_kernels<384>,  avx512_dimension_kernels<512>,
+    avx512_dimension_kernels<768>,  avx512_dimension_kernels<1024>,
+    avx512_dimension_kernels<1536>, avx512_dimension_kernels<3072>};
+
+static_assert(std::size(avx2_specialized) ==
+                  std::size(specialized_dimensions) &&
+              std::size(avx512_specialized) ==
+                  std::size(specialized_dimensions));
+#endif
+
+const kernel_table scalar_kernels = {
+    .target = isa::scalar,
+    .addition = elementwise_scalar<add_op>,
+    .subtraction = elementwise_scalar<sub_op>,
+    .multiplication = elementwise_scalar<mul_op>,
+    .division = elementwise_scalar<div_op>,
+    .scale = fused_scalar<scale_op>,
+    .axpy = fused_scalar<axpy_op>,
+    .lerp = fused_scalar<lerp_op>,
+    .dot = reduce_scalar<dot_op>,
+    .l2_squared = reduce_scalar<l2_squared_op>,
+    .l1 = reduce_scalar<l1_op>,
+    .cosine = cosine_scalar<true>,
+    .dot_norm = cosine_scalar<false>,
+    .accumulate = accumulate_scalar,
+    .int8_dot = int8_dot_scalar,
+    .hamming = hamming_scalar,
+    .panel_gemv = panel_gemv_scalar,
+    .gather_dot = gather_dot_scalar,
+    .moments = moments_scalar,
+    .rank_update = rank_update_scalar,
+    .specialized = nullptr,
+    .fp16 = scalar_element_kernels<fp16_element>,
+    .bf16 = scalar_element_kernels<bf16_element>,
+};
+
+#ifdef VECTOR_KERNELS_X86
+const kernel_table sse2_kernels = {
+    .target = isa::sse2,
+    .addition = elementwise_sse2<add_op>,
+    .subtraction = elementwise_sse2<sub_op>,
+    .multiplication = elementwise_sse2<mul_op>,
+    .division = elementwise_sse2<div_op>,
+    .scale = fused_sse2<scale_op>,
+    .axpy = fused_sse2<axpy_op>,
+    .lerp = fused_sse2<lerp_op>,
+    .dot = reduce_sse2<dot_op>,
+    .l2_squared = reduce_sse2<l2_squared_op>,
+    .l1 = reduce_sse2<l1_op>,
+    .cosine = cosine_sse2<true>,
+    .dot_norm = cosine_sse2<false>,
+    .accumulate = accumulate_sse2,
+    .int8_dot = int8_dot_sse2,
+    .hamming = hamming_scalar,
+    .panel_gemv = panel_gemv_sse2,
+    .gather_dot = gather_dot_scalar,
+    .moments = moments_scalar,
+    .rank_update = rank_update_scalar,
+    .specialized = nullptr,
+    .fp16 = scalar_element_kernels<fp16_element>,
+    .bf16 = scalar_element_kernels<bf16_element>,
+};
+
+const kernel_table avx2_kernels = {
+    .target = isa::avx2,
+    .addition = elementwise_avx2<add_op>,
+    .subtraction = elementwise_avx2<sub_op>,
+    .multiplication = elementwise_avx2<mul_op>,
+    .division = elementwise_avx2<div_op>,
+    .scale = fused_avx2<scale_op>,
+    .axpy = fused_avx2<axpy_op>,
+    .lerp = fused_avx2<lerp_op>,
+    .dot = reduce_avx2<dot_op>,
+    .l2_squared = reduce_avx2<l2_squared_op>,
+    .l1 = reduce_avx2<l1_op>,
+    .cosine = cosine_avx2<true>,
+    .dot_norm = cosine_avx2<false>,
+    .accumulate = accumulate_avx2,
+    .int8_dot = int8_dot_avx2,
+    .hamming = hamming_avx2,
+    .panel_gemv = panel_gemv_avx2,
+    .gather_dot = gather_dot_avx2,
+    .moments = moments_avx2,
+    .rank_update = rank_update_avx2,
+    .specialized = avx2_specialized,
+    .fp16 = avx2_element_kernels<fp16_element>,
+    .bf16 = avx2_element_kernels<bf16_element>,
+};
+
+const kernel_table avx512_kernels = {
+    .target = isa::avx512,
+    .addition = elementwise_avx512<add_op>,
+    .subtraction = elementwise_avx512<sub_op>,
+    .multiplication = elementwise_avx512<mul_op>,
+    .division = elementwise_avx512<div_op>,
+    .scale = fused_avx512<scale_op>,
+    .axpy = fused_avx512<axpy_op>,
+    .lerp = fused_avx512<lerp_op>,
+    .dot = reduce_avx512<dot_op>,
+    .l2_squared = reduce_avx512<l2_squared_op>,
+    .l1 = reduce_avx512<l1_op>,
+    .cosine = cosine_avx512<true>,
+    .dot_norm = cosine_avx512<false>,
+    .accumulate = accumulate_avx512,
+    /* Byte operations on 512-bit registers need AVX512BW. */
+    .int8_dot = int8_dot_avx2,
+    .hamming = hamming_avx2,
+    .panel_gemv = panel_gemv_avx512,
+    .gather_dot = gather_dot_avx512,
+    .moments = moments_avx512,
+    .rank_update = rank_update_avx512,
+    .specialized = avx512_specialized,
+    .fp16 = avx512_element_kernels<fp16_element>,
+    .bf16 = avx512_element_kernels<bf16_element>,
+};
+
+const kernel_table avx512_vnni_kernels = {
+    .target = isa::avx512_vnni,
+    .addition = elementwise_avx512<add_op>,
+    .subtraction = elementwise_avx512<sub_op>,
+    .multiplication = elementwise_avx512<mul_op>,
+    .division = elementwise_avx512<div_op>,
+    .scale = fused_avx512<scale_op>,
+    .axpy = fused_avx512<axpy_op>,
+    .lerp = fused_avx512<lerp_op>,
+    .dot = reduce_avx512<dot_op>,
+    .l2_squared = reduce_avx512<l2_squared_op>,
+    .l1 = reduce_avx512<l1_op>,
+    .cosine = cosine_avx512<true>,
+    .dot_norm = cosine_avx512<false>,
+    .accumulate = accumulate_avx512,
+    .int8_dot = int8_dot_avx512_vnni,
+    .hamming = hamming_avx512_vnni,
+    .panel_gemv = panel_gemv_avx512,
+    .gather_dot = gather_dot_avx512,
+    .moments = moments_avx512,
+    .rank_update = rank_update_avx512,
+    .specialized = avx512_specialized,
+    .fp16 = avx512_element_kernels<fp16_element>,
+    .bf16 = avx512_element_kernels<bf16_element>,
+};
+#endif
+
+std::atomic<const kernel_table *> active_kernels{&scalar_kernels};
+
+const kernel_table *kernels_for(isa target) {
+  switch (target) {
+    case isa::scalar:
+      return &scalar_kernels;
+#ifdef VECTOR_KERNELS_X86
+    case isa::sse2:
+      return &sse2_kernels;
+    case isa::avx2:
+      return &avx2_kernels;
+    case isa::avx512:
+      return &avx512_kernels;
+    case isa::avx512_vnni:
+      return &avx512_vnni_kernels;
+#else
+    default:
+      return nullptr;
+#endif
+  }
+  return nullptr;
+}
+
+bool supported(isa target) {
+#ifdef VECTOR_KERNELS_X86
+  __builtin_cpu_init();
+  switch (target) {
+    case isa::scalar:
+      return true;
+    case isa::sse2:
+      return __builtin_cpu_supports("sse2");
+    case isa::avx2:
+      return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") &&
+             __builtin_cpu_supports("f16c");
+    case isa::avx512:
+      return __builtin_cpu_supports("avx512f");
+    case isa::avx512_vnni:
+      return __builtin_cpu_supports("avx512f") &&
+             __builtin_cpu_supports("avx512bw") &&
+             __builtin_cpu_supports("avx512vnni") &&
+             __builtin_cpu_supports("avx512vpopcntdq");
+  }
+  return false;
+#else
+  return target == isa::scalar;
+#endif
+}
+
+}  // namespace
+
+isa detect() {
+  for (isa target :
+       {isa::avx512_vnni, isa::avx512, isa::avx2, isa::sse2}) {
+    if (supported(target)) return target;
+  }
+  return isa::scalar;
+}
+
+bool select(isa target) {
+  const kernel_table *kernels = kernels_for(target);
+  if (kernels == nullptr || !supported(target)) return true;
+  active_kernels.store(kernels, std::memory_order_release);
+  return false;
+}
+
+void select() { select(detect()); }
+
+const kernel_table &active() {
+  return *active_kernels.load(std::memory_order_acquire);
+}
+
+dimension_kernels for_dimension(uint32_t vec_dim) {
+  const kernel_table &kernels = active();
+  if (kernels.specialized != nullptr) {
+    for (size_t i = 0; i < std::size(specialized_dimensions); i++)
+      if (specialized_dimensions[i] == vec_dim) return kernels.specialized[i];
+  }
+  dimension_kernels generic = generic_kernels();
+  generic.dimension = vec_dim;
+  return generic;
+}
+
+dimension_kernels generic_kernels() {
+  const kernel_table &kernels = active();
+  return {0,
+          kernels.addition,
+          kernels.subtraction,
+          kernels.multiplication,
+          kernels.division,
+          kernels.dot,
+          kernels.l2_squared,
+          kernels.l1,
+          kernels.cosine,
+          kernels.dot_norm};
+}
+
+double distance_to_query(metric m, uint32_t vec_dim, const char *vec,
+                         const char *query, double query_norm_squared) {
+  if (m != metric::cosine) return distance(m, vec_dim, vec, query);
+
+  cosine_terms terms = active().dot_norm(vec_dim, vec, query);
+  if (terms.norm1 == 0 || query_norm_squared == 0) return 1.0;
+  return 1.0 - terms.dot / std::sqrt(terms.norm1 * query_norm_squared);
+}
+
+double distance(metric m, uint32_t vec_dim, const char *vec1,
+                const char *vec2) {
+  const kernel_table &kernels = active();
+  switch (m) {
+    case metric::l2:
+      return std::sqrt(kernels.l2_squared(vec_dim, vec1, vec2));
+    case metric::cosine: {
+      cosine_terms terms = kernels.cosine(vec_dim, vec1, vec2);
+      if (terms.norm1 == 0 || terms.norm2 == 0) return 1.0;
+      return 1.0 - terms.dot / std::sqrt(terms.norm1 * terms.norm2);
+    }
+    case metric::dot:
+      return -kernels.dot(vec_dim, vec1, vec2);
+    case metric::l1:
+      return kernels.l1(vec_dim, vec1, vec2);
+  }
+  return 0;
+}
+
+bool name_equals(const char *name, size_t length, const char *upper) {
+  size_t i = 0;
+  while (i < length && upper[i] != '\0' &&
+         std::toupper(static_cast<unsigned char>(name[i])) == upper[i])
+    i++;
+  return i == length && upper[i] == '\0';
+}
+
+bool metric_from_name(const char *name, size_t length, metric *m) {
+  static const struct {
+    const char *name;
+    metric value;
+  } names[] = {{"L2", metric::l2},
+               {"EUCLIDEAN", metric::l2},
+               {"COSINE", metric::cosine},
+               {"DOT", metric::dot},
+               {"L1", metric::l1},
+               {"MANHATTAN", metric::l1}};
+
+  for (const auto &entry : names) {
+    if (name_equals(name, length, entry.name)) {
+      *m = entry.value;
+      return false;
+    }
+  }
+  return true;
+}
+
+const char *isa_name(isa target) {
+  switch (target) {
+    case isa::scalar:
+      return "scalar";
+    case isa::sse2:
+      return "SSE2";
+    case isa::avx2:
+      return "AVX2";
+    case isa::avx512:
+      return "AVX-512";
+    case isa::avx512_vnni:
+      return "AVX-512 VNNI";
+  }
+  return "unknown";
+}
+
+}  // namespace vector_kernels
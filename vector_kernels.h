@@ -0,0 +1,299 @@
+/* Copyright (c) 2017, 2024, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License, version 2.0, for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA */
+
+#ifndef VECTOR_KERNELS_H
+#define VECTOR_KERNELS_H
+
+/*
+  Arithmetic kernels of the vector_operations component.
+
+  Only vector_operations.h and .cc, which implement the UDFs, include the
+  server headers: this layer and the vector_* ones built on it do not depend
+  on them, so that they can be linked without the server by the tests and
+  the benchmark.
+
+  The kernels work on raw (possibly unaligned) float buffers as found in
+  args->args[]. Every kernel exists in a scalar version and, on x86, in
+  SSE2, AVX2 and AVX-512 versions; the best implementation supported by the
+  CPU is selected once by vector_kernels::select() when the component is
+  initialized.
+*/
+
+#include <cstddef>
+#include <cstdint>
+
+namespace vector_kernels {
+
+/*
+  avx512_vnni is AVX-512 with the BW, VNNI and VPOPCNTDQ extensions, used by
+  the kernels of the quantized codes.
+*/
+enum class isa { scalar, sse2, avx2, avx512, avx512_vnni };
+
+enum class op_status { ok, out_of_range, division_by_zero };
+
+/*
+  Storage type of the vector elements. The kernels of every type compute in
+  float: fp16 (IEEE binary16) and bf16 (the upper half of a float) only
+  differ in how the elements are widened on load and narrowed on store.
+*/
+enum class element_type { fp32, fp16, bf16 };
+
+/*
+  Element-wise kernel: result[i] = vec1[i] <op> vec2[i] for i < vec_dim.
+  Returns op_status::out_of_range when a result element is not finite and,
+  for the division, op_status::division_by_zero when vec2 contains a zero.
+  Every element is read before it is written, so result may be vec1 or vec2.
+*/
+typedef op_status (*elementwise_fn)(uint32_t vec_dim, const char *vec1,
+                                    const char *vec2, char *result);
+
+/*
+  Fused kernel combining a scalar and two vectors in a single pass:
+  scale: result[i] = s * vec1[i] (vec2 is ignored)
+  axpy:  result[i] = s * vec1[i] + vec2[i]
+  lerp:  result[i] = vec1[i] + s * (vec2[i] - vec1[i])
+  The multiply-add is a single FMA on AVX2 and AVX-512.
+*/
+typedef op_status (*fused_fn)(uint32_t vec_dim, float s, const char *vec1,
+                              const char *vec2, char *result);
+
+/*
+  Reduction kernel over two vectors of vec_dim floats, accumulated in float
+  with several independent accumulators (FMA where available).
+*/
+typedef double (*reduction_fn)(uint32_t vec_dim, const char *vec1,
+                               const char *vec2);
+
+/* Terms of the cosine distance, computed together in a single pass. */
+struct cosine_terms {
+  double dot;
+  double norm1;  // squared L2 norm of vec1
+  double norm2;  // squared L2 norm of vec2
+};
+
+typedef cosine_terms (*cosine_fn)(uint32_t vec_dim, const char *vec1,
+                                  const char *vec2);
+
+/*
+  acc[i] += vec[i] for i < vec_dim, widening the floats to double. acc is
+  expected to be 64-byte aligned.
+*/
+typedef void (*accumulate_fn)(uint32_t vec_dim, const char *vec, double *acc);
+
+/*
+  Dot product of n signed 8-bit codes, accumulated exactly in integers
+  (VPDPBUSD with AVX-512 VNNI).
+*/
+typedef int64_t (*int8_dot_fn)(uint32_t n, const char *code1,
+                               const char *code2);
+
+/* Number of differing bits between two bit strings of `bytes` bytes. */
+typedef uint64_t (*hamming_fn)(size_t bytes, const char *code1,
+                               const char *code2);
+
+/*
+  Matrix-vector product over a panel of panel_rows matrix rows stored column
+  after column, 64-byte aligned: result[r] += sum(panel[j * panel_rows + r] *
+  vec[j]) for r < panel_rows and j < cols. Each column is a single register
+  on AVX-512, multiplied by the broadcast vec[j].
+*/
+constexpr uint32_t panel_rows = 16;
+
+typedef void (*panel_gemv_fn)(uint32_t cols, const float *panel,
+                              const char *vec, float *result);
+
+/*
+  Dot product of a sparse vector, nnz uint32 indexes and their float
+  values, with a dense float vector holding every index: the dense elements
+  are gathered by index (VGATHERDPS with AVX2 and AVX-512; SSE2 has no
+  gather, its kernel is the scalar one).
+*/
+typedef double (*gather_dot_fn)(uint32_t nnz, const char *indexes,
+                                const char *values, const char *dense);
+
+/*
+  Welford update of the per-dimension moments with the count-th vector of
+  vec_dim floats: mean[i] += (vec[i] - mean[i]) * inv_count and
+  m2[i] += (vec[i] - previous mean[i]) * (vec[i] - mean[i]) in double
+  precision, min[i] and max[i] being updated in float.
+*/
+typedef void (*moments_fn)(uint32_t vec_dim, const char *vec,
+                           double inv_count, double *mean, double *m2,
+                           float *min, float *max);
+
+/*
+  Rows [first, first + rank_update_rows) of a symmetric rank-k update in
+  double precision: matrix[i][j] += sum(block[r][i] * block[r][j]) for
+  r < rows and first <= j < n, the block and the matrix having n columns.
+  Together the calls for every multiple of rank_update_rows add the Gram
+  matrix of the block rows to the upper triangle of the matrix; the few
+  elements they update below the diagonal are not meant to be read. The
+  SIMD kernels keep a chunk of each of the matrix rows in registers while
+  the block rows are streamed through them, every block element read
+  serving the four rows. The SSE2 kernels of this and of moments_fn are the
+  scalar ones.
+*/
+constexpr uint32_t rank_update_rows = 4;
+
+typedef void (*rank_update_fn)(uint32_t n, uint32_t first, uint32_t rows,
+                               const double *block, double *matrix);
+
+/*
+  Converts vec_dim elements between float and a 16-bit element type; returns
+  op_status::out_of_range if a converted element is not finite (a float too
+  large for fp16 becomes an infinity).
+*/
+typedef op_status (*convert_fn)(uint32_t vec_dim, const char *src,
+                                char *dst);
+
+/*
+  The element-wise and distance kernels of a 16-bit element type; their
+  operands and results are all of that type.
+*/
+struct element_kernels {
+  elementwise_fn addition;
+  elementwise_fn subtraction;
+  elementwise_fn multiplication;
+  elementwise_fn division;
+  reduction_fn dot;
+  reduction_fn l2_squared;
+  reduction_fn l1;
+  cosine_fn cosine;
+  convert_fn widen;   // to float
+  convert_fn narrow;  // from float
+};
+
+/*
+  The common embedding sizes. The AVX2 and AVX-512 float element-wise and
+  distance kernels are also compiled for each of them as a constant, so that
+  their loops have a known trip count and no tail.
+*/
+constexpr uint32_t specialized_dimensions[] = {384,  512,  768,
+                                               1024, 1536, 3072};
+
+/*
+  The float element-wise and distance kernels for vectors of `dimension`
+  elements, whether specialized for it or the generic ones. The specialized
+  kernels ignore their vec_dim argument.
+*/
+struct dimension_kernels {
+  uint32_t dimension;
+  elementwise_fn addition;
+  elementwise_fn subtraction;
+  elementwise_fn multiplication;
+  elementwise_fn division;
+  reduction_fn dot;
+  reduction_fn l2_squared;
+  reduction_fn l1;
+  cosine_fn cosine;
+  cosine_fn dot_norm;
+};
+
+struct kernel_table {
+  isa target;
+  elementwise_fn addition;
+  elementwise_fn subtraction;
+  elementwise_fn multiplication;
+  elementwise_fn division;
+  fused_fn scale;
+  fused_fn axpy;
+  fused_fn lerp;
+  reduction_fn dot;         // sum(vec1[i] * vec2[i])
+  reduction_fn l2_squared;  // sum((vec1[i] - vec2[i])^2)
+  reduction_fn l1;          // sum(|vec1[i] - vec2[i]|)
+  cosine_fn cosine;
+  cosine_fn dot_norm;  // cosine without norm2, for a vec2 of known norm
+  accumulate_fn accumulate;
+  int8_dot_fn int8_dot;
+  hamming_fn hamming;
+  panel_gemv_fn panel_gemv;
+  gather_dot_fn gather_dot;
+  moments_fn moments;
+  rank_update_fn rank_update;
+  /* One per specialized_dimensions, nullptr without specialized kernels. */
+  const dimension_kernels *specialized;
+  element_kernels fp16;
+  element_kernels bf16;
+};
+
+/*
+  Distances used to rank neighbors; smaller is always nearer. For `dot` the
+  distance is the negated dot product and for `cosine` it is
+  1 - cosine similarity, taken as 1 when one of the vectors is zero.
+*/
+enum class metric { l2, cosine, dot, l1 };
+
+double distance(metric m, uint32_t vec_dim, const char *vec1,
+                const char *vec2);
+
+/*
+  distance() of `vec` to a query vector whose squared L2 norm was computed
+  beforehand, which saves a third of the cosine work.
+*/
+double distance_to_query(metric m, uint32_t vec_dim, const char *vec,
+                         const char *query, double query_norm_squared);
+
+/*
+  True if name[0, length) is `upper`, an upper-case NUL-terminated name,
+  ignoring the case. The names of the UDF options are matched with it.
+*/
+bool name_equals(const char *name, size_t length, const char *upper);
+
+/*
+  Parses a case-insensitive metric name: L2 (or EUCLIDEAN), COSINE, DOT or L1
+  (or MANHATTAN). Returns true if the name is unknown.
+*/
+bool metric_from_name(const char *name, size_t length, metric *m);
+
+/* Best instruction set supported by the running CPU. */
+isa detect();
+
+/*
+  Makes the kernels of `target` the active ones. Returns true if the CPU does
+  not support it, in which case the active kernels are left unchanged.
+*/
+bool select(isa target);
+
+/* Selects the best kernels for the running CPU. */
+void select();
+
+/* The active kernels; the scalar ones until select() is called. */
+const kernel_table &active();
+
+/*
+  The float kernels of active() for vectors of vec_dim elements: the ones
+  specialized for vec_dim if there are, else the generic ones.
+*/
+dimension_kernels for_dimension(uint32_t vec_dim);
+
+/*
+  The generic float kernels of active(), for vectors of any size; their
+  dimension is 0.
+*/
+dimension_kernels generic_kernels();
+
+const char *isa_name(isa target);
+
+}  // namespace vector_kernels
+
+#endif /* VECTOR_KERNELS_H */
@@ -0,0 +1,380 @@
+/* Copyright (c) 2017, 2024, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License, version 2.0, for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA */
+
+
+#include "vector_kmeans.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "vector_kernels.h"
+#include "vector_random.h"
+
+namespace vector_kmeans {
+
+namespace {
+
+constexpr uint64_t clustering_seed = 0x6b6d65616e73;
+
+/* k-means++ seeds from at most max(seeding_candidates * k, min) vectors. */
+constexpr size_t seeding_candidates = 16;
+constexpr size_t min_seeding_candidates = 65536;
+
+/* Vectors of a mini-batch: at least max(batch_clusters * k, min). */
+constexpr size_t batch_clusters = 4;
+constexpr size_t min_batch = 32768;
+
+/* Distance computations (vectors * centroids * dimensions) per chunk. */
+constexpr size_t chunk_work = 1 << 20;
+
+/* Vectors per block of the k-means++ distance sums. */
+constexpr uint32_t seeding_block = 1024;
+
+/* The vectors of a sample and their centroids. */
+struct problem {
+  vector_parallel::thread_pool *workers;
+  vector_kernels::reduction_fn l2_squared;
+  uint32_t vec_dim;
+  const float *data;
+  float *centroids;
+  uint32_t k;
+
+  const char *vec(size_t i) const {
+    return reinterpret_cast<const char *>(data + i * vec_dim);
+  }
+  float *centroid(uint32_t c) const { return centroids + size_t{c} * vec_dim; }
+
+  /* Chunk of a loop computing `centroids` distances per element. */
+  uint32_t grain(uint32_t centroids) const {
+    return static_cast<uint32_t>(std::max<size_t>(
+        1, chunk_work / (size_t{centroids} * vec_dim)));
+  }
+
+  /* Sets nearest[j] to the centroid nearest to the vector rows[j]. */
+  void assign(const std::vector<uint32_t> &rows,
+              std::vector<uint32_t> *nearest) const {
+    workers->parallel_for(
+        static_cast<uint32_t>(rows.size()), grain(k),
+        [&](unsigned, uint32_t begin, uint32_t end) {
+          for (uint32_t j = begin; j < end; j++) {
+            const char *v = vec(rows[j]);
+            uint32_t best = 0;
+            double best_distance = HUGE_VAL;
+            for (uint32_t c = 0; c < k; c++) {
+              double d = l2_squared(
+                  vec_dim, v, reinterpret_cast<const char *>(centroid(c)));
+              if (d < best_distance) {
+                best_distance = d;
+                best = c;
+              }
+            }
+            (*nearest)[j] = best;
+          }
+        });
+  }
+};
+
+/*
+  Groups the positions j of `nearest` by cluster, in increasing order within
+  a cluster: the members of cluster c are members[start[c]..start[c + 1]).
+*/
+void group_by_cluster(const std::vector<uint32_t> &nearest, uint32_t k,
+                      std::vector<uint32_t> *start,
+                      std::vector<uint32_t> *members) {
+  start->assign(size_t{k} + 1, 0);
+  for (uint32_t c : nearest) (*start)[c + 1]++;
+  for (uint32_t c = 0; c < k; c++) (*start)[c + 1] += (*start)[c];
+  members->resize(nearest.size());
+  std::vector<uint32_t> next(start->begin(), start->end() - 1);
+  for (uint32_t j = 0; j < nearest.size(); j++)
+    (*members)[next[nearest[j]]++] = j;
+}
+
+/*
+  Draws a candidate with a probability proportional to its distance, given
+  the sums of the distances of the blocks and their total.
+*/
+uint32_t draw(const std::vector<double> &distance,
+              const std::vector<double> &block_sum, double total,
+              uint64_t *random_state) {
+  double target = vector_random::next_uniform(random_state) * total;
+  uint32_t b = 0;
+  while (b + 1 < block_sum.size() && target >= block_sum[b])
+    target -= block_sum[b++];
+  const uint32_t first = b * seeding_block;
+  const uint32_t last = static_cast<uint32_t>(
+      std::min<size_t>(distance.size(), first + seeding_block));
+  uint32_t pick = first;
+  while (pick + 1 < last && target >= distance[pick])
+    target -= distance[pick++];
+  /* Rounding may end on a vector that is already a centroid. */
+  while (pick > first && distance[pick] == 0) pick--;
+  return pick;
+}
+
+/*
+  Greedy k-means++: the first centroid is a random candidate. For every next
+  one, 2 + ln(k) candidates are drawn with a probability proportional to
+  their squared distance to the nearest centroid already chosen, and the one
+  reducing the most the sum of these distances is kept.
+*/
+void seed_centroids(const problem &p, size_t n, uint64_t *random_state) {
+  const uint32_t candidates = static_cast<uint32_t>(std::min(
+      n, std::max(seeding_candidates * p.k, min_seeding_candidates)));
+  std::vector<uint32_t> rows(n);
+  for (uint32_t i = 0; i < n; i++) rows[i] = i;
+  for (uint32_t i = 0; i < candidates && candidates < n; i++)
+    std::swap(rows[i], rows[i + vector_random::next(random_state) % (n - i)]);
+  rows.resize(candidates);
+
+  const uint32_t blocks = (candidates + seeding_block - 1) / seeding_block;
+  const uint32_t block_grain =
+      std::max<uint32_t>(1, p.grain(1) / seeding_block);
+  const uint32_t trials = 2 + static_cast<uint32_t>(std::log(p.k));
+  std::vector<double> distance(candidates, HUGE_VAL);
+  std::vector<double> block_sum(blocks);
+  std::vector<uint32_t> trial(trials);
+  std::vector<double> trial_sum(size_t{blocks} * trials);
+
+  uint32_t pick =
+      static_cast<uint32_t>(vector_random::next(random_state) % candidates);
+  for (uint32_t c = 0; c < p.k; c++) {
+    memcpy(p.centroid(c), p.vec(rows[pick]), p.vec_dim * sizeof(float));
+    if (c + 1 == p.k) break;
+
+    const char *centroid = reinterpret_cast<const char *>(p.centroid(c));
+    p.workers->parallel_for(
+        blocks, block_grain, [&](unsigned, uint32_t begin, uint32_t end) {
+          for (uint32_t b = begin; b < end; b++) {
+            uint32_t last = std::min(candidates, (b + 1) * seeding_block);
+            double sum = 0;
+            for (uint32_t i = b * seeding_block; i < last; i++) {
+              distance[i] = std::min(
+                  distance[i], p.l2_squared(p.vec_dim, p.vec(rows[i]),
+                                            centroid));
+              sum += distance[i];
+            }
+            block_sum[b] = sum;
+          }
+        });
+
+    double total = 0;
+    for (double sum : block_sum) total += sum;
+    if (!(total > 0)) {
+      /* All the candidates are centroids already. */
+      pick = static_cast<uint32_t>(vector_random::next(random_state) %
+                                   candidates);
+      continue;
+    }
+    for (uint32_t &t : trial)
+      t = draw(distance, block_sum, total, random_state);
+
+    p.workers->parallel_for(
+        blocks, std::max<uint32_t>(1, block_grain / trials),
+        [&](unsigned, uint32_t begin, uint32_t end) {
+          for (uint32_t b = begin; b < end; b++) {
+            uint32_t last = std::min(candidates, (b + 1) * seeding_block);
+            for (uint32_t t = 0; t < trials; t++) {
+              const char *vec = p.vec(rows[trial[t]]);
+              double sum = 0;
+              for (uint32_t i = b * seeding_block; i < last; i++)
+                sum += std::min(distance[i],
+                                p.l2_squared(p.vec_dim, p.vec(rows[i]), vec));
+              trial_sum[size_t{b} * trials + t] = sum;
+            }
+          }
+        });
+
+    double best_sum = HUGE_VAL;
+    for (uint32_t t = 0; t < trials; t++) {
+      double sum = 0;
+      for (uint32_t b = 0; b < blocks; b++)
+        sum += trial_sum[size_t{b} * trials + t];
+      if (sum < best_sum) {
+        best_sum = sum;
+        pick = trial[t];
+      }
+    }
+  }
+}
+
+/*
+  Lloyd's iterations over all the n vectors, stopping early once the
+  assignment is stable. An empty cluster is reseeded with a random vector.
+*/
+void lloyd(const problem &p, size_t n, uint32_t iterations,
+           uint64_t *random_state) {
+  std::vector<uint32_t> rows(n);
+  for (uint32_t i = 0; i < n; i++) rows[i] = i;
+  std::vector<uint32_t> nearest(n), previous, start, members;
+  std::vector<std::vector<double>> sums(p.workers->participants(),
+                                        std::vector<double>(p.vec_dim));
+
+  for (uint32_t iteration = 0; iteration < iterations; iteration++) {
+    p.assign(rows, &nearest);
+    if (nearest == previous) break;
+    group_by_cluster(nearest, p.k, &start, &members);
+
+    p.workers->parallel_for(
+        p.k, p.grain(static_cast<uint32_t>(n / p.k + 1)),
+        [&](unsigned participant, uint32_t begin, uint32_t end) {
+          std::vector<double> &sum = sums[participant];
+          for (uint32_t c = begin; c < end; c++) {
+            if (start[c] == start[c + 1]) continue;
+            std::fill(sum.begin(), sum.end(), 0.0);
+            for (uint32_t m = start[c]; m < start[c + 1]; m++) {
+              const float *v = p.data + size_t{members[m]} * p.vec_dim;
+              for (uint32_t d = 0; d < p.vec_dim; d++) sum[d] += v[d];
+            }
+            float *centroid = p.centroid(c);
+            const double count = start[c + 1] - start[c];
+            for (uint32_t d = 0; d < p.vec_dim; d++)
+              centroid[d] = static_cast<float>(sum[d] / count);
+          }
+        });
+    for (uint32_t c = 0; c < p.k; c++) {
+      if (start[c] != start[c + 1]) continue;
+      size_t pick = vector_random::next(random_state) % n;
+      memcpy(p.centroid(c), p.vec(pick), p.vec_dim * sizeof(float));
+    }
+    previous.swap(nearest);
+    nearest.resize(n);
+  }
+}
+
+/*
+  Mini-batch iterations: every batch of random vectors is assigned to the
+  centroids, then each centroid moves towards each of its vectors by the
+  inverse of the number of vectors it was assigned so far.
+*/
+void mini_batch(const problem &p, size_t n, size_t batch,
+                uint32_t iterations, uint64_t *random_state) {
+  std::vector<uint32_t> rows(batch), nearest(batch), start, members;
+  std::vector<uint64_t> counts(p.k);
+
+  for (uint32_t iteration = 0; iteration < iterations; iteration++) {
+    for (uint32_t &row : rows)
+      row = static_cast<uint32_t>(vector_random::next(random_state) % n);
+    p.assign(rows, &nearest);
+    group_by_cluster(nearest, p.k, &start, &members);
+
+    p.workers->parallel_for(
+        p.k, p.grain(static_cast<uint32_t>(batch / p.k + 1)),
+        [&](unsigned, uint32_t begin, uint32_t end) {
+          for (uint32_t c = begin; c < end; c++) {
+            float *centroid = p.centroid(c);
+            for (uint32_t m = start[c]; m < start[c + 1]; m++) {
+              const float *v = p.data + size_t{rows[members[m]]} * p.vec_dim;
+              const float rate = 1.0f / static_cast<float>(++counts[c]);
+              for (uint32_t d = 0; d < p.vec_dim; d++)
+                centroid[d] += rate * (v[d] - centroid[d]);
+            }
+          }
+        });
+  }
+}
+
+/*
+  Appends room for a vector of vec_dim floats to a sample of at most
+  `capacity` vectors. The allocation doubles, as with resize(), but is
+  capped at the capacity instead of overshooting it up to twice.
+*/
+void grow_sample(std::vector<float> *sample, size_t capacity,
+                 uint32_t vec_dim) {
+  const size_t size = sample->size() + vec_dim;
+  if (size > sample->capacity())
+    sample->reserve(std::min(std::max(size, 2 * sample->capacity()),
+                             capacity * vec_dim));
+  sample->resize(size);
+}
+
+}  // namespace
+
+void cluster(vector_parallel::thread_pool *workers, uint32_t vec_dim,
+             const float *data, size_t n, uint32_t k, uint32_t iterations,
+             uint64_t seed, float *centroids) {
+  problem p{workers,
+            vector_kernels::for_dimension(vec_dim).l2_squared,
+            vec_dim,
+            data,
+            centroids,
+            k};
+
+  uint64_t random_state = seed;
+  seed_centroids(p, n, &random_state);
+  const size_t batch = std::max(batch_clusters * k, min_batch);
+  if (n <= batch)
+    lloyd(p, n, iterations, &random_state);
+  else
+    mini_batch(p, n, batch, iterations, &random_state);
+}
+
+void clustering::start(uint32_t vec_dim, uint32_t k, uint32_t iterations,
+                       double sampling_rate, size_t sample_bytes) {
+  reset();
+  m_vec_dim = vec_dim;
+  m_k = k;
+  m_iterations = iterations;
+  m_sampling_rate = sampling_rate;
+  m_sample_capacity =
+      std::max<size_t>(sample_bytes / (vec_dim * sizeof(float)), 1);
+  m_random_state = clustering_seed;
+}
+
+void clustering::add(const char *vec) {
+  if (m_sampling_rate < 1 &&
+      vector_random::next_uniform(&m_random_state) >= m_sampling_rate)
+    return;
+
+  /* Reservoir sampling once the arena is full. */
+  size_t slot = m_sampled;
+  if (m_sampled >= m_sample_capacity)
+    slot = vector_random::next(&m_random_state) % (m_sampled + 1);
+  if (slot < m_sample_capacity) {
+    if (slot * m_vec_dim == m_sample.size())
+      grow_sample(&m_sample, m_sample_capacity, m_vec_dim);
+    memcpy(&m_sample[slot * m_vec_dim], vec, m_vec_dim * sizeof(float));
+  }
+  m_sampled++;
+}
+
+
+void clustering::finish(vector_parallel::thread_pool *workers,
+                        std::vector<char> *out) {
+  out->clear();
+  const size_t n = m_sample.size() / std::max<uint32_t>(m_vec_dim, 1);
+  if (n == 0) return;
+
+  const uint32_t k = static_cast<uint32_t>(std::min<size_t>(m_k, n));
+  out->resize(size_t{k} * m_vec_dim * sizeof(float));
+  cluster(workers, m_vec_dim, m_sample.data(), n, k, m_iterations,
+          m_random_state, reinterpret_cast<float *>(out->data()));
+}
+
+void clustering::reset() {
+  m_vec_dim = 0;
+  m_sampled = 0;
+  m_sample = std::vector<float>();
+}
+
+}  // namespace vector_kmeans
@@ -0,0 +1,115 @@
+/* Copyright (c) 2017, 2024, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License, version 2.0, for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA */
+
+
+#ifndef VECTOR_KMEANS_H
+#define VECTOR_KMEANS_H
+
+/*
+  k-means clustering of float vectors, for VECTOR_KMEANS and the training of
+  the IVF lists and of the product quantization codebooks.
+
+  The vectors are copied to a contiguous arena as they are added, after a
+  Bernoulli sampling at the requested rate; once the arena is full it is
+  kept as a reservoir sample of the vectors, so the memory is bounded
+  whatever the size of the group. The arena grows by doubling, but its
+  capacity never exceeds the limit given to start().
+
+  The centroids are seeded by k-means++ over a random subset of the sample,
+  then refined by Lloyd iterations when the sample fits in a single batch,
+  or by mini-batch iterations (Sculley, "Web-scale k-means clustering")
+  over random batches of it otherwise. The vectors are assigned to their
+  nearest centroid by the workers of a thread pool, and the centroids are
+  updated in parallel, every cluster by a single participant in the order
+  of its vectors, so the result does not depend on the number of threads.
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "vector_parallel.h"
+
+namespace vector_kmeans {
+
+constexpr uint32_t max_clusters = 65536;
+constexpr uint32_t max_iterations = 1000;
+constexpr uint32_t default_iterations = 20;
+
+/*
+  Clusters the n vectors of vec_dim floats at `data` into k <= n centroids,
+  float[k][vec_dim] written to `centroids`: k-means++ seeding, then Lloyd or
+  mini-batch iterations depending on n. The result only depends on the
+  vectors, their order and `seed`. Throws std::bad_alloc on OOM.
+*/
+void cluster(vector_parallel::thread_pool *workers, uint32_t vec_dim,
+             const float *data, size_t n, uint32_t k, uint32_t iterations,
+             uint64_t seed, float *centroids);
+
+class clustering {
+ public:
+  /* Default memory of the sample of the vectors. */
+  static constexpr size_t default_sample_bytes = 256 << 20;
+
+  /*
+    Starts the clustering of vectors of vec_dim floats into k clusters, a
+    vector being sampled with probability sampling_rate in (0, 1] and the
+    sample taking at most sample_bytes (but at least one vector).
+  */
+  void start(uint32_t vec_dim, uint32_t k, uint32_t iterations,
+             double sampling_rate, size_t sample_bytes = default_sample_bytes);
+
+  bool started() const { return m_vec_dim != 0; }
+  uint32_t dimensions() const { return m_vec_dim; }
+
+  /* Adds a vector of vec_dim floats. Throws std::bad_alloc on OOM. */
+  void add(const char *vec);
+
+  /* The vectors sampled so far, float[sample_size()][vec_dim]. */
+  const float *sample() const { return m_sample.data(); }
+  size_t sample_size() const {
+    return m_vec_dim == 0 ? 0 : m_sample.size() / m_vec_dim;
+  }
+
+  /*
+    Writes the min(k, sample size) centroids, float[][vec_dim], to `out`;
+    nothing if no vector was sampled. Throws std::bad_alloc on OOM.
+  */
+  void finish(vector_parallel::thread_pool *workers, std::vector<char> *out);
+
+  /* Discards the vectors added. */
+  void reset();
+
+ private:
+  uint32_t m_vec_dim = 0;
+  uint32_t m_k = 0;
+  uint32_t m_iterations = 0;
+  double m_sampling_rate = 1;
+  uint64_t m_sampled = 0;        // vectors kept by the Bernoulli sampling
+  size_t m_sample_capacity = 0;  // vectors
+  std::vector<float> m_sample;
+  uint64_t m_random_state = 0;
+};
+
+}  // namespace vector_kmeans
+
+#endif /* VECTOR_KMEANS_H */
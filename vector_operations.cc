@@ -28,12 +28,113 @@
 REQUIRES_SERVICE_PLACEHOLDER(log_builtins);
 REQUIRES_SERVICE_PLACEHOLDER(log_builtins_string);
 REQUIRES_SERVICE_PLACEHOLDER(udf_registration);
+REQUIRES_SERVICE_PLACEHOLDER(udf_registration_aggregate);
 REQUIRES_SERVICE_PLACEHOLDER(mysql_udf_metadata);
 REQUIRES_SERVICE_PLACEHOLDER(mysql_runtime_error);
+REQUIRES_SERVICE_PLACEHOLDER(component_sys_variable_register);
+REQUIRES_SERVICE_PLACEHOLDER(component_sys_variable_unregister);
+REQUIRES_SERVICE_PLACEHOLDER(status_variable_registration);
 
 SERVICE_TYPE(log_builtins) * log_bi;
 SERVICE_TYPE(log_builtins_string) * log_bs;
 
+/* The per-UDF counters of the status variables vector_operations.<udf>. */
+static vector_counters::registry *counters;
+
+/*
+  Kind of the error reported by the UDF call running in the thread, set
+  where the error is reported; a call failing without setting it counts as
+  an error of kind other.
+*/
+static thread_local vector_counters::error_kind udf_error =
+    vector_counters::error_kind::none;
+
+/* Measures a UDF callback and counts it in the counters of its UDF. */
+class udf_call {
+ public:
+  udf_call() : m_start(vector_counters::ticks()) {
+    udf_error = vector_counters::error_kind::none;
+  }
+
+  /*
+    Counts the call; the input bytes are those of the string arguments in
+    `args`, if not nullptr.
+  */
+  void done(uint32_t slot, const UDF_ARGS *args, uint64_t bytes_out,
+            bool error) {
+    uint64_t elapsed = vector_counters::ticks() - m_start;
+    uint64_t bytes_in = 0;
+    for (unsigned int i = 0; args != nullptr && i < args->arg_count; i++)
+      if (args->arg_type[i] == STRING_RESULT && args->args[i] != nullptr)
+        bytes_in += args->lengths[i];
+    vector_counters::error_kind kind = vector_counters::error_kind::none;
+    if (error)
+      kind = udf_error == vector_counters::error_kind::none
+                 ? vector_counters::error_kind::other
+                 : udf_error;
+    counters->record(slot, elapsed, bytes_in, bytes_out, kind);
+  }
+
+ private:
+  uint64_t m_start;
+};
+
+/*
+  Wrappers registered in place of the UDF callbacks to count them; `slot` is
+  the counters of the UDF of callback udf. The arguments of the result
+  callback of an aggregate UDF are those of its last row, already counted by
+  udf_counted_add, so they are not counted again.
+*/
+template <auto udf, class Callback = decltype(udf)>
+struct udf_counted;
+
+/* REAL and INT UDFs. */
+template <auto udf, class Result>
+struct udf_counted<udf, Result (*)(UDF_INIT *, UDF_ARGS *, char *, char *)> {
+  static inline uint32_t slot = vector_counters::max_functions;
+  static inline bool aggregate = false;
+
+  static Result call(UDF_INIT *initid, UDF_ARGS *args, char *is_null,
+                     char *error) {
+    udf_call counted;
+    Result result = udf(initid, args, is_null, error);
+    counted.done(slot, aggregate ? nullptr : args,
+                 *is_null ? 0 : sizeof(Result), *error);
+    return result;
+  }
+};
+
+/* STRING UDFs. */
+template <auto udf>
+struct udf_counted<udf, const char *(*)(UDF_INIT *, UDF_ARGS *, char *,
+                                        unsigned long *, char *, char *)> {
+  static inline uint32_t slot = vector_counters::max_functions;
+  static inline bool aggregate = false;
+
+  static const char *call(UDF_INIT *initid, UDF_ARGS *args, char *buffer,
+                          unsigned long *length, char *is_null,
+                          char *error) {
+    udf_call counted;
+    const char *result = udf(initid, args, buffer, length, is_null, error);
+    counted.done(slot, aggregate ? nullptr : args,
+                 result != nullptr ? *length : 0, *error);
+    return result;
+  }
+};
+
+/*
+  The add callback of an aggregate UDF, counted with its result callback
+  udf: every row added and every group result is a call. The arguments are
+  only counted as input with the rows.
+*/
+template <auto udf, auto add>
+static void udf_counted_add(UDF_INIT *initid, UDF_ARGS *args,
+                            unsigned char *is_null, unsigned char *error) {
+  udf_call counted;
+  add(initid, args, is_null, error);
+  counted.done(udf_counted<udf>::slot, args, 0, *error);
+}
+
 class udf_list {
   typedef std::list<std::string> udf_list_t;
 
@@ -50,277 +151,5017 @@ class udf_list {
     return true;
   }
 
+  bool add_aggregate(const char *func_name, enum Item_result return_type,
+                     Udf_func_any func, Udf_func_add add_func,
+                     Udf_func_clear clear_func, Udf_func_init init_func = NULL,
+                     Udf_func_deinit deinit_func = NULL) {
+    if (!mysql_service_udf_registration_aggregate->udf_register(
+            func_name, return_type, func, init_func, deinit_func, add_func,
+            clear_func)) {
+      aggregate_set.push_back(func_name);
+      return false;
+    }
+    return true;
+  }
+
+  /* Registers the UDF with the wrapper counting the calls of udf. */
+  template <auto udf>
+  bool add_scalar(const char *func_name, enum Item_result return_type,
+                  Udf_func_init init_func = NULL,
+                  Udf_func_deinit deinit_func = NULL) {
+    udf_counted<udf>::slot = counters->add(func_name);
+    return add_scalar(func_name, return_type,
+                      (Udf_func_any)udf_counted<udf>::call, init_func,
+                      deinit_func);
+  }
+
+  template <auto udf, auto add>
+  bool add_aggregate(const char *func_name, enum Item_result return_type,
+                     Udf_func_clear clear_func, Udf_func_init init_func = NULL,
+                     Udf_func_deinit deinit_func = NULL) {
+    udf_counted<udf>::slot = counters->add(func_name);
+    udf_counted<udf>::aggregate = true;
+    return add_aggregate(func_name, return_type,
+                         (Udf_func_any)udf_counted<udf>::call,
+                         udf_counted_add<udf, add>, clear_func, init_func,
+                         deinit_func);
+  }
+
   bool unregister() {
+    unregister(set, mysql_service_udf_registration);
+    unregister(aggregate_set, mysql_service_udf_registration_aggregate);
+
+    /* success: empty set */
+    if (set.empty() && aggregate_set.empty()) return false;
+
+    /* failure: entries still in the set */
+    return true;
+  }
+
+ private:
+  template <class Service>
+  static void unregister(udf_list_t &udfs, Service *service) {
     udf_list_t delete_set;
     /* try to unregister all of the udfs */
-    for (auto udf : set) {
+    for (auto udf : udfs) {
       int was_present = 0;
-      if (!mysql_service_udf_registration->udf_unregister(udf.c_str(),
-                                                          &was_present) ||
-          !was_present)
+      if (!service->udf_unregister(udf.c_str(), &was_present) || !was_present)
         delete_set.push_back(udf);
     }
 
     /* remove the unregistered ones from the list */
-    for (auto udf : delete_set) set.remove(udf);
+    for (auto udf : delete_set) udfs.remove(udf);
+  }
 
-    /* success: empty set */
-    if (set.empty()) return false;
+  udf_list_t set;
+  udf_list_t aggregate_set;
+} *list;
 
-    /* failure: entries still in the set */
+/*
+  The error of the index UDFs given a vector with NaN or infinite elements,
+  whose distances could not be ordered.
+*/
+static const char non_finite_vector[] =
+    "the vector has NaN or infinite elements";
+
+/* The named HNSW indexes, alive while the component is installed. */
+static vector_index_registry *indexes;
+
+/*
+  vector_operations.index_memory_limit: the memory the indexes may use, in
+  bytes. An insert beyond it fails.
+*/
+static constexpr unsigned long long default_index_memory_limit = 1ULL << 30;
+static unsigned long long index_memory_limit = default_index_memory_limit;
+
+/*
+  vector_operations.kmeans_memory_limit: the memory the training sample of a
+  VECTOR_KMEANS, VECTOR_PQ_TRAIN or VECTOR_IVF_BUILD group may use, in
+  bytes. The vectors beyond it replace random ones of the sample.
+*/
+static unsigned long long kmeans_memory_limit =
+    vector_kmeans::clustering::default_sample_bytes;
+
+static size_t kmeans_sample_bytes() {
+  return static_cast<size_t>(
+      std::min<unsigned long long>(kmeans_memory_limit, SIZE_MAX));
+}
+
+/*
+  vector_operations.covariance_memory_limit: the memory a VECTOR_COVARIANCE
+  group may use, in bytes, its matrices and result included. A group of
+  vectors with too many dimensions for it fails.
+*/
+static constexpr unsigned long long default_covariance_memory_limit =
+    1ULL << 30;
+static unsigned long long covariance_memory_limit =
+    default_covariance_memory_limit;
+
+/* The named matrices of VECTOR_PROJECT. */
+static vector_projection::registry *projections;
+
+/* The named vectors of VECTOR_REGISTER. */
+static vector_registry::registry *registered_vectors;
+
+/* The IVF index files mapped by VECTOR_IVF_SEARCH. */
+static vector_ivf::file_cache *ivf_files;
+
+/*
+  vector_operations.ivf_directory: the directory of the IVF index files, the
+  only one VECTOR_IVF_BUILD writes to. The IVF functions are disabled while
+  it is not set.
+*/
+static char *ivf_directory = nullptr;
+
+/*
+  vector_operations.batch_threads: the threads computing a
+  VECTOR_BATCH_DISTANCE, the one of the connection included. The others are
+  the workers of the pool shared by all the connections.
+*/
+static unsigned int batch_threads = 1;
+
+static vector_parallel::thread_pool *workers;
+
+/*
+  The status variable vector_operations.<udf> of every UDF shows its
+  counters as a JSON object. A SHOW_FUNC callback is not told which variable
+  it is called for, hence one instance of show_udf_counters per slot.
+*/
+template <uint32_t slot>
+static int show_udf_counters(MYSQL_THD, SHOW_VAR *var, char *buffer) {
+  counters->read(slot).to_json(buffer, SHOW_VAR_FUNC_BUFF_SIZE);
+  var->type = SHOW_CHAR;
+  var->value = buffer;
+  return 0;
+}
+
+template <uint32_t... slots>
+static constexpr std::array<mysql_show_var_func, sizeof...(slots)>
+show_udf_counters_table(std::integer_sequence<uint32_t, slots...>) {
+  return {show_udf_counters<slots>...};
+}
+
+static constexpr std::array<mysql_show_var_func, vector_counters::max_functions>
+    show_udf_counters_functions = show_udf_counters_table(
+        std::make_integer_sequence<uint32_t, vector_counters::max_functions>());
+
+/* The status variables registered and their names. */
+struct udf_status_variables {
+  std::vector<std::string> names;
+  std::vector<SHOW_VAR> variables;
+};
+
+static udf_status_variables *status_variables;
+
+/* Builds and registers the status variables of the UDFs registered so far. */
+static bool udf_status_variables_register() {
+  status_variables = new udf_status_variables();
+  uint32_t size = counters->size();
+  status_variables->names.reserve(size);
+  for (uint32_t slot = 0; slot < size; slot++) {
+    std::string name = "vector_operations." + counters->name(slot);
+    std::transform(name.begin(), name.end(), name.begin(), [](char c) {
+      return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    });
+    status_variables->names.push_back(name);
+    status_variables->variables.push_back(
+        {status_variables->names.back().c_str(),
+         (char *)show_udf_counters_functions[slot], SHOW_FUNC,
+         SHOW_SCOPE_GLOBAL});
+  }
+  status_variables->variables.push_back(
+      {nullptr, nullptr, SHOW_UNDEF, SHOW_SCOPE_UNDEF});
+
+  if (mysql_service_status_variable_registration->register_variable(
+          status_variables->variables.data())) {
+    delete status_variables;
+    status_variables = nullptr;
     return true;
   }
+  return false;
+}
 
- private:
-  udf_list_t set;
-} *list;
+static void udf_status_variables_unregister() {
+  if (status_variables == nullptr) return;
+  mysql_service_status_variable_registration->unregister_variable(
+      status_variables->variables.data());
+  delete status_variables;
+  status_variables = nullptr;
+}
 
 namespace udf_impl {
 
 void error_msg_size() {
+  udf_error = vector_counters::error_kind::size_mismatch;
   mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
                                   ER_UDF_ERROR, 0, "vector operation",
                                   "both vectors must have the same size");
 }
 
-const char *udf_init = "udf_init", *my_udf = "my_udf",
-           *my_udf_clear = "my_clear", *my_udf_add = "my_udf_add";
-
-// UDF to implement a vector addition function between two vectors
+void error_msg_oom(const char *udf_name) {
+  udf_error = vector_counters::error_kind::out_of_memory;
+  mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                  ER_UDF_ERROR, 0, udf_name, "Out of memory");
+}
 
-static bool vector_addition_udf_init(UDF_INIT *initid, UDF_ARGS *args, char *) {
-  if (args->arg_count < 2) {
+/* Checks the argument count of a UDF taking two vectors. */
+static bool vector_args_check(UDF_ARGS *args, const char *udf_name) {
+  if (args->arg_count != 2) {
     mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
-                                    ER_UDF_ERROR, 0, "vector_addition",
+                                    ER_UDF_ERROR, 0, udf_name,
                                     "this function requires 2 parameters");
     return true;
   }
+  return false;
+}
+
+/*
+  Returns the common dimension of the float vector arguments arg1 and arg2 in
+  vec_dim, or true after reporting the error if they are not valid vectors of
+  the same size.
+*/
+static bool vector_dimensions(UDF_ARGS *args, uint32_t *vec_dim,
+                              unsigned int arg1 = 0, unsigned int arg2 = 1) {
+  uint32_t dim_vec1 =
+      float_vector_dimensions(args->args[arg1], args->lengths[arg1]);
+  uint32_t dim_vec2 =
+      float_vector_dimensions(args->args[arg2], args->lengths[arg2]);
+  if (dim_vec1 != dim_vec2 || dim_vec1 == UINT32_MAX) {
+    error_msg_size();
+    return true;
+  }
+  *vec_dim = dim_vec1;
+  return false;
+}
+
+/*
+  Returns the fp32 elements of the vector argument `arg`, normalized or not,
+  and their count, or UINT32_MAX if it is NULL or not an fp32 vector.
+*/
+static uint32_t float_vector_operand(UDF_ARGS *args, unsigned int arg,
+                                    const char **elements) {
+  if (args->args[arg] == nullptr) return UINT32_MAX;
+  vector_kernels::element_type type;
+  uint32_t vec_dim =
+      vector_decode(args->args[arg], args->lengths[arg], &type, elements);
+  return type == vector_kernels::element_type::fp32 ? vec_dim : UINT32_MAX;
+}
+
+/*
+  Returns true if the argument `arg` is a constant text string, which names a
+  registered vector where a vector is expected: the vectors are binary
+  strings.
+*/
+static bool vector_argument_is_name(UDF_ARGS *args, unsigned int arg) {
+  if (args->args[arg] == nullptr || args->arg_type[arg] != STRING_RESULT)
+    return false;
+  void *charset = nullptr;
+  if (mysql_service_mysql_udf_metadata->argument_get(args, "charset", arg,
+                                                     &charset) ||
+      charset == nullptr)
+    return false;
+  return strcmp(static_cast<const char *>(charset), "binary") != 0;
+}
+
+/*
+  Caches the vector argument `arg` in `constant` if it is constant, looking
+  up the registered vector it names if it is a name. Returns true after
+  reporting the error on OOM or if no vector has this name.
+*/
+static bool vector_constant_init(vector_constant *constant, UDF_ARGS *args,
+                                 unsigned int arg, const char *udf_name) {
+  if (!vector_argument_is_name(args, arg)) {
+    if (!constant->init(args, arg)) return false;
+    error_msg_oom(udf_name);
+    return true;
+  }
+
+  std::shared_ptr<const vector_registry::entry> registered;
+  try {
+    registered = registered_vectors->find(
+        std::string(args->args[arg], args->lengths[arg]));
+  } catch (const std::bad_alloc &) {
+    error_msg_oom(udf_name);
+    return true;
+  }
+  if (registered == nullptr) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, udf_name,
+                                    "no vector registered with this name");
+    return true;
+  }
+  constant->init(std::move(registered));
+  return false;
+}
+
+/*
+  float_vector_operand() for an argument cached by vector_constant_init():
+  the cached elements if it is a constant or a name, the argument itself
+  otherwise.
+*/
+static uint32_t float_vector_operand(const vector_constant &constant,
+                                    UDF_ARGS *args, unsigned int arg,
+                                    const char **elements) {
+  if (constant.data != nullptr) {
+    *elements = constant.data;
+    return constant.vec_dim;
+  }
+  return float_vector_operand(args, arg, elements);
+}
+
+/*
+  Allocates the per-statement vector_udf_state of a UDF whose vector operands
+  are the arguments arg1 and arg2 (pass arg2 == arg1 for a single operand) and
+  caches the constant ones. Returns true (and reports the error) on OOM or if
+  an operand names no registered vector.
+*/
+static bool vector_state_create(UDF_INIT *initid, UDF_ARGS *args,
+                                const char *udf_name, unsigned int arg1,
+                                unsigned int arg2) {
+  vector_udf_state *state = new (std::nothrow) vector_udf_state();
+  if (state == nullptr) {
+    error_msg_oom(udf_name);
+    return true;
+  }
+  if (vector_constant_init(&state->constants[0], args, arg1, udf_name) ||
+      (arg2 != arg1 &&
+       vector_constant_init(&state->constants[1], args, arg2, udf_name))) {
+    delete state;
+    return true;
+  }
+  state->args[0] = arg1;
+  state->args[1] = arg2;
+  const vector_constant *constant = state->constants[0].data != nullptr
+                                        ? &state->constants[0]
+                                        : &state->constants[1];
+  state->kernels = vector_kernels::for_dimension(
+      constant->data != nullptr ? constant->vec_dim : 0);
+  initid->ptr = reinterpret_cast<char *>(state);
   initid->maybe_null = true;
   return false;
 }
 
-static void vector_addition_udf_deinit(__attribute__((unused))
-                                       UDF_INIT *initid) {
-  assert(initid->ptr == udf_init || initid->ptr == my_udf);
+/* vector_state_create() for the element-wise and distance UDFs. */
+static bool vector_state_init(UDF_INIT *initid, UDF_ARGS *args,
+                              const char *udf_name) {
+  if (vector_args_check(args, udf_name)) return true;
+  return vector_state_create(initid, args, udf_name, 0, 1);
 }
 
-const char *vector_addition_udf(UDF_INIT *, UDF_ARGS *args, char *vector_sum,
-                                unsigned long *length, char *is_null,
-                                char *error) {
-  *error = 0;
-  *is_null = 0;
+static void vector_state_deinit(UDF_INIT *initid) {
+  delete reinterpret_cast<vector_udf_state *>(initid->ptr);
+  initid->ptr = nullptr;
+}
+
+/*
+  The float kernels of the statement for operands of vec_dim elements, see
+  vector_udf_state::kernels.
+*/
+static const vector_kernels::dimension_kernels &vector_state_kernels(
+    vector_udf_state *state, uint32_t vec_dim) {
+  if (state->kernels.dimension != vec_dim)
+    state->kernels = vector_kernels::for_dimension(vec_dim);
+  return state->kernels;
+}
+
+/*
+  Resolves vector operand i of a row, from the cache if it is constant, and
+  returns its dimension (UINT32_MAX if it is not a valid vector) and its
+  element type; `operand` points to its elements.
+*/
+static uint32_t vector_operand(const vector_udf_state *state, UDF_ARGS *args,
+                               unsigned int i, const char **operand,
+                               vector_kernels::element_type *type) {
+  const vector_constant &constant = state->constants[i];
+  if (constant.data != nullptr) {
+    *operand = constant.data;
+    *type = vector_kernels::element_type::fp32;
+    return constant.vec_dim;
+  }
+  return vector_decode(args->args[state->args[i]],
+                       args->lengths[state->args[i]], type, operand);
+}
 
-  uint32_t dim_vec1 = get_dimensions(args->lengths[0], sizeof(float));
-  uint32_t dim_vec2 = get_dimensions(args->lengths[1], sizeof(float));
-  if (dim_vec1 != dim_vec2 || dim_vec1 == UINT32_MAX ||
-      dim_vec2 == UINT32_MAX) {
+/*
+  Resolves the two vector operands of a row and returns their common
+  dimension in vec_dim and element type in type. Returns true after reporting
+  the error if they are not valid vectors of the same size and type.
+*/
+static bool vector_operands(const vector_udf_state *state, UDF_ARGS *args,
+                            const char **operands, uint32_t *vec_dim,
+                            vector_kernels::element_type *type) {
+  vector_kernels::element_type type2;
+  uint32_t dim_vec1 = vector_operand(state, args, 0, &operands[0], type);
+  uint32_t dim_vec2 = vector_operand(state, args, 1, &operands[1], &type2);
+  if (dim_vec1 != dim_vec2 || dim_vec1 == UINT32_MAX) {
     error_msg_size();
-    *error = 1;
-    *is_null = 1;
-    return 0;
+    return true;
   }
+  if (*type != type2) {
+    mysql_error_service_emit_printf(
+        mysql_service_mysql_runtime_error, ER_UDF_ERROR, 0, "vector operation",
+        "both vectors must have the same element type");
+    return true;
+  }
+  *vec_dim = dim_vec1;
+  return false;
+}
 
-  float *vec1 = ((float *)args->args[0]);
-  float *vec2 = ((float *)args->args[1]);
+/*
+  Resolves the two operands of an element-wise UDF and returns the output
+  buffer sized for their common dimension and type, with the tag of the type
+  already written, or nullptr after reporting the error. The elements of the
+  result go to vector_elements(type, buffer).
+*/
+static char *vector_result_prepare(UDF_INIT *initid, UDF_ARGS *args,
+                                   const char *udf_name, const char **operands,
+                                   uint32_t *vec_dim,
+                                   vector_kernels::element_type *type) {
+  vector_udf_state *state = reinterpret_cast<vector_udf_state *>(initid->ptr);
+  if (vector_operands(state, args, operands, vec_dim, type)) return nullptr;
 
-  unsigned long vector_length = 0;
+  char *buffer = state->result.reserve(vector_bytes(*type, *vec_dim));
+  if (buffer == nullptr) {
+    error_msg_oom(udf_name);
+    return nullptr;
+  }
+  vector_elements(*type, buffer);
+  return buffer;
+}
 
-  vector_sum = vector_addition(dim_vec1, vec1, vec2, &vector_length);
-  *length = vector_length;
+/*
+  Reports the error of a UDF computing on floats only given a 16-bit vector;
+  returns true if there was an error.
+*/
+static bool vector_float_only(vector_kernels::element_type type,
+                              const char *udf_name) {
+  if (type == vector_kernels::element_type::fp32) return false;
+  mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                  ER_UDF_ERROR, 0, udf_name,
+                                  "this function requires float vectors");
+  return true;
+}
 
-  return const_cast<char *>(vector_sum);
+/* Reports a failed kernel status; returns true if there was an error. */
+static bool vector_status_error(vector_kernels::op_status status,
+                                const char *udf_name) {
+  switch (status) {
+    case vector_kernels::op_status::ok:
+      return false;
+    case vector_kernels::op_status::out_of_range:
+      udf_error = vector_counters::error_kind::out_of_range;
+      mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                      ER_UDF_ERROR, 0, udf_name,
+                                      "Data out of range");
+      break;
+    case vector_kernels::op_status::division_by_zero:
+      udf_error = vector_counters::error_kind::division_by_zero;
+      mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                      ER_UDF_ERROR, 0, udf_name,
+                                      "Division by zero is undefined");
+      break;
+  }
+  return true;
 }
 
-// UDF to implement a vector subtraction function between two vectors
+/*
+  VECTOR_ADDITION and VECTOR_MULTIPLICATION fold any number of vectors of the
+  same size and element type. Beyond two operands the result is computed by
+  blocks small enough to stay in L1: a block is written from the first two
+  operands, then updated in place with each of the others, so that every
+  operand is read once and no intermediate vector is materialized.
+*/
 
-static bool vector_subtraction_udf_init(UDF_INIT *initid, UDF_ARGS *args,
-                                        char *) {
+static constexpr uint32_t vector_block_elements = 2048;
+
+typedef vector_kernels::op_status (*vector_fold_op)(
+    const vector_kernels::dimension_kernels &kernels,
+    vector_kernels::element_type type, uint32_t vec_dim, const char *vec1,
+    const char *vec2, char *result);
+
+static bool vector_fold_init(UDF_INIT *initid, UDF_ARGS *args,
+                             const char *udf_name) {
   if (args->arg_count < 2) {
     mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
-                                    ER_UDF_ERROR, 0, "vector_subtraction",
-                                    "this function requires 2 parameters");
+                                    ER_UDF_ERROR, 0, udf_name,
+                                    "this function requires 2 or more "
+                                    "parameters");
     return true;
   }
-  initid->maybe_null = true;
+  if (vector_state_create(initid, args, udf_name, 0, 1)) return true;
+  vector_udf_state *state = reinterpret_cast<vector_udf_state *>(initid->ptr);
+  const unsigned int others = args->arg_count - 2;
+  try {
+    state->operands.resize(others);
+    state->other_constants.reset(new vector_constant[others]);
+  } catch (const std::bad_alloc &) {
+    vector_state_deinit(initid);
+    error_msg_oom(udf_name);
+    return true;
+  }
+  for (unsigned int i = 0; i < others; i++) {
+    if (vector_constant_init(&state->other_constants[i], args, i + 2,
+                             udf_name)) {
+      vector_state_deinit(initid);
+      return true;
+    }
+  }
   return false;
 }
 
-static void vector_subtraction_udf_deinit(__attribute__((unused))
-                                          UDF_INIT *initid) {
-  assert(initid->ptr == udf_init || initid->ptr == my_udf);
-}
-
-const char *vector_subtraction_udf(UDF_INIT *, UDF_ARGS *args, char *vector_sum,
-                                   unsigned long *length, char *is_null,
-                                   char *error) {
+static const char *vector_fold(UDF_INIT *initid, UDF_ARGS *args,
+                               const char *udf_name, vector_fold_op op,
+                               unsigned long *length, char *is_null,
+                               char *error) {
   *error = 0;
   *is_null = 0;
 
-  uint32_t dim_vec1 = get_dimensions(args->lengths[0], sizeof(float));
-  uint32_t dim_vec2 = get_dimensions(args->lengths[1], sizeof(float));
-  if (dim_vec1 != dim_vec2 || dim_vec1 == UINT32_MAX ||
-      dim_vec2 == UINT32_MAX) {
-    error_msg_size();
+  uint32_t vec_dim = 0;
+  const char *operands[2];
+  vector_kernels::element_type type;
+  char *result = vector_result_prepare(initid, args, udf_name, operands,
+                                       &vec_dim, &type);
+  if (result == nullptr) {
     *error = 1;
     *is_null = 1;
     return 0;
   }
 
-  float *vec1 = ((float *)args->args[0]);
-  float *vec2 = ((float *)args->args[1]);
+  /* The other operands are all validated before any computation. */
+  vector_udf_state *state = reinterpret_cast<vector_udf_state *>(initid->ptr);
+  std::vector<const char *> &others = state->operands;
+  for (size_t i = 0; i < others.size(); i++) {
+    const vector_constant &constant = state->other_constants[i];
+    vector_kernels::element_type other_type =
+        vector_kernels::element_type::fp32;
+    uint32_t other_dim = constant.vec_dim;
+    others[i] = constant.data;
+    if (constant.data == nullptr)
+      other_dim = vector_decode(args->args[i + 2], args->lengths[i + 2],
+                                &other_type, &others[i]);
+    if (other_dim != vec_dim) {
+      error_msg_size();
+      *error = 1;
+      *is_null = 1;
+      return 0;
+    }
+    if (other_type != type) {
+      mysql_error_service_emit_printf(
+          mysql_service_mysql_runtime_error, ER_UDF_ERROR, 0, udf_name,
+          "all vectors must have the same element type");
+      *error = 1;
+      *is_null = 1;
+      return 0;
+    }
+  }
+
+  char *elements = vector_elements(type, result);
+  const size_t element_size = type == vector_kernels::element_type::fp32
+                                  ? sizeof(float)
+                                  : sizeof(uint16_t);
+  const uint32_t block = others.empty() ? vec_dim : vector_block_elements;
+  /*
+    Resolved once per row: the kernels specialized for the dimension when
+    the vector is a single block, else the generic ones for every block.
+  */
+  const vector_kernels::dimension_kernels kernels =
+      block >= vec_dim ? vector_state_kernels(state, vec_dim)
+                       : vector_kernels::generic_kernels();
+  vector_kernels::op_status status = vector_kernels::op_status::ok;
+  for (uint32_t start = 0;
+       start < vec_dim && status == vector_kernels::op_status::ok;
+       start += block) {
+    uint32_t count = std::min(block, vec_dim - start);
+    size_t offset = start * element_size;
+    status = op(kernels, type, count, operands[0] + offset,
+                operands[1] + offset, elements + offset);
+    for (size_t i = 0;
+         i < others.size() && status == vector_kernels::op_status::ok; i++)
+      status = op(kernels, type, count, elements + offset, others[i] + offset,
+                  elements + offset);
+  }
+  if (vector_status_error(status, udf_name)) {
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
 
-  unsigned long vector_length = 0;
+  *length = vector_bytes(type, vec_dim);
+  return result;
+}
 
-  vector_sum = vector_subtraction(dim_vec1, vec1, vec2, &vector_length);
-  *length = vector_length;
+// UDF to implement the sum of two or more vectors
 
-  return const_cast<char *>(vector_sum);
+static bool vector_addition_udf_init(UDF_INIT *initid, UDF_ARGS *args, char *) {
+  return vector_fold_init(initid, args, "vector_addition");
 }
 
-// UDF to implement a vector product function of two vectors
+static void vector_addition_udf_deinit(UDF_INIT *initid) {
+  vector_state_deinit(initid);
+}
 
-static bool vector_multiplication_udf_init(UDF_INIT *initid, UDF_ARGS *args,
-                                           char *) {
-  if (args->arg_count < 2) {
-    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
-                                    ER_UDF_ERROR, 0, "vector_multiplication",
-                                    "this function requires 2 parameters");
-    return true;
-  }
-  initid->maybe_null = true;
-  return false;
+const char *vector_addition_udf(UDF_INIT *initid, UDF_ARGS *args, char *,
+                                unsigned long *length, char *is_null,
+                                char *error) {
+  return vector_fold(initid, args, "vector_addition", vector_addition, length,
+                     is_null, error);
 }
 
-static void vector_multiplication_udf_deinit(__attribute__((unused))
-                                             UDF_INIT *initid) {
-  assert(initid->ptr == udf_init || initid->ptr == my_udf);
+// UDF to implement a vector subtraction function between two vectors
+
+static bool vector_subtraction_udf_init(UDF_INIT *initid, UDF_ARGS *args,
+                                        char *) {
+  return vector_state_init(initid, args, "vector_subtraction");
 }
 
-const char *vector_multiplication_udf(UDF_INIT *, UDF_ARGS *args,
-                                      char *vector_sum, unsigned long *length,
-                                      char *is_null, char *error) {
+static void vector_subtraction_udf_deinit(UDF_INIT *initid) {
+  vector_state_deinit(initid);
+}
+
+const char *vector_subtraction_udf(UDF_INIT *initid, UDF_ARGS *args, char *,
+                                   unsigned long *length, char *is_null,
+                                   char *error) {
   *error = 0;
   *is_null = 0;
 
-  uint32_t dim_vec1 = get_dimensions(args->lengths[0], sizeof(float));
-  uint32_t dim_vec2 = get_dimensions(args->lengths[1], sizeof(float));
-  if (dim_vec1 != dim_vec2 || dim_vec1 == UINT32_MAX ||
-      dim_vec2 == UINT32_MAX) {
-    error_msg_size();
+  uint32_t vec_dim = 0;
+  const char *operands[2];
+  vector_kernels::element_type type;
+  char *result = vector_result_prepare(initid, args, "vector_subtraction",
+                                       operands, &vec_dim, &type);
+  if (result == nullptr) {
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  vector_udf_state *state = reinterpret_cast<vector_udf_state *>(initid->ptr);
+  if (vector_status_error(
+          vector_subtraction(vector_state_kernels(state, vec_dim), type,
+                             vec_dim, operands[0], operands[1],
+                             vector_elements(type, result)),
+          "vector_subtraction")) {
     *error = 1;
     *is_null = 1;
     return 0;
   }
 
-  float *vec1 = ((float *)args->args[0]);
-  float *vec2 = ((float *)args->args[1]);
+  *length = vector_bytes(type, vec_dim);
+  return result;
+}
+
+// UDF to implement the element-wise product of two or more vectors
 
-  unsigned long vector_length = 0;
+static bool vector_multiplication_udf_init(UDF_INIT *initid, UDF_ARGS *args,
+                                           char *) {
+  return vector_fold_init(initid, args, "vector_multiplication");
+}
 
-  vector_sum = vector_multiplication(dim_vec1, vec1, vec2, &vector_length);
-  *length = vector_length;
+static void vector_multiplication_udf_deinit(UDF_INIT *initid) {
+  vector_state_deinit(initid);
+}
 
-  return const_cast<char *>(vector_sum);
+const char *vector_multiplication_udf(UDF_INIT *initid, UDF_ARGS *args, char *,
+                                      unsigned long *length, char *is_null,
+                                      char *error) {
+  return vector_fold(initid, args, "vector_multiplication",
+                     vector_multiplication, length, is_null, error);
 }
 
 // UDF to implement a vector division function of two vectors
 
 static bool vector_division_udf_init(UDF_INIT *initid, UDF_ARGS *args, char *) {
-  if (args->arg_count < 2) {
-    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
-                                    ER_UDF_ERROR, 0, "vector_division",
-                                    "this function requires 2 parameters");
-    return true;
-  }
-  initid->maybe_null = true;
-  return false;
+  return vector_state_init(initid, args, "vector_division");
 }
 
-static void vector_division_udf_deinit(__attribute__((unused))
-                                       UDF_INIT *initid) {
-  assert(initid->ptr == udf_init || initid->ptr == my_udf);
+static void vector_division_udf_deinit(UDF_INIT *initid) {
+  vector_state_deinit(initid);
 }
 
-const char *vector_division_udf(UDF_INIT *, UDF_ARGS *args, char *vector_sum,
+const char *vector_division_udf(UDF_INIT *initid, UDF_ARGS *args, char *,
                                 unsigned long *length, char *is_null,
                                 char *error) {
   *error = 0;
   *is_null = 0;
 
-  uint32_t dim_vec1 = get_dimensions(args->lengths[0], sizeof(float));
-  uint32_t dim_vec2 = get_dimensions(args->lengths[1], sizeof(float));
-  if (dim_vec1 != dim_vec2 || dim_vec1 == UINT32_MAX ||
-      dim_vec2 == UINT32_MAX) {
-    error_msg_size();
+  uint32_t vec_dim = 0;
+  const char *operands[2];
+  vector_kernels::element_type type;
+  char *result = vector_result_prepare(initid, args, "vector_division",
+                                       operands, &vec_dim, &type);
+  if (result == nullptr) {
     *error = 1;
     *is_null = 1;
     return 0;
   }
 
-  float *vec1 = ((float *)args->args[0]);
-  float *vec2 = ((float *)args->args[1]);
+  /* A constant divisor known to contain a zero skips the kernel. */
+  vector_udf_state *state = reinterpret_cast<vector_udf_state *>(initid->ptr);
+  const vector_constant &divisor = state->constants[1];
+  vector_kernels::op_status status =
+      divisor.data != nullptr && divisor.has_zero
+          ? vector_kernels::op_status::division_by_zero
+          : vector_division(vector_state_kernels(state, vec_dim), type,
+                            vec_dim, operands[0], operands[1],
+                            vector_elements(type, result));
+  if (vector_status_error(status, "vector_division")) {
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
 
-  unsigned long vector_length = 0;
+  *length = vector_bytes(type, vec_dim);
+  return result;
+}
 
-  vector_sum = vector_division(dim_vec1, vec1, vec2, &vector_length);
-  *length = vector_length;
+/*
+  The fused UDFs below combine a REAL scalar with one or two vectors in a
+  single kernel pass, without materializing intermediate vectors. The scalar
+  is coerced to REAL by the init callback; a NULL scalar gives a NULL result.
+*/
 
-  return const_cast<char *>(vector_sum);
+static bool vector_fused_init(UDF_INIT *initid, UDF_ARGS *args,
+                              const char *udf_name, unsigned int arg_count,
+                              unsigned int scalar_arg, unsigned int arg1,
+                              unsigned int arg2) {
+  if (args->arg_count != arg_count) {
+    mysql_error_service_emit_printf(
+        mysql_service_mysql_runtime_error, ER_UDF_ERROR, 0, udf_name,
+        arg_count == 2 ? "this function requires 2 parameters"
+                       : "this function requires 3 parameters");
+    return true;
+  }
+  args->arg_type[scalar_arg] = REAL_RESULT;
+  return vector_state_create(initid, args, udf_name, arg1, arg2);
 }
 
-} /* namespace udf_impl */
-
-static mysql_service_status_t vector_operations_service_init() {
-  mysql_service_status_t result = 0;
+/* Reads the REAL argument `arg` as a float; returns true if it is NULL. */
+static bool vector_scalar_arg(UDF_ARGS *args, unsigned int arg, float *value) {
+  if (args->args[arg] == nullptr) return true;
+  *value = static_cast<float>(*reinterpret_cast<double *>(args->args[arg]));
+  return false;
+}
 
-  log_bi = mysql_service_log_builtins;
-  log_bs = mysql_service_log_builtins_string;
+// UDF to implement the product of a vector by a scalar: VECTOR_SCALE(v, s)
 
-  LogComponentErr(INFORMATION_LEVEL, ER_LOG_PRINTF_MSG, "initializing…");
+static bool vector_scale_udf_init(UDF_INIT *initid, UDF_ARGS *args, char *) {
+  return vector_fused_init(initid, args, "vector_scale", 2, 1, 0, 0);
+}
 
-  list = new udf_list();
+const char *vector_scale_udf(UDF_INIT *initid, UDF_ARGS *args, char *,
+                             unsigned long *length, char *is_null,
+                             char *error) {
+  *error = 0;
+  *is_null = 0;
 
-  if (list->add_scalar("VECTOR_ADDITION", Item_result::STRING_RESULT,
-                       (Udf_func_any)udf_impl::vector_addition_udf,
-                       udf_impl::vector_addition_udf_init,
-                       udf_impl::vector_addition_udf_deinit)) {
-    delete list;
-    return 1; /* failure: one of the UDF registrations failed */
+  float s;
+  if (vector_scalar_arg(args, 1, &s)) {
+    *is_null = 1;
+    return 0;
   }
 
-  if (list->add_scalar("VECTOR_SUBTRACTION", Item_result::STRING_RESULT,
-                       (Udf_func_any)udf_impl::vector_subtraction_udf,
-                       udf_impl::vector_subtraction_udf_init,
-                       udf_impl::vector_subtraction_udf_deinit)) {
-    delete list;
-    return 1; /* failure: one of the UDF registrations failed */
+  vector_udf_state *state = reinterpret_cast<vector_udf_state *>(initid->ptr);
+  const char *vec;
+  vector_kernels::element_type type;
+  uint32_t vec_dim = vector_operand(state, args, 0, &vec, &type);
+  if (vec_dim == UINT32_MAX) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_scale",
+                                    "Invalid vector");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  if (vector_float_only(type, "vector_scale")) {
+    *error = 1;
+    *is_null = 1;
+    return 0;
   }
 
-  if (list->add_scalar("VECTOR_MULTIPLICATION", Item_result::STRING_RESULT,
-                       (Udf_func_any)udf_impl::vector_multiplication_udf,
-                       udf_impl::vector_multiplication_udf_init,
-                       udf_impl::vector_multiplication_udf_deinit)) {
-    delete list;
-    return 1; /* failure: one of the UDF registrations failed */
+  char *result = state->result.reserve(Field_vector::dimension_bytes(vec_dim));
+  if (result == nullptr) {
+    error_msg_oom("vector_scale");
+    *error = 1;
+    *is_null = 1;
+    return 0;
   }
 
-  if (list->add_scalar("VECTOR_DIVISION", Item_result::STRING_RESULT,
-                       (Udf_func_any)udf_impl::vector_division_udf,
-                       udf_impl::vector_division_udf_init,
-                       udf_impl::vector_division_udf_deinit)) {
-    delete list;
-    return 1; /* failure: one of the UDF registrations failed */
+  if (vector_status_error(vector_scale(vec_dim, vec, s, result),
+                          "vector_scale")) {
+    *error = 1;
+    *is_null = 1;
+    return 0;
   }
 
+  *length = Field_vector::dimension_bytes(vec_dim);
   return result;
 }
 
-static mysql_service_status_t vector_operations_service_deinit() {
-  mysql_service_status_t result = 0;
+// UDF to implement a * x + y for a scalar a: VECTOR_AXPY(a, x, y)
 
-  if (list->unregister()) return 1; /* failure: some UDFs still in use */
+static bool vector_axpy_udf_init(UDF_INIT *initid, UDF_ARGS *args, char *) {
+  return vector_fused_init(initid, args, "vector_axpy", 3, 0, 1, 2);
+}
 
-  delete list;
+const char *vector_axpy_udf(UDF_INIT *initid, UDF_ARGS *args, char *,
+                            unsigned long *length, char *is_null,
+                            char *error) {
+  *error = 0;
+  *is_null = 0;
+
+  float a;
+  if (vector_scalar_arg(args, 0, &a)) {
+    *is_null = 1;
+    return 0;
+  }
+
+  uint32_t vec_dim = 0;
+  const char *operands[2];
+  vector_kernels::element_type type;
+  char *result = vector_result_prepare(initid, args, "vector_axpy", operands,
+                                       &vec_dim, &type);
+  if (result == nullptr || vector_float_only(type, "vector_axpy") ||
+      vector_status_error(
+          vector_axpy(vec_dim, a, operands[0], operands[1], result),
+          "vector_axpy")) {
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  *length = Field_vector::dimension_bytes(vec_dim);
+  return result;
+}
+
+// UDF to implement the linear interpolation VECTOR_LERP(a, b, t)
+
+static bool vector_lerp_udf_init(UDF_INIT *initid, UDF_ARGS *args, char *) {
+  return vector_fused_init(initid, args, "vector_lerp", 3, 2, 0, 1);
+}
+
+const char *vector_lerp_udf(UDF_INIT *initid, UDF_ARGS *args, char *,
+                            unsigned long *length, char *is_null,
+                            char *error) {
+  *error = 0;
+  *is_null = 0;
+
+  float t;
+  if (vector_scalar_arg(args, 2, &t)) {
+    *is_null = 1;
+    return 0;
+  }
+
+  uint32_t vec_dim = 0;
+  const char *operands[2];
+  vector_kernels::element_type type;
+  char *result = vector_result_prepare(initid, args, "vector_lerp", operands,
+                                       &vec_dim, &type);
+  if (result == nullptr || vector_float_only(type, "vector_lerp") ||
+      vector_status_error(
+          vector_lerp(vec_dim, operands[0], operands[1], t, result),
+          "vector_lerp")) {
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  *length = Field_vector::dimension_bytes(vec_dim);
+  return result;
+}
+
+// UDF evaluating an element-wise expression: VECTOR_EVAL('a*0.3 + b', v1, v2)
+
+/*
+  Per-statement state of VECTOR_EVAL: the expression, constant for the
+  statement, is compiled once by the init callback, which also caches the
+  constant and named input vectors.
+*/
+struct vector_eval {
+  vector_expression expression;
+  vector_result result;
+  vector_constant constants[vector_expression::max_inputs];
+  const char *inputs[vector_expression::max_inputs];
+};
+
+static bool vector_eval_udf_init(UDF_INIT *initid, UDF_ARGS *args, char *) {
+  if (args->arg_count < 2 ||
+      args->arg_count > 1 + vector_expression::max_inputs) {
+    mysql_error_service_emit_printf(
+        mysql_service_mysql_runtime_error, ER_UDF_ERROR, 0, "vector_eval",
+        "this function requires an expression and 1 to 26 vectors");
+    return true;
+  }
+  if (args->arg_type[0] != STRING_RESULT || args->args[0] == nullptr) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_eval",
+                                    "the expression must be a constant string");
+    return true;
+  }
+
+  vector_eval *eval = new (std::nothrow) vector_eval();
+  if (eval == nullptr) {
+    error_msg_oom("vector_eval");
+    return true;
+  }
+  std::string compile_error;
+  if (eval->expression.compile(args->args[0], args->lengths[0],
+                               args->arg_count - 1, &compile_error)) {
+    delete eval;
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_eval",
+                                    compile_error.c_str());
+    return true;
+  }
+  for (unsigned int i = 1; i < args->arg_count; i++) {
+    if (vector_constant_init(&eval->constants[i - 1], args, i,
+                             "vector_eval")) {
+      delete eval;
+      return true;
+    }
+  }
+
+  initid->ptr = reinterpret_cast<char *>(eval);
+  initid->maybe_null = true;
+  return false;
+}
+
+static void vector_eval_udf_deinit(UDF_INIT *initid) {
+  delete reinterpret_cast<vector_eval *>(initid->ptr);
+  initid->ptr = nullptr;
+}
+
+const char *vector_eval_udf(UDF_INIT *initid, UDF_ARGS *args, char *,
+                            unsigned long *length, char *is_null,
+                            char *error) {
+  vector_eval *eval = reinterpret_cast<vector_eval *>(initid->ptr);
+  *error = 0;
+  *is_null = 0;
+
+  uint32_t vec_dim = UINT32_MAX;
+  for (unsigned int i = 1; i < args->arg_count; i++) {
+    uint32_t dim = float_vector_operand(eval->constants[i - 1], args, i,
+                                        &eval->inputs[i - 1]);
+    if (dim == UINT32_MAX ||
+        (i > 1 && dim != vec_dim)) {
+      udf_error = vector_counters::error_kind::size_mismatch;
+      mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                      ER_UDF_ERROR, 0, "vector_eval",
+                                      "all vectors must have the same size");
+      *error = 1;
+      *is_null = 1;
+      return 0;
+    }
+    vec_dim = dim;
+  }
+
+  char *result = eval->result.reserve(Field_vector::dimension_bytes(vec_dim));
+  if (result == nullptr) {
+    error_msg_oom("vector_eval");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  if (vector_status_error(
+          eval->expression.evaluate(vec_dim, eval->inputs, result),
+          "vector_eval")) {
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  *length = Field_vector::dimension_bytes(vec_dim);
+  return result;
+}
+
+/*
+  The distance UDFs below return a REAL computed by a fused reduction kernel
+  reading both vectors in place; their state only holds the cached constant
+  operands.
+*/
+
+/*
+  Resolves the operands of a distance UDF; returns true after setting the
+  error flags if they are invalid.
+*/
+static bool vector_distance_operands(UDF_INIT *initid, UDF_ARGS *args,
+                                     const char **operands, uint32_t *vec_dim,
+                                     vector_kernels::element_type *type,
+                                     char *is_null, char *error) {
+  *error = 0;
+  *is_null = 0;
+  if (vector_operands(reinterpret_cast<vector_udf_state *>(initid->ptr), args,
+                      operands, vec_dim, type)) {
+    *error = 1;
+    *is_null = 1;
+    return true;
+  }
+  return false;
+}
+
+// UDF to implement the dot product of two vectors
+
+static bool vector_dot_udf_init(UDF_INIT *initid, UDF_ARGS *args, char *) {
+  return vector_state_init(initid, args, "vector_dot");
+}
+
+double vector_dot_udf(UDF_INIT *initid, UDF_ARGS *args, char *is_null,
+                      char *error) {
+  uint32_t vec_dim = 0;
+  const char *operands[2];
+  vector_kernels::element_type type;
+  if (vector_distance_operands(initid, args, operands, &vec_dim, &type,
+                               is_null, error))
+    return 0;
+
+  if (type != vector_kernels::element_type::fp32)
+    return vector_half_kernels(type).dot(vec_dim, operands[0], operands[1]);
+  return vector_state_kernels(
+             reinterpret_cast<vector_udf_state *>(initid->ptr), vec_dim)
+      .dot(vec_dim, operands[0], operands[1]);
+}
+
+/*
+  Squared L2 norm of vector operand i of a row when it is known without
+  reading the vector: cached for a constant, 1 for a normalized vector. Returns
+  -1 if it has to be computed.
+*/
+static double vector_known_norm_squared(const vector_udf_state *state,
+                                        UDF_ARGS *args, unsigned int i) {
+  if (state->constants[i].data != nullptr)
+    return state->constants[i].norm_squared;
+  unsigned int arg = state->args[i];
+  if (vector_is_normalized(args->args[arg], args->lengths[arg])) return 1;
+  return -1;
+}
+
+// UDF to implement the cosine distance (1 - cosine similarity) of two vectors
+
+static bool vector_cosine_udf_init(UDF_INIT *initid, UDF_ARGS *args, char *) {
+  return vector_state_init(initid, args, "vector_cosine");
+}
+
+double vector_cosine_udf(UDF_INIT *initid, UDF_ARGS *args, char *is_null,
+                         char *error) {
+  uint32_t vec_dim = 0;
+  const char *operands[2];
+  vector_kernels::element_type type;
+  if (vector_distance_operands(initid, args, operands, &vec_dim, &type,
+                               is_null, error))
+    return 0;
+
+  /*
+    The norm of a constant or normalized operand is already known: only
+    compute the others.
+  */
+  vector_udf_state *state = reinterpret_cast<vector_udf_state *>(initid->ptr);
+  const vector_kernels::dimension_kernels &kernels =
+      vector_state_kernels(state, vec_dim);
+  double norm1 = vector_known_norm_squared(state, args, 0);
+  double norm2 = vector_known_norm_squared(state, args, 1);
+  vector_kernels::cosine_terms terms;
+  if (norm1 >= 0 && norm2 >= 0) {
+    terms = {kernels.dot(vec_dim, operands[0], operands[1]), norm1, norm2};
+  } else if (norm2 >= 0) {
+    terms = kernels.dot_norm(vec_dim, operands[0], operands[1]);
+    terms.norm2 = norm2;
+  } else if (norm1 >= 0) {
+    terms = kernels.dot_norm(vec_dim, operands[1], operands[0]);
+    terms.norm2 = norm1;
+  } else if (type != vector_kernels::element_type::fp32) {
+    terms = vector_half_kernels(type).cosine(vec_dim, operands[0], operands[1]);
+  } else {
+    terms = kernels.cosine(vec_dim, operands[0], operands[1]);
+  }
+
+  if (terms.norm1 == 0 || terms.norm2 == 0) {
+    udf_error = vector_counters::error_kind::division_by_zero;
+    mysql_error_service_emit_printf(
+        mysql_service_mysql_runtime_error, ER_UDF_ERROR, 0, "vector_cosine",
+        "Cosine distance is undefined for a zero vector");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  return 1.0 - terms.dot / std::sqrt(terms.norm1 * terms.norm2);
+}
+
+// UDF to implement the euclidean (L2) distance of two vectors
+
+static bool vector_l2_udf_init(UDF_INIT *initid, UDF_ARGS *args, char *) {
+  return vector_state_init(initid, args, "vector_l2");
+}
+
+double vector_l2_udf(UDF_INIT *initid, UDF_ARGS *args, char *is_null,
+                     char *error) {
+  uint32_t vec_dim = 0;
+  const char *operands[2];
+  vector_kernels::element_type type;
+  if (vector_distance_operands(initid, args, operands, &vec_dim, &type,
+                               is_null, error))
+    return 0;
+
+  if (type != vector_kernels::element_type::fp32)
+    return std::sqrt(vector_half_kernels(type).l2_squared(
+        vec_dim, operands[0], operands[1]));
+  return std::sqrt(
+      vector_state_kernels(reinterpret_cast<vector_udf_state *>(initid->ptr),
+                           vec_dim)
+          .l2_squared(vec_dim, operands[0], operands[1]));
+}
+
+// UDF to implement the manhattan (L1) distance of two vectors
+
+static bool vector_l1_udf_init(UDF_INIT *initid, UDF_ARGS *args, char *) {
+  return vector_state_init(initid, args, "vector_l1");
+}
+
+double vector_l1_udf(UDF_INIT *initid, UDF_ARGS *args, char *is_null,
+                     char *error) {
+  uint32_t vec_dim = 0;
+  const char *operands[2];
+  vector_kernels::element_type type;
+  if (vector_distance_operands(initid, args, operands, &vec_dim, &type,
+                               is_null, error))
+    return 0;
+
+  if (type != vector_kernels::element_type::fp32)
+    return vector_half_kernels(type).l1(vec_dim, operands[0], operands[1]);
+  return vector_state_kernels(
+             reinterpret_cast<vector_udf_state *>(initid->ptr), vec_dim)
+      .l1(vec_dim, operands[0], operands[1]);
+}
+
+/*
+  The UDFs below convert vectors to the quantized codes of
+  vector_quantization.h and compute distances directly on the codes.
+*/
+
+// UDFs converting a vector between the element types: VECTOR_TO_FP16(v),
+// VECTOR_TO_BF16(v) and VECTOR_TO_FP32(v)
+
+struct vector_conversion {
+  vector_result result;
+  vector_result scratch;  // floats of a conversion between the 16-bit types
+};
+
+static bool vector_conversion_udf_init(UDF_INIT *initid, UDF_ARGS *args,
+                                       const char *udf_name) {
+  if (args->arg_count != 1) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, udf_name,
+                                    "this function requires 1 parameter");
+    return true;
+  }
+  vector_conversion *state = new (std::nothrow) vector_conversion();
+  if (state == nullptr) {
+    error_msg_oom(udf_name);
+    return true;
+  }
+  initid->ptr = reinterpret_cast<char *>(state);
+  initid->maybe_null = true;
+  return false;
+}
+
+static void vector_conversion_udf_deinit(UDF_INIT *initid) {
+  delete reinterpret_cast<vector_conversion *>(initid->ptr);
+  initid->ptr = nullptr;
+}
+
+static const char *vector_convert(UDF_INIT *initid, UDF_ARGS *args,
+                                  vector_kernels::element_type target,
+                                  const char *udf_name, unsigned long *length,
+                                  char *is_null, char *error) {
+  vector_conversion *state =
+      reinterpret_cast<vector_conversion *>(initid->ptr);
+  *error = 0;
+  *is_null = 0;
+
+  if (args->args[0] == nullptr) {
+    *is_null = 1;
+    return 0;
+  }
+  vector_kernels::element_type source;
+  const char *elements;
+  uint32_t vec_dim =
+      vector_decode(args->args[0], args->lengths[0], &source, &elements);
+  if (vec_dim == UINT32_MAX) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, udf_name,
+                                    "Invalid vector");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  char *result = state->result.reserve(vector_bytes(target, vec_dim));
+  const char *floats = elements;
+  if (result != nullptr && source != vector_kernels::element_type::fp32 &&
+      target != vector_kernels::element_type::fp32 && source != target)
+    floats = state->scratch.reserve(Field_vector::dimension_bytes(vec_dim));
+  if (result == nullptr || floats == nullptr) {
+    error_msg_oom(udf_name);
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  vector_kernels::op_status status = vector_kernels::op_status::ok;
+  char *output = vector_elements(target, result);
+  if (source == target) {
+    /* A normalized vector only keeps its elements. */
+    memcpy(output, elements, vector_bytes(target, vec_dim) - (output - result));
+  } else if (target == vector_kernels::element_type::fp32) {
+    status = vector_half_kernels(source).widen(vec_dim, elements, output);
+  } else {
+    /* From floats, going through the scratch buffer from the other type. */
+    if (floats != elements)
+      status = vector_half_kernels(source).widen(
+          vec_dim, elements, const_cast<char *>(floats));
+    if (status == vector_kernels::op_status::ok)
+      status = vector_half_kernels(target).narrow(vec_dim, floats, output);
+  }
+  if (vector_status_error(status, udf_name)) {
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  *length = vector_bytes(target, vec_dim);
+  return result;
+}
+
+static bool vector_to_fp16_udf_init(UDF_INIT *initid, UDF_ARGS *args,
+                                    char *) {
+  return vector_conversion_udf_init(initid, args, "vector_to_fp16");
+}
+
+const char *vector_to_fp16_udf(UDF_INIT *initid, UDF_ARGS *args, char *,
+                               unsigned long *length, char *is_null,
+                               char *error) {
+  return vector_convert(initid, args, vector_kernels::element_type::fp16,
+                        "vector_to_fp16", length, is_null, error);
+}
+
+static bool vector_to_bf16_udf_init(UDF_INIT *initid, UDF_ARGS *args,
+                                    char *) {
+  return vector_conversion_udf_init(initid, args, "vector_to_bf16");
+}
+
+const char *vector_to_bf16_udf(UDF_INIT *initid, UDF_ARGS *args, char *,
+                               unsigned long *length, char *is_null,
+                               char *error) {
+  return vector_convert(initid, args, vector_kernels::element_type::bf16,
+                        "vector_to_bf16", length, is_null, error);
+}
+
+static bool vector_to_fp32_udf_init(UDF_INIT *initid, UDF_ARGS *args,
+                                    char *) {
+  return vector_conversion_udf_init(initid, args, "vector_to_fp32");
+}
+
+const char *vector_to_fp32_udf(UDF_INIT *initid, UDF_ARGS *args, char *,
+                               unsigned long *length, char *is_null,
+                               char *error) {
+  return vector_convert(initid, args, vector_kernels::element_type::fp32,
+                        "vector_to_fp32", length, is_null, error);
+}
+
+// UDF scaling a vector to unit length: VECTOR_NORMALIZE(v)
+
+static bool vector_normalize_udf_init(UDF_INIT *initid, UDF_ARGS *args,
+                                      char *) {
+  return vector_conversion_udf_init(initid, args, "vector_normalize");
+}
+
+const char *vector_normalize_udf(UDF_INIT *initid, UDF_ARGS *args, char *,
+                                 unsigned long *length, char *is_null,
+                                 char *error) {
+  vector_conversion *state =
+      reinterpret_cast<vector_conversion *>(initid->ptr);
+  *error = 0;
+  *is_null = 0;
+
+  if (args->args[0] == nullptr) {
+    *is_null = 1;
+    return 0;
+  }
+  vector_kernels::element_type source;
+  const char *elements;
+  uint32_t vec_dim =
+      vector_decode(args->args[0], args->lengths[0], &source, &elements);
+  if (vec_dim == UINT32_MAX) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_normalize",
+                                    "Invalid vector");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  size_t bytes = normalized_header_size + vec_dim * sizeof(float);
+  char *result = state->result.reserve(bytes);
+  if (result == nullptr) {
+    error_msg_oom("vector_normalize");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  if (vector_is_normalized(args->args[0], args->lengths[0])) {
+    memcpy(result, args->args[0], bytes);
+    *length = bytes;
+    return result;
+  }
+
+  /* The 16-bit elements are widened in place of the result. */
+  char *output = result + normalized_header_size;
+  vector_kernels::op_status status = vector_kernels::op_status::ok;
+  if (source != vector_kernels::element_type::fp32) {
+    status = vector_half_kernels(source).widen(vec_dim, elements, output);
+    elements = output;
+  }
+  double norm =
+      std::sqrt(vector_kernels::active().dot(vec_dim, elements, elements));
+  if (status == vector_kernels::op_status::ok && norm == 0) {
+    udf_error = vector_counters::error_kind::division_by_zero;
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_normalize",
+                                    "A zero vector cannot be normalized");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  if (status == vector_kernels::op_status::ok && !std::isfinite(norm))
+    status = vector_kernels::op_status::out_of_range;
+  if (status == vector_kernels::op_status::ok)
+    status = vector_scale(vec_dim, elements, static_cast<float>(1 / norm),
+                          output);
+  if (vector_status_error(status, "vector_normalize")) {
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  float stored_norm = static_cast<float>(norm);
+  memcpy(result, &normalized_vector_tag, sizeof(normalized_vector_tag));
+  memcpy(result + vector_tag_size, &stored_norm, sizeof(stored_norm));
+  *length = bytes;
+  return result;
+}
+
+// UDF returning the L2 norm of a vector: VECTOR_NORM(v)
+
+static bool vector_norm_udf_init(UDF_INIT *initid, UDF_ARGS *args, char *) {
+  if (args->arg_count != 1) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_norm",
+                                    "this function requires 1 parameter");
+    return true;
+  }
+  initid->maybe_null = true;
+  return false;
+}
+
+double vector_norm_udf(UDF_INIT *, UDF_ARGS *args, char *is_null,
+                       char *error) {
+  *error = 0;
+  *is_null = 0;
+
+  if (args->args[0] == nullptr) {
+    *is_null = 1;
+    return 0;
+  }
+  /* A normalized vector has the norm of the vector it was computed from. */
+  if (vector_is_normalized(args->args[0], args->lengths[0]))
+    return normalized_vector_norm(args->args[0]);
+
+  vector_kernels::element_type type;
+  const char *elements;
+  uint32_t vec_dim =
+      vector_decode(args->args[0], args->lengths[0], &type, &elements);
+  if (vec_dim == UINT32_MAX) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_norm",
+                                    "Invalid vector");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  if (type != vector_kernels::element_type::fp32)
+    return std::sqrt(
+        vector_half_kernels(type).dot(vec_dim, elements, elements));
+  return std::sqrt(vector_kernels::active().dot(vec_dim, elements, elements));
+}
+
+// UDF writing a vector as a JSON array: VECTOR_TO_TEXT(v [, digits])
+
+/*
+  Per-statement state of VECTOR_TO_TEXT; the significant digits are
+  constant, vector_text::shortest for the shortest round-trip form.
+*/
+struct vector_to_text {
+  vector_result result;
+  vector_result scratch;  // floats of a 16-bit vector
+  int digits = vector_text::shortest;
+};
+
+static bool vector_to_text_udf_init(UDF_INIT *initid, UDF_ARGS *args,
+                                    char *) {
+  if (args->arg_count < 1 || args->arg_count > 2) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_to_text",
+                                    "this function requires 1 or 2 parameters");
+    return true;
+  }
+
+  long long digits = vector_text::shortest;
+  if (args->arg_count == 2) {
+    args->arg_type[1] = INT_RESULT;
+    digits = args->args[1] ? *reinterpret_cast<long long *>(args->args[1]) : 0;
+    if (digits < 1 || digits > vector_text::max_digits) {
+      mysql_error_service_emit_printf(
+          mysql_service_mysql_runtime_error, ER_UDF_ERROR, 0, "vector_to_text",
+          "digits must be a constant between 1 and 9");
+      return true;
+    }
+  }
+
+  vector_to_text *state = new (std::nothrow) vector_to_text();
+  if (state == nullptr) {
+    error_msg_oom("vector_to_text");
+    return true;
+  }
+  state->digits = static_cast<int>(digits);
+  if (mysql_service_mysql_udf_metadata->result_set(
+          initid, "charset", const_cast<char *>("utf8mb4"))) {
+    delete state;
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_to_text",
+                                    "unable to set the result charset");
+    return true;
+  }
+  initid->ptr = reinterpret_cast<char *>(state);
+  initid->maybe_null = true;
+  return false;
+}
+
+static void vector_to_text_udf_deinit(UDF_INIT *initid) {
+  delete reinterpret_cast<vector_to_text *>(initid->ptr);
+  initid->ptr = nullptr;
+}
+
+const char *vector_to_text_udf(UDF_INIT *initid, UDF_ARGS *args, char *,
+                               unsigned long *length, char *is_null,
+                               char *error) {
+  vector_to_text *state = reinterpret_cast<vector_to_text *>(initid->ptr);
+  *error = 0;
+  *is_null = 0;
+
+  if (args->args[0] == nullptr) {
+    *is_null = 1;
+    return 0;
+  }
+  vector_kernels::element_type type;
+  const char *elements;
+  uint32_t vec_dim =
+      vector_decode(args->args[0], args->lengths[0], &type, &elements);
+  if (vec_dim == UINT32_MAX) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_to_text",
+                                    "Invalid vector");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  char *result = state->result.reserve(vector_text::max_text_bytes(vec_dim));
+  const char *floats = elements;
+  if (result != nullptr && type != vector_kernels::element_type::fp32)
+    floats = state->scratch.reserve(Field_vector::dimension_bytes(vec_dim));
+  if (result == nullptr || floats == nullptr) {
+    error_msg_oom("vector_to_text");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  if (floats != elements &&
+      vector_status_error(vector_half_kernels(type).widen(
+                              vec_dim, elements, const_cast<char *>(floats)),
+                          "vector_to_text")) {
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  size_t bytes = vector_text::format(vec_dim, floats, state->digits, result);
+  if (bytes == SIZE_MAX) {
+    vector_status_error(vector_kernels::op_status::out_of_range,
+                        "vector_to_text");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  *length = bytes;
+  return result;
+}
+
+// UDF reading a vector from a JSON array of numbers: VECTOR_FROM_JSON(text)
+
+static bool vector_from_json_udf_init(UDF_INIT *initid, UDF_ARGS *args,
+                                      char *) {
+  if (args->arg_count != 1) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_from_json",
+                                    "this function requires 1 parameter");
+    return true;
+  }
+  args->arg_type[0] = STRING_RESULT;
+  vector_result *result = new (std::nothrow) vector_result();
+  if (result == nullptr) {
+    error_msg_oom("vector_from_json");
+    return true;
+  }
+  initid->ptr = reinterpret_cast<char *>(result);
+  initid->maybe_null = true;
+  return false;
+}
+
+static void vector_from_json_udf_deinit(UDF_INIT *initid) {
+  delete reinterpret_cast<vector_result *>(initid->ptr);
+  initid->ptr = nullptr;
+}
+
+const char *vector_from_json_udf(UDF_INIT *initid, UDF_ARGS *args, char *,
+                                 unsigned long *length, char *is_null,
+                                 char *error) {
+  vector_result *result_buffer = reinterpret_cast<vector_result *>(initid->ptr);
+  *error = 0;
+  *is_null = 0;
+
+  if (args->args[0] == nullptr) {
+    *is_null = 1;
+    return 0;
+  }
+  uint32_t vec_dim = vector_text::count(args->args[0], args->lengths[0]);
+  char *result = nullptr;
+  if (vec_dim != UINT32_MAX && vec_dim <= Field_vector::max_dimensions) {
+    result = result_buffer->reserve(Field_vector::dimension_bytes(vec_dim));
+    if (result == nullptr) {
+      error_msg_oom("vector_from_json");
+      *error = 1;
+      *is_null = 1;
+      return 0;
+    }
+  }
+  if (result == nullptr ||
+      vector_text::parse(args->args[0], args->lengths[0], vec_dim, result)) {
+    mysql_error_service_emit_printf(
+        mysql_service_mysql_runtime_error, ER_UDF_ERROR, 0, "vector_from_json",
+        "the text is not a JSON array of at most 16383 floats");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  *length = Field_vector::dimension_bytes(vec_dim);
+  return result;
+}
+
+// UDF storing a projection matrix:
+// VECTOR_PROJECTION_LOAD(name, matrix, rows, cols)
+
+static constexpr unsigned long max_projection_name_length = 64;
+
+static bool vector_projection_load_udf_init(UDF_INIT *initid, UDF_ARGS *args,
+                                            char *) {
+  if (args->arg_count != 4) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_projection_load",
+                                    "this function requires 4 parameters");
+    return true;
+  }
+  args->arg_type[0] = STRING_RESULT;
+  args->arg_type[2] = INT_RESULT;
+  args->arg_type[3] = INT_RESULT;
+  initid->maybe_null = true;
+  return false;
+}
+
+long long vector_projection_load_udf(UDF_INIT *, UDF_ARGS *args,
+                                     char *is_null, char *error) {
+  *error = 0;
+  *is_null = 0;
+
+  const char *message = nullptr;
+  long long rows =
+      args->args[2] ? *reinterpret_cast<long long *>(args->args[2]) : 0;
+  long long cols =
+      args->args[3] ? *reinterpret_cast<long long *>(args->args[3]) : 0;
+  if (args->args[0] == nullptr || args->lengths[0] == 0 ||
+      args->lengths[0] > max_projection_name_length) {
+    message = "invalid projection name";
+  } else if (rows < 1 || rows > Field_vector::max_dimensions || cols < 1 ||
+             cols > Field_vector::max_dimensions) {
+    message = "rows and cols must be between 1 and 16383";
+  } else if (args->args[1] == nullptr ||
+             args->lengths[1] != static_cast<unsigned long>(rows) *
+                                     static_cast<unsigned long>(cols) *
+                                     sizeof(float)) {
+    udf_error = vector_counters::error_kind::size_mismatch;
+    message = "the matrix must hold rows * cols floats";
+  }
+  if (message != nullptr) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_projection_load",
+                                    message);
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  try {
+    projections->store(std::string(args->args[0], args->lengths[0]),
+                       std::make_shared<const vector_projection::matrix>(
+                           static_cast<uint32_t>(rows),
+                           static_cast<uint32_t>(cols), args->args[1]));
+  } catch (const std::bad_alloc &) {
+    error_msg_oom("vector_projection_load");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  return 1;
+}
+
+// UDF projecting a vector with a stored matrix: VECTOR_PROJECT(name, v)
+
+/*
+  Per-statement state of VECTOR_PROJECT. The matrix of a constant name is
+  looked up once, the statement keeping it even if it is replaced meanwhile,
+  and a constant or named vector is cached.
+*/
+struct vector_projection_state {
+  vector_result result;
+  std::shared_ptr<const vector_projection::matrix> matrix;
+  vector_constant vector;
+};
+
+static bool vector_project_udf_init(UDF_INIT *initid, UDF_ARGS *args,
+                                    char *) {
+  if (args->arg_count != 2) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_project",
+                                    "this function requires 2 parameters");
+    return true;
+  }
+  args->arg_type[0] = STRING_RESULT;
+
+  vector_projection_state *state = new (std::nothrow) vector_projection_state();
+  if (state == nullptr) {
+    error_msg_oom("vector_project");
+    return true;
+  }
+  if (args->args[0] != nullptr) {
+    try {
+      state->matrix =
+          projections->find(std::string(args->args[0], args->lengths[0]));
+    } catch (const std::bad_alloc &) {
+      delete state;
+      error_msg_oom("vector_project");
+      return true;
+    }
+  }
+  if (vector_constant_init(&state->vector, args, 1, "vector_project")) {
+    delete state;
+    return true;
+  }
+  initid->ptr = reinterpret_cast<char *>(state);
+  initid->maybe_null = true;
+  return false;
+}
+
+static void vector_project_udf_deinit(UDF_INIT *initid) {
+  delete reinterpret_cast<vector_projection_state *>(initid->ptr);
+  initid->ptr = nullptr;
+}
+
+const char *vector_project_udf(UDF_INIT *initid, UDF_ARGS *args, char *,
+                               unsigned long *length, char *is_null,
+                               char *error) {
+  vector_projection_state *state =
+      reinterpret_cast<vector_projection_state *>(initid->ptr);
+  *error = 0;
+  *is_null = 0;
+
+  if (args->args[0] == nullptr || args->args[1] == nullptr) {
+    *is_null = 1;
+    return 0;
+  }
+
+  std::shared_ptr<const vector_projection::matrix> matrix = state->matrix;
+  if (matrix == nullptr) {
+    try {
+      matrix = projections->find(std::string(args->args[0], args->lengths[0]));
+    } catch (const std::bad_alloc &) {
+      error_msg_oom("vector_project");
+      *error = 1;
+      *is_null = 1;
+      return 0;
+    }
+  }
+
+  const char *message = nullptr;
+  const char *elements;
+  uint32_t vec_dim = float_vector_operand(state->vector, args, 1, &elements);
+  if (matrix == nullptr) {
+    message = "no projection with this name";
+  } else if (vec_dim == UINT32_MAX) {
+    message = "Invalid vector";
+  } else if (vec_dim != matrix->cols()) {
+    udf_error = vector_counters::error_kind::size_mismatch;
+    message = "the vector size does not match the projection";
+  }
+  if (message != nullptr) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_project",
+                                    message);
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  char *result =
+      state->result.reserve(Field_vector::dimension_bytes(matrix->rows()));
+  if (result == nullptr) {
+    error_msg_oom("vector_project");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  if (vector_status_error(matrix->project(elements, result),
+                          "vector_project")) {
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  *length = Field_vector::dimension_bytes(matrix->rows());
+  return result;
+}
+
+// UDF removing a projection matrix: VECTOR_PROJECTION_DROP(name)
+
+static bool vector_projection_drop_udf_init(UDF_INIT *initid, UDF_ARGS *args,
+                                            char *) {
+  if (args->arg_count != 1) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_projection_drop",
+                                    "this function requires 1 parameter");
+    return true;
+  }
+  args->arg_type[0] = STRING_RESULT;
+  initid->maybe_null = true;
+  return false;
+}
+
+long long vector_projection_drop_udf(UDF_INIT *, UDF_ARGS *args,
+                                     char *is_null, char *error) {
+  *error = 0;
+  *is_null = 0;
+  if (args->args[0] == nullptr) {
+    *is_null = 1;
+    return 0;
+  }
+  try {
+    return projections->drop(std::string(args->args[0], args->lengths[0]))
+               ? 0
+               : 1;
+  } catch (const std::bad_alloc &) {
+    error_msg_oom("vector_projection_drop");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+}
+
+// UDF registering a named vector: VECTOR_REGISTER(name, v)
+
+static constexpr unsigned long max_vector_name_length = 64;
+
+static bool vector_register_udf_init(UDF_INIT *initid, UDF_ARGS *args,
+                                     char *) {
+  if (args->arg_count != 2) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_register",
+                                    "this function requires 2 parameters");
+    return true;
+  }
+  args->arg_type[0] = STRING_RESULT;
+  initid->maybe_null = true;
+  return false;
+}
+
+long long vector_register_udf(UDF_INIT *, UDF_ARGS *args, char *is_null,
+                              char *error) {
+  *error = 0;
+  *is_null = 0;
+
+  const char *message = nullptr;
+  vector_kernels::element_type type;
+  const char *elements = nullptr;
+  uint32_t vec_dim =
+      args->args[1] == nullptr
+          ? UINT32_MAX
+          : vector_decode(args->args[1], args->lengths[1], &type, &elements);
+  if (args->args[0] == nullptr || args->lengths[0] == 0 ||
+      args->lengths[0] > max_vector_name_length) {
+    message = "invalid vector name";
+  } else if (vec_dim == UINT32_MAX ||
+             type != vector_kernels::element_type::fp32) {
+    message = "Invalid vector";
+  }
+  if (message != nullptr) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_register",
+                                    message);
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  try {
+    std::shared_ptr<vector_registry::entry> registered =
+        std::make_shared<vector_registry::entry>();
+    registered->value.assign(args->args[1], args->args[1] + args->lengths[1]);
+    registered->elements = elements - args->args[1];
+    registered->vec_dim = vec_dim;
+    const char *data = registered->data();
+    registered->norm_squared =
+        vector_is_normalized(args->args[1], args->lengths[1])
+            ? 1
+            : vector_kernels::active().dot(vec_dim, data, data);
+    for (uint32_t i = 0; i < vec_dim; i++) {
+      float value;
+      memcpy(&value, data + i * sizeof(float), sizeof(float));
+      registered->has_zero |= (value == 0);
+    }
+    registered_vectors->store(std::string(args->args[0], args->lengths[0]),
+                              std::move(registered));
+  } catch (const std::bad_alloc &) {
+    error_msg_oom("vector_register");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  return 1;
+}
+
+// UDF returning a registered vector, NULL if there is none: VECTOR_GET(name)
+
+static bool vector_get_udf_init(UDF_INIT *initid, UDF_ARGS *args, char *) {
+  if (args->arg_count != 1) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_get",
+                                    "this function requires 1 parameter");
+    return true;
+  }
+  args->arg_type[0] = STRING_RESULT;
+
+  /* The vector returned last, held until the next row. */
+  std::shared_ptr<const vector_registry::entry> *returned =
+      new (std::nothrow) std::shared_ptr<const vector_registry::entry>();
+  if (returned == nullptr) {
+    error_msg_oom("vector_get");
+    return true;
+  }
+  initid->ptr = reinterpret_cast<char *>(returned);
+  initid->maybe_null = true;
+  return false;
+}
+
+static void vector_get_udf_deinit(UDF_INIT *initid) {
+  delete reinterpret_cast<std::shared_ptr<const vector_registry::entry> *>(
+      initid->ptr);
+  initid->ptr = nullptr;
+}
+
+const char *vector_get_udf(UDF_INIT *initid, UDF_ARGS *args, char *,
+                           unsigned long *length, char *is_null,
+                           char *error) {
+  std::shared_ptr<const vector_registry::entry> *returned =
+      reinterpret_cast<std::shared_ptr<const vector_registry::entry> *>(
+          initid->ptr);
+  *error = 0;
+  *is_null = 0;
+
+  if (args->args[0] == nullptr) {
+    *is_null = 1;
+    return 0;
+  }
+  try {
+    *returned = registered_vectors->find(
+        std::string(args->args[0], args->lengths[0]));
+  } catch (const std::bad_alloc &) {
+    error_msg_oom("vector_get");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  if (*returned == nullptr) {
+    *is_null = 1;
+    return 0;
+  }
+  *length = (*returned)->value.size();
+  return (*returned)->value.data();
+}
+
+// UDF removing a registered vector: VECTOR_UNREGISTER(name)
+
+static bool vector_unregister_udf_init(UDF_INIT *initid, UDF_ARGS *args,
+                                       char *) {
+  if (args->arg_count != 1) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_unregister",
+                                    "this function requires 1 parameter");
+    return true;
+  }
+  args->arg_type[0] = STRING_RESULT;
+  initid->maybe_null = true;
+  return false;
+}
+
+long long vector_unregister_udf(UDF_INIT *, UDF_ARGS *args, char *is_null,
+                                char *error) {
+  *error = 0;
+  *is_null = 0;
+  if (args->args[0] == nullptr) {
+    *is_null = 1;
+    return 0;
+  }
+  try {
+    return registered_vectors->drop(
+               std::string(args->args[0], args->lengths[0]))
+               ? 0
+               : 1;
+  } catch (const std::bad_alloc &) {
+    error_msg_oom("vector_unregister");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+}
+
+// UDF to quantize a vector: VECTOR_QUANTIZE(v [, 'INT8' | 'BINARY'])
+
+struct vector_quantized {
+  vector_result result;
+  vector_quantization::format format = vector_quantization::format::int8;
+};
+
+static bool vector_quantize_udf_init(UDF_INIT *initid, UDF_ARGS *args,
+                                     char *) {
+  if (args->arg_count < 1 || args->arg_count > 2) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_quantize",
+                                    "this function requires 1 or 2 parameters");
+    return true;
+  }
+
+  vector_quantization::format format = vector_quantization::format::int8;
+  if (args->arg_count == 2 &&
+      (args->arg_type[1] != STRING_RESULT || args->args[1] == nullptr ||
+       vector_quantization::format_from_name(args->args[1], args->lengths[1],
+                                             &format))) {
+    mysql_error_service_emit_printf(
+        mysql_service_mysql_runtime_error, ER_UDF_ERROR, 0, "vector_quantize",
+        "format must be a constant 'INT8' or 'BINARY'");
+    return true;
+  }
+
+  vector_quantized *state = new (std::nothrow) vector_quantized();
+  if (state == nullptr) {
+    error_msg_oom("vector_quantize");
+    return true;
+  }
+  state->format = format;
+  initid->ptr = reinterpret_cast<char *>(state);
+  initid->maybe_null = true;
+  return false;
+}
+
+static void vector_quantize_udf_deinit(UDF_INIT *initid) {
+  delete reinterpret_cast<vector_quantized *>(initid->ptr);
+  initid->ptr = nullptr;
+}
+
+const char *vector_quantize_udf(UDF_INIT *initid, UDF_ARGS *args, char *,
+                                unsigned long *length, char *is_null,
+                                char *error) {
+  vector_quantized *state = reinterpret_cast<vector_quantized *>(initid->ptr);
+  *error = 0;
+  *is_null = 0;
+
+  if (args->args[0] == nullptr) {
+    *is_null = 1;
+    return 0;
+  }
+  uint32_t vec_dim = float_vector_dimensions(args->args[0], args->lengths[0]);
+  if (vec_dim == UINT32_MAX) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_quantize",
+                                    "Invalid vector");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  const bool binary = state->format == vector_quantization::format::binary;
+  size_t bytes = binary ? vector_quantization::binary_bytes(vec_dim)
+                        : vector_quantization::int8_bytes(vec_dim);
+  char *result = state->result.reserve(bytes);
+  if (result == nullptr) {
+    error_msg_oom("vector_quantize");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  if (binary) {
+    vector_quantization::quantize_binary(vec_dim, args->args[0], result);
+  } else if (vector_quantization::quantize_int8(vec_dim, args->args[0],
+                                                result)) {
+    vector_status_error(vector_kernels::op_status::out_of_range,
+                        "vector_quantize");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  *length = bytes;
+  return result;
+}
+
+/*
+  Returns the dimension of the int8 code argument `arg`, or UINT32_MAX if it
+  is not a valid code.
+*/
+static uint32_t vector_int8_dimensions(UDF_ARGS *args, unsigned int arg) {
+  if (args->args[arg] == nullptr) return UINT32_MAX;
+  uint32_t vec_dim = vector_quantization::int8_dimensions(args->lengths[arg]);
+  if (vec_dim > Field_vector::max_dimensions) return UINT32_MAX;
+  return vec_dim;
+}
+
+// UDF to decode an int8 code back to a vector: VECTOR_DEQUANTIZE(code)
+
+static bool vector_dequantize_udf_init(UDF_INIT *initid, UDF_ARGS *args,
+                                       char *) {
+  if (args->arg_count != 1) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_dequantize",
+                                    "this function requires 1 parameter");
+    return true;
+  }
+  vector_result *result = new (std::nothrow) vector_result();
+  if (result == nullptr) {
+    error_msg_oom("vector_dequantize");
+    return true;
+  }
+  initid->ptr = reinterpret_cast<char *>(result);
+  initid->maybe_null = true;
+  return false;
+}
+
+static void vector_dequantize_udf_deinit(UDF_INIT *initid) {
+  delete reinterpret_cast<vector_result *>(initid->ptr);
+  initid->ptr = nullptr;
+}
+
+const char *vector_dequantize_udf(UDF_INIT *initid, UDF_ARGS *args, char *,
+                                  unsigned long *length, char *is_null,
+                                  char *error) {
+  *error = 0;
+  *is_null = 0;
+
+  if (args->args[0] == nullptr) {
+    *is_null = 1;
+    return 0;
+  }
+  uint32_t vec_dim = vector_int8_dimensions(args, 0);
+  if (vec_dim == UINT32_MAX) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_dequantize",
+                                    "Invalid int8 code");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  vector_result *buffer = reinterpret_cast<vector_result *>(initid->ptr);
+  char *result = buffer->reserve(Field_vector::dimension_bytes(vec_dim));
+  if (result == nullptr) {
+    error_msg_oom("vector_dequantize");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  vector_quantization::dequantize_int8(vec_dim, args->args[0], result);
+  *length = Field_vector::dimension_bytes(vec_dim);
+  return result;
+}
+
+/* Init callback of the code distance UDFs, which keep no state. */
+static bool vector_code_udf_init(UDF_INIT *initid, UDF_ARGS *args,
+                                 const char *udf_name) {
+  if (vector_args_check(args, udf_name)) return true;
+  initid->maybe_null = true;
+  return false;
+}
+
+/*
+  Returns the common dimension of the two int8 code arguments in vec_dim;
+  returns true after reporting the error if they are invalid.
+*/
+static bool vector_int8_operands(UDF_ARGS *args, const char *udf_name,
+                                 uint32_t *vec_dim, char *is_null,
+                                 char *error) {
+  *error = 0;
+  *is_null = 0;
+  uint32_t dim_code1 = vector_int8_dimensions(args, 0);
+  uint32_t dim_code2 = vector_int8_dimensions(args, 1);
+  if (dim_code1 != dim_code2 || dim_code1 == UINT32_MAX) {
+    udf_error = vector_counters::error_kind::size_mismatch;
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, udf_name,
+                                    "both int8 codes must have the same size");
+    *error = 1;
+    *is_null = 1;
+    return true;
+  }
+  *vec_dim = dim_code1;
+  return false;
+}
+
+// UDF to implement the dot product of two int8 codes
+
+static bool vector_int8_dot_udf_init(UDF_INIT *initid, UDF_ARGS *args,
+                                     char *) {
+  return vector_code_udf_init(initid, args, "vector_int8_dot");
+}
+
+double vector_int8_dot_udf(UDF_INIT *, UDF_ARGS *args, char *is_null,
+                           char *error) {
+  uint32_t vec_dim = 0;
+  if (vector_int8_operands(args, "vector_int8_dot", &vec_dim, is_null, error))
+    return 0;
+  return vector_quantization::int8_dot(vec_dim, args->args[0], args->args[1]);
+}
+
+// UDF to implement the euclidean (L2) distance of two int8 codes
+
+static bool vector_int8_l2_udf_init(UDF_INIT *initid, UDF_ARGS *args,
+                                    char *) {
+  return vector_code_udf_init(initid, args, "vector_int8_l2");
+}
+
+double vector_int8_l2_udf(UDF_INIT *, UDF_ARGS *args, char *is_null,
+                          char *error) {
+  uint32_t vec_dim = 0;
+  if (vector_int8_operands(args, "vector_int8_l2", &vec_dim, is_null, error))
+    return 0;
+  return std::sqrt(vector_quantization::int8_l2_squared(
+      vec_dim, args->args[0], args->args[1]));
+}
+
+// UDF to implement the Hamming distance of two binary codes
+
+static bool vector_hamming_udf_init(UDF_INIT *initid, UDF_ARGS *args,
+                                    char *) {
+  return vector_code_udf_init(initid, args, "vector_hamming");
+}
+
+long long vector_hamming_udf(UDF_INIT *, UDF_ARGS *args, char *is_null,
+                             char *error) {
+  *error = 0;
+  *is_null = 0;
+  if (args->args[0] == nullptr || args->args[1] == nullptr ||
+      args->lengths[0] != args->lengths[1] || args->lengths[0] == 0) {
+    udf_error = vector_counters::error_kind::size_mismatch;
+    mysql_error_service_emit_printf(
+        mysql_service_mysql_runtime_error, ER_UDF_ERROR, 0, "vector_hamming",
+        "both binary codes must have the same size");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  return static_cast<long long>(vector_kernels::active().hamming(
+      args->lengths[0], args->args[0], args->args[1]));
+}
+
+// Aggregate UDF training the product quantization codebook of the vectors
+// of a group: VECTOR_PQ_TRAIN(v, m)
+
+struct vector_pq_train {
+  uint32_t m = 0;
+  vector_pq::trainer trainer;
+  std::vector<char> result;
+  bool failed = false;
+};
+
+static bool vector_pq_train_udf_init(UDF_INIT *initid, UDF_ARGS *args,
+                                     char *) {
+  if (args->arg_count != 2) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_pq_train",
+                                    "this function requires 2 parameters");
+    return true;
+  }
+  args->arg_type[1] = INT_RESULT;
+
+  long long m =
+      args->args[1] ? *reinterpret_cast<long long *>(args->args[1]) : 0;
+  if (m < 1 || m > Field_vector::max_dimensions) {
+    mysql_error_service_emit_printf(
+        mysql_service_mysql_runtime_error, ER_UDF_ERROR, 0, "vector_pq_train",
+        "m must be a constant between 1 and the vector dimension");
+    return true;
+  }
+
+  vector_pq_train *train = new (std::nothrow) vector_pq_train();
+  if (train == nullptr) {
+    error_msg_oom("vector_pq_train");
+    return true;
+  }
+  train->m = static_cast<uint32_t>(m);
+  initid->ptr = reinterpret_cast<char *>(train);
+  initid->maybe_null = true;
+  return false;
+}
+
+static void vector_pq_train_udf_deinit(UDF_INIT *initid) {
+  delete reinterpret_cast<vector_pq_train *>(initid->ptr);
+  initid->ptr = nullptr;
+}
+
+static void vector_pq_train_clear(UDF_INIT *initid, unsigned char *,
+                                  unsigned char *) {
+  vector_pq_train *train = reinterpret_cast<vector_pq_train *>(initid->ptr);
+  train->trainer.reset();
+  train->failed = false;
+}
+
+static void vector_pq_train_add(UDF_INIT *initid, UDF_ARGS *args,
+                                unsigned char *, unsigned char *error) {
+  vector_pq_train *train = reinterpret_cast<vector_pq_train *>(initid->ptr);
+  if (train->failed || args->args[0] == nullptr) return;
+
+  const char *elements;
+  uint32_t vec_dim = float_vector_operand(args, 0, &elements);
+  if (vec_dim == UINT32_MAX || vec_dim < train->m ||
+      vec_dim % train->m != 0 ||
+      (train->trainer.started() && vec_dim != train->trainer.dimensions())) {
+    udf_error = vector_counters::error_kind::size_mismatch;
+    mysql_error_service_emit_printf(
+        mysql_service_mysql_runtime_error, ER_UDF_ERROR, 0, "vector_pq_train",
+        "all vectors must have the same size, a multiple of m");
+    train->failed = true;
+    *error = 1;
+    return;
+  }
+
+  try {
+    if (!train->trainer.started())
+      train->trainer.start(vec_dim, train->m, kmeans_sample_bytes());
+    train->trainer.add(elements);
+  } catch (const std::bad_alloc &) {
+    error_msg_oom("vector_pq_train");
+    train->failed = true;
+    *error = 1;
+  }
+}
+
+const char *vector_pq_train_udf(UDF_INIT *initid, UDF_ARGS *, char *,
+                                unsigned long *length, char *is_null,
+                                char *error) {
+  vector_pq_train *train = reinterpret_cast<vector_pq_train *>(initid->ptr);
+  *error = 0;
+  *is_null = 0;
+
+  if (train->failed) {
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  if (!train->trainer.started()) {
+    *is_null = 1;
+    return 0;
+  }
+
+  try {
+    train->trainer.finish(workers, &train->result);
+  } catch (const std::bad_alloc &) {
+    error_msg_oom("vector_pq_train");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  *length = train->result.size();
+  return train->result.data();
+}
+
+/*
+  Parses the codebook argument `arg`; returns true after reporting the error
+  if it is not a valid codebook.
+*/
+static bool vector_pq_codebook(UDF_ARGS *args, unsigned int arg,
+                               const char *udf_name,
+                               vector_pq::codebook *codebook) {
+  if (!codebook->parse(args->args[arg], args->lengths[arg])) return false;
+  mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                  ER_UDF_ERROR, 0, udf_name,
+                                  "Invalid product quantization codebook");
+  return true;
+}
+
+/* Reports that a vector does not match the dimension of the codebook. */
+static void vector_pq_size_error(const char *udf_name) {
+  udf_error = vector_counters::error_kind::size_mismatch;
+  mysql_error_service_emit_printf(
+      mysql_service_mysql_runtime_error, ER_UDF_ERROR, 0, udf_name,
+      "the vector size does not match the codebook");
+}
+
+// UDF encoding a vector with a product quantization codebook:
+// VECTOR_PQ_ENCODE(codebook, v)
+
+static bool vector_pq_encode_udf_init(UDF_INIT *initid, UDF_ARGS *args,
+                                      char *) {
+  if (args->arg_count != 2) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_pq_encode",
+                                    "this function requires 2 parameters");
+    return true;
+  }
+  vector_result *result = new (std::nothrow) vector_result();
+  if (result == nullptr) {
+    error_msg_oom("vector_pq_encode");
+    return true;
+  }
+  initid->ptr = reinterpret_cast<char *>(result);
+  initid->maybe_null = true;
+  return false;
+}
+
+static void vector_pq_encode_udf_deinit(UDF_INIT *initid) {
+  delete reinterpret_cast<vector_result *>(initid->ptr);
+  initid->ptr = nullptr;
+}
+
+const char *vector_pq_encode_udf(UDF_INIT *initid, UDF_ARGS *args, char *,
+                                 unsigned long *length, char *is_null,
+                                 char *error) {
+  vector_result *result_buffer = reinterpret_cast<vector_result *>(initid->ptr);
+  *error = 0;
+  *is_null = 0;
+
+  if (args->args[0] == nullptr || args->args[1] == nullptr) {
+    *is_null = 1;
+    return 0;
+  }
+  vector_pq::codebook codebook;
+  if (vector_pq_codebook(args, 0, "vector_pq_encode", &codebook)) {
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  const char *elements;
+  if (float_vector_operand(args, 1, &elements) != codebook.dimensions()) {
+    vector_pq_size_error("vector_pq_encode");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  char *result = result_buffer->reserve(codebook.subspaces());
+  if (result == nullptr) {
+    error_msg_oom("vector_pq_encode");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  codebook.encode(elements, reinterpret_cast<unsigned char *>(result));
+  *length = codebook.subspaces();
+  return result;
+}
+
+// UDF estimating the L2 distance of a query vector to a product
+// quantization code: VECTOR_PQ_DISTANCE(codebook, query, code)
+
+/*
+  Per-statement state of VECTOR_PQ_DISTANCE: the distance table of the
+  query, computed once in the init callback if the codebook and the query
+  are constant, else for every row.
+*/
+struct vector_pq_distance {
+  std::vector<float> table;
+  uint32_t m = 0;
+  bool constant = false;
+  vector_constant query;  // if constant or named
+};
+
+/*
+  Computes the distance table of the query argument with the codebook
+  argument in `state`; returns true after reporting the error.
+*/
+static bool vector_pq_distance_table(vector_pq_distance *state,
+                                     UDF_ARGS *args) {
+  vector_pq::codebook codebook;
+  if (vector_pq_codebook(args, 0, "vector_pq_distance", &codebook))
+    return true;
+  const char *query;
+  if (float_vector_operand(state->query, args, 1, &query) !=
+      codebook.dimensions()) {
+    vector_pq_size_error("vector_pq_distance");
+    return true;
+  }
+  try {
+    state->table.resize(size_t{codebook.subspaces()} *
+                        vector_pq::max_centroids);
+  } catch (const std::bad_alloc &) {
+    error_msg_oom("vector_pq_distance");
+    return true;
+  }
+  codebook.distance_table(query, state->table.data());
+  state->m = codebook.subspaces();
+  return false;
+}
+
+static bool vector_pq_distance_udf_init(UDF_INIT *initid, UDF_ARGS *args,
+                                        char *) {
+  if (args->arg_count != 3) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_pq_distance",
+                                    "this function requires 3 parameters");
+    return true;
+  }
+  vector_pq_distance *state = new (std::nothrow) vector_pq_distance();
+  if (state == nullptr) {
+    error_msg_oom("vector_pq_distance");
+    return true;
+  }
+  if (vector_constant_init(&state->query, args, 1, "vector_pq_distance")) {
+    delete state;
+    return true;
+  }
+  if (args->args[0] != nullptr && args->args[1] != nullptr) {
+    if (vector_pq_distance_table(state, args)) {
+      delete state;
+      return true;
+    }
+    state->constant = true;
+  }
+  initid->ptr = reinterpret_cast<char *>(state);
+  initid->maybe_null = true;
+  return false;
+}
+
+static void vector_pq_distance_udf_deinit(UDF_INIT *initid) {
+  delete reinterpret_cast<vector_pq_distance *>(initid->ptr);
+  initid->ptr = nullptr;
+}
+
+double vector_pq_distance_udf(UDF_INIT *initid, UDF_ARGS *args, char *is_null,
+                              char *error) {
+  vector_pq_distance *state =
+      reinterpret_cast<vector_pq_distance *>(initid->ptr);
+  *error = 0;
+  *is_null = 0;
+
+  if (args->args[0] == nullptr || args->args[1] == nullptr ||
+      args->args[2] == nullptr) {
+    *is_null = 1;
+    return 0;
+  }
+  if (!state->constant && vector_pq_distance_table(state, args)) {
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  if (args->lengths[2] != state->m) {
+    udf_error = vector_counters::error_kind::size_mismatch;
+    mysql_error_service_emit_printf(
+        mysql_service_mysql_runtime_error, ER_UDF_ERROR, 0,
+        "vector_pq_distance", "the code size does not match the codebook");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  return std::sqrt(vector_pq::adc_distance(
+      state->table.data(), state->m,
+      reinterpret_cast<const unsigned char *>(args->args[2])));
+}
+
+/*
+  The UDFs below build and compute on the sparse vectors of
+  vector_sparse.h. They share a result buffer as state.
+*/
+
+static bool vector_sparse_state_init(UDF_INIT *initid, UDF_ARGS *args,
+                                     const char *udf_name,
+                                     unsigned int arg_count) {
+  if (args->arg_count != arg_count) {
+    mysql_error_service_emit_printf(
+        mysql_service_mysql_runtime_error, ER_UDF_ERROR, 0, udf_name,
+        arg_count == 1 ? "this function requires 1 parameter"
+                       : "this function requires 2 parameters");
+    return true;
+  }
+  vector_result *result = new (std::nothrow) vector_result();
+  if (result == nullptr) {
+    error_msg_oom(udf_name);
+    return true;
+  }
+  initid->ptr = reinterpret_cast<char *>(result);
+  initid->maybe_null = true;
+  return false;
+}
+
+static void vector_sparse_state_deinit(UDF_INIT *initid) {
+  delete reinterpret_cast<vector_result *>(initid->ptr);
+  initid->ptr = nullptr;
+}
+
+/*
+  Reads the sparse vector argument `arg`; returns true after reporting the
+  error if it is not one.
+*/
+static bool vector_sparse_operand(UDF_ARGS *args, unsigned int arg,
+                                  const char *udf_name,
+                                  vector_sparse::view *v) {
+  if (!v->parse(args->args[arg], args->lengths[arg])) return false;
+  mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                  ER_UDF_ERROR, 0, udf_name,
+                                  "Invalid sparse vector");
+  return true;
+}
+
+// UDF building a sparse vector from a JSON object of its non-zero elements:
+// VECTOR_SPARSE(dimensions, '{"index": value, ...}')
+
+static bool vector_sparse_udf_init(UDF_INIT *initid, UDF_ARGS *args,
+                                   char *) {
+  if (vector_sparse_state_init(initid, args, "vector_sparse", 2)) return true;
+  args->arg_type[0] = INT_RESULT;
+  args->arg_type[1] = STRING_RESULT;
+  return false;
+}
+
+const char *vector_sparse_udf(UDF_INIT *initid, UDF_ARGS *args, char *,
+                              unsigned long *length, char *is_null,
+                              char *error) {
+  vector_result *result_buffer = reinterpret_cast<vector_result *>(initid->ptr);
+  *error = 0;
+  *is_null = 0;
+
+  if (args->args[0] == nullptr || args->args[1] == nullptr) {
+    *is_null = 1;
+    return 0;
+  }
+  long long dimensions = *reinterpret_cast<long long *>(args->args[0]);
+  if (dimensions < 1 || dimensions > vector_sparse::max_dimensions) {
+    mysql_error_service_emit_printf(
+        mysql_service_mysql_runtime_error, ER_UDF_ERROR, 0, "vector_sparse",
+        "dimensions must be between 1 and 2147483647");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  std::vector<std::pair<uint32_t, float>> pairs;
+  bool invalid;
+  try {
+    invalid = vector_sparse::parse_text(args->args[1], args->lengths[1],
+                                        static_cast<uint32_t>(dimensions),
+                                        &pairs);
+  } catch (const std::bad_alloc &) {
+    error_msg_oom("vector_sparse");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  if (invalid) {
+    mysql_error_service_emit_printf(
+        mysql_service_mysql_runtime_error, ER_UDF_ERROR, 0, "vector_sparse",
+        "the text must be a JSON object of distinct indexes below the "
+        "dimensions and of finite values");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  const uint32_t nnz = static_cast<uint32_t>(pairs.size());
+  char *result = result_buffer->reserve(vector_sparse::sparse_bytes(nnz));
+  if (result == nullptr) {
+    error_msg_oom("vector_sparse");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  vector_sparse::writer w(result, static_cast<uint32_t>(dimensions), nnz);
+  for (const std::pair<uint32_t, float> &element : pairs)
+    w.append(element.first, element.second);
+  *length = w.finish();
+  return result;
+}
+
+// UDF converting a vector to a sparse vector: VECTOR_TO_SPARSE(v)
+
+static bool vector_to_sparse_udf_init(UDF_INIT *initid, UDF_ARGS *args,
+                                      char *) {
+  return vector_sparse_state_init(initid, args, "vector_to_sparse", 1);
+}
+
+const char *vector_to_sparse_udf(UDF_INIT *initid, UDF_ARGS *args, char *,
+                                 unsigned long *length, char *is_null,
+                                 char *error) {
+  vector_result *result_buffer = reinterpret_cast<vector_result *>(initid->ptr);
+  *error = 0;
+  *is_null = 0;
+
+  if (args->args[0] == nullptr) {
+    *is_null = 1;
+    return 0;
+  }
+  vector_kernels::element_type type;
+  const char *elements;
+  uint32_t vec_dim =
+      vector_decode(args->args[0], args->lengths[0], &type, &elements);
+  if (vec_dim == UINT32_MAX) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_to_sparse",
+                                    "Invalid vector");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  if (vector_float_only(type, "vector_to_sparse")) {
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  char *result = result_buffer->reserve(vector_sparse::sparse_bytes(
+      vector_sparse::count_nonzero(vec_dim, elements)));
+  if (result == nullptr) {
+    error_msg_oom("vector_to_sparse");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  *length = vector_sparse::from_dense(vec_dim, elements, result);
+  return result;
+}
+
+// UDF converting a sparse vector to a vector: VECTOR_SPARSE_TO_DENSE(s)
+
+static bool vector_sparse_to_dense_udf_init(UDF_INIT *initid, UDF_ARGS *args,
+                                            char *) {
+  return vector_sparse_state_init(initid, args, "vector_sparse_to_dense", 1);
+}
+
+const char *vector_sparse_to_dense_udf(UDF_INIT *initid, UDF_ARGS *args,
+                                       char *, unsigned long *length,
+                                       char *is_null, char *error) {
+  vector_result *result_buffer = reinterpret_cast<vector_result *>(initid->ptr);
+  *error = 0;
+  *is_null = 0;
+
+  if (args->args[0] == nullptr) {
+    *is_null = 1;
+    return 0;
+  }
+  vector_sparse::view v;
+  if (vector_sparse_operand(args, 0, "vector_sparse_to_dense", &v)) {
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  if (v.dimensions > Field_vector::max_dimensions) {
+    udf_error = vector_counters::error_kind::size_mismatch;
+    mysql_error_service_emit_printf(
+        mysql_service_mysql_runtime_error, ER_UDF_ERROR, 0,
+        "vector_sparse_to_dense",
+        "the sparse vector has more dimensions than a VECTOR");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  char *result =
+      result_buffer->reserve(Field_vector::dimension_bytes(v.dimensions));
+  if (result == nullptr) {
+    error_msg_oom("vector_sparse_to_dense");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  vector_sparse::to_dense(v, result);
+  *length = Field_vector::dimension_bytes(v.dimensions);
+  return result;
+}
+
+// UDF writing a sparse vector as a JSON object: VECTOR_SPARSE_TO_TEXT(s)
+
+static bool vector_sparse_to_text_udf_init(UDF_INIT *initid, UDF_ARGS *args,
+                                           char *) {
+  if (vector_sparse_state_init(initid, args, "vector_sparse_to_text", 1))
+    return true;
+  if (mysql_service_mysql_udf_metadata->result_set(
+          initid, "charset", const_cast<char *>("utf8mb4"))) {
+    vector_sparse_state_deinit(initid);
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_sparse_to_text",
+                                    "unable to set the result charset");
+    return true;
+  }
+  return false;
+}
+
+const char *vector_sparse_to_text_udf(UDF_INIT *initid, UDF_ARGS *args,
+                                      char *, unsigned long *length,
+                                      char *is_null, char *error) {
+  vector_result *result_buffer = reinterpret_cast<vector_result *>(initid->ptr);
+  *error = 0;
+  *is_null = 0;
+
+  if (args->args[0] == nullptr) {
+    *is_null = 1;
+    return 0;
+  }
+  vector_sparse::view v;
+  if (vector_sparse_operand(args, 0, "vector_sparse_to_text", &v)) {
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  char *result = result_buffer->reserve(vector_sparse::max_text_bytes(v.nnz));
+  if (result == nullptr) {
+    error_msg_oom("vector_sparse_to_text");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  *length = vector_sparse::to_text(v, result);
+  return result;
+}
+
+// UDF adding two sparse vectors: VECTOR_SPARSE_ADD(s1, s2)
+
+static bool vector_sparse_add_udf_init(UDF_INIT *initid, UDF_ARGS *args,
+                                       char *) {
+  return vector_sparse_state_init(initid, args, "vector_sparse_add", 2);
+}
+
+const char *vector_sparse_add_udf(UDF_INIT *initid, UDF_ARGS *args, char *,
+                                  unsigned long *length, char *is_null,
+                                  char *error) {
+  vector_result *result_buffer = reinterpret_cast<vector_result *>(initid->ptr);
+  *error = 0;
+  *is_null = 0;
+
+  if (args->args[0] == nullptr || args->args[1] == nullptr) {
+    *is_null = 1;
+    return 0;
+  }
+  vector_sparse::view a, b;
+  if (vector_sparse_operand(args, 0, "vector_sparse_add", &a) ||
+      vector_sparse_operand(args, 1, "vector_sparse_add", &b)) {
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  if (a.dimensions != b.dimensions) {
+    error_msg_size();
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  char *result =
+      result_buffer->reserve(vector_sparse::sparse_bytes(a.nnz + b.nnz));
+  if (result == nullptr) {
+    error_msg_oom("vector_sparse_add");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  size_t bytes = vector_sparse::add(a, b, result);
+  if (bytes == SIZE_MAX) {
+    vector_status_error(vector_kernels::op_status::out_of_range,
+                        "vector_sparse_add");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  *length = bytes;
+  return result;
+}
+
+// UDF multiplying a sparse vector by a scalar: VECTOR_SPARSE_SCALE(s, x)
+
+static bool vector_sparse_scale_udf_init(UDF_INIT *initid, UDF_ARGS *args,
+                                         char *) {
+  if (vector_sparse_state_init(initid, args, "vector_sparse_scale", 2))
+    return true;
+  args->arg_type[1] = REAL_RESULT;
+  return false;
+}
+
+const char *vector_sparse_scale_udf(UDF_INIT *initid, UDF_ARGS *args, char *,
+                                    unsigned long *length, char *is_null,
+                                    char *error) {
+  vector_result *result_buffer = reinterpret_cast<vector_result *>(initid->ptr);
+  *error = 0;
+  *is_null = 0;
+
+  float s;
+  if (args->args[0] == nullptr || vector_scalar_arg(args, 1, &s)) {
+    *is_null = 1;
+    return 0;
+  }
+  vector_sparse::view v;
+  if (vector_sparse_operand(args, 0, "vector_sparse_scale", &v)) {
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  char *result = result_buffer->reserve(vector_sparse::sparse_bytes(v.nnz));
+  if (result == nullptr) {
+    error_msg_oom("vector_sparse_scale");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  size_t bytes = vector_sparse::scale(v, s, result);
+  if (bytes == SIZE_MAX) {
+    vector_status_error(vector_kernels::op_status::out_of_range,
+                        "vector_sparse_scale");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  *length = bytes;
+  return result;
+}
+
+// UDF computing the dot product of a sparse vector with a sparse or dense
+// vector: VECTOR_SPARSE_DOT(s, v)
+
+static bool vector_sparse_dot_udf_init(UDF_INIT *initid, UDF_ARGS *args,
+                                       char *) {
+  if (args->arg_count != 2) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_sparse_dot",
+                                    "this function requires 2 parameters");
+    return true;
+  }
+  initid->maybe_null = true;
+  return false;
+}
+
+double vector_sparse_dot_udf(UDF_INIT *, UDF_ARGS *args, char *is_null,
+                             char *error) {
+  *error = 0;
+  *is_null = 0;
+
+  if (args->args[0] == nullptr || args->args[1] == nullptr) {
+    *is_null = 1;
+    return 0;
+  }
+  /* The sparse operand first. */
+  const unsigned int sparse_arg =
+      vector_sparse::is_sparse(args->args[0], args->lengths[0]) ? 0 : 1;
+  const unsigned int other_arg = 1 - sparse_arg;
+  vector_sparse::view a;
+  if (vector_sparse_operand(args, sparse_arg, "vector_sparse_dot", &a)) {
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  if (vector_sparse::is_sparse(args->args[other_arg],
+                               args->lengths[other_arg])) {
+    vector_sparse::view b;
+    if (vector_sparse_operand(args, other_arg, "vector_sparse_dot", &b)) {
+      *error = 1;
+      *is_null = 1;
+      return 0;
+    }
+    if (a.dimensions != b.dimensions) {
+      error_msg_size();
+      *error = 1;
+      *is_null = 1;
+      return 0;
+    }
+    return vector_sparse::dot(a, b);
+  }
+
+  vector_kernels::element_type type;
+  const char *dense;
+  uint32_t vec_dim = vector_decode(args->args[other_arg],
+                                   args->lengths[other_arg], &type, &dense);
+  if (vec_dim != a.dimensions) {
+    error_msg_size();
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  if (vector_float_only(type, "vector_sparse_dot")) {
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  return vector_kernels::active().gather_dot(a.nnz, a.indexes, a.values,
+                                             dense);
+}
+
+/*
+  VECTOR_SUM and VECTOR_AVG share their state and the add/clear callbacks;
+  NULL vectors are skipped, as by the built-in SUM and AVG.
+*/
+
+static bool vector_accumulator_init(UDF_INIT *initid, UDF_ARGS *args,
+                                    const char *udf_name) {
+  if (args->arg_count != 1) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, udf_name,
+                                    "this function requires 1 parameter");
+    return true;
+  }
+  vector_accumulator *acc = new (std::nothrow) vector_accumulator();
+  if (acc == nullptr) {
+    error_msg_oom(udf_name);
+    return true;
+  }
+  initid->ptr = reinterpret_cast<char *>(acc);
+  initid->maybe_null = true;
+  return false;
+}
+
+static void vector_accumulator_deinit(UDF_INIT *initid) {
+  delete reinterpret_cast<vector_accumulator *>(initid->ptr);
+  initid->ptr = nullptr;
+}
+
+static void vector_accumulator_clear(UDF_INIT *initid, unsigned char *,
+                                     unsigned char *) {
+  reinterpret_cast<vector_accumulator *>(initid->ptr)->clear();
+}
+
+static void vector_accumulator_add(UDF_INIT *initid, UDF_ARGS *args,
+                                   unsigned char *, unsigned char *error) {
+  vector_accumulator *acc = reinterpret_cast<vector_accumulator *>(initid->ptr);
+  if (acc->failed || args->args[0] == nullptr) return;
+
+  uint32_t vec_dim = float_vector_dimensions(args->args[0], args->lengths[0]);
+  if (vec_dim == UINT32_MAX || (acc->count > 0 && vec_dim != acc->vec_dim)) {
+    error_msg_size();
+    acc->failed = true;
+    *error = 1;
+    return;
+  }
+  if (acc->count == 0 && acc->start(vec_dim)) {
+    error_msg_oom("vector aggregate");
+    acc->failed = true;
+    *error = 1;
+    return;
+  }
+
+  vector_kernels::active().accumulate(vec_dim, args->args[0], acc->sum);
+  acc->count++;
+}
+
+/* Writes sum / divisor as a binary vector; returns nullptr on error. */
+static char *vector_accumulator_result(UDF_INIT *initid, double divisor,
+                                       const char *udf_name,
+                                       unsigned long *length, char *is_null,
+                                       char *error) {
+  vector_accumulator *acc = reinterpret_cast<vector_accumulator *>(initid->ptr);
+  *error = 0;
+  *is_null = 0;
+
+  if (acc->failed) {
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  if (acc->count == 0) {
+    *is_null = 1;
+    return 0;
+  }
+
+  char *result =
+      acc->result.reserve(Field_vector::dimension_bytes(acc->vec_dim));
+  if (result == nullptr) {
+    error_msg_oom(udf_name);
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  bool out_of_range = false;
+  for (uint32_t i = 0; i < acc->vec_dim; i++) {
+    float value = static_cast<float>(acc->sum[i] / divisor);
+    out_of_range |= !std::isfinite(value);
+    memcpy(result + i * sizeof(float), &value, sizeof(float));
+  }
+  if (vector_status_error(out_of_range ? vector_kernels::op_status::out_of_range
+                                       : vector_kernels::op_status::ok,
+                          udf_name)) {
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  *length = Field_vector::dimension_bytes(acc->vec_dim);
+  return result;
+}
+
+// Aggregate UDF to implement the sum of the vectors of a group
+
+static bool vector_sum_udf_init(UDF_INIT *initid, UDF_ARGS *args, char *) {
+  return vector_accumulator_init(initid, args, "vector_sum");
+}
+
+const char *vector_sum_udf(UDF_INIT *initid, UDF_ARGS *, char *,
+                           unsigned long *length, char *is_null,
+                           char *error) {
+  return vector_accumulator_result(initid, 1.0, "vector_sum", length, is_null,
+                                   error);
+}
+
+// Aggregate UDF to implement the average (centroid) of the vectors of a group
+
+static bool vector_avg_udf_init(UDF_INIT *initid, UDF_ARGS *args, char *) {
+  return vector_accumulator_init(initid, args, "vector_avg");
+}
+
+const char *vector_avg_udf(UDF_INIT *initid, UDF_ARGS *, char *,
+                           unsigned long *length, char *is_null,
+                           char *error) {
+  vector_accumulator *acc = reinterpret_cast<vector_accumulator *>(initid->ptr);
+  return vector_accumulator_result(initid, static_cast<double>(acc->count),
+                                   "vector_avg", length, is_null, error);
+}
+
+// Aggregate UDF keeping the k nearest rows of a group to a query vector
+
+/*
+  Per-group state of VECTOR_TOPK(row_id, vector, query_vector, k [, metric]);
+  k and the metric are constant for the statement.
+*/
+struct vector_topk {
+  topk_heap heap;
+  vector_result result;
+  vector_constant query;
+  vector_kernels::metric metric = vector_kernels::metric::l2;
+  bool failed = false;
+};
+
+static constexpr long long max_topk = 10000;
+
+static bool vector_topk_udf_init(UDF_INIT *initid, UDF_ARGS *args, char *) {
+  if (args->arg_count < 4 || args->arg_count > 5) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_topk",
+                                    "this function requires 4 or 5 parameters");
+    return true;
+  }
+  args->arg_type[0] = INT_RESULT;
+  args->arg_type[3] = INT_RESULT;
+
+  long long k = args->args[3] ? *reinterpret_cast<long long *>(args->args[3])
+                              : 0;
+  if (k < 1 || k > max_topk) {
+    mysql_error_service_emit_printf(
+        mysql_service_mysql_runtime_error, ER_UDF_ERROR, 0, "vector_topk",
+        "k must be a constant between 1 and 10000");
+    return true;
+  }
+
+  vector_kernels::metric metric = vector_kernels::metric::l2;
+  if (args->arg_count == 5 &&
+      (args->arg_type[4] != STRING_RESULT || args->args[4] == nullptr ||
+       vector_kernels::metric_from_name(args->args[4], args->lengths[4],
+                                        &metric))) {
+    mysql_error_service_emit_printf(
+        mysql_service_mysql_runtime_error, ER_UDF_ERROR, 0, "vector_topk",
+        "metric must be a constant 'L2', 'COSINE', 'DOT' or 'L1'");
+    return true;
+  }
+
+  vector_topk *topk = new (std::nothrow) vector_topk();
+  if (topk == nullptr || topk->heap.reserve(k)) {
+    delete topk;
+    error_msg_oom("vector_topk");
+    return true;
+  }
+  if (vector_constant_init(&topk->query, args, 2, "vector_topk")) {
+    delete topk;
+    return true;
+  }
+  topk->metric = metric;
+
+  if (mysql_service_mysql_udf_metadata->result_set(
+          initid, "charset", const_cast<char *>("utf8mb4"))) {
+    delete topk;
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_topk",
+                                    "unable to set the result charset");
+    return true;
+  }
+
+  initid->ptr = reinterpret_cast<char *>(topk);
+  initid->maybe_null = true;
+  return false;
+}
+
+static void vector_topk_udf_deinit(UDF_INIT *initid) {
+  delete reinterpret_cast<vector_topk *>(initid->ptr);
+  initid->ptr = nullptr;
+}
+
+static void vector_topk_clear(UDF_INIT *initid, unsigned char *,
+                              unsigned char *) {
+  vector_topk *topk = reinterpret_cast<vector_topk *>(initid->ptr);
+  topk->heap.clear();
+  topk->failed = false;
+}
+
+static void vector_topk_add(UDF_INIT *initid, UDF_ARGS *args, unsigned char *,
+                            unsigned char *error) {
+  vector_topk *topk = reinterpret_cast<vector_topk *>(initid->ptr);
+  if (topk->failed || args->args[0] == nullptr || args->args[1] == nullptr ||
+      args->args[2] == nullptr)
+    return;
+
+  double distance;
+  uint32_t vec_dim = float_vector_dimensions(args->args[1], args->lengths[1]);
+  if (topk->query.data != nullptr) {
+    /* args->args[2] may be the name of the query, not its elements. */
+    if (vec_dim != topk->query.vec_dim) {
+      error_msg_size();
+      topk->failed = true;
+      *error = 1;
+      return;
+    }
+    distance = vector_kernels::distance_to_query(
+        topk->metric, vec_dim, args->args[1], topk->query.data,
+        topk->query.norm_squared);
+  } else {
+    if (vector_dimensions(args, &vec_dim, 1, 2)) {
+      topk->failed = true;
+      *error = 1;
+      return;
+    }
+    distance = vector_kernels::distance(topk->metric, vec_dim, args->args[1],
+                                        args->args[2]);
+  }
+  if (!std::isfinite(distance)) return;
+  topk->heap.push(distance, *reinterpret_cast<long long *>(args->args[0]));
+}
+
+const char *vector_topk_udf(UDF_INIT *initid, UDF_ARGS *, char *,
+                            unsigned long *length, char *is_null,
+                            char *error) {
+  vector_topk *topk = reinterpret_cast<vector_topk *>(initid->ptr);
+  *error = 0;
+  *is_null = 0;
+
+  if (topk->failed) {
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  const std::vector<topk_heap::entry> &neighbors = topk->heap.sorted();
+  if (neighbors.empty()) {
+    *is_null = 1;
+    return 0;
+  }
+
+  char *result = neighbors_to_json(neighbors, &topk->result, length);
+  if (result == nullptr) {
+    error_msg_oom("vector_topk");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  return result;
+}
+
+// UDF computing the distances of a query to a packed batch of vectors:
+// VECTOR_BATCH_DISTANCE(query_vector, vectors [, metric [, k]])
+
+/*
+  Per-statement state of VECTOR_BATCH_DISTANCE; the metric and k are
+  constant. `vectors` is the concatenation of vectors of the query size, as
+  GROUP_CONCAT(v SEPARATOR '') or a stored BLOB. Without k the distances are
+  returned as an array of floats; with k the k nearest vectors, numbered
+  from 0 in the batch, in the JSON format of VECTOR_TOPK. The batch is split
+  over the thread pool, with one heap per participant for the k nearest.
+*/
+struct vector_batch {
+  vector_result result;
+  vector_constant query;
+  std::vector<topk_heap> heaps;
+  vector_kernels::metric metric = vector_kernels::metric::l2;
+  long long k = 0;
+};
+
+/* Bytes of vectors in a chunk of the batch run by a thread. */
+static constexpr uint32_t batch_chunk_bytes = 32768;
+
+static bool vector_batch_distance_udf_init(UDF_INIT *initid, UDF_ARGS *args,
+                                           char *) {
+  if (args->arg_count < 2 || args->arg_count > 4) {
+    mysql_error_service_emit_printf(
+        mysql_service_mysql_runtime_error, ER_UDF_ERROR, 0,
+        "vector_batch_distance", "this function requires 2 to 4 parameters");
+    return true;
+  }
+  if (args->arg_count == 4) args->arg_type[3] = INT_RESULT;
+
+  vector_kernels::metric metric = vector_kernels::metric::l2;
+  if (args->arg_count >= 3 &&
+      (args->arg_type[2] != STRING_RESULT || args->args[2] == nullptr ||
+       vector_kernels::metric_from_name(args->args[2], args->lengths[2],
+                                        &metric))) {
+    mysql_error_service_emit_printf(
+        mysql_service_mysql_runtime_error, ER_UDF_ERROR, 0,
+        "vector_batch_distance",
+        "metric must be a constant 'L2', 'COSINE', 'DOT' or 'L1'");
+    return true;
+  }
+
+  long long k = 0;
+  if (args->arg_count == 4) {
+    k = args->args[3] ? *reinterpret_cast<long long *>(args->args[3]) : 0;
+    if (k < 1 || k > max_topk) {
+      mysql_error_service_emit_printf(
+          mysql_service_mysql_runtime_error, ER_UDF_ERROR, 0,
+          "vector_batch_distance", "k must be a constant between 1 and 10000");
+      return true;
+    }
+  }
+
+  vector_batch *batch = new (std::nothrow) vector_batch();
+  if (batch == nullptr) {
+    error_msg_oom("vector_batch_distance");
+    return true;
+  }
+  batch->metric = metric;
+  batch->k = k;
+  if (vector_constant_init(&batch->query, args, 0, "vector_batch_distance")) {
+    delete batch;
+    return true;
+  }
+  if (k > 0) {
+    try {
+      batch->heaps.resize(workers->participants());
+    } catch (const std::bad_alloc &) {
+      delete batch;
+      error_msg_oom("vector_batch_distance");
+      return true;
+    }
+    for (topk_heap &heap : batch->heaps) {
+      if (heap.reserve(k)) {
+        delete batch;
+        error_msg_oom("vector_batch_distance");
+        return true;
+      }
+    }
+    if (mysql_service_mysql_udf_metadata->result_set(
+            initid, "charset", const_cast<char *>("utf8mb4"))) {
+      delete batch;
+      mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                      ER_UDF_ERROR, 0, "vector_batch_distance",
+                                      "unable to set the result charset");
+      return true;
+    }
+  }
+
+  initid->ptr = reinterpret_cast<char *>(batch);
+  initid->maybe_null = true;
+  return false;
+}
+
+static void vector_batch_distance_udf_deinit(UDF_INIT *initid) {
+  delete reinterpret_cast<vector_batch *>(initid->ptr);
+  initid->ptr = nullptr;
+}
+
+const char *vector_batch_distance_udf(UDF_INIT *initid, UDF_ARGS *args, char *,
+                                      unsigned long *length, char *is_null,
+                                      char *error) {
+  vector_batch *batch = reinterpret_cast<vector_batch *>(initid->ptr);
+  *error = 0;
+  *is_null = 0;
+
+  if (args->args[0] == nullptr || args->args[1] == nullptr) {
+    *is_null = 1;
+    return 0;
+  }
+  vector_kernels::element_type type = vector_kernels::element_type::fp32;
+  const char *query = batch->query.data;
+  uint32_t vec_dim =
+      query != nullptr
+          ? batch->query.vec_dim
+          : vector_decode(args->args[0], args->lengths[0], &type, &query);
+  if (vec_dim == UINT32_MAX) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_batch_distance",
+                                    "Invalid vector");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  if (vector_float_only(type, "vector_batch_distance")) {
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  const size_t vector_size = Field_vector::dimension_bytes(vec_dim);
+  if (args->lengths[1] % vector_size != 0 ||
+      args->lengths[1] / vector_size > UINT32_MAX) {
+    udf_error = vector_counters::error_kind::size_mismatch;
+    mysql_error_service_emit_printf(
+        mysql_service_mysql_runtime_error, ER_UDF_ERROR, 0,
+        "vector_batch_distance",
+        "the batch must be a concatenation of vectors of the query size");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  const uint32_t count = static_cast<uint32_t>(args->lengths[1] / vector_size);
+  const uint32_t grain = static_cast<uint32_t>(
+      std::max<size_t>(1, batch_chunk_bytes / vector_size));
+  const char *vectors = args->args[1];
+  const vector_kernels::metric metric = batch->metric;
+  const double query_norm =
+      batch->query.data != nullptr
+          ? batch->query.norm_squared
+          : vector_kernels::active().dot(vec_dim, query, query);
+
+  if (batch->k == 0) {
+    float *distances = reinterpret_cast<float *>(
+        batch->result.reserve(std::max<size_t>(count, 1) * sizeof(float)));
+    if (distances == nullptr) {
+      error_msg_oom("vector_batch_distance");
+      *error = 1;
+      *is_null = 1;
+      return 0;
+    }
+    workers->parallel_for(
+        count, grain, [&](unsigned, uint32_t begin, uint32_t end) {
+          for (uint32_t i = begin; i < end; i++) {
+            double distance = vector_kernels::distance_to_query(
+                metric, vec_dim, vectors + i * vector_size, query, query_norm);
+            distances[i] = static_cast<float>(distance);
+          }
+        });
+    *length = count * sizeof(float);
+    return reinterpret_cast<char *>(distances);
+  }
+
+  workers->parallel_for(
+      count, grain, [&](unsigned participant, uint32_t begin, uint32_t end) {
+        topk_heap &heap = batch->heaps[participant];
+        for (uint32_t i = begin; i < end; i++) {
+          double distance = vector_kernels::distance_to_query(
+              metric, vec_dim, vectors + i * vector_size, query, query_norm);
+          if (std::isfinite(distance)) heap.push(distance, i);
+        }
+      });
+
+  /* Merges the heaps of the participants into the first one. */
+  topk_heap &nearest = batch->heaps[0];
+  for (size_t i = 1; i < batch->heaps.size(); i++) {
+    for (const topk_heap::entry &entry : batch->heaps[i].sorted())
+      nearest.push(entry.first, entry.second);
+    batch->heaps[i].clear();
+  }
+  const std::vector<topk_heap::entry> &neighbors = nearest.sorted();
+  if (neighbors.empty()) {
+    *is_null = 1;
+    return 0;
+  }
+  char *result = neighbors_to_json(neighbors, &batch->result, length);
+  nearest.clear();
+  if (result == nullptr) {
+    error_msg_oom("vector_batch_distance");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  return result;
+}
+
+// Aggregate UDF clustering the vectors of a group by k-means:
+// VECTOR_KMEANS(v, k [, iterations [, sampling_rate]])
+
+struct vector_kmeans_state {
+  uint32_t k = 0;
+  uint32_t iterations = vector_kmeans::default_iterations;
+  double sampling_rate = 1;
+  vector_kmeans::clustering clustering;
+  std::vector<char> result;
+  bool failed = false;
+};
+
+static bool vector_kmeans_udf_init(UDF_INIT *initid, UDF_ARGS *args, char *) {
+  if (args->arg_count < 2 || args->arg_count > 4) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_kmeans",
+                                    "this function requires 2 to 4 parameters");
+    return true;
+  }
+  args->arg_type[1] = INT_RESULT;
+  if (args->arg_count > 2) args->arg_type[2] = INT_RESULT;
+  if (args->arg_count > 3) args->arg_type[3] = REAL_RESULT;
+
+  long long k =
+      args->args[1] ? *reinterpret_cast<long long *>(args->args[1]) : 0;
+  if (k < 1 || k > vector_kmeans::max_clusters) {
+    mysql_error_service_emit_printf(
+        mysql_service_mysql_runtime_error, ER_UDF_ERROR, 0, "vector_kmeans",
+        "k must be a constant between 1 and 65536");
+    return true;
+  }
+  long long iterations = vector_kmeans::default_iterations;
+  if (args->arg_count > 2)
+    iterations =
+        args->args[2] ? *reinterpret_cast<long long *>(args->args[2]) : 0;
+  if (iterations < 1 || iterations > vector_kmeans::max_iterations) {
+    mysql_error_service_emit_printf(
+        mysql_service_mysql_runtime_error, ER_UDF_ERROR, 0, "vector_kmeans",
+        "iterations must be a constant between 1 and 1000");
+    return true;
+  }
+  double sampling_rate = 1;
+  if (args->arg_count > 3)
+    sampling_rate =
+        args->args[3] ? *reinterpret_cast<double *>(args->args[3]) : 0;
+  if (!(sampling_rate > 0 && sampling_rate <= 1)) {
+    mysql_error_service_emit_printf(
+        mysql_service_mysql_runtime_error, ER_UDF_ERROR, 0, "vector_kmeans",
+        "sampling_rate must be a constant greater than 0 and at most 1");
+    return true;
+  }
+
+  vector_kmeans_state *kmeans = new (std::nothrow) vector_kmeans_state();
+  if (kmeans == nullptr) {
+    error_msg_oom("vector_kmeans");
+    return true;
+  }
+  kmeans->k = static_cast<uint32_t>(k);
+  kmeans->iterations = static_cast<uint32_t>(iterations);
+  kmeans->sampling_rate = sampling_rate;
+  initid->ptr = reinterpret_cast<char *>(kmeans);
+  initid->maybe_null = true;
+  return false;
+}
+
+static void vector_kmeans_udf_deinit(UDF_INIT *initid) {
+  delete reinterpret_cast<vector_kmeans_state *>(initid->ptr);
+  initid->ptr = nullptr;
+}
+
+static void vector_kmeans_clear(UDF_INIT *initid, unsigned char *,
+                                unsigned char *) {
+  vector_kmeans_state *kmeans =
+      reinterpret_cast<vector_kmeans_state *>(initid->ptr);
+  kmeans->clustering.reset();
+  kmeans->failed = false;
+}
+
+static void vector_kmeans_add(UDF_INIT *initid, UDF_ARGS *args,
+                              unsigned char *, unsigned char *error) {
+  vector_kmeans_state *kmeans =
+      reinterpret_cast<vector_kmeans_state *>(initid->ptr);
+  if (kmeans->failed || args->args[0] == nullptr) return;
+
+  const char *elements;
+  uint32_t vec_dim = float_vector_operand(args, 0, &elements);
+  if (vec_dim == UINT32_MAX || vec_dim == 0 ||
+      (kmeans->clustering.started() &&
+       vec_dim != kmeans->clustering.dimensions())) {
+    udf_error = vector_counters::error_kind::size_mismatch;
+    mysql_error_service_emit_printf(
+        mysql_service_mysql_runtime_error, ER_UDF_ERROR, 0, "vector_kmeans",
+        "all vectors must be float vectors of the same size");
+    kmeans->failed = true;
+    *error = 1;
+    return;
+  }
+
+  try {
+    if (!kmeans->clustering.started())
+      kmeans->clustering.start(vec_dim, kmeans->k, kmeans->iterations,
+                               kmeans->sampling_rate, kmeans_sample_bytes());
+    kmeans->clustering.add(elements);
+  } catch (const std::bad_alloc &) {
+    error_msg_oom("vector_kmeans");
+    kmeans->failed = true;
+    *error = 1;
+  }
+}
+
+const char *vector_kmeans_udf(UDF_INIT *initid, UDF_ARGS *, char *,
+                              unsigned long *length, char *is_null,
+                              char *error) {
+  vector_kmeans_state *kmeans =
+      reinterpret_cast<vector_kmeans_state *>(initid->ptr);
+  *error = 0;
+  *is_null = 0;
+
+  if (kmeans->failed) {
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  try {
+    kmeans->clustering.finish(workers, &kmeans->result);
+  } catch (const std::bad_alloc &) {
+    error_msg_oom("vector_kmeans");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  if (kmeans->result.empty()) {
+    *is_null = 1;
+    return 0;
+  }
+  *length = kmeans->result.size();
+  return kmeans->result.data();
+}
+
+/*
+  VECTOR_STATS and VECTOR_COVARIANCE take an optional constant format,
+  'BINARY' (the default) or 'JSON', the JSON results being utf8mb4 text.
+  Their vectors are float vectors of the same size; NULL vectors are
+  skipped.
+*/
+
+static bool vector_stats_format_init(UDF_INIT *initid, UDF_ARGS *args,
+                                     const char *udf_name,
+                                     vector_stats::format *format) {
+  if (args->arg_count < 1 || args->arg_count > 2) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, udf_name,
+                                    "this function requires 1 or 2 parameters");
+    return true;
+  }
+  *format = vector_stats::format::binary;
+  if (args->arg_count == 2 &&
+      (args->arg_type[1] != STRING_RESULT || args->args[1] == nullptr ||
+       vector_stats::format_from_name(args->args[1], args->lengths[1],
+                                      format))) {
+    mysql_error_service_emit_printf(
+        mysql_service_mysql_runtime_error, ER_UDF_ERROR, 0, udf_name,
+        "format must be a constant 'BINARY' or 'JSON'");
+    return true;
+  }
+  if (*format == vector_stats::format::json &&
+      mysql_service_mysql_udf_metadata->result_set(
+          initid, "charset", const_cast<char *>("utf8mb4"))) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, udf_name,
+                                    "unable to set the result charset");
+    return true;
+  }
+  initid->maybe_null = true;
+  return false;
+}
+
+/* Copies `text` to `out` and returns the end of the copy. */
+static char *vector_stats_append(char *out, const char *text) {
+  size_t length = strlen(text);
+  memcpy(out, text, length);
+  return out + length;
+}
+
+/*
+  Appends `key` and the JSON array of the vec_dim floats of `values` to
+  `out`; returns the end of the text, or nullptr if a float is not finite.
+*/
+static char *vector_stats_json_array(char *out, const char *key,
+                                     uint32_t vec_dim, const float *values) {
+  out = vector_stats_append(out, key);
+  size_t bytes = vector_text::format(
+      vec_dim, reinterpret_cast<const char *>(values), vector_text::shortest,
+      out);
+  return bytes == SIZE_MAX ? nullptr : out + bytes;
+}
+
+/* The bytes of a JSON array of vec_dim floats with its name. */
+static size_t vector_stats_json_bytes(uint32_t vec_dim) {
+  return 32 + vector_text::max_text_bytes(vec_dim);
+}
+
+// Aggregate UDF computing the per-dimension mean, variance, minimum and
+// maximum of the vectors of a group: VECTOR_STATS(v [, format])
+
+struct vector_stats_state {
+  vector_stats::format format = vector_stats::format::binary;
+  vector_stats::moments moments;
+  vector_result values;
+  vector_result result;
+  bool failed = false;
+};
+
+static bool vector_stats_udf_init(UDF_INIT *initid, UDF_ARGS *args, char *) {
+  vector_stats::format format;
+  if (vector_stats_format_init(initid, args, "vector_stats", &format))
+    return true;
+  vector_stats_state *stats = new (std::nothrow) vector_stats_state();
+  if (stats == nullptr) {
+    error_msg_oom("vector_stats");
+    return true;
+  }
+  stats->format = format;
+  initid->ptr = reinterpret_cast<char *>(stats);
+  return false;
+}
+
+static void vector_stats_udf_deinit(UDF_INIT *initid) {
+  delete reinterpret_cast<vector_stats_state *>(initid->ptr);
+  initid->ptr = nullptr;
+}
+
+static void vector_stats_clear(UDF_INIT *initid, unsigned char *,
+                               unsigned char *) {
+  vector_stats_state *stats =
+      reinterpret_cast<vector_stats_state *>(initid->ptr);
+  stats->moments.reset();
+  stats->failed = false;
+}
+
+static void vector_stats_add(UDF_INIT *initid, UDF_ARGS *args,
+                             unsigned char *, unsigned char *error) {
+  vector_stats_state *stats =
+      reinterpret_cast<vector_stats_state *>(initid->ptr);
+  if (stats->failed || args->args[0] == nullptr) return;
+
+  const char *elements;
+  uint32_t vec_dim = float_vector_operand(args, 0, &elements);
+  if (vec_dim == UINT32_MAX || vec_dim == 0 ||
+      (stats->moments.started() && vec_dim != stats->moments.dimensions())) {
+    udf_error = vector_counters::error_kind::size_mismatch;
+    mysql_error_service_emit_printf(
+        mysql_service_mysql_runtime_error, ER_UDF_ERROR, 0, "vector_stats",
+        "all vectors must be float vectors of the same size");
+    stats->failed = true;
+    *error = 1;
+    return;
+  }
+
+  if (!stats->moments.started()) {
+    try {
+      stats->moments.start(vec_dim);
+    } catch (const std::bad_alloc &) {
+      error_msg_oom("vector_stats");
+      stats->failed = true;
+      *error = 1;
+      return;
+    }
+  }
+  stats->moments.add(elements);
+}
+
+const char *vector_stats_udf(UDF_INIT *initid, UDF_ARGS *, char *,
+                             unsigned long *length, char *is_null,
+                             char *error) {
+  vector_stats_state *stats =
+      reinterpret_cast<vector_stats_state *>(initid->ptr);
+  *error = 0;
+  *is_null = 0;
+
+  if (stats->failed) {
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  if (!stats->moments.started()) {
+    *is_null = 1;
+    return 0;
+  }
+
+  const uint32_t vec_dim = stats->moments.dimensions();
+  const size_t values_bytes = 4 * Field_vector::dimension_bytes(vec_dim);
+  const bool json = stats->format == vector_stats::format::json;
+  char *result = stats->result.reserve(
+      json ? 64 + 4 * vector_stats_json_bytes(vec_dim) : values_bytes);
+  float *values = reinterpret_cast<float *>(
+      json ? stats->values.reserve(values_bytes) : result);
+  if (result == nullptr || values == nullptr) {
+    error_msg_oom("vector_stats");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  bool out_of_range = stats->moments.finish(values);
+  char *end = result + values_bytes;
+  if (json && !out_of_range) {
+    end = vector_stats_append(result, "{\"count\": ");
+    end = std::to_chars(end, end + 20, stats->moments.count()).ptr;
+    const char *const keys[] = {", \"mean\": ", ", \"variance\": ",
+                                ", \"min\": ", ", \"max\": "};
+    for (size_t s = 0; s < std::size(keys) && end != nullptr; s++)
+      end = vector_stats_json_array(end, keys[s], vec_dim,
+                                    values + s * vec_dim);
+    if (end != nullptr) *end++ = '}';
+    out_of_range = end == nullptr;
+  }
+  if (vector_status_error(out_of_range ? vector_kernels::op_status::out_of_range
+                                       : vector_kernels::op_status::ok,
+                          "vector_stats")) {
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  *length = end - result;
+  return result;
+}
+
+// Aggregate UDF computing the mean and the covariance matrix of the vectors
+// of a group: VECTOR_COVARIANCE(v [, format])
+
+/* The bytes of the result of a group of vec_dim dimensions. */
+static size_t vector_covariance_result_bytes(uint32_t vec_dim, bool json) {
+  return json ? 64 + size_t{vec_dim + 1} * vector_stats_json_bytes(vec_dim)
+              : size_t{vec_dim} * Field_vector::dimension_bytes(vec_dim);
+}
+
+/* The bytes of the float means, and of the matrix formatted as JSON. */
+static size_t vector_covariance_values_bytes(uint32_t vec_dim, bool json) {
+  return (json ? size_t{vec_dim} * Field_vector::dimension_bytes(vec_dim)
+               : 0) +
+         Field_vector::dimension_bytes(vec_dim);
+}
+
+/*
+  The memory of a group of vec_dim dimensions: the double matrix, means and
+  rows of vector_stats::covariance, then the floats and the result.
+*/
+static size_t vector_covariance_bytes(uint32_t vec_dim, bool json) {
+  const size_t rows = size_t{vec_dim} + 1 +
+                      vector_stats::covariance::block_rows + 1;
+  return rows * vec_dim * sizeof(double) +
+         vector_covariance_values_bytes(vec_dim, json) +
+         vector_covariance_result_bytes(vec_dim, json);
+}
+
+struct vector_covariance_state {
+  vector_stats::format format = vector_stats::format::binary;
+  vector_stats::covariance covariance;
+  vector_result values;
+  vector_result result;
+  bool failed = false;
+};
+
+static bool vector_covariance_udf_init(UDF_INIT *initid, UDF_ARGS *args,
+                                       char *) {
+  vector_stats::format format;
+  if (vector_stats_format_init(initid, args, "vector_covariance", &format))
+    return true;
+  vector_covariance_state *cov = new (std::nothrow) vector_covariance_state();
+  if (cov == nullptr) {
+    error_msg_oom("vector_covariance");
+    return true;
+  }
+  cov->format = format;
+  initid->ptr = reinterpret_cast<char *>(cov);
+  return false;
+}
+
+static void vector_covariance_udf_deinit(UDF_INIT *initid) {
+  delete reinterpret_cast<vector_covariance_state *>(initid->ptr);
+  initid->ptr = nullptr;
+}
+
+static void vector_covariance_clear(UDF_INIT *initid, unsigned char *,
+                                    unsigned char *) {
+  vector_covariance_state *cov =
+      reinterpret_cast<vector_covariance_state *>(initid->ptr);
+  cov->covariance.reset();
+  cov->failed = false;
+}
+
+static void vector_covariance_add(UDF_INIT *initid, UDF_ARGS *args,
+                                  unsigned char *, unsigned char *error) {
+  vector_covariance_state *cov =
+      reinterpret_cast<vector_covariance_state *>(initid->ptr);
+  if (cov->failed || args->args[0] == nullptr) return;
+
+  const char *elements;
+  uint32_t vec_dim = float_vector_operand(args, 0, &elements);
+  if (vec_dim == UINT32_MAX || vec_dim == 0 ||
+      (cov->covariance.started() &&
+       vec_dim != cov->covariance.dimensions())) {
+    udf_error = vector_counters::error_kind::size_mismatch;
+    mysql_error_service_emit_printf(
+        mysql_service_mysql_runtime_error, ER_UDF_ERROR, 0,
+        "vector_covariance",
+        "all vectors must be float vectors of the same size");
+    cov->failed = true;
+    *error = 1;
+    return;
+  }
+  if (vec_dim > vector_stats::max_covariance_dimensions) {
+    udf_error = vector_counters::error_kind::size_mismatch;
+    mysql_error_service_emit_printf(
+        mysql_service_mysql_runtime_error, ER_UDF_ERROR, 0,
+        "vector_covariance", "the vectors must have at most 4096 dimensions");
+    cov->failed = true;
+    *error = 1;
+    return;
+  }
+
+  if (!cov->covariance.started()) {
+    if (vector_covariance_bytes(vec_dim,
+                                cov->format == vector_stats::format::json) >
+        covariance_memory_limit) {
+      udf_error = vector_counters::error_kind::out_of_memory;
+      mysql_error_service_emit_printf(
+          mysql_service_mysql_runtime_error, ER_UDF_ERROR, 0,
+          "vector_covariance",
+          "vector_operations.covariance_memory_limit reached");
+      cov->failed = true;
+      *error = 1;
+      return;
+    }
+    try {
+      cov->covariance.start(vec_dim, workers);
+    } catch (const std::bad_alloc &) {
+      error_msg_oom("vector_covariance");
+      cov->failed = true;
+      *error = 1;
+      return;
+    }
+  }
+  cov->covariance.add(elements);
+}
+
+const char *vector_covariance_udf(UDF_INIT *initid, UDF_ARGS *, char *,
+                                  unsigned long *length, char *is_null,
+                                  char *error) {
+  vector_covariance_state *cov =
+      reinterpret_cast<vector_covariance_state *>(initid->ptr);
+  *error = 0;
+  *is_null = 0;
+
+  if (cov->failed) {
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  if (!cov->covariance.started()) {
+    *is_null = 1;
+    return 0;
+  }
+
+  const uint32_t vec_dim = cov->covariance.dimensions();
+  const size_t matrix_bytes =
+      size_t{vec_dim} * Field_vector::dimension_bytes(vec_dim);
+  const bool json = cov->format == vector_stats::format::json;
+  char *result =
+      cov->result.reserve(vector_covariance_result_bytes(vec_dim, json));
+  float *values = reinterpret_cast<float *>(
+      cov->values.reserve(vector_covariance_values_bytes(vec_dim, json)));
+  if (result == nullptr || values == nullptr) {
+    error_msg_oom("vector_covariance");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  /* The means come first in `values`, followed by the JSON matrix. */
+  float *matrix = json ? values + vec_dim : reinterpret_cast<float *>(result);
+  bool out_of_range = cov->covariance.finish(values, matrix);
+  char *end = result + matrix_bytes;
+  if (json && !out_of_range) {
+    end = vector_stats_append(result, "{\"count\": ");
+    end = std::to_chars(end, end + 20, cov->covariance.count()).ptr;
+    end = vector_stats_json_array(end, ", \"mean\": ", vec_dim, values);
+    if (end != nullptr) end = vector_stats_append(end, ", \"covariance\": [");
+    for (uint32_t i = 0; i < vec_dim && end != nullptr; i++) {
+      if (i > 0) *end++ = ',';
+      size_t bytes = vector_text::format(
+          vec_dim, reinterpret_cast<const char *>(matrix + size_t{i} * vec_dim),
+          vector_text::shortest, end);
+      end = bytes == SIZE_MAX ? nullptr : end + bytes;
+    }
+    if (end != nullptr) end = vector_stats_append(end, "]}");
+    out_of_range = end == nullptr;
+  }
+  if (vector_status_error(out_of_range ? vector_kernels::op_status::out_of_range
+                                       : vector_kernels::op_status::ok,
+                          "vector_covariance")) {
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  *length = end - result;
+  return result;
+}
+
+// UDF inserting a vector in a named HNSW index:
+// VECTOR_INDEX_ADD(index_name, id, vector)
+
+static bool vector_index_add_udf_init(UDF_INIT *initid, UDF_ARGS *args,
+                                      char *) {
+  if (args->arg_count != 3) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_index_add",
+                                    "this function requires 3 parameters");
+    return true;
+  }
+  args->arg_type[0] = STRING_RESULT;
+  args->arg_type[1] = INT_RESULT;
+  initid->maybe_null = true;
+  return false;
+}
+
+long long vector_index_add_udf(UDF_INIT *, UDF_ARGS *args, char *is_null,
+                               char *error) {
+  *error = 0;
+  *is_null = 0;
+
+  if (args->args[0] == nullptr || args->args[1] == nullptr ||
+      args->args[2] == nullptr) {
+    *is_null = 1;
+    return 0;
+  }
+  uint32_t vec_dim = float_vector_dimensions(args->args[2], args->lengths[2]);
+  if (vec_dim == UINT32_MAX) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_index_add",
+                                    "Invalid vector");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  if (!float_vector_is_finite(args->args[2], vec_dim)) {
+    udf_error = vector_counters::error_kind::out_of_range;
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_index_add",
+                                    non_finite_vector);
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  const char *message = nullptr;
+  std::shared_ptr<hnsw_index> index;
+  try {
+    index = indexes->find_or_create(
+        std::string(args->args[0], args->lengths[0]), vec_dim);
+  } catch (const std::bad_alloc &) {
+    udf_error = vector_counters::error_kind::out_of_memory;
+    message = "Out of memory";
+  }
+
+  if (index != nullptr && index->dimensions() != vec_dim) {
+    udf_error = vector_counters::error_kind::size_mismatch;
+    message = "the vector size does not match the index";
+  } else if (index != nullptr) {
+    long long id = *reinterpret_cast<long long *>(args->args[1]);
+    switch (index->add(id, args->args[2], index_memory_limit)) {
+      case hnsw_index::add_status::ok:
+        return static_cast<long long>(index->size());
+      case hnsw_index::add_status::duplicate_id:
+        message = "the id is already in the index";
+        break;
+      case hnsw_index::add_status::memory_limit:
+        udf_error = vector_counters::error_kind::out_of_memory;
+        message = "vector_operations.index_memory_limit reached";
+        break;
+      case hnsw_index::add_status::out_of_memory:
+        udf_error = vector_counters::error_kind::out_of_memory;
+        message = "Out of memory";
+        break;
+    }
+  }
+
+  mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                  ER_UDF_ERROR, 0, "vector_index_add",
+                                  message);
+  *error = 1;
+  *is_null = 1;
+  return 0;
+}
+
+/*
+  Per-statement state of VECTOR_INDEX_SEARCH and VECTOR_IVF_SEARCH: the
+  result buffer and the query vector, cached if it is constant or a name.
+*/
+struct vector_search_state {
+  vector_result result;
+  vector_constant query;
+  /*
+    VECTOR_IVF_SEARCH: the path of the index, resolved once at init when the
+    name is constant (path_error being the error of an invalid name), and
+    the file of file_path, opened by the first row searching it.
+  */
+  bool constant_path = false;
+  const char *path_error = nullptr;
+  std::string path;
+  std::shared_ptr<vector_ivf::index_file> file;
+  std::string file_path;
+};
+
+/* The init callback of the searches, taking (index_name, query, k [, n]). */
+static bool vector_search_init(UDF_INIT *initid, UDF_ARGS *args,
+                               const char *udf_name) {
+  if (args->arg_count < 3 || args->arg_count > 4) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, udf_name,
+                                    "this function requires 3 or 4 parameters");
+    return true;
+  }
+  args->arg_type[0] = STRING_RESULT;
+  args->arg_type[2] = INT_RESULT;
+  if (args->arg_count == 4) args->arg_type[3] = INT_RESULT;
+
+  vector_search_state *state = new (std::nothrow) vector_search_state();
+  if (state == nullptr) {
+    error_msg_oom(udf_name);
+    return true;
+  }
+  if (vector_constant_init(&state->query, args, 1, udf_name)) {
+    delete state;
+    return true;
+  }
+  if (mysql_service_mysql_udf_metadata->result_set(
+          initid, "charset", const_cast<char *>("utf8mb4"))) {
+    delete state;
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, udf_name,
+                                    "unable to set the result charset");
+    return true;
+  }
+  initid->ptr = reinterpret_cast<char *>(state);
+  initid->maybe_null = true;
+  return false;
+}
+
+static void vector_search_deinit(UDF_INIT *initid) {
+  delete reinterpret_cast<vector_search_state *>(initid->ptr);
+  initid->ptr = nullptr;
+}
+
+// UDF searching the k nearest rows of a named HNSW index:
+// VECTOR_INDEX_SEARCH(index_name, query_vector, k [, ef])
+
+static constexpr long long default_index_ef = 64;
+
+static bool vector_index_search_udf_init(UDF_INIT *initid, UDF_ARGS *args,
+                                         char *) {
+  return vector_search_init(initid, args, "vector_index_search");
+}
+
+static void vector_index_search_udf_deinit(UDF_INIT *initid) {
+  vector_search_deinit(initid);
+}
+
+const char *vector_index_search_udf(UDF_INIT *initid, UDF_ARGS *args, char *,
+                                    unsigned long *length, char *is_null,
+                                    char *error) {
+  vector_search_state *state =
+      reinterpret_cast<vector_search_state *>(initid->ptr);
+  *error = 0;
+  *is_null = 0;
+
+  if (args->args[0] == nullptr || args->args[1] == nullptr) {
+    *is_null = 1;
+    return 0;
+  }
+
+  const char *message = nullptr;
+  long long k =
+      args->args[2] ? *reinterpret_cast<long long *>(args->args[2]) : 0;
+  long long ef = args->arg_count == 4 && args->args[3]
+                     ? *reinterpret_cast<long long *>(args->args[3])
+                     : default_index_ef;
+  const char *query;
+  uint32_t vec_dim = float_vector_operand(state->query, args, 1, &query);
+  std::shared_ptr<hnsw_index> index;
+  try {
+    index = indexes->find(std::string(args->args[0], args->lengths[0]));
+  } catch (const std::bad_alloc &) {
+    error_msg_oom("vector_index_search");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  if (k < 1 || k > max_topk) {
+    message = "k must be between 1 and 10000";
+  } else if (ef < 1 || ef > max_topk) {
+    message = "ef must be between 1 and 10000";
+  } else if (vec_dim == UINT32_MAX) {
+    message = "Invalid vector";
+  } else if (!float_vector_is_finite(query, vec_dim)) {
+    udf_error = vector_counters::error_kind::out_of_range;
+    message = non_finite_vector;
+  } else if (index == nullptr) {
+    message = "no index with this name";
+  } else if (index->dimensions() != vec_dim) {
+    udf_error = vector_counters::error_kind::size_mismatch;
+    message = "the vector size does not match the index";
+  }
+  if (message != nullptr) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_index_search",
+                                    message);
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  char *result = nullptr;
+  try {
+    result = neighbors_to_json(
+        index->search(query, static_cast<uint32_t>(k),
+                      static_cast<uint32_t>(ef)),
+        &state->result, length);
+  } catch (const std::bad_alloc &) {
+  }
+  if (result == nullptr) {
+    error_msg_oom("vector_index_search");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  return result;
+}
+
+// UDF removing a named HNSW index: VECTOR_INDEX_DROP(index_name)
+
+static bool vector_index_drop_udf_init(UDF_INIT *initid, UDF_ARGS *args,
+                                       char *) {
+  if (args->arg_count != 1) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_index_drop",
+                                    "this function requires 1 parameter");
+    return true;
+  }
+  args->arg_type[0] = STRING_RESULT;
+  initid->maybe_null = true;
+  return false;
+}
+
+long long vector_index_drop_udf(UDF_INIT *, UDF_ARGS *args, char *is_null,
+                                char *error) {
+  *error = 0;
+  *is_null = 0;
+  if (args->args[0] == nullptr) {
+    *is_null = 1;
+    return 0;
+  }
+  try {
+    return indexes->drop(std::string(args->args[0], args->lengths[0])) ? 0
+                                                                        : 1;
+  } catch (const std::bad_alloc &) {
+    error_msg_oom("vector_index_drop");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+}
+
+/*
+  Returns in `path` the file of the IVF index `name` in
+  vector_operations.ivf_directory; returns the error message if the name is
+  invalid or no directory is configured, nullptr on success.
+*/
+static const char *vector_ivf_path(const char *name, unsigned long length,
+                                   std::string *path) {
+  static constexpr unsigned long max_name_length = 64;
+  if (ivf_directory == nullptr || *ivf_directory == '\0')
+    return "vector_operations.ivf_directory is not set";
+  if (name == nullptr || length == 0 || length > max_name_length)
+    return "invalid index name";
+  for (unsigned long i = 0; i < length; i++) {
+    if (!std::isalnum(static_cast<unsigned char>(name[i])) &&
+        name[i] != '_' && name[i] != '-')
+      return "invalid index name";
+  }
+  path->assign(ivf_directory);
+  path->append("/");
+  path->append(name, length);
+  path->append(".ivf");
+  return nullptr;
+}
+
+// Aggregate UDF writing the IVF-Flat index file of the vectors of a group:
+// VECTOR_IVF_BUILD(index_name, id, vector, lists)
+
+struct vector_ivf_build {
+  std::string path;
+  uint32_t lists = 0;
+  vector_ivf::builder builder;
+  bool failed = false;
+};
+
+static bool vector_ivf_build_udf_init(UDF_INIT *initid, UDF_ARGS *args,
+                                      char *) {
+  if (args->arg_count != 4) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_ivf_build",
+                                    "this function requires 4 parameters");
+    return true;
+  }
+  args->arg_type[0] = STRING_RESULT;
+  args->arg_type[1] = INT_RESULT;
+  args->arg_type[3] = INT_RESULT;
+
+  long long lists =
+      args->args[3] ? *reinterpret_cast<long long *>(args->args[3]) : 0;
+  if (lists < 1 || lists > vector_ivf::max_lists) {
+    mysql_error_service_emit_printf(
+        mysql_service_mysql_runtime_error, ER_UDF_ERROR, 0,
+        "vector_ivf_build", "lists must be a constant between 1 and 65536");
+    return true;
+  }
+
+  vector_ivf_build *build = new (std::nothrow) vector_ivf_build();
+  if (build == nullptr) {
+    error_msg_oom("vector_ivf_build");
+    return true;
+  }
+  const char *message =
+      args->args[0] == nullptr
+          ? "the index name must be a constant"
+          : vector_ivf_path(args->args[0], args->lengths[0], &build->path);
+  if (message != nullptr) {
+    delete build;
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_ivf_build",
+                                    message);
+    return true;
+  }
+  build->lists = static_cast<uint32_t>(lists);
+
+  initid->ptr = reinterpret_cast<char *>(build);
+  initid->maybe_null = true;
+  return false;
+}
+
+static void vector_ivf_build_udf_deinit(UDF_INIT *initid) {
+  delete reinterpret_cast<vector_ivf_build *>(initid->ptr);
+  initid->ptr = nullptr;
+}
+
+static void vector_ivf_build_clear(UDF_INIT *initid, unsigned char *,
+                                   unsigned char *) {
+  vector_ivf_build *build = reinterpret_cast<vector_ivf_build *>(initid->ptr);
+  build->builder.reset();
+  build->failed = false;
+}
+
+static void vector_ivf_build_add(UDF_INIT *initid, UDF_ARGS *args,
+                                 unsigned char *, unsigned char *error) {
+  vector_ivf_build *build = reinterpret_cast<vector_ivf_build *>(initid->ptr);
+  if (build->failed || args->args[1] == nullptr || args->args[2] == nullptr)
+    return;
+
+  uint32_t vec_dim = float_vector_dimensions(args->args[2], args->lengths[2]);
+  if (vec_dim == UINT32_MAX ||
+      (build->builder.started() && vec_dim != build->builder.dimensions())) {
+    error_msg_size();
+    build->failed = true;
+    *error = 1;
+    return;
+  }
+  if (!float_vector_is_finite(args->args[2], vec_dim)) {
+    udf_error = vector_counters::error_kind::out_of_range;
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_ivf_build",
+                                    non_finite_vector);
+    build->failed = true;
+    *error = 1;
+    return;
+  }
+
+  std::string message;
+  if ((!build->builder.started() &&
+       build->builder.start(build->path, vec_dim, build->lists,
+                            kmeans_sample_bytes(), &message)) ||
+      build->builder.add(*reinterpret_cast<long long *>(args->args[1]),
+                         args->args[2], &message)) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_ivf_build",
+                                    message.c_str());
+    build->failed = true;
+    *error = 1;
+  }
+}
+
+long long vector_ivf_build_udf(UDF_INIT *initid, UDF_ARGS *, char *is_null,
+                               char *error) {
+  vector_ivf_build *build = reinterpret_cast<vector_ivf_build *>(initid->ptr);
+  *error = 0;
+  *is_null = 0;
+
+  if (build->failed) {
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  if (build->builder.count() == 0) {
+    *is_null = 1;
+    return 0;
+  }
+
+  long long count = static_cast<long long>(build->builder.count());
+  std::string message;
+  if (build->builder.finish(workers, &message)) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_ivf_build",
+                                    message.c_str());
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  return count;
+}
+
+// UDF searching the k nearest rows of an IVF-Flat index file:
+// VECTOR_IVF_SEARCH(index_name, query_vector, k [, nprobe])
+
+static constexpr long long default_ivf_nprobe = 8;
+
+static bool vector_ivf_search_udf_init(UDF_INIT *initid, UDF_ARGS *args,
+                                       char *) {
+  if (vector_search_init(initid, args, "vector_ivf_search")) return true;
+  vector_search_state *state =
+      reinterpret_cast<vector_search_state *>(initid->ptr);
+  if (args->args[0] != nullptr) {
+    try {
+      state->path_error =
+          vector_ivf_path(args->args[0], args->lengths[0], &state->path);
+    } catch (const std::bad_alloc &) {
+      vector_search_deinit(initid);
+      error_msg_oom("vector_ivf_search");
+      return true;
+    }
+    state->constant_path = true;
+  }
+  return false;
+}
+
+/*
+  The index file at state->path. The file is only looked up again, and
+  checked for a rebuild, when the path differs from the one of the
+  previous row, so that a statement searching a constant index name takes
+  the lock of the cache and stats the file once.
+*/
+static std::shared_ptr<vector_ivf::index_file> vector_ivf_search_file(
+    vector_search_state *state, std::string *error) {
+  if (state->file == nullptr || state->file_path != state->path) {
+    state->file = nullptr;
+    std::shared_ptr<vector_ivf::index_file> file =
+        ivf_files->open(state->path, error);
+    if (file == nullptr) return nullptr;
+    state->file_path = state->path;
+    state->file = std::move(file);
+  }
+  return state->file;
+}
+
+static void vector_ivf_search_udf_deinit(UDF_INIT *initid) {
+  vector_search_deinit(initid);
+}
+
+const char *vector_ivf_search_udf(UDF_INIT *initid, UDF_ARGS *args, char *,
+                                  unsigned long *length, char *is_null,
+                                  char *error) {
+  vector_search_state *state =
+      reinterpret_cast<vector_search_state *>(initid->ptr);
+  *error = 0;
+  *is_null = 0;
+
+  if (args->args[0] == nullptr || args->args[1] == nullptr) {
+    *is_null = 1;
+    return 0;
+  }
+
+  std::string message;
+  std::shared_ptr<vector_ivf::index_file> file;
+  long long k =
+      args->args[2] ? *reinterpret_cast<long long *>(args->args[2]) : 0;
+  long long nprobe = args->arg_count == 4 && args->args[3]
+                         ? *reinterpret_cast<long long *>(args->args[3])
+                         : default_ivf_nprobe;
+  const char *query;
+  uint32_t vec_dim = float_vector_operand(state->query, args, 1, &query);
+  /* Resolving a name that is not constant and opening its file allocate. */
+  try {
+    const char *invalid =
+        state->constant_path
+            ? state->path_error
+            : vector_ivf_path(args->args[0], args->lengths[0], &state->path);
+    if (invalid != nullptr) {
+      message = invalid;
+    } else if (k < 1 || k > max_topk) {
+      message = "k must be between 1 and 10000";
+    } else if (nprobe < 1 || nprobe > vector_ivf::max_lists) {
+      message = "nprobe must be between 1 and 65536";
+    } else if (vec_dim == UINT32_MAX) {
+      message = "Invalid vector";
+    } else if (!float_vector_is_finite(query, vec_dim)) {
+      udf_error = vector_counters::error_kind::out_of_range;
+      message = non_finite_vector;
+    } else if ((file = vector_ivf_search_file(state, &message)) != nullptr &&
+               file->dimensions() != vec_dim) {
+      udf_error = vector_counters::error_kind::size_mismatch;
+      message = "the vector size does not match the index";
+    }
+  } catch (const std::bad_alloc &) {
+    error_msg_oom("vector_ivf_search");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  if (!message.empty()) {
+    mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
+                                    ER_UDF_ERROR, 0, "vector_ivf_search",
+                                    message.c_str());
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+
+  char *result = nullptr;
+  try {
+    result = neighbors_to_json(
+        file->search(query, static_cast<uint32_t>(k),
+                     static_cast<uint32_t>(nprobe)),
+        &state->result, length);
+  } catch (const std::bad_alloc &) {
+  }
+  if (result == nullptr) {
+    error_msg_oom("vector_ivf_search");
+    *error = 1;
+    *is_null = 1;
+    return 0;
+  }
+  return result;
+}
+
+} /* namespace udf_impl */
+
+static void sys_variables_unregister() {
+  mysql_service_component_sys_variable_unregister->unregister_variable(
+      "vector_operations", "index_memory_limit");
+  mysql_service_component_sys_variable_unregister->unregister_variable(
+      "vector_operations", "ivf_directory");
+  mysql_service_component_sys_variable_unregister->unregister_variable(
+      "vector_operations", "batch_threads");
+  mysql_service_component_sys_variable_unregister->unregister_variable(
+      "vector_operations", "kmeans_memory_limit");
+  mysql_service_component_sys_variable_unregister->unregister_variable(
+      "vector_operations", "covariance_memory_limit");
+}
+
+/*
+  Deletes the UDF list, unregistering the UDFs left in it, then the worker
+  pool and the registries: what the service init allocated.
+*/
+static void vector_operations_release() {
+  delete list;
+  list = nullptr;
+  delete workers;
+  workers = nullptr;
+  delete indexes;
+  indexes = nullptr;
+  delete ivf_files;
+  ivf_files = nullptr;
+  delete projections;
+  projections = nullptr;
+  delete registered_vectors;
+  registered_vectors = nullptr;
+  delete counters;
+  counters = nullptr;
+}
+
+/* Registers the UDFs in `list`, and their counters. */
+static bool udf_functions_register() {
+  list = new udf_list();
+
+  if (list->add_scalar<udf_impl::vector_addition_udf>(
+          "VECTOR_ADDITION", Item_result::STRING_RESULT,
+          udf_impl::vector_addition_udf_init,
+          udf_impl::vector_addition_udf_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_subtraction_udf>(
+          "VECTOR_SUBTRACTION", Item_result::STRING_RESULT,
+          udf_impl::vector_subtraction_udf_init,
+          udf_impl::vector_subtraction_udf_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_multiplication_udf>(
+          "VECTOR_MULTIPLICATION", Item_result::STRING_RESULT,
+          udf_impl::vector_multiplication_udf_init,
+          udf_impl::vector_multiplication_udf_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_division_udf>(
+          "VECTOR_DIVISION", Item_result::STRING_RESULT,
+          udf_impl::vector_division_udf_init,
+          udf_impl::vector_division_udf_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_scale_udf>(
+          "VECTOR_SCALE", Item_result::STRING_RESULT,
+          udf_impl::vector_scale_udf_init, udf_impl::vector_state_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_axpy_udf>(
+          "VECTOR_AXPY", Item_result::STRING_RESULT,
+          udf_impl::vector_axpy_udf_init, udf_impl::vector_state_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_lerp_udf>(
+          "VECTOR_LERP", Item_result::STRING_RESULT,
+          udf_impl::vector_lerp_udf_init, udf_impl::vector_state_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_eval_udf>(
+          "VECTOR_EVAL", Item_result::STRING_RESULT,
+          udf_impl::vector_eval_udf_init, udf_impl::vector_eval_udf_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_dot_udf>(
+          "VECTOR_DOT", Item_result::REAL_RESULT, udf_impl::vector_dot_udf_init,
+          udf_impl::vector_state_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_cosine_udf>(
+          "VECTOR_COSINE", Item_result::REAL_RESULT,
+          udf_impl::vector_cosine_udf_init, udf_impl::vector_state_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_l2_udf>(
+          "VECTOR_L2", Item_result::REAL_RESULT, udf_impl::vector_l2_udf_init,
+          udf_impl::vector_state_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_l1_udf>(
+          "VECTOR_L1", Item_result::REAL_RESULT, udf_impl::vector_l1_udf_init,
+          udf_impl::vector_state_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_to_fp16_udf>(
+          "VECTOR_TO_FP16", Item_result::STRING_RESULT,
+          udf_impl::vector_to_fp16_udf_init,
+          udf_impl::vector_conversion_udf_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_to_bf16_udf>(
+          "VECTOR_TO_BF16", Item_result::STRING_RESULT,
+          udf_impl::vector_to_bf16_udf_init,
+          udf_impl::vector_conversion_udf_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_to_fp32_udf>(
+          "VECTOR_TO_FP32", Item_result::STRING_RESULT,
+          udf_impl::vector_to_fp32_udf_init,
+          udf_impl::vector_conversion_udf_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_normalize_udf>(
+          "VECTOR_NORMALIZE", Item_result::STRING_RESULT,
+          udf_impl::vector_normalize_udf_init,
+          udf_impl::vector_conversion_udf_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_norm_udf>(
+          "VECTOR_NORM", Item_result::REAL_RESULT,
+          udf_impl::vector_norm_udf_init)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_to_text_udf>(
+          "VECTOR_TO_TEXT", Item_result::STRING_RESULT,
+          udf_impl::vector_to_text_udf_init,
+          udf_impl::vector_to_text_udf_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_from_json_udf>(
+          "VECTOR_FROM_JSON", Item_result::STRING_RESULT,
+          udf_impl::vector_from_json_udf_init,
+          udf_impl::vector_from_json_udf_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_projection_load_udf>(
+          "VECTOR_PROJECTION_LOAD", Item_result::INT_RESULT,
+          udf_impl::vector_projection_load_udf_init)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_project_udf>(
+          "VECTOR_PROJECT", Item_result::STRING_RESULT,
+          udf_impl::vector_project_udf_init,
+          udf_impl::vector_project_udf_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_projection_drop_udf>(
+          "VECTOR_PROJECTION_DROP", Item_result::INT_RESULT,
+          udf_impl::vector_projection_drop_udf_init)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_register_udf>(
+          "VECTOR_REGISTER", Item_result::INT_RESULT,
+          udf_impl::vector_register_udf_init)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_get_udf>(
+          "VECTOR_GET", Item_result::STRING_RESULT,
+          udf_impl::vector_get_udf_init, udf_impl::vector_get_udf_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_unregister_udf>(
+          "VECTOR_UNREGISTER", Item_result::INT_RESULT,
+          udf_impl::vector_unregister_udf_init)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_quantize_udf>(
+          "VECTOR_QUANTIZE", Item_result::STRING_RESULT,
+          udf_impl::vector_quantize_udf_init,
+          udf_impl::vector_quantize_udf_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_dequantize_udf>(
+          "VECTOR_DEQUANTIZE", Item_result::STRING_RESULT,
+          udf_impl::vector_dequantize_udf_init,
+          udf_impl::vector_dequantize_udf_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_int8_dot_udf>(
+          "VECTOR_INT8_DOT", Item_result::REAL_RESULT,
+          udf_impl::vector_int8_dot_udf_init)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_int8_l2_udf>(
+          "VECTOR_INT8_L2", Item_result::REAL_RESULT,
+          udf_impl::vector_int8_l2_udf_init)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_hamming_udf>(
+          "VECTOR_HAMMING", Item_result::INT_RESULT,
+          udf_impl::vector_hamming_udf_init)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_aggregate<udf_impl::vector_pq_train_udf,
+                          udf_impl::vector_pq_train_add>(
+          "VECTOR_PQ_TRAIN", Item_result::STRING_RESULT,
+          udf_impl::vector_pq_train_clear, udf_impl::vector_pq_train_udf_init,
+          udf_impl::vector_pq_train_udf_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_pq_encode_udf>(
+          "VECTOR_PQ_ENCODE", Item_result::STRING_RESULT,
+          udf_impl::vector_pq_encode_udf_init,
+          udf_impl::vector_pq_encode_udf_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_pq_distance_udf>(
+          "VECTOR_PQ_DISTANCE", Item_result::REAL_RESULT,
+          udf_impl::vector_pq_distance_udf_init,
+          udf_impl::vector_pq_distance_udf_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_sparse_udf>(
+          "VECTOR_SPARSE", Item_result::STRING_RESULT,
+          udf_impl::vector_sparse_udf_init,
+          udf_impl::vector_sparse_state_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_to_sparse_udf>(
+          "VECTOR_TO_SPARSE", Item_result::STRING_RESULT,
+          udf_impl::vector_to_sparse_udf_init,
+          udf_impl::vector_sparse_state_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_sparse_to_dense_udf>(
+          "VECTOR_SPARSE_TO_DENSE", Item_result::STRING_RESULT,
+          udf_impl::vector_sparse_to_dense_udf_init,
+          udf_impl::vector_sparse_state_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_sparse_to_text_udf>(
+          "VECTOR_SPARSE_TO_TEXT", Item_result::STRING_RESULT,
+          udf_impl::vector_sparse_to_text_udf_init,
+          udf_impl::vector_sparse_state_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_sparse_add_udf>(
+          "VECTOR_SPARSE_ADD", Item_result::STRING_RESULT,
+          udf_impl::vector_sparse_add_udf_init,
+          udf_impl::vector_sparse_state_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_sparse_scale_udf>(
+          "VECTOR_SPARSE_SCALE", Item_result::STRING_RESULT,
+          udf_impl::vector_sparse_scale_udf_init,
+          udf_impl::vector_sparse_state_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_sparse_dot_udf>(
+          "VECTOR_SPARSE_DOT", Item_result::REAL_RESULT,
+          udf_impl::vector_sparse_dot_udf_init)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_aggregate<udf_impl::vector_sum_udf,
+                          udf_impl::vector_accumulator_add>(
+          "VECTOR_SUM", Item_result::STRING_RESULT,
+          udf_impl::vector_accumulator_clear, udf_impl::vector_sum_udf_init,
+          udf_impl::vector_accumulator_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_aggregate<udf_impl::vector_avg_udf,
+                          udf_impl::vector_accumulator_add>(
+          "VECTOR_AVG", Item_result::STRING_RESULT,
+          udf_impl::vector_accumulator_clear, udf_impl::vector_avg_udf_init,
+          udf_impl::vector_accumulator_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_aggregate<udf_impl::vector_topk_udf,
+                          udf_impl::vector_topk_add>(
+          "VECTOR_TOPK", Item_result::STRING_RESULT,
+          udf_impl::vector_topk_clear, udf_impl::vector_topk_udf_init,
+          udf_impl::vector_topk_udf_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_batch_distance_udf>(
+          "VECTOR_BATCH_DISTANCE", Item_result::STRING_RESULT,
+          udf_impl::vector_batch_distance_udf_init,
+          udf_impl::vector_batch_distance_udf_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_aggregate<udf_impl::vector_kmeans_udf,
+                          udf_impl::vector_kmeans_add>(
+          "VECTOR_KMEANS", Item_result::STRING_RESULT,
+          udf_impl::vector_kmeans_clear, udf_impl::vector_kmeans_udf_init,
+          udf_impl::vector_kmeans_udf_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_aggregate<udf_impl::vector_stats_udf,
+                          udf_impl::vector_stats_add>(
+          "VECTOR_STATS", Item_result::STRING_RESULT,
+          udf_impl::vector_stats_clear, udf_impl::vector_stats_udf_init,
+          udf_impl::vector_stats_udf_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_aggregate<udf_impl::vector_covariance_udf,
+                          udf_impl::vector_covariance_add>(
+          "VECTOR_COVARIANCE", Item_result::STRING_RESULT,
+          udf_impl::vector_covariance_clear,
+          udf_impl::vector_covariance_udf_init,
+          udf_impl::vector_covariance_udf_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_index_add_udf>(
+          "VECTOR_INDEX_ADD", Item_result::INT_RESULT,
+          udf_impl::vector_index_add_udf_init)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_index_search_udf>(
+          "VECTOR_INDEX_SEARCH", Item_result::STRING_RESULT,
+          udf_impl::vector_index_search_udf_init,
+          udf_impl::vector_index_search_udf_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_index_drop_udf>(
+          "VECTOR_INDEX_DROP", Item_result::INT_RESULT,
+          udf_impl::vector_index_drop_udf_init)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_aggregate<udf_impl::vector_ivf_build_udf,
+                          udf_impl::vector_ivf_build_add>(
+          "VECTOR_IVF_BUILD", Item_result::INT_RESULT,
+          udf_impl::vector_ivf_build_clear, udf_impl::vector_ivf_build_udf_init,
+          udf_impl::vector_ivf_build_udf_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  if (list->add_scalar<udf_impl::vector_ivf_search_udf>(
+          "VECTOR_IVF_SEARCH", Item_result::STRING_RESULT,
+          udf_impl::vector_ivf_search_udf_init,
+          udf_impl::vector_ivf_search_udf_deinit)) {
+    return true; /* failure: one of the UDF registrations failed */
+  }
+
+  return false;
+}
+
+static mysql_service_status_t vector_operations_service_init() {
+  mysql_service_status_t result = 0;
+
+  log_bi = mysql_service_log_builtins;
+  log_bs = mysql_service_log_builtins_string;
+
+  LogComponentErr(INFORMATION_LEVEL, ER_LOG_PRINTF_MSG, "initializing…");
+
+  vector_kernels::select();
+  std::string kernels_msg =
+      std::string("using ") +
+      vector_kernels::isa_name(vector_kernels::active().target) +
+      " vector kernels";
+  LogComponentErr(INFORMATION_LEVEL, ER_LOG_PRINTF_MSG, kernels_msg.c_str());
+
+  counters = new vector_counters::registry();
+  indexes = new vector_index_registry();
+  ivf_files = new vector_ivf::file_cache();
+  projections = new vector_projection::registry();
+  registered_vectors = new vector_registry::registry();
+
+  INTEGRAL_CHECK_ARG(ulonglong) memory_limit_arg;
+  memory_limit_arg.def_val = default_index_memory_limit;
+  memory_limit_arg.min_val = 0;
+  memory_limit_arg.max_val = ULLONG_MAX;
+  memory_limit_arg.blk_sz = 0;
+  if (mysql_service_component_sys_variable_register->register_variable(
+          "vector_operations", "index_memory_limit",
+          PLUGIN_VAR_LONGLONG | PLUGIN_VAR_UNSIGNED,
+          "Memory the VECTOR_INDEX_ADD indexes may use, in bytes", nullptr,
+          nullptr, &memory_limit_arg, &index_memory_limit)) {
+    vector_operations_release();
+    return 1; /* failure: the system variable registration failed */
+  }
+
+  STR_CHECK_ARG(str) ivf_directory_arg;
+  ivf_directory_arg.def_val = nullptr;
+  if (mysql_service_component_sys_variable_register->register_variable(
+          "vector_operations", "ivf_directory",
+          PLUGIN_VAR_STR | PLUGIN_VAR_MEMALLOC | PLUGIN_VAR_READONLY,
+          "Directory of the VECTOR_IVF_BUILD index files", nullptr, nullptr,
+          &ivf_directory_arg, &ivf_directory)) {
+    mysql_service_component_sys_variable_unregister->unregister_variable(
+        "vector_operations", "index_memory_limit");
+    vector_operations_release();
+    return 1; /* failure: the system variable registration failed */
+  }
+
+  INTEGRAL_CHECK_ARG(uint) batch_threads_arg;
+  batch_threads_arg.def_val = std::max(1U, std::thread::hardware_concurrency());
+  batch_threads_arg.min_val = 1;
+  batch_threads_arg.max_val = 1024;
+  batch_threads_arg.blk_sz = 0;
+  if (mysql_service_component_sys_variable_register->register_variable(
+          "vector_operations", "batch_threads",
+          PLUGIN_VAR_INT | PLUGIN_VAR_UNSIGNED | PLUGIN_VAR_READONLY,
+          "Threads computing a VECTOR_BATCH_DISTANCE, the caller included",
+          nullptr, nullptr, &batch_threads_arg, &batch_threads)) {
+    mysql_service_component_sys_variable_unregister->unregister_variable(
+        "vector_operations", "index_memory_limit");
+    mysql_service_component_sys_variable_unregister->unregister_variable(
+        "vector_operations", "ivf_directory");
+    vector_operations_release();
+    return 1; /* failure: the system variable registration failed */
+  }
+
+  {
+    /* A scope of its own: INTEGRAL_CHECK_ARG defines a struct. */
+    INTEGRAL_CHECK_ARG(ulonglong) kmeans_memory_limit_arg;
+    kmeans_memory_limit_arg.def_val =
+        vector_kmeans::clustering::default_sample_bytes;
+    kmeans_memory_limit_arg.min_val = 1 << 20;
+    kmeans_memory_limit_arg.max_val = ULLONG_MAX;
+    kmeans_memory_limit_arg.blk_sz = 0;
+    if (mysql_service_component_sys_variable_register->register_variable(
+            "vector_operations", "kmeans_memory_limit",
+            PLUGIN_VAR_LONGLONG | PLUGIN_VAR_UNSIGNED,
+            "Memory the training sample of a VECTOR_KMEANS, VECTOR_PQ_TRAIN "
+            "or VECTOR_IVF_BUILD group may use, in bytes",
+            nullptr, nullptr, &kmeans_memory_limit_arg,
+            &kmeans_memory_limit)) {
+      mysql_service_component_sys_variable_unregister->unregister_variable(
+          "vector_operations", "index_memory_limit");
+      mysql_service_component_sys_variable_unregister->unregister_variable(
+          "vector_operations", "ivf_directory");
+      mysql_service_component_sys_variable_unregister->unregister_variable(
+          "vector_operations", "batch_threads");
+      vector_operations_release();
+      return 1; /* failure: the system variable registration failed */
+    }
+  }
+
+  {
+    INTEGRAL_CHECK_ARG(ulonglong) covariance_memory_limit_arg;
+    covariance_memory_limit_arg.def_val = default_covariance_memory_limit;
+    covariance_memory_limit_arg.min_val = 0;
+    covariance_memory_limit_arg.max_val = ULLONG_MAX;
+    covariance_memory_limit_arg.blk_sz = 0;
+    if (mysql_service_component_sys_variable_register->register_variable(
+            "vector_operations", "covariance_memory_limit",
+            PLUGIN_VAR_LONGLONG | PLUGIN_VAR_UNSIGNED,
+            "Memory a VECTOR_COVARIANCE group may use, in bytes", nullptr,
+            nullptr, &covariance_memory_limit_arg,
+            &covariance_memory_limit)) {
+      mysql_service_component_sys_variable_unregister->unregister_variable(
+          "vector_operations", "index_memory_limit");
+      mysql_service_component_sys_variable_unregister->unregister_variable(
+          "vector_operations", "ivf_directory");
+      mysql_service_component_sys_variable_unregister->unregister_variable(
+          "vector_operations", "batch_threads");
+      mysql_service_component_sys_variable_unregister->unregister_variable(
+          "vector_operations", "kmeans_memory_limit");
+      vector_operations_release();
+      return 1; /* failure: the system variable registration failed */
+    }
+  }
+
+  /*
+    The pool must exist before the UDFs using it are registered: they can be
+    called as soon as they are.
+  */
+  workers = new vector_parallel::thread_pool(batch_threads - 1);
+
+  /* The status variables are those of the counters of the UDFs. */
+  if (udf_functions_register() || udf_status_variables_register()) {
+    sys_variables_unregister();
+    vector_operations_release();
+    return 1; /* failure: the UDF or status variable registration failed */
+  }
+
+  return result;
+}
+
+static mysql_service_status_t vector_operations_service_deinit() {
+  mysql_service_status_t result = 0;
+
+  if (list->unregister()) return 1; /* failure: some UDFs still in use */
+
+  sys_variables_unregister();
+  udf_status_variables_unregister();
+  vector_operations_release();
 
   LogComponentErr(INFORMATION_LEVEL, ER_LOG_PRINTF_MSG, "uninstalled.");
 
@@ -333,7 +5174,11 @@ END_COMPONENT_PROVIDES();
 BEGIN_COMPONENT_REQUIRES(vector_operations_service)
 REQUIRES_SERVICE(log_builtins), REQUIRES_SERVICE(log_builtins_string),
     REQUIRES_SERVICE(mysql_udf_metadata), REQUIRES_SERVICE(udf_registration),
-    REQUIRES_SERVICE(mysql_runtime_error), END_COMPONENT_REQUIRES();
+    REQUIRES_SERVICE(udf_registration_aggregate),
+    REQUIRES_SERVICE(mysql_runtime_error),
+    REQUIRES_SERVICE(component_sys_variable_register),
+    REQUIRES_SERVICE(component_sys_variable_unregister),
+    REQUIRES_SERVICE(status_variable_registration), END_COMPONENT_REQUIRES();
 
 /* A list of metadata to describe the Component. */
 BEGIN_COMPONENT_METADATA(vector_operations_service)
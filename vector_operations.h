@@ -23,253 +23,469 @@
 #define LOG_COMPONENT_TAG "community_vector"
 
 #include <mysql/components/component_implementation.h>
+#include <mysql/components/services/component_sys_var_service.h>
 #include <mysql/components/services/log_builtins.h> /* LogComponentErr */
 #include <mysql/components/services/mysql_runtime_error_service.h>
+#include <mysql/components/services/status_variable_registration.h>
 #include <mysql/components/services/udf_metadata.h>
 #include <mysql/components/services/udf_registration.h>
 #include <mysqld_error.h> /* Errors */
 
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <list>
-#include <sstream>
+#include <memory>
+#include <new>
 #include <string>
+#include <utility>
 #include <vector>
 
-#include "mysql/strings/m_ctype.h"
 #include "sql/field.h"
 #include "sql/sql_udf.h"
 #include "vector-common/vector_conversion.h"
-
-void populate_vector(uint32_t vec_dim, float *vec1,
-                     std::vector<float> &vector1) {
-  vector1.clear();
-  vector1.reserve(vec_dim);
-
-  for (uint32_t i = 0; i < vec_dim; i++) {
-    float value1;
-    memcpy(&value1, vec1 + i, sizeof(float));
-    vector1.push_back(value1);
+#include "vector_counters.h"
+#include "vector_expression.h"
+#include "vector_index.h"
+#include "vector_ivf.h"
+#include "vector_kernels.h"
+#include "vector_kmeans.h"
+#include "vector_parallel.h"
+#include "vector_pq.h"
+#include "vector_projection.h"
+#include "vector_quantization.h"
+#include "vector_registry.h"
+#include "vector_sparse.h"
+#include "vector_stats.h"
+#include "vector_text.h"
+
+/*
+  Per-statement result buffer of the element-wise vector UDFs.
+
+  It is created by the *_udf_init callbacks and stored in UDF_INIT::ptr. The
+  binary vector returned to the server is written directly in it; it is sized
+  on the first row and only grown again if a later row has more dimensions.
+*/
+class vector_result {
+ public:
+  static constexpr size_t alignment = 64;
+
+  ~vector_result() { std::free(m_buffer); }
+
+  /* Returns a buffer of at least `bytes` bytes or nullptr on OOM. */
+  char *reserve(size_t bytes) {
+    if (bytes <= m_capacity) return m_buffer;
+    size_t capacity = (bytes + alignment - 1) & ~(alignment - 1);
+    char *buffer = static_cast<char *>(std::aligned_alloc(alignment, capacity));
+    if (buffer == nullptr) return nullptr;
+    std::free(m_buffer);
+    m_buffer = buffer;
+    m_capacity = capacity;
+    return m_buffer;
   }
+
+ private:
+  char *m_buffer = nullptr;
+  size_t m_capacity = 0;
+};
+
+/*
+  Half precision vectors (VECTOR_TO_FP16, VECTOR_TO_BF16) are stored as a
+  4 bytes tag followed by 2 bytes per element. The tag is the bit pattern of
+  a float NaN, which a VECTOR never holds, so that a tagged vector is never
+  mistaken for a float one.
+*/
+static constexpr uint32_t fp16_vector_tag = 0x7fc0f160;
+static constexpr uint32_t bf16_vector_tag = 0x7fc0bf16;
+static constexpr size_t vector_tag_size = sizeof(uint32_t);
+
+/*
+  VECTOR_NORMALIZE returns unit vectors, stored as a 4 bytes tag, the L2 norm
+  the vector had before its normalization as a float, and the float elements.
+  Their norm being known, VECTOR_COSINE only computes the dot product when
+  both operands are normalized and a single norm when one of them is.
+*/
+static constexpr uint32_t normalized_vector_tag = 0x7fc0c05e;
+static constexpr size_t normalized_header_size =
+    vector_tag_size + sizeof(float);
+
+static inline bool vector_is_normalized(const char *arg,
+                                        unsigned long length) {
+  if (length < normalized_header_size) return false;
+  uint32_t tag;
+  memcpy(&tag, arg, sizeof(tag));
+  return tag == normalized_vector_tag;
 }
 
-std::string std_vector_to_string(const std::vector<float> &vec) {
-  std::ostringstream oss;
-  oss << "[";
+/* The norm stored in a normalized vector. */
+static inline float normalized_vector_norm(const char *arg) {
+  float norm;
+  memcpy(&norm, arg + vector_tag_size, sizeof(norm));
+  return norm;
+}
 
-  for (size_t i = 0; i < vec.size(); ++i) {
-    // Set precision and scientific notation
-    oss << std::scientific << vec[i];
+static inline vector_kernels::element_type vector_element_type(
+    const char *arg, unsigned long length) {
+  if (length < vector_tag_size) return vector_kernels::element_type::fp32;
+  uint32_t tag;
+  memcpy(&tag, arg, sizeof(tag));
+  if (tag == fp16_vector_tag) return vector_kernels::element_type::fp16;
+  if (tag == bf16_vector_tag) return vector_kernels::element_type::bf16;
+  return vector_kernels::element_type::fp32;
+}
 
-    // Add a comma if it's not the last element
-    if (i != vec.size() - 1) {
-      oss << ",";
-    }
+/*
+  Decodes a vector argument of any element type: returns its dimension
+  (UINT32_MAX if it is not a valid vector) and sets its type and the start of
+  its elements. A normalized vector decodes as the float unit vector, a
+  sparse vector is not a valid vector.
+*/
+static inline uint32_t vector_decode(const char *arg, unsigned long length,
+                                     vector_kernels::element_type *type,
+                                     const char **data) {
+  if (arg == nullptr || vector_sparse::is_sparse(arg, length))
+    return UINT32_MAX;
+  if (vector_is_normalized(arg, length)) {
+    *type = vector_kernels::element_type::fp32;
+    *data = arg + normalized_header_size;
+    return get_dimensions(length - normalized_header_size, sizeof(float));
   }
-
-  oss << "]";
-  return oss.str();
+  *type = vector_element_type(arg, length);
+  if (*type == vector_kernels::element_type::fp32) {
+    *data = arg;
+    return get_dimensions(length, sizeof(float));
+  }
+  *data = arg + vector_tag_size;
+  uint32_t vec_dim = get_dimensions(length - vector_tag_size, sizeof(uint16_t));
+  return vec_dim > Field_vector::max_dimensions ? UINT32_MAX : vec_dim;
 }
 
-static char *vector_addition(uint32_t vec_dim, float *vec1, float *vec2,
-                             unsigned long *length) {
-  std::vector<float> vector1;
-  std::vector<float> vector2;
-
-  populate_vector(vec_dim, vec1, vector1);
-  populate_vector(vec_dim, vec2, vector2);
-
-  std::vector<float> result(vector1.size());
-
-  const CHARSET_INFO *cs = &my_charset_utf8mb4_bin;
-
-  for (size_t i = 0; i < vector1.size(); ++i) {
-    result[i] = vector1[i] + vector2[i];
-  }
+/*
+  Dimension of a float vector argument, UINT32_MAX if it is NULL, invalid,
+  normalized, sparse or of a 16-bit element type; for the UDFs that only
+  compute on plain floats.
+*/
+static inline uint32_t float_vector_dimensions(const char *arg,
+                                               unsigned long length) {
+  if (arg == nullptr ||
+      vector_element_type(arg, length) != vector_kernels::element_type::fp32 ||
+      vector_is_normalized(arg, length) ||
+      vector_sparse::is_sparse(arg, length))
+    return UINT32_MAX;
+  return get_dimensions(length, sizeof(float));
+}
 
-  std::string result_str = std_vector_to_string(result);
-  char *result_cstr = result_str.data();
-  String vector_string;
-
-  uint32 output_dims = Field_vector::max_dimensions;
-  auto dimension_bytes = Field_vector::dimension_bytes(output_dims);
-  if (vector_string.mem_realloc(dimension_bytes)) return 0;
-
-  bool err = from_string_to_vector(cs, result_cstr, strlen(result_cstr),
-                                   vector_string.ptr(), &output_dims);
-
-  if (err) {
-    if (output_dims == Field_vector::max_dimensions) {
-      vector_string.replace(32, 5, "... \0", 5);
-      mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
-                                      ER_UDF_ERROR, 0, "vector_addition",
-                                      "Data out of range");
-    } else {
-      mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
-                                      ER_UDF_ERROR, 0, "vector_addition",
-                                      "Invalid vector conversion");
-    }
-    return 0;
+/*
+  True if none of the vec_dim floats at vec is NaN or infinite. The indexes
+  only take finite vectors: their distances must be ordered.
+*/
+static inline bool float_vector_is_finite(const char *vec, uint32_t vec_dim) {
+  for (uint32_t i = 0; i < vec_dim; i++) {
+    float value;
+    memcpy(&value, vec + i * sizeof(float), sizeof(float));
+    if (!std::isfinite(value)) return false;
   }
+  return true;
+}
 
-  size_t output_vector_length = Field_vector::dimension_bytes(output_dims);
-  vector_string.length(output_vector_length);
-  *length = output_vector_length;
-
-  return vector_string.c_ptr_safe();
+/* Size in bytes of a vector of vec_dim elements of the given type. */
+static inline size_t vector_bytes(vector_kernels::element_type type,
+                                  uint32_t vec_dim) {
+  if (type == vector_kernels::element_type::fp32)
+    return Field_vector::dimension_bytes(vec_dim);
+  return vector_tag_size + vec_dim * sizeof(uint16_t);
 }
 
-static char *vector_subtraction(uint32_t vec_dim, float *vec1, float *vec2,
-                                unsigned long *length) {
-  std::vector<float> vector1;
-  std::vector<float> vector2;
+/*
+  Writes the tag of `type` at the start of the result buffer and returns
+  where its elements go.
+*/
+static inline char *vector_elements(vector_kernels::element_type type,
+                                    char *buffer) {
+  if (type == vector_kernels::element_type::fp32) return buffer;
+  uint32_t tag = type == vector_kernels::element_type::fp16 ? fp16_vector_tag
+                                                            : bf16_vector_tag;
+  memcpy(buffer, &tag, sizeof(tag));
+  return buffer + vector_tag_size;
+}
 
-  populate_vector(vec_dim, vec1, vector1);
-  populate_vector(vec_dim, vec2, vector2);
+/* The kernels of a 16-bit element type. */
+static inline const vector_kernels::element_kernels &vector_half_kernels(
+    vector_kernels::element_type type) {
+  return type == vector_kernels::element_type::fp16
+             ? vector_kernels::active().fp16
+             : vector_kernels::active().bf16;
+}
 
-  std::vector<float> result(vector1.size());
+/*
+  A constant vector argument detected by a *_udf_init callback (the server
+  passes constant arguments to it already evaluated). It is validated and
+  copied once into an aligned buffer and its derived data is precomputed, so
+  that the per-row functions only decode the other arguments. A vector
+  registered by VECTOR_REGISTER is used in place, held until the statement
+  ends.
+*/
+struct vector_constant {
+  vector_result buffer;
+  std::shared_ptr<const vector_registry::entry> registered;
+  const char *data = nullptr;  // nullptr if the argument is not constant
+  uint32_t vec_dim = 0;
+  double norm_squared = 0;
+  bool has_zero = false;
+
+  /*
+    Caches args->args[arg] if it is a constant and valid float (or
+    normalized) vector; invalid constants are left to the per-row
+    validation. Returns true on OOM.
+  */
+  bool init(UDF_ARGS *args, unsigned int arg) {
+    data = nullptr;
+    if (args->args[arg] == nullptr || args->arg_type[arg] != STRING_RESULT)
+      return false;
+    vector_kernels::element_type type;
+    const char *elements;
+    uint32_t dim =
+        vector_decode(args->args[arg], args->lengths[arg], &type, &elements);
+    if (dim == UINT32_MAX || type != vector_kernels::element_type::fp32)
+      return false;
+
+    char *copy = buffer.reserve(args->lengths[arg]);
+    if (copy == nullptr) return true;
+    memcpy(copy, args->args[arg], args->lengths[arg]);
+    copy += elements - args->args[arg];
+
+    vec_dim = dim;
+    norm_squared = vector_is_normalized(args->args[arg], args->lengths[arg])
+                       ? 1
+                       : vector_kernels::active().dot(dim, copy, copy);
+    has_zero = false;
+    for (uint32_t i = 0; i < dim; i++) {
+      float value;
+      memcpy(&value, copy + i * sizeof(float), sizeof(float));
+      has_zero |= (value == 0);
+    }
+    data = copy;
+    return false;
+  }
 
-  const CHARSET_INFO *cs = &my_charset_utf8mb4_bin;
-  
-  for (size_t i = 0; i < vector1.size(); ++i) {
-    result[i] = vector1[i] - vector2[i];
+  /* Uses the registered vector `e`, already validated. */
+  void init(std::shared_ptr<const vector_registry::entry> e) {
+    registered = std::move(e);
+    vec_dim = registered->vec_dim;
+    norm_squared = registered->norm_squared;
+    has_zero = registered->has_zero;
+    data = registered->data();
+  }
+};
+
+/*
+  Per-statement state of the element-wise and distance UDFs, kept in
+  UDF_INIT::ptr: the result buffer and the first two vector operands, with
+  the cached form of the constant ones. The operands of VECTOR_ADDITION and
+  VECTOR_MULTIPLICATION after the second are cached the same way in
+  other_constants, and the others resolved on every row.
+*/
+struct vector_udf_state {
+  vector_result result;
+  vector_constant constants[2];
+  unsigned int args[2] = {0, 1};  // argument index of each vector operand
+  std::vector<const char *> operands;  // the third and next ones, if any
+  std::unique_ptr<vector_constant[]> other_constants;  // one per operand
+  /*
+    The float kernels for the dimension of the operands, specialized for it
+    if it is one of vector_kernels::specialized_dimensions. Selected by the
+    init callback if an operand is constant, else on the first row, and only
+    again if the dimension changes.
+  */
+  vector_kernels::dimension_kernels kernels{};
+};
+
+/*
+  Per-group state of the VECTOR_SUM and VECTOR_AVG aggregates, kept in
+  UDF_INIT::ptr. The double precision running sum is allocated on the first
+  row and reused, only zeroed, by every following group.
+*/
+struct vector_accumulator {
+  vector_result sum_buffer;
+  vector_result result;
+  double *sum = nullptr;
+  uint32_t vec_dim = 0;
+  unsigned long long count = 0;
+  bool failed = false;
+
+  void clear() {
+    vec_dim = 0;
+    count = 0;
+    failed = false;
   }
 
-  std::string result_str = std_vector_to_string(result);
-  char *result_cstr = result_str.data();
-  String vector_string;
-
-  uint32 output_dims = Field_vector::max_dimensions;
-  auto dimension_bytes = Field_vector::dimension_bytes(output_dims);
-  if (vector_string.mem_realloc(dimension_bytes)) return 0;
-
-  bool err = from_string_to_vector(cs, result_cstr, strlen(result_cstr),
-                                   vector_string.ptr(), &output_dims);
-
-  if (err) {
-    if (output_dims == Field_vector::max_dimensions) {
-      vector_string.replace(32, 5, "... \0", 5);
-      mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
-                                      ER_UDF_ERROR, 0, "vector_subtraction",
-                                      "Data out of range");
-    } else {
-      mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
-                                      ER_UDF_ERROR, 0, "vector_subtraction",
-                                      "Invalid vector conversion");
+  /* Starts a group of vec_dim dimensions; returns true on OOM. */
+  bool start(uint32_t dim) {
+    sum = reinterpret_cast<double *>(sum_buffer.reserve(dim * sizeof(double)));
+    if (sum == nullptr) return true;
+    memset(sum, 0, dim * sizeof(double));
+    vec_dim = dim;
+    return false;
+  }
+};
+
+/*
+  Bounded max-heap of the k nearest (distance, id) pairs seen so far. The root
+  is the farthest retained neighbor, so a row that is not nearer than it is
+  rejected with a single comparison and memory stays constant.
+*/
+class topk_heap {
+ public:
+  typedef std::pair<double, long long> entry;
+
+  /* Returns true on OOM. */
+  bool reserve(size_t k) {
+    try {
+      m_heap.reserve(k);
+    } catch (...) {
+      return true;
     }
-    return 0;
+    m_k = k;
+    return false;
   }
 
-  size_t output_vector_length = Field_vector::dimension_bytes(output_dims);
-  vector_string.length(output_vector_length);
-  *length = output_vector_length;
-
-  return vector_string.c_ptr_safe();
-}
-
-static char *vector_multiplication(uint32_t vec_dim, float *vec1, float *vec2,
-                                   unsigned long *length) {
-  std::vector<float> vector1;
-  std::vector<float> vector2;
+  void clear() { m_heap.clear(); }
 
-  populate_vector(vec_dim, vec1, vector1);
-  populate_vector(vec_dim, vec2, vector2);
+  size_t k() const { return m_k; }
 
-  std::vector<float> result(vector1.size());
-
-  const CHARSET_INFO *cs = &my_charset_utf8mb4_bin;
-
-  for (size_t i = 0; i < vector1.size(); ++i) {
-    result[i] = vector1[i] * vector2[i];
+  void push(double distance, long long id) {
+    entry candidate(distance, id);
+    if (m_heap.size() < m_k) {
+      m_heap.push_back(candidate);
+      std::push_heap(m_heap.begin(), m_heap.end());
+    } else if (m_k > 0 && candidate < m_heap.front()) {
+      std::pop_heap(m_heap.begin(), m_heap.end());
+      m_heap.back() = candidate;
+      std::push_heap(m_heap.begin(), m_heap.end());
+    }
   }
 
-  std::string result_str = std_vector_to_string(result);
-  char *result_cstr = result_str.data();
-  String vector_string;
-
-  uint32 output_dims = Field_vector::max_dimensions;
-  auto dimension_bytes = Field_vector::dimension_bytes(output_dims);
-  if (vector_string.mem_realloc(dimension_bytes)) return 0;
-
-  bool err = from_string_to_vector(cs, result_cstr, strlen(result_cstr),
-                                   vector_string.ptr(), &output_dims);
-
-  if (err) {
-    if (output_dims == Field_vector::max_dimensions) {
-      vector_string.replace(32, 5, "... \0", 5);
-      mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
-                                      ER_UDF_ERROR, 0, "vector_multiplication",
-                                      "Data out of range");
-    } else {
-      mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
-                                      ER_UDF_ERROR, 0, "vector_multiplication",
-                                      "Invalid vector conversion");
-    }
-    return 0;
+  /* Farthest retained distance, or +inf while fewer than k are kept. */
+  double bound() const {
+    return m_heap.size() < m_k ? HUGE_VAL : m_heap.front().first;
   }
 
-  size_t output_vector_length = Field_vector::dimension_bytes(output_dims);
-  vector_string.length(output_vector_length);
-  *length = output_vector_length;
+  /*
+    Sorts the retained entries by ascending distance. The heap must be
+    cleared before it is pushed to again.
+  */
+  const std::vector<entry> &sorted() {
+    std::sort_heap(m_heap.begin(), m_heap.end());
+    return m_heap;
+  }
 
-  return vector_string.c_ptr_safe();
+ private:
+  std::vector<entry> m_heap;
+  size_t m_k = 0;
+};
+
+/*
+  Writes neighbors as the JSON array [{"id": .., "distance": ..}, ..] into
+  `out`, leaving out the non-finite distances, which JSON cannot represent.
+  Returns the result pointer, or nullptr on OOM.
+*/
+static inline char *neighbors_to_json(const std::vector<topk_heap::entry> &list,
+                                      vector_result *out,
+                                      unsigned long *length) {
+  static constexpr size_t max_entry_length = 80;
+  char *buffer = out->reserve(2 + list.size() * max_entry_length);
+  if (buffer == nullptr) return nullptr;
+
+  char *pos = buffer;
+  *pos++ = '[';
+  for (size_t i = 0; i < list.size(); i++) {
+    if (!std::isfinite(list[i].first)) continue;
+    if (pos > buffer + 1) *pos++ = ',';
+    memcpy(pos, "{\"id\": ", 7);
+    pos = std::to_chars(pos + 7, pos + 7 + 20, list[i].second).ptr;
+    memcpy(pos, ", \"distance\": ", 14);
+    pos = std::to_chars(pos + 14, pos + 14 + 32, list[i].first).ptr;
+    *pos++ = '}';
+  }
+  *pos++ = ']';
+  *length = pos - buffer;
+  return buffer;
 }
 
-static char *vector_division(uint32_t vec_dim, float *vec1, float *vec2,
-                             unsigned long *length) {
-  std::vector<float> vector1;
-  std::vector<float> vector2;
+/*
+  The element-wise operations read both operands in place (the server gives no
+  alignment guarantee for args->args[]) and write the binary result to
+  `result`, using the kernels selected for the CPU at component init. The
+  operands and the result are all of element type `type`; float operands go
+  to `kernels`, which must be the ones for vec_dim.
+*/
+
+static inline vector_kernels::op_status vector_addition(
+    const vector_kernels::dimension_kernels &kernels,
+    vector_kernels::element_type type, uint32_t vec_dim, const char *vec1,
+    const char *vec2, char *result) {
+  if (type != vector_kernels::element_type::fp32)
+    return vector_half_kernels(type).addition(vec_dim, vec1, vec2, result);
+  return kernels.addition(vec_dim, vec1, vec2, result);
+}
 
-  populate_vector(vec_dim, vec1, vector1);
-  populate_vector(vec_dim, vec2, vector2);
+static inline vector_kernels::op_status vector_subtraction(
+    const vector_kernels::dimension_kernels &kernels,
+    vector_kernels::element_type type, uint32_t vec_dim, const char *vec1,
+    const char *vec2, char *result) {
+  if (type != vector_kernels::element_type::fp32)
+    return vector_half_kernels(type).subtraction(vec_dim, vec1, vec2, result);
+  return kernels.subtraction(vec_dim, vec1, vec2, result);
+}
 
-  std::vector<float> result(vector1.size());
+static inline vector_kernels::op_status vector_multiplication(
+    const vector_kernels::dimension_kernels &kernels,
+    vector_kernels::element_type type, uint32_t vec_dim, const char *vec1,
+    const char *vec2, char *result) {
+  if (type != vector_kernels::element_type::fp32)
+    return vector_half_kernels(type).multiplication(vec_dim, vec1, vec2,
+                                                    result);
+  return kernels.multiplication(vec_dim, vec1, vec2, result);
+}
 
-  const CHARSET_INFO *cs = &my_charset_utf8mb4_bin;
-  
-  for (size_t i = 0; i < vector1.size(); ++i) {
-    if (vector2[i] == 0) {
-      mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
-                                      ER_UDF_ERROR, 0, "vector_division",
-                                      "Division by zero is undefined");
-      return 0;
-    }
-    result[i] = vector1[i] / vector2[i];
-  }
+static inline vector_kernels::op_status vector_scale(uint32_t vec_dim,
+                                                     const char *vec, float s,
+                                                     char *result) {
+  return vector_kernels::active().scale(vec_dim, s, vec, vec, result);
+}
 
-  std::string result_str = std_vector_to_string(result);
-  char *result_cstr = result_str.data();
-  String vector_string;
-
-  uint32 output_dims = Field_vector::max_dimensions;
-  auto dimension_bytes = Field_vector::dimension_bytes(output_dims);
-  if (vector_string.mem_realloc(dimension_bytes)) return 0;
-
-  bool err = from_string_to_vector(cs, result_cstr, strlen(result_cstr),
-                                   vector_string.ptr(), &output_dims);
-
-  if (err) {
-    if (output_dims == Field_vector::max_dimensions) {
-      vector_string.replace(32, 5, "... \0", 5);
-      mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
-                                      ER_UDF_ERROR, 0, "vector_division",
-                                      "Data out of range");
-    } else {
-      mysql_error_service_emit_printf(mysql_service_mysql_runtime_error,
-                                      ER_UDF_ERROR, 0, "vector_division",
-                                      "Invalid vector conversion");
-    }
-    return 0;
-  }
+static inline vector_kernels::op_status vector_axpy(uint32_t vec_dim, float a,
+                                                    const char *x,
+                                                    const char *y,
+                                                    char *result) {
+  return vector_kernels::active().axpy(vec_dim, a, x, y, result);
+}
 
-  size_t output_vector_length = Field_vector::dimension_bytes(output_dims);
-  vector_string.length(output_vector_length);
-  *length = output_vector_length;
+static inline vector_kernels::op_status vector_lerp(uint32_t vec_dim,
+                                                    const char *a,
+                                                    const char *b, float t,
+                                                    char *result) {
+  return vector_kernels::active().lerp(vec_dim, t, a, b, result);
+}
 
-  return vector_string.c_ptr_safe();
+static inline vector_kernels::op_status vector_division(
+    const vector_kernels::dimension_kernels &kernels,
+    vector_kernels::element_type type, uint32_t vec_dim, const char *vec1,
+    const char *vec2, char *result) {
+  if (type != vector_kernels::element_type::fp32)
+    return vector_half_kernels(type).division(vec_dim, vec1, vec2, result);
+  return kernels.division(vec_dim, vec1, vec2, result);
 }
 
 extern REQUIRES_SERVICE_PLACEHOLDER(log_builtins);
 extern REQUIRES_SERVICE_PLACEHOLDER(log_builtins_string);
 extern REQUIRES_SERVICE_PLACEHOLDER(udf_registration);
+extern REQUIRES_SERVICE_PLACEHOLDER(udf_registration_aggregate);
 extern REQUIRES_SERVICE_PLACEHOLDER(mysql_udf_metadata);
 extern REQUIRES_SERVICE_PLACEHOLDER(mysql_runtime_error);
 
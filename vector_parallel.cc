@@ -0,0 +1,250 @@
+/* Copyright (c) 2017, 2024, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License, version 2.0, for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA */
+
+#include "vector_parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <new>
+#include <system_error>
+
+namespace vector_parallel {
+
+namespace {
+
+/* A range [begin, end) packed in 64 bits, to be updated atomically. */
+uint64_t range_pack(uint32_t begin, uint32_t end) {
+  return static_cast<uint64_t>(begin) << 32 | end;
+}
+
+uint32_t range_begin(uint64_t range) {
+  return static_cast<uint32_t>(range >> 32);
+}
+
+uint32_t range_size(uint64_t range) {
+  uint32_t begin = range_begin(range);
+  uint32_t end = static_cast<uint32_t>(range);
+  return begin < end ? end - begin : 0;
+}
+
+}  // namespace
+
+struct thread_pool::loop {
+  /* A participant's range, on its own cache line. */
+  struct alignas(64) range_slot {
+    std::atomic<uint64_t> range{0};
+  };
+
+  loop(unsigned participants, uint32_t count, uint32_t grain,
+       const loop_body &body)
+      : ranges(new range_slot[participants]),
+        participants(participants),
+        grain(grain),
+        body(body),
+        remaining(count) {
+    ranges[0].range.store(range_pack(0, count), std::memory_order_relaxed);
+  }
+
+  std::unique_ptr<range_slot[]> ranges;
+  const unsigned participants;
+  const uint32_t grain;
+  const loop_body &body;
+  unsigned joined = 1;                 // under m_lock, the caller is 0
+  std::atomic<uint32_t> remaining;     // elements not processed yet
+  std::atomic<bool> drained{false};    // nothing left to steal
+  std::atomic<bool> failed{false};     // a chunk threw, skip the others
+  std::mutex done_lock;
+  std::condition_variable done;
+  std::exception_ptr error;            // under done_lock, the first thrown
+
+  /* Takes the next chunk of the range of `participant`. */
+  bool take(unsigned participant, uint32_t *begin, uint32_t *end) {
+    std::atomic<uint64_t> &slot = ranges[participant].range;
+    uint64_t range = slot.load(std::memory_order_acquire);
+    for (;;) {
+      uint32_t size = range_size(range);
+      if (size == 0) return false;
+      uint32_t first = range_begin(range);
+      uint32_t chunk = std::min(size, grain);
+      if (slot.compare_exchange_weak(
+              range, range_pack(first + chunk, first + size),
+              std::memory_order_acq_rel, std::memory_order_acquire)) {
+        *begin = first;
+        *end = first + chunk;
+        return true;
+      }
+    }
+  }
+
+  /*
+    Moves the back half of the largest range of the others to the empty
+    range of `participant`. Returns false when no range is worth splitting,
+    its owner finishing a single chunk sooner alone.
+  */
+  bool steal(unsigned participant) {
+    for (;;) {
+      unsigned victim = participant;
+      uint64_t largest = 0;
+      for (unsigned i = 0; i < participants; i++) {
+        if (i == participant) continue;
+        uint64_t range = ranges[i].range.load(std::memory_order_acquire);
+        if (range_size(range) > range_size(largest)) {
+          victim = i;
+          largest = range;
+        }
+      }
+      uint32_t size = range_size(largest);
+      if (size <= grain) return false;
+
+      uint32_t first = range_begin(largest);
+      uint32_t middle = first + size / 2;
+      if (ranges[victim].range.compare_exchange_strong(
+              largest, range_pack(first, middle), std::memory_order_acq_rel,
+              std::memory_order_acquire)) {
+        ranges[participant].range.store(range_pack(middle, first + size),
+                                        std::memory_order_release);
+        return true;
+      }
+    }
+  }
+
+  /*
+    Processes chunks as `participant` until no work is left to take. An
+    exception thrown by the body is kept for the caller, and the chunks
+    taken after it are only counted as done.
+  */
+  void run(unsigned participant) {
+    uint32_t begin, end;
+    do {
+      while (take(participant, &begin, &end)) {
+        if (!failed.load(std::memory_order_relaxed)) {
+          try {
+            body(participant, begin, end);
+          } catch (...) {
+            std::lock_guard<std::mutex> guard(done_lock);
+            if (!error) error = std::current_exception();
+            failed.store(true, std::memory_order_relaxed);
+          }
+        }
+        if (remaining.fetch_sub(end - begin, std::memory_order_acq_rel) ==
+            end - begin) {
+          std::lock_guard<std::mutex> guard(done_lock);
+          done.notify_all();
+        }
+      }
+    } while (steal(participant));
+    drained.store(true, std::memory_order_relaxed);
+  }
+};
+
+thread_pool::thread_pool(unsigned threads) {
+  m_threads.reserve(threads);
+  for (unsigned i = 0; i < threads; i++) {
+    try {
+      m_threads.emplace_back(&thread_pool::worker, this);
+    } catch (const std::system_error &) {
+      break;
+    }
+  }
+}
+
+thread_pool::~thread_pool() {
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_stopping = true;
+  }
+  m_wakeup.notify_all();
+  for (std::thread &thread : m_threads) thread.join();
+}
+
+void thread_pool::parallel_for(uint32_t count, uint32_t grain,
+                               const loop_body &body) {
+  if (count == 0) return;
+  grain = std::max<uint32_t>(grain, 1);
+  std::shared_ptr<loop> work;
+  if (!m_threads.empty() && count > grain) {
+    try {
+      work = std::make_shared<loop>(participants(), count, grain, body);
+    } catch (const std::bad_alloc &) {
+      /* Runs on the caller only. */
+    }
+  }
+  if (!work) {
+    body(0, 0, count);
+    return;
+  }
+
+  /* Without room in the list, the workers are just not told about it. */
+  std::list<std::shared_ptr<loop>>::iterator position;
+  bool listed = false;
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    try {
+      position = m_loops.insert(m_loops.end(), work);
+      listed = true;
+    } catch (const std::bad_alloc &) {
+    }
+  }
+  if (listed) m_wakeup.notify_all();
+
+  work->run(0);
+  {
+    std::unique_lock<std::mutex> lock(work->done_lock);
+    work->done.wait(lock, [&work] {
+      return work->remaining.load(std::memory_order_acquire) == 0;
+    });
+  }
+
+  if (listed) {
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_loops.erase(position);
+  }
+  if (work->error) std::rethrow_exception(work->error);
+}
+
+void thread_pool::worker() {
+  std::unique_lock<std::mutex> lock(m_lock);
+  for (;;) {
+    std::shared_ptr<loop> work;
+    m_wakeup.wait(lock, [this, &work] {
+      if (m_stopping) return true;
+      for (const std::shared_ptr<loop> &candidate : m_loops) {
+        if (candidate->joined < candidate->participants &&
+            !candidate->drained.load(std::memory_order_relaxed)) {
+          work = candidate;
+          return true;
+        }
+      }
+      return false;
+    });
+    if (m_stopping) return;
+
+    unsigned participant = work->joined++;
+    lock.unlock();
+    work->run(participant);
+    work.reset();
+    lock.lock();
+  }
+}
+
+}  // namespace vector_parallel
@@ -0,0 +1,100 @@
+/* Copyright (c) 2017, 2024, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License, version 2.0, for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA */
+
+#ifndef VECTOR_PARALLEL_H
+#define VECTOR_PARALLEL_H
+
+/*
+  Worker threads owned by the component, running the loops of the batch UDFs
+  together with the connection thread calling them.
+
+  A loop over [0, count) starts as a single range owned by its caller. Every
+  participant, the caller or a worker that joined the loop, takes chunks from
+  the front of its own range and, once it is empty, steals the back half of
+  the largest range left. The work is so balanced without being split
+  beforehand, and the ranges are only updated with compare-and-swap: the pool
+  mutex just protects the list of the running loops.
+*/
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vector_parallel {
+
+/*
+  Body of a loop: processes the elements [begin, end) on behalf of
+  `participant`, numbered from 0 (the caller) to
+  thread_pool::participants() - 1. A participant never runs two chunks of a
+  loop at the same time.
+*/
+typedef std::function<void(unsigned participant, uint32_t begin, uint32_t end)>
+    loop_body;
+
+class thread_pool {
+ public:
+  /*
+    Starts `threads` workers, or as many as the system allows; with none the
+    loops run on their caller only.
+  */
+  explicit thread_pool(unsigned threads);
+
+  /* Stops and joins the workers; no loop may be running. */
+  ~thread_pool();
+
+  thread_pool(const thread_pool &) = delete;
+  thread_pool &operator=(const thread_pool &) = delete;
+
+  /* Largest number of participants of a loop: the workers and the caller. */
+  unsigned participants() const {
+    return static_cast<unsigned>(m_threads.size()) + 1;
+  }
+
+  /*
+    Runs body over [0, count) in chunks of at most `grain` elements and
+    returns once they are all processed. The loops of concurrent callers
+    share the workers; a loop of a single chunk runs on its caller only.
+    If the body throws, the chunks not started yet are skipped and the
+    first exception is rethrown here once all the chunks are done.
+  */
+  void parallel_for(uint32_t count, uint32_t grain, const loop_body &body);
+
+ private:
+  struct loop;
+
+  void worker();
+
+  std::vector<std::thread> m_threads;
+  std::mutex m_lock;  // m_loops, m_stopping
+  std::condition_variable m_wakeup;
+  std::list<std::shared_ptr<loop>> m_loops;
+  bool m_stopping = false;
+};
+
+}  // namespace vector_parallel
+
+#endif /* VECTOR_PARALLEL_H */
@@ -0,0 +1,135 @@
+/* Copyright (c) 2017, 2024, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License, version 2.0, for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA */
+
+#include "vector_pq.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "vector_kernels.h"
+#include "vector_kmeans.h"
+
+namespace vector_pq {
+
+namespace {
+
+constexpr uint64_t training_seed = 0x5eed;
+
+}  // namespace
+
+bool codebook::parse(const char *data, size_t length) {
+  if (data == nullptr || length < sizeof(codebook_header)) return true;
+  memcpy(&m_header, data, sizeof(m_header));
+  if (memcmp(m_header.magic, codebook_magic, sizeof(codebook_magic)) != 0 ||
+      m_header.m == 0 || m_header.vec_dim % m_header.m != 0 ||
+      m_header.centroids == 0 || m_header.centroids > max_centroids)
+    return true;
+  m_sub_dim = m_header.vec_dim / m_header.m;
+  if (length != sizeof(codebook_header) + size_t{m_header.m} *
+                                               m_header.centroids *
+                                               m_sub_dim * sizeof(float))
+    return true;
+  m_centroids = data + sizeof(codebook_header);
+  return false;
+}
+
+void codebook::encode(const char *vec, unsigned char *code) const {
+  const vector_kernels::kernel_table &kernels = vector_kernels::active();
+  for (uint32_t j = 0; j < m_header.m; j++) {
+    const char *sub = vec + size_t{j} * m_sub_dim * sizeof(float);
+    uint32_t best = 0;
+    double best_distance = HUGE_VAL;
+    for (uint32_t c = 0; c < m_header.centroids; c++) {
+      double d = kernels.l2_squared(m_sub_dim, sub, centroid(j, c));
+      if (d < best_distance) {
+        best_distance = d;
+        best = c;
+      }
+    }
+    code[j] = static_cast<unsigned char>(best);
+  }
+}
+
+void codebook::distance_table(const char *query, float *table) const {
+  const vector_kernels::kernel_table &kernels = vector_kernels::active();
+  for (uint32_t j = 0; j < m_header.m; j++) {
+    const char *sub = query + size_t{j} * m_sub_dim * sizeof(float);
+    float *row = table + size_t{j} * max_centroids;
+    for (uint32_t c = 0; c < m_header.centroids; c++)
+      row[c] = static_cast<float>(
+          kernels.l2_squared(m_sub_dim, sub, centroid(j, c)));
+    /* Codes of another codebook cannot point past the centroids. */
+    std::fill(row + m_header.centroids, row + max_centroids, HUGE_VALF);
+  }
+}
+
+void trainer::start(uint32_t vec_dim, uint32_t m, size_t sample_bytes) {
+  reset();
+  m_vec_dim = vec_dim;
+  m_m = m;
+  /* Only the sample is used: the subspaces are clustered by finish(). */
+  m_sample.start(vec_dim, max_centroids, training_iterations, 1,
+                 sample_bytes);
+}
+
+void trainer::add(const char *vec) { m_sample.add(vec); }
+
+void trainer::finish(vector_parallel::thread_pool *workers,
+                     std::vector<char> *out) {
+  out->clear();
+  const size_t n = m_sample.sample_size();
+  if (n == 0) return;
+  const float *sample = m_sample.sample();
+
+  codebook_header header;
+  memcpy(header.magic, codebook_magic, sizeof(codebook_magic));
+  header.vec_dim = m_vec_dim;
+  header.m = m_m;
+  header.centroids = static_cast<uint32_t>(std::min<size_t>(n, max_centroids));
+  const uint32_t sub_dim = m_vec_dim / m_m;
+  const size_t codebook_floats = size_t{header.centroids} * sub_dim;
+  out->resize(sizeof(header) + m_m * codebook_floats * sizeof(float));
+  memcpy(out->data(), &header, sizeof(header));
+
+  /* Trains every subspace on the sample of its sub-vectors. */
+  std::vector<float> sub_sample(n * sub_dim);
+  std::vector<float> centroids(codebook_floats);
+  for (uint32_t j = 0; j < m_m; j++) {
+    for (size_t i = 0; i < n; i++)
+      memcpy(&sub_sample[i * sub_dim], &sample[i * m_vec_dim + j * sub_dim],
+             sub_dim * sizeof(float));
+    vector_kmeans::cluster(workers, sub_dim, sub_sample.data(), n,
+                           header.centroids, training_iterations,
+                           training_seed + j, centroids.data());
+    memcpy(out->data() + sizeof(header) + j * codebook_floats * sizeof(float),
+           centroids.data(), codebook_floats * sizeof(float));
+  }
+}
+
+void trainer::reset() {
+  m_vec_dim = 0;
+  m_m = 0;
+  m_sample.reset();
+}
+
+}  // namespace vector_pq
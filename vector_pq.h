@@ -0,0 +1,146 @@
+/* Copyright (c) 2017, 2024, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License, version 2.0, for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA */
+
+#ifndef VECTOR_PQ_H
+#define VECTOR_PQ_H
+
+/*
+  Product quantization of float vectors.
+
+  A vector of vec_dim dimensions is split into m sub-vectors of vec_dim / m
+  dimensions, each replaced by the byte number of its nearest centroid in the
+  codebook of its subspace: the code of a vector is m bytes, 4 * vec_dim / m
+  times smaller than the floats. The codebooks are trained by k-means over a
+  sample of the vectors.
+
+  The codebooks are a VARBINARY value, a codebook_header followed by the
+  centroids float centroids[m][centroids][vec_dim / m].
+
+  The distance of a query to a code is estimated asymmetrically, from the
+  exact query: a table of the squared L2 distances of each query sub-vector
+  to every centroid of its subspace is computed once per query, after which
+  the distance to a code only takes m table lookups.
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "vector_kmeans.h"
+#include "vector_parallel.h"
+
+namespace vector_pq {
+
+constexpr char codebook_magic[4] = {'V', 'P', 'Q', '1'};
+
+/* Centroids of a subspace, numbered by a byte. */
+constexpr uint32_t max_centroids = 256;
+
+struct codebook_header {
+  char magic[4];
+  uint32_t vec_dim;
+  uint32_t m;
+  uint32_t centroids;  // per subspace
+};
+
+/* A codebook value, validated by parse(). */
+class codebook {
+ public:
+  /*
+    Reads the codebook at `data`, which must outlive this object. Returns
+    true if it is not a valid codebook.
+  */
+  bool parse(const char *data, size_t length);
+
+  uint32_t dimensions() const { return m_header.vec_dim; }
+  uint32_t subspaces() const { return m_header.m; }
+
+  /* Writes the m bytes code of `vec` (vec_dim floats) to `code`. */
+  void encode(const char *vec, unsigned char *code) const;
+
+  /*
+    Fills table[j * max_centroids + c] with the squared L2 distance of the
+    sub-vector j of `query` to the centroid c of subspace j; table has room
+    for m * max_centroids floats.
+  */
+  void distance_table(const char *query, float *table) const;
+
+ private:
+  const char *centroid(uint32_t subspace, uint32_t c) const {
+    return m_centroids + (size_t{subspace} * m_header.centroids + c) *
+                             m_sub_dim * sizeof(float);
+  }
+
+  codebook_header m_header{};
+  uint32_t m_sub_dim = 0;
+  const char *m_centroids = nullptr;
+};
+
+/* The estimated squared L2 distance of a code to the query of `table`. */
+inline float adc_distance(const float *table, uint32_t m,
+                          const unsigned char *code) {
+  float sum0 = 0, sum1 = 0;
+  uint32_t j = 0;
+  for (; j + 2 <= m; j += 2) {
+    sum0 += table[j * max_centroids + code[j]];
+    sum1 += table[(j + 1) * max_centroids + code[j + 1]];
+  }
+  if (j < m) sum0 += table[j * max_centroids + code[j]];
+  return sum0 + sum1;
+}
+
+/*
+  Trains the codebooks of a stream of vectors, keeping a sample of them in
+  memory in a vector_kmeans::clustering.
+*/
+class trainer {
+ public:
+  static constexpr uint32_t training_iterations = 10;
+
+  /* The training sample takes at most sample_bytes. */
+  void start(uint32_t vec_dim, uint32_t m, size_t sample_bytes);
+
+  bool started() const { return m_vec_dim != 0; }
+  uint32_t dimensions() const { return m_vec_dim; }
+
+  /* Adds a vector of vec_dim floats. Throws std::bad_alloc on OOM. */
+  void add(const char *vec);
+
+  /*
+    Writes the codebook trained on the sample by vector_kmeans, on the
+    threads of `workers`, to `out`; nothing if no vector was added. Throws
+    std::bad_alloc on OOM.
+  */
+  void finish(vector_parallel::thread_pool *workers, std::vector<char> *out);
+
+  /* Discards the vectors added. */
+  void reset();
+
+ private:
+  uint32_t m_vec_dim = 0;
+  uint32_t m_m = 0;
+  vector_kmeans::clustering m_sample;
+};
+
+}  // namespace vector_pq
+
+#endif /* VECTOR_PQ_H */
@@ -0,0 +1,116 @@
+/* Copyright (c) 2017, 2024, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License, version 2.0, for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA */
+
+#include "vector_projection.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <new>
+
+namespace vector_projection {
+
+namespace {
+
+/* Columns of a block, 8 KiB of the projected vector. */
+constexpr uint32_t block_cols = 2048;
+
+}  // namespace
+
+matrix::matrix(uint32_t rows, uint32_t cols, const char *data)
+    : m_rows(rows), m_cols(cols) {
+  using vector_kernels::panel_rows;
+  size_t panels = (rows + panel_rows - 1) / panel_rows;
+  size_t bytes = panels * panel_rows * cols * sizeof(float);
+  m_panels.reset(static_cast<float *>(std::aligned_alloc(64, bytes)));
+  if (m_panels == nullptr) throw std::bad_alloc();
+
+  float *out = m_panels.get();
+  for (size_t p = 0; p < panels; p++) {
+    for (uint32_t j = 0; j < cols; j++) {
+      for (uint32_t r = 0; r < panel_rows; r++) {
+        size_t row = p * panel_rows + r;
+        if (row < rows)
+          memcpy(out, data + (row * cols + j) * sizeof(float), sizeof(float));
+        else
+          *out = 0;
+        out++;
+      }
+    }
+  }
+}
+
+vector_kernels::op_status matrix::project(const char *vec,
+                                          char *result) const {
+  using vector_kernels::panel_rows;
+  const vector_kernels::panel_gemv_fn gemv =
+      vector_kernels::active().panel_gemv;
+  uint32_t full_panels = m_rows / panel_rows;
+  uint32_t panels = (m_rows + panel_rows - 1) / panel_rows;
+  float *out = reinterpret_cast<float *>(result);
+  float last[panel_rows] = {};  // the rows of the padded panel
+  std::fill(out, out + full_panels * panel_rows, 0.0f);
+
+  for (uint32_t start = 0; start < m_cols; start += block_cols) {
+    uint32_t cols = std::min(block_cols, m_cols - start);
+    const char *block = vec + start * sizeof(float);
+    for (uint32_t p = 0; p < panels; p++) {
+      const float *panel =
+          m_panels.get() + (size_t{p} * m_cols + start) * panel_rows;
+      gemv(cols, panel, block, p < full_panels ? out + p * panel_rows : last);
+    }
+  }
+  memcpy(out + full_panels * panel_rows, last,
+         (m_rows - full_panels * panel_rows) * sizeof(float));
+
+  bool finite = true;
+  for (uint32_t r = 0; r < m_rows; r++) finite &= std::isfinite(out[r]);
+  return finite ? vector_kernels::op_status::ok
+                : vector_kernels::op_status::out_of_range;
+}
+
+std::shared_ptr<const matrix> registry::find(const std::string &name) const {
+  std::shared_lock<std::shared_mutex> guard(m_lock);
+  auto it = m_matrices.find(name);
+  return it == m_matrices.end() ? nullptr : it->second;
+}
+
+void registry::store(const std::string &name, std::shared_ptr<const matrix> m) {
+  std::shared_ptr<const matrix> previous;
+  std::unique_lock<std::shared_mutex> guard(m_lock);
+  std::shared_ptr<const matrix> &slot = m_matrices[name];
+  previous = std::move(slot);
+  slot = std::move(m);
+}
+
+bool registry::drop(const std::string &name) {
+  std::shared_ptr<const matrix> m;
+  std::unique_lock<std::shared_mutex> guard(m_lock);
+  auto it = m_matrices.find(name);
+  if (it == m_matrices.end()) return true;
+  m = std::move(it->second);
+  m_matrices.erase(it);
+  return false;
+}
+
+}  // namespace vector_projection
@@ -0,0 +1,104 @@
+/* Copyright (c) 2017, 2024, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License, version 2.0, for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA */
+
+#ifndef VECTOR_PROJECTION_H
+#define VECTOR_PROJECTION_H
+
+/*
+  Named projection matrices of VECTOR_PROJECTION_LOAD and VECTOR_PROJECT,
+  kept in memory while the component is installed.
+
+  A matrix of rows x cols maps a vector of cols dimensions to rows
+  dimensions. It is repacked once, when it is loaded, into panels of
+  vector_kernels::panel_rows rows stored column after column in a 64-byte
+  aligned buffer, the last panel padded with zero rows. A projection runs
+  the panel kernel over blocks of columns: every block of the vector stays
+  in L1 while the panels are streamed through it, each matrix element being
+  read once.
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+#include "vector_kernels.h"
+
+namespace vector_projection {
+
+class matrix {
+ public:
+  /*
+    Repacks the rows x cols floats of `data`, stored row after row. Throws
+    std::bad_alloc on OOM.
+  */
+  matrix(uint32_t rows, uint32_t cols, const char *data);
+
+  matrix(const matrix &) = delete;
+  matrix &operator=(const matrix &) = delete;
+
+  uint32_t rows() const { return m_rows; }
+  uint32_t cols() const { return m_cols; }
+
+  /*
+    Writes the rows floats of the product of the matrix by the vector of
+    cols floats `vec` to `result`. Returns op_status::out_of_range if one of
+    them is not finite.
+  */
+  vector_kernels::op_status project(const char *vec, char *result) const;
+
+ private:
+  struct free_deleter {
+    void operator()(float *p) const { std::free(p); }
+  };
+
+  uint32_t m_rows;
+  uint32_t m_cols;
+  std::unique_ptr<float[], free_deleter> m_panels;
+};
+
+class registry {
+ public:
+  /* The matrix named `name`, or nullptr if it does not exist. */
+  std::shared_ptr<const matrix> find(const std::string &name) const;
+
+  /*
+    Stores a matrix under `name`, replacing the previous one, which is
+    released once the projections still using it are done. Throws
+    std::bad_alloc on OOM.
+  */
+  void store(const std::string &name, std::shared_ptr<const matrix> m);
+
+  /* Removes the matrix; returns true if it does not exist. */
+  bool drop(const std::string &name);
+
+ private:
+  mutable std::shared_mutex m_lock;
+  std::unordered_map<std::string, std::shared_ptr<const matrix>> m_matrices;
+};
+
+}  // namespace vector_projection
+
+#endif /* VECTOR_PROJECTION_H */
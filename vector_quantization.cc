@@ -0,0 +1,146 @@
+/* Copyright (c) 2017, 2024, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License, version 2.0, for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA */
+
+
+#include "vector_quantization.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "vector_kernels.h"
+
+namespace vector_quantization {
+
+namespace {
+
+inline float load_float(const char *vec, uint32_t i) {
+  float value;
+  memcpy(&value, vec + i * sizeof(float), sizeof(float));
+  return value;
+}
+
+inline int8_header load_header(const char *code) {
+  int8_header header;
+  memcpy(&header, code, sizeof(header));
+  return header;
+}
+
+}  // namespace
+
+bool format_from_name(const char *name, size_t length, format *f) {
+  static const struct {
+    const char *name;
+    format value;
+  } names[] = {{"INT8", format::int8}, {"BINARY", format::binary}};
+
+  for (const auto &entry : names) {
+    if (vector_kernels::name_equals(name, length, entry.name)) {
+      *f = entry.value;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool quantize_int8(uint32_t vec_dim, const char *vec, char *code) {
+  float min = load_float(vec, 0), max = min;
+  for (uint32_t i = 1; i < vec_dim; i++) {
+    float value = load_float(vec, i);
+    min = std::min(min, value);
+    max = std::max(max, value);
+  }
+  if (!std::isfinite(min) || !std::isfinite(max)) return true;
+
+  /* Halved before the difference, which could overflow. */
+  int8_header header;
+  header.offset = min / 2 + max / 2;
+  header.scale = (max / 2 - min / 2) / 127;
+  header.sum = 0;
+  header.sum_squares = 0;
+
+  int8_t *codes = reinterpret_cast<int8_t *>(code + int8_header_size);
+  const float inverse = header.scale > 0 ? 1 / header.scale : 0;
+  for (uint32_t i = 0; i < vec_dim; i++) {
+    float q = std::nearbyint((load_float(vec, i) - header.offset) * inverse);
+    int32_t c = static_cast<int32_t>(std::clamp(q, -127.0f, 127.0f));
+    codes[i] = static_cast<int8_t>(c);
+    header.sum += c;
+    header.sum_squares += c * c;
+  }
+  memcpy(code, &header, sizeof(header));
+  return false;
+}
+
+void dequantize_int8(uint32_t vec_dim, const char *code, char *vec) {
+  const int8_header header = load_header(code);
+  const int8_t *codes =
+      reinterpret_cast<const int8_t *>(code + int8_header_size);
+  for (uint32_t i = 0; i < vec_dim; i++) {
+    float value = header.offset + header.scale * codes[i];
+    memcpy(vec + i * sizeof(float), &value, sizeof(float));
+  }
+}
+
+void quantize_binary(uint32_t vec_dim, const char *vec, char *code) {
+  memset(code, 0, binary_bytes(vec_dim));
+  for (uint32_t i = 0; i < vec_dim; i++) {
+    if (load_float(vec, i) > 0) code[i / 8] |= static_cast<char>(1 << (i % 8));
+  }
+}
+
+/*
+  With x[i] = o1 + s1 * p[i] and y[i] = o2 + s2 * q[i]:
+  x.y = n o1 o2 + o1 s2 sum(q) + o2 s1 sum(p) + s1 s2 p.q
+*/
+double int8_dot(uint32_t vec_dim, const char *code1, const char *code2) {
+  const int8_header h1 = load_header(code1);
+  const int8_header h2 = load_header(code2);
+  const double dot = static_cast<double>(vector_kernels::active().int8_dot(
+      vec_dim, code1 + int8_header_size, code2 + int8_header_size));
+  return static_cast<double>(vec_dim) * h1.offset * h2.offset +
+         static_cast<double>(h1.offset) * h2.scale * h2.sum +
+         static_cast<double>(h2.offset) * h1.scale * h1.sum +
+         static_cast<double>(h1.scale) * h2.scale * dot;
+}
+
+/*
+  With d = o1 - o2, |x - y|^2 = sum((d + s1 p[i] - s2 q[i])^2)
+  = n d^2 + 2 d (s1 sum(p) - s2 sum(q)) + s1^2 sum(p^2) + s2^2 sum(q^2)
+    - 2 s1 s2 p.q
+  which does not cancel out large offsets.
+*/
+double int8_l2_squared(uint32_t vec_dim, const char *code1,
+                       const char *code2) {
+  const int8_header h1 = load_header(code1);
+  const int8_header h2 = load_header(code2);
+  const double dot = static_cast<double>(vector_kernels::active().int8_dot(
+      vec_dim, code1 + int8_header_size, code2 + int8_header_size));
+  const double d = static_cast<double>(h1.offset) - h2.offset;
+  const double s1 = h1.scale, s2 = h2.scale;
+  double l2 = vec_dim * d * d + 2 * d * (s1 * h1.sum - s2 * h2.sum) +
+              s1 * s1 * h1.sum_squares + s2 * s2 * h2.sum_squares -
+              2 * s1 * s2 * dot;
+  return std::max(l2, 0.0);
+}
+
+}  // namespace vector_quantization
@@ -0,0 +1,97 @@
+/* Copyright (c) 2017, 2024, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License, version 2.0, for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA */
+
+
+#ifndef VECTOR_QUANTIZATION_H
+#define VECTOR_QUANTIZATION_H
+
+/*
+  Quantized codes of float vectors, stored as VARBINARY.
+
+  An int8 code is an int8_header followed by one signed byte per dimension,
+  element i standing for offset + scale * code[i]; the header also keeps the
+  sum and the sum of squares of the codes, so the distances between two codes
+  only need their integer dot product. The codes span [-127, 127] over the
+  [min, max] range of the vector: 4x smaller than the floats.
+
+  A binary code keeps the sign of every element, bit i of the code (least
+  significant bit first) being set if element i is positive: 32x smaller than
+  the floats, compared by Hamming distance.
+*/
+
+#include <cstddef>
+#include <cstdint>
+
+namespace vector_quantization {
+
+enum class format { int8, binary };
+
+/*
+  Parses a case-insensitive format name: INT8 or BINARY. Returns true if the
+  name is unknown.
+*/
+bool format_from_name(const char *name, size_t length, format *f);
+
+struct int8_header {
+  float scale;
+  float offset;
+  int32_t sum;          // sum(code[i])
+  int32_t sum_squares;  // sum(code[i]^2)
+};
+
+constexpr size_t int8_header_size = sizeof(int8_header);
+
+inline size_t int8_bytes(uint32_t vec_dim) {
+  return int8_header_size + vec_dim;
+}
+
+/* Dimension of an int8 code of `length` bytes, UINT32_MAX if invalid. */
+inline uint32_t int8_dimensions(size_t length) {
+  if (length <= int8_header_size || length - int8_header_size >= UINT32_MAX)
+    return UINT32_MAX;
+  return static_cast<uint32_t>(length - int8_header_size);
+}
+
+inline size_t binary_bytes(uint32_t vec_dim) { return (vec_dim + 7) / 8; }
+
+/*
+  Encodes vec_dim floats into int8_bytes(vec_dim) bytes of code. Returns true
+  if the vector has a non-finite element.
+*/
+bool quantize_int8(uint32_t vec_dim, const char *vec, char *code);
+
+/* Decodes an int8 code of vec_dim dimensions into vec_dim floats. */
+void dequantize_int8(uint32_t vec_dim, const char *code, char *vec);
+
+/* Encodes vec_dim floats into binary_bytes(vec_dim) bytes of code. */
+void quantize_binary(uint32_t vec_dim, const char *vec, char *code);
+
+/* Dot product of the vectors encoded by two int8 codes of vec_dim dims. */
+double int8_dot(uint32_t vec_dim, const char *code1, const char *code2);
+
+/* Squared L2 distance of the vectors encoded by two int8 codes. */
+double int8_l2_squared(uint32_t vec_dim, const char *code1,
+                       const char *code2);
+
+}  // namespace vector_quantization
+
+#endif /* VECTOR_QUANTIZATION_H */
@@ -0,0 +1,52 @@
+/* Copyright (c) 2017, 2024, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License, version 2.0, for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA */
+
+
+#ifndef VECTOR_RANDOM_H
+#define VECTOR_RANDOM_H
+
+/*
+  The pseudo-random numbers of the component: splitmix64 (Steele, Lea and
+  Flood, "Fast splittable pseudorandom number generators"), cheap, good
+  enough for sampling and deterministic for a given seed.
+*/
+
+#include <cstdint>
+
+namespace vector_random {
+
+/* The next 64 random bits of the sequence whose state is *state. */
+inline uint64_t next(uint64_t *state) {
+  uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+/* A uniform double in [0, 1). */
+inline double next_uniform(uint64_t *state) {
+  return static_cast<double>(next(state) >> 11) * 0x1p-53;
+}
+
+}  // namespace vector_random
+
+#endif /* VECTOR_RANDOM_H */
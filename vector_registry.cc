@@ -0,0 +1,93 @@
+/* Copyright (c) 2017, 2024, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License, version 2.0, for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA */
+
+#include "vector_registry.h"
+
+#include <thread>
+
+namespace vector_registry {
+
+registry::registry()
+    : m_current(new snapshot()),
+      m_counters(new reader_counters[reader_shards]()) {}
+
+registry::~registry() { delete m_current.load(); }
+
+uint32_t registry::shard() {
+  static std::atomic<uint32_t> next_shard{0};
+  thread_local const uint32_t shard =
+      next_shard.fetch_add(1, std::memory_order_relaxed) % reader_shards;
+  return shard;
+}
+
+std::shared_ptr<const entry> registry::find(const std::string &name) const {
+  /*
+    The increment is ordered before the load of the snapshot: a writer that
+    finds the counter at zero after switching the epoch has published its
+    snapshot before this reader loads one.
+  */
+  std::atomic<uint64_t> &readers =
+      m_counters[shard()].readers[m_epoch.load() & 1];
+  readers.fetch_add(1);
+  const snapshot *current = m_current.load();
+  std::shared_ptr<const entry> found;
+  auto it = current->find(name);
+  if (it != current->end()) found = it->second;
+  readers.fetch_sub(1, std::memory_order_release);
+  return found;
+}
+
+void registry::publish(snapshot *next) {
+  const snapshot *previous = m_current.exchange(next);
+  /*
+    A reader may have read the epoch before the previous switch and only
+    then announced itself, under the parity that is current again: switching
+    twice, waiting each time for the parity left, waits for it too.
+  */
+  for (int pass = 0; pass < 2; pass++) {
+    uint64_t epoch = m_epoch.fetch_add(1);
+    for (uint32_t s = 0; s < reader_shards; s++) {
+      while (m_counters[s].readers[epoch & 1].load() != 0)
+        std::this_thread::yield();
+    }
+  }
+  delete previous;
+}
+
+void registry::store(const std::string &name, std::shared_ptr<const entry> e) {
+  std::lock_guard<std::mutex> guard(m_write_lock);
+  std::unique_ptr<snapshot> next(new snapshot(*m_current.load()));
+  (*next)[name] = std::move(e);
+  publish(next.release());
+}
+
+bool registry::drop(const std::string &name) {
+  std::lock_guard<std::mutex> guard(m_write_lock);
+  const snapshot *current = m_current.load();
+  if (current->find(name) == current->end()) return true;
+  std::unique_ptr<snapshot> next(new snapshot(*current));
+  next->erase(name);
+  publish(next.release());
+  return false;
+}
+
+}  // namespace vector_registry
@@ -0,0 +1,109 @@
+/* Copyright (c) 2017, 2024, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License, version 2.0, for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA */
+
+#ifndef VECTOR_REGISTRY_H
+#define VECTOR_REGISTRY_H
+
+/*
+  Named vectors of VECTOR_REGISTER, kept in memory while the component is
+  installed and passed by name to the other functions.
+
+  The lookups run on every statement using a name while the vectors rarely
+  change, so the registry is read-copy-update: the map of the names is an
+  immutable snapshot replaced as a whole by the writers, which are
+  serialized by a mutex. A reader takes no lock: it announces itself in the
+  counter of the current epoch in its reader shard, loads the snapshot and
+  copies the shared pointer of the vector it looks for before leaving.
+  After publishing a new snapshot, a writer switches the epoch twice,
+  waiting each time for the counters of the previous epoch to drain, before
+  freeing the old snapshot; the vectors themselves are freed when their last
+  user is done.
+*/
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace vector_registry {
+
+/* A registered vector, with what the functions cache of a constant. */
+struct entry {
+  std::vector<char> value;  // the vector as given to VECTOR_REGISTER
+  size_t elements = 0;      // offset of the float elements in value
+  uint32_t vec_dim = 0;
+  double norm_squared = 0;
+  bool has_zero = false;
+
+  const char *data() const { return value.data() + elements; }
+};
+
+/* Readers updating distinct counters. */
+constexpr uint32_t reader_shards = 32;
+
+class registry {
+ public:
+  registry();
+  ~registry();
+
+  registry(const registry &) = delete;
+  registry &operator=(const registry &) = delete;
+
+  /* The vector named `name`, or nullptr if it does not exist. */
+  std::shared_ptr<const entry> find(const std::string &name) const;
+
+  /*
+    Stores a vector under `name`, replacing the previous one. Throws
+    std::bad_alloc on OOM.
+  */
+  void store(const std::string &name, std::shared_ptr<const entry> e);
+
+  /* Removes the vector; returns true if it does not exist. */
+  bool drop(const std::string &name);
+
+ private:
+  typedef std::unordered_map<std::string, std::shared_ptr<const entry>>
+      snapshot;
+
+  struct alignas(64) reader_counters {
+    std::atomic<uint64_t> readers[2];  // by epoch parity
+  };
+
+  /* The reader shard of the calling thread. */
+  static uint32_t shard();
+
+  /* Publishes `next` and frees the previous snapshot; m_write_lock held. */
+  void publish(snapshot *next);
+
+  std::atomic<const snapshot *> m_current;
+  std::atomic<uint64_t> m_epoch{0};
+  std::unique_ptr<reader_counters[]> m_counters;
+  std::mutex m_write_lock;
+};
+
+}  // namespace vector_registry
+
+#endif /* VECTOR_REGISTRY_H */
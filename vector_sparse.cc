@@ -0,0 +1,276 @@
+/* Copyright (c) 2017, 2024, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License, version 2.0, for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA */
+
+#include "vector_sparse.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <system_error>
+
+namespace vector_sparse {
+
+namespace {
+
+/* Sizes ratio from which dot() gallops through the larger vector. */
+constexpr uint32_t galloping_ratio = 8;
+
+uint32_t read_uint32(const char *p) {
+  uint32_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+float read_float(const char *p) {
+  float value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+/*
+  The first i in [begin, v.nnz) with v.index(i) >= index, v.nnz if none:
+  doubles the step from begin until passing index, then bisects the last
+  step.
+*/
+uint32_t gallop(const view &v, uint32_t begin, uint32_t index) {
+  uint32_t low = begin;
+  uint32_t high = begin;
+  uint32_t step = 1;
+  while (high < v.nnz && v.index(high) < index) {
+    low = high + 1;
+    high = v.nnz - high > step ? high + step : v.nnz;
+    step = std::min<uint32_t>(step, UINT32_MAX / 2) * 2;
+  }
+  while (low < high) {
+    uint32_t middle = low + (high - low) / 2;
+    if (v.index(middle) < index)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  return low;
+}
+
+bool is_space(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+const char *skip_spaces(const char *pos, const char *end) {
+  while (pos < end && is_space(*pos)) pos++;
+  return pos;
+}
+
+}  // namespace
+
+bool view::parse(const char *data, size_t length) {
+  if (!is_sparse(data, length) ||
+      (length - header_size) % (sizeof(uint32_t) + sizeof(float)) != 0 ||
+      (length - header_size) / (sizeof(uint32_t) + sizeof(float)) >
+          max_dimensions)
+    return true;
+  dimensions = read_uint32(data + sizeof(uint32_t));
+  nnz = static_cast<uint32_t>((length - header_size) /
+                              (sizeof(uint32_t) + sizeof(float)));
+  indexes = data + header_size;
+  values = indexes + size_t{nnz} * sizeof(uint32_t);
+  if (dimensions == 0 || dimensions > max_dimensions || nnz > dimensions)
+    return true;
+  uint32_t previous = 0;
+  for (uint32_t i = 0; i < nnz; i++) {
+    uint32_t current = index(i);
+    if (current >= dimensions || (i > 0 && current <= previous)) return true;
+    previous = current;
+  }
+  return false;
+}
+
+uint32_t view::index(uint32_t i) const {
+  return read_uint32(indexes + size_t{i} * sizeof(uint32_t));
+}
+
+float view::value(uint32_t i) const {
+  return read_float(values + size_t{i} * sizeof(float));
+}
+
+writer::writer(char *out, uint32_t dimensions, uint32_t capacity)
+    : m_out(out), m_capacity(capacity) {
+  memcpy(out, &sparse_vector_tag, sizeof(uint32_t));
+  memcpy(out + sizeof(uint32_t), &dimensions, sizeof(uint32_t));
+}
+
+void writer::append(uint32_t index, float value) {
+  char *indexes = m_out + header_size;
+  char *values = indexes + size_t{m_capacity} * sizeof(uint32_t);
+  memcpy(indexes + size_t{m_nnz} * sizeof(uint32_t), &index, sizeof(index));
+  memcpy(values + size_t{m_nnz} * sizeof(float), &value, sizeof(value));
+  m_nnz++;
+}
+
+size_t writer::finish() {
+  char *indexes = m_out + header_size;
+  if (m_nnz < m_capacity)
+    memmove(indexes + size_t{m_nnz} * sizeof(uint32_t),
+            indexes + size_t{m_capacity} * sizeof(uint32_t),
+            size_t{m_nnz} * sizeof(float));
+  return sparse_bytes(m_nnz);
+}
+
+uint32_t count_nonzero(uint32_t vec_dim, const char *dense) {
+  uint32_t nnz = 0;
+  for (uint32_t i = 0; i < vec_dim; i++)
+    nnz += read_float(dense + i * sizeof(float)) != 0;
+  return nnz;
+}
+
+size_t from_dense(uint32_t vec_dim, const char *dense, char *out) {
+  writer w(out, vec_dim, count_nonzero(vec_dim, dense));
+  for (uint32_t i = 0; i < vec_dim; i++) {
+    float value = read_float(dense + i * sizeof(float));
+    if (value != 0) w.append(i, value);
+  }
+  return w.finish();
+}
+
+void to_dense(const view &v, char *out) {
+  memset(out, 0, size_t{v.dimensions} * sizeof(float));
+  for (uint32_t i = 0; i < v.nnz; i++)
+    memcpy(out + size_t{v.index(i)} * sizeof(float),
+           v.values + size_t{i} * sizeof(float), sizeof(float));
+}
+
+bool parse_text(const char *text, size_t length, uint32_t dimensions,
+                std::vector<std::pair<uint32_t, float>> *pairs) {
+  pairs->clear();
+  const char *pos = text;
+  const char *end = text + length;
+  pos = skip_spaces(pos, end);
+  if (pos == end || *pos++ != '{') return true;
+  pos = skip_spaces(pos, end);
+  if (pos < end && *pos == '}') return skip_spaces(pos + 1, end) != end;
+
+  for (;;) {
+    uint32_t index;
+    float value;
+    pos = skip_spaces(pos, end);
+    if (pos == end || *pos++ != '"') return true;
+    std::from_chars_result read = std::from_chars(pos, end, index);
+    if (read.ec != std::errc() || read.ptr == end || *read.ptr != '"' ||
+        index >= dimensions)
+      return true;
+    pos = skip_spaces(read.ptr + 1, end);
+    if (pos == end || *pos++ != ':') return true;
+    pos = skip_spaces(pos, end);
+    if (pos == end || *pos == '+') return true;
+    read = std::from_chars(pos, end, value);
+    if (read.ec != std::errc() || !std::isfinite(value)) return true;
+    if (value != 0) pairs->emplace_back(index, value);
+    pos = skip_spaces(read.ptr, end);
+    if (pos == end) return true;
+    if (*pos == '}') break;
+    if (*pos++ != ',') return true;
+  }
+  if (skip_spaces(pos + 1, end) != end) return true;
+
+  std::sort(pairs->begin(), pairs->end());
+  for (size_t i = 1; i < pairs->size(); i++) {
+    if ((*pairs)[i].first == (*pairs)[i - 1].first) return true;
+  }
+  return false;
+}
+
+size_t to_text(const view &v, char *out) {
+  char *pos = out;
+  *pos++ = '{';
+  for (uint32_t i = 0; i < v.nnz; i++) {
+    if (i > 0) *pos++ = ',';
+    *pos++ = '"';
+    pos = std::to_chars(pos, pos + 10, v.index(i)).ptr;
+    *pos++ = '"';
+    *pos++ = ':';
+    pos = std::to_chars(pos, pos + 15, v.value(i)).ptr;
+  }
+  *pos++ = '}';
+  return pos - out;
+}
+
+size_t add(const view &a, const view &b, char *out) {
+  writer w(out, a.dimensions, a.nnz + b.nnz);
+  uint32_t i = 0, j = 0;
+  while (i < a.nnz || j < b.nnz) {
+    uint32_t index_a = i < a.nnz ? a.index(i) : UINT32_MAX;
+    uint32_t index_b = j < b.nnz ? b.index(j) : UINT32_MAX;
+    float value;
+    uint32_t index = std::min(index_a, index_b);
+    if (index_a == index_b)
+      value = a.value(i++) + b.value(j++);
+    else if (index_a < index_b)
+      value = a.value(i++);
+    else
+      value = b.value(j++);
+    if (!std::isfinite(value)) return SIZE_MAX;
+    if (value != 0) w.append(index, value);
+  }
+  return w.finish();
+}
+
+size_t scale(const view &v, float s, char *out) {
+  writer w(out, v.dimensions, v.nnz);
+  for (uint32_t i = 0; i < v.nnz; i++) {
+    float value = v.value(i) * s;
+    if (!std::isfinite(value)) return SIZE_MAX;
+    if (value != 0) w.append(v.index(i), value);
+  }
+  return w.finish();
+}
+
+double dot(const view &a, const view &b) {
+  const view &small = a.nnz <= b.nnz ? a : b;
+  const view &large = a.nnz <= b.nnz ? b : a;
+  double sum = 0;
+  if (small.nnz == 0) return sum;
+
+  if (large.nnz / small.nnz >= galloping_ratio) {
+    uint32_t j = 0;
+    for (uint32_t i = 0; i < small.nnz && j < large.nnz; i++) {
+      j = gallop(large, j, small.index(i));
+      if (j < large.nnz && large.index(j) == small.index(i))
+        sum += static_cast<double>(small.value(i)) * large.value(j);
+    }
+    return sum;
+  }
+
+  uint32_t i = 0, j = 0;
+  while (i < small.nnz && j < large.nnz) {
+    uint32_t index_small = small.index(i);
+    uint32_t index_large = large.index(j);
+    if (index_small == index_large)
+      sum += static_cast<double>(small.value(i++)) * large.value(j++);
+    else if (index_small < index_large)
+      i++;
+    else
+      j++;
+  }
+  return sum;
+}
+
+}  // namespace vector_sparse
@@ -0,0 +1,140 @@
+/* Copyright (c) 2017, 2024, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License, version 2.0, for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA */
+
+#ifndef VECTOR_SPARSE_H
+#define VECTOR_SPARSE_H
+
+/*
+  Sparse vectors, stored as VARBINARY: a 4 bytes tag, the dimension as a
+  uint32, then the nnz indexes of the non-zero elements as uint32 in
+  increasing order, followed by their nnz float values. The tag is the bit
+  pattern of a float NaN, like the tags of the 16-bit vectors, so that a
+  sparse vector is never mistaken for a dense one. The dimension is not
+  bound by the one of a VECTOR: a vector of 30000 dimensions with 100
+  non-zero elements takes 808 bytes.
+
+  The indexes and the values are kept apart so that the dot product with a
+  dense vector gathers the dense elements of a block of indexes with one
+  SIMD instruction. The dot product of two sparse vectors intersects their
+  indexes by merging them, or by galloping through the larger one when
+  their sizes differ widely.
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace vector_sparse {
+
+constexpr uint32_t sparse_vector_tag = 0x7fc05a25;
+constexpr size_t header_size = 2 * sizeof(uint32_t);
+constexpr uint32_t max_dimensions = INT32_MAX;
+
+inline size_t sparse_bytes(uint32_t nnz) {
+  return header_size + size_t{nnz} * (sizeof(uint32_t) + sizeof(float));
+}
+
+/* Returns true if the value starts with the tag of a sparse vector. */
+inline bool is_sparse(const char *data, size_t length) {
+  if (data == nullptr || length < header_size) return false;
+  uint32_t tag;
+  memcpy(&tag, data, sizeof(tag));
+  return tag == sparse_vector_tag;
+}
+
+/* A sparse vector value, validated by parse(). */
+struct view {
+  uint32_t dimensions = 0;
+  uint32_t nnz = 0;
+  const char *indexes = nullptr;
+  const char *values = nullptr;
+
+  /* Reads the sparse vector at `data`; returns true if it is not valid. */
+  bool parse(const char *data, size_t length);
+
+  uint32_t index(uint32_t i) const;
+  float value(uint32_t i) const;
+};
+
+/*
+  A sparse vector written to a buffer of sparse_bytes(capacity) bytes, nnz
+  growing up to capacity; finish() moves the values after the indexes
+  written and returns the size of the vector.
+*/
+class writer {
+ public:
+  writer(char *out, uint32_t dimensions, uint32_t capacity);
+
+  void append(uint32_t index, float value);
+  size_t finish();
+
+ private:
+  char *m_out;
+  uint32_t m_capacity;
+  uint32_t m_nnz = 0;
+};
+
+/* The non-zero elements of the vec_dim floats of `dense`. */
+uint32_t count_nonzero(uint32_t vec_dim, const char *dense);
+
+/* Writes the sparse form of `dense`, of count_nonzero() elements, to out. */
+size_t from_dense(uint32_t vec_dim, const char *dense, char *out);
+
+/* Writes the `dimensions` floats of `v` to out. */
+void to_dense(const view &v, char *out);
+
+/*
+  Reads the (index, value) pairs of a JSON object such as {"17": 0.5,
+  "2301": 1.25} and sorts them by index, zero values dropped. Returns true
+  if the text is not such an object, an index is repeated or not below
+  `dimensions`, or a value is not finite. Throws std::bad_alloc on OOM.
+*/
+bool parse_text(const char *text, size_t length, uint32_t dimensions,
+                std::vector<std::pair<uint32_t, float>> *pairs);
+
+/* The largest text of a sparse vector of nnz elements. */
+inline size_t max_text_bytes(uint32_t nnz) {
+  /* "4294967295":-1.17549435e-38 and a comma per element, and the braces. */
+  return 2 + size_t{nnz} * 29;
+}
+
+/* Writes `v` as a JSON object to out; returns the length of the text. */
+size_t to_text(const view &v, char *out);
+
+/*
+  Writes a + b to a writer of capacity a.nnz + b.nnz, the elements adding to
+  zero dropped; the dimensions must be the same. Returns the size of the sum,
+  or SIZE_MAX if an element overflows.
+*/
+size_t add(const view &a, const view &b, char *out);
+
+/* Writes s * v to a writer of capacity v.nnz; as add(). */
+size_t scale(const view &v, float s, char *out);
+
+/* The dot product of two sparse vectors of the same dimension. */
+double dot(const view &a, const view &b);
+
+}  // namespace vector_sparse
+
+#endif /* VECTOR_SPARSE_H */
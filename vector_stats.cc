@@ -0,0 +1,186 @@
+/* Copyright (c) 2017, 2024, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License, version 2.0, for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA */
+
+
+#include "vector_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "vector_kernels.h"
+
+namespace vector_stats {
+
+namespace {
+
+/* Multiply-adds of the rank update per chunk of matrix rows. */
+constexpr size_t chunk_work = 1 << 18;
+
+/* Converts a statistic to float; returns true if it is out of range. */
+bool store(double value, float *out) {
+  *out = static_cast<float>(value);
+  return !std::isfinite(*out);
+}
+
+}  // namespace
+
+bool format_from_name(const char *name, size_t length, format *f) {
+  static const struct {
+    const char *name;
+    format value;
+  } names[] = {{"BINARY", format::binary}, {"JSON", format::json}};
+
+  for (const auto &entry : names) {
+    if (vector_kernels::name_equals(name, length, entry.name)) {
+      *f = entry.value;
+      return false;
+    }
+  }
+  return true;
+}
+
+void moments::start(uint32_t vec_dim) {
+  m_mean.assign(vec_dim, 0.0);
+  m_m2.assign(vec_dim, 0.0);
+  m_min.assign(vec_dim, HUGE_VALF);
+  m_max.assign(vec_dim, -HUGE_VALF);
+  m_vec_dim = vec_dim;
+  m_count = 0;
+}
+
+void moments::add(const char *vec) {
+  m_count++;
+  vector_kernels::active().moments(m_vec_dim, vec,
+                                   1.0 / static_cast<double>(m_count),
+                                   m_mean.data(), m_m2.data(), m_min.data(),
+                                   m_max.data());
+}
+
+bool moments::finish(float *out) const {
+  const double count = static_cast<double>(m_count);
+  bool out_of_range = false;
+  for (uint32_t i = 0; i < m_vec_dim; i++) {
+    out_of_range |= store(m_mean[i], out + i);
+    out_of_range |= store(m_m2[i] / count, out + m_vec_dim + i);
+    out[2 * m_vec_dim + i] = m_min[i];
+    out[3 * m_vec_dim + i] = m_max[i];
+  }
+  return out_of_range;
+}
+
+void moments::reset() {
+  m_vec_dim = 0;
+  m_count = 0;
+}
+
+void covariance::start(uint32_t vec_dim,
+                       vector_parallel::thread_pool *workers) {
+  m_matrix.assign(size_t{vec_dim} * vec_dim, 0.0);
+  m_mean.assign(vec_dim, 0.0);
+  m_block.resize(size_t{block_rows + 1} * vec_dim);
+  m_workers = workers;
+  m_vec_dim = vec_dim;
+  m_count = 0;
+  m_block_size = 0;
+}
+
+void covariance::add(const char *vec) {
+  double *row = &m_block[size_t{m_block_size} * m_vec_dim];
+  for (uint32_t i = 0; i < m_vec_dim; i++) {
+    float value;
+    memcpy(&value, vec + i * sizeof(float), sizeof(value));
+    row[i] = value;
+  }
+  if (++m_block_size == block_rows) flush();
+}
+
+void covariance::flush() {
+  const uint32_t vec_dim = m_vec_dim;
+  const uint32_t size = m_block_size;
+  if (size == 0) return;
+
+  /* The mean of the block, in the spare row. */
+  double *block = m_block.data();
+  double *spare = block + size_t{size} * vec_dim;
+  std::fill(spare, spare + vec_dim, 0.0);
+  for (uint32_t r = 0; r < size; r++)
+    for (uint32_t i = 0; i < vec_dim; i++) spare[i] += block[r * vec_dim + i];
+  for (uint32_t i = 0; i < vec_dim; i++) spare[i] /= size;
+  for (uint32_t r = 0; r < size; r++)
+    for (uint32_t i = 0; i < vec_dim; i++) block[r * vec_dim + i] -= spare[i];
+
+  /*
+    Chan et al.: merging adds count * size / (count + size) times the outer
+    product of the difference of the means, the spare row scaled by its
+    square root.
+  */
+  const double count = static_cast<double>(m_count);
+  const double total = count + size;
+  const double scale = std::sqrt(count * size / total);
+  for (uint32_t i = 0; i < vec_dim; i++) {
+    double difference = spare[i] - m_mean[i];
+    m_mean[i] += difference * size / total;
+    spare[i] = difference * scale;
+  }
+  const uint32_t rows = m_count > 0 ? size + 1 : size;
+
+  const vector_kernels::rank_update_fn rank_update =
+      vector_kernels::active().rank_update;
+  double *matrix = m_matrix.data();
+  const uint32_t step = vector_kernels::rank_update_rows;
+  m_workers->parallel_for(
+      (vec_dim + step - 1) / step,
+      static_cast<uint32_t>(std::max<size_t>(
+          1, chunk_work / (size_t{rows} * vec_dim * step))),
+      [&](unsigned, uint32_t begin, uint32_t end) {
+        for (uint32_t g = begin; g < end; g++)
+          rank_update(vec_dim, g * step, rows, block, matrix);
+      });
+  m_count += size;
+  m_block_size = 0;
+}
+
+bool covariance::finish(float *mean, float *matrix) {
+  flush();
+  const uint32_t vec_dim = m_vec_dim;
+  const double count = static_cast<double>(m_count);
+  bool out_of_range = false;
+  for (uint32_t i = 0; i < vec_dim; i++) {
+    out_of_range |= store(m_mean[i], mean + i);
+    for (uint32_t j = i; j < vec_dim; j++) {
+      out_of_range |=
+          store(m_matrix[size_t{i} * vec_dim + j] / count,
+                matrix + size_t{i} * vec_dim + j);
+      matrix[size_t{j} * vec_dim + i] = matrix[size_t{i} * vec_dim + j];
+    }
+  }
+  return out_of_range;
+}
+
+void covariance::reset() {
+  m_vec_dim = 0;
+  m_count = 0;
+  m_block_size = 0;
+}
+
+}  // namespace vector_stats
@@ -0,0 +1,137 @@
+/* Copyright (c) 2017, 2024, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License, version 2.0, for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA */
+
+
+#ifndef VECTOR_STATS_H
+#define VECTOR_STATS_H
+
+/*
+  Streaming statistics of float vectors, for VECTOR_STATS and
+  VECTOR_COVARIANCE.
+
+  The per-dimension mean and variance are updated by Welford's algorithm,
+  with the minimum and the maximum, in a single pass and in double
+  precision. The covariance matrix buffers blocks of rows: a block is
+  centered on its own mean, its scatter matrix added by a symmetric rank-k
+  update of the upper triangle, and its mean merged with the running one by
+  Chan's formula, the difference of the means being one more row of the
+  update. The rows of the matrix are updated four at a time by the workers
+  of a thread pool, the block being streamed through registers holding
+  chunks of the four rows.
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "vector_parallel.h"
+
+namespace vector_stats {
+
+/* The covariance matrix of 4096 dimensions takes 128 MB. */
+constexpr uint32_t max_covariance_dimensions = 4096;
+
+enum class format { binary, json };
+
+/*
+  Parses a case-insensitive format name, BINARY or JSON. Returns true if the
+  name is unknown.
+*/
+bool format_from_name(const char *name, size_t length, format *f);
+
+/* Per-dimension mean, variance, minimum and maximum. */
+class moments {
+ public:
+  /* Starts vectors of vec_dim floats. Throws std::bad_alloc on OOM. */
+  void start(uint32_t vec_dim);
+
+  bool started() const { return m_vec_dim != 0; }
+  uint32_t dimensions() const { return m_vec_dim; }
+  uint64_t count() const { return m_count; }
+
+  /* Adds a vector of vec_dim floats. */
+  void add(const char *vec);
+
+  /*
+    Writes the mean, the population variance, the minimum and the maximum
+    of every dimension as float[4][vec_dim] to `out`. Returns true if one of
+    them is out of the float range.
+  */
+  bool finish(float *out) const;
+
+  /* Discards the vectors added. */
+  void reset();
+
+ private:
+  uint32_t m_vec_dim = 0;
+  uint64_t m_count = 0;
+  std::vector<double> m_mean;
+  std::vector<double> m_m2;  // sums of the squared deviations
+  std::vector<float> m_min;
+  std::vector<float> m_max;
+};
+
+/* Mean and covariance matrix. */
+class covariance {
+ public:
+  /* Rows buffered before an update of the matrix. */
+  static constexpr uint32_t block_rows = 32;
+
+  /*
+    Starts vectors of vec_dim floats, at most max_covariance_dimensions.
+    Throws std::bad_alloc on OOM.
+  */
+  void start(uint32_t vec_dim, vector_parallel::thread_pool *workers);
+
+  bool started() const { return m_vec_dim != 0; }
+  uint32_t dimensions() const { return m_vec_dim; }
+  uint64_t count() const { return m_count + m_block_size; }
+
+  /* Adds a vector of vec_dim floats. */
+  void add(const char *vec);
+
+  /*
+    Writes the vec_dim means to `mean` and the vec_dim x vec_dim population
+    covariance matrix, row after row, to `matrix`. Returns true if one of
+    them is out of the float range.
+  */
+  bool finish(float *mean, float *matrix);
+
+  /* Discards the vectors added. */
+  void reset();
+
+ private:
+  /* Merges the buffered rows into the mean and the matrix. */
+  void flush();
+
+  vector_parallel::thread_pool *m_workers = nullptr;
+  uint32_t m_vec_dim = 0;
+  uint64_t m_count = 0;  // rows merged
+  std::vector<double> m_mean;
+  std::vector<double> m_matrix;  // upper triangle of the co-moment sums
+  std::vector<double> m_block;   // block_rows + 1 rows of vec_dim
+  uint32_t m_block_size = 0;
+};
+
+}  // namespace vector_stats
+
+#endif /* VECTOR_STATS_H */
@@ -0,0 +1,175 @@
+/* Copyright (c) 2017, 2024, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License, version 2.0, for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA */
+
+#include "vector_text.h"
+
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <system_error>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace vector_text {
+
+namespace {
+
+/* The characters of a JSON array of numbers. */
+enum char_class : unsigned char {
+  invalid = 0,
+  number = 1,  // 0-9 + - . e E
+  space = 2,
+  comma = 3,
+  bracket = 4
+};
+
+struct char_table {
+  unsigned char classes[256] = {};
+
+  constexpr char_table() {
+    for (int c = '0'; c <= '9'; c++) classes[c] = number;
+    for (unsigned char c : {'+', '-', '.', 'e', 'E'}) classes[c] = number;
+    for (unsigned char c : {' ', '\t', '\n', '\r'}) classes[c] = space;
+    classes[static_cast<unsigned char>(',')] = comma;
+    classes[static_cast<unsigned char>('[')] = bracket;
+    classes[static_cast<unsigned char>(']')] = bracket;
+  }
+};
+
+constexpr char_table table;
+
+/* The result of the scan of a text. */
+struct scan_result {
+  bool valid = true;
+  size_t commas = 0;
+};
+
+/* Scans text[begin, end) one byte at a time. */
+void scan_bytes(const unsigned char *text, size_t begin, size_t end,
+                scan_result *scan) {
+  for (size_t i = begin; i < end; i++) {
+    unsigned char c = table.classes[text[i]];
+    scan->valid &= c != invalid;
+    scan->commas += c == comma;
+  }
+}
+
+scan_result scan(const char *text, size_t length) {
+  scan_result result;
+  const unsigned char *bytes = reinterpret_cast<const unsigned char *>(text);
+  size_t i = 0;
+#if defined(__SSE2__)
+  /*
+    A block of digits, signs, dots, exponents and commas only is checked
+    with range compares; the blocks with anything else (white space and
+    the brackets) go through the table.
+  */
+  const __m128i below_zero = _mm_set1_epi8('0' - 1);
+  const __m128i above_nine = _mm_set1_epi8('9' + 1);
+  const __m128i plus = _mm_set1_epi8('+');
+  const __m128i comma_char = _mm_set1_epi8(',');
+  const __m128i minus = _mm_set1_epi8('-');
+  const __m128i dot = _mm_set1_epi8('.');
+  const __m128i lower_e = _mm_set1_epi8('e');
+  const __m128i upper_e = _mm_set1_epi8('E');
+  for (; i + 16 <= length; i += 16) {
+    __m128i block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + i));
+    /* Signed compares: the bytes from 0x80 are never digits. */
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(block, below_zero),
+                                  _mm_cmplt_epi8(block, above_nine));
+    __m128i commas = _mm_cmpeq_epi8(block, comma_char);
+    __m128i other = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(block, plus), _mm_cmpeq_epi8(block, minus)),
+        _mm_or_si128(_mm_cmpeq_epi8(block, dot),
+                     _mm_or_si128(_mm_cmpeq_epi8(block, lower_e),
+                                  _mm_cmpeq_epi8(block, upper_e))));
+    __m128i known = _mm_or_si128(_mm_or_si128(digit, commas), other);
+    if (_mm_movemask_epi8(known) != 0xffff) {
+      scan_bytes(bytes, i, i + 16, &result);
+      continue;
+    }
+    result.commas += __builtin_popcount(_mm_movemask_epi8(commas));
+  }
+#endif
+  scan_bytes(bytes, i, length, &result);
+  return result;
+}
+
+bool is_space(char c) {
+  return table.classes[static_cast<unsigned char>(c)] == space;
+}
+
+}  // namespace
+
+size_t format(uint32_t vec_dim, const char *vec, int digits, char *out) {
+  char *pos = out;
+  *pos++ = '[';
+  for (uint32_t i = 0; i < vec_dim; i++) {
+    float value;
+    memcpy(&value, vec + i * sizeof(float), sizeof(float));
+    if (!std::isfinite(value)) return SIZE_MAX;
+    if (i > 0) *pos++ = ',';
+    std::to_chars_result written =
+        digits == shortest
+            ? std::to_chars(pos, pos + 15, value)
+            : std::to_chars(pos, pos + 15, value, std::chars_format::general,
+                            digits);
+    pos = written.ptr;
+  }
+  *pos++ = ']';
+  return pos - out;
+}
+
+uint32_t count(const char *text, size_t length) {
+  if (text == nullptr || length < 3) return UINT32_MAX;
+  scan_result result = scan(text, length);
+  if (!result.valid || result.commas >= UINT32_MAX) return UINT32_MAX;
+  return static_cast<uint32_t>(result.commas + 1);
+}
+
+bool parse(const char *text, size_t length, uint32_t vec_dim, char *out) {
+  const char *pos = text;
+  const char *end = text + length;
+  while (pos < end && is_space(*pos)) pos++;
+  if (pos == end || *pos++ != '[') return true;
+
+  for (uint32_t i = 0; i < vec_dim; i++) {
+    while (pos < end && is_space(*pos)) pos++;
+    /* JSON numbers have no leading plus. */
+    if (pos == end || *pos == '+') return true;
+    float value;
+    std::from_chars_result read = std::from_chars(pos, end, value);
+    if (read.ec != std::errc() || !std::isfinite(value)) return true;
+    memcpy(out + i * sizeof(float), &value, sizeof(float));
+    pos = read.ptr;
+    while (pos < end && is_space(*pos)) pos++;
+    if (pos == end || *pos++ != (i + 1 < vec_dim ? ',' : ']')) return true;
+  }
+
+  while (pos < end && is_space(*pos)) pos++;
+  return pos != end;
+}
+
+}  // namespace vector_text
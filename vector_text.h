@@ -0,0 +1,75 @@
+/* Copyright (c) 2017, 2024, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License, version 2.0, for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA */
+
+#ifndef VECTOR_TEXT_H
+#define VECTOR_TEXT_H
+
+/*
+  Conversion of float vectors to and from their text form, a JSON array of
+  numbers such as [0.5,-1.25,3e-07].
+
+  The formatter writes every element with std::to_chars, locale independent,
+  either in its shortest form that reads back as the same float or rounded
+  to a number of significant digits, into a buffer sized once for the
+  largest output. The parser first scans the text 16 bytes at a time with
+  SSE2 to check its characters and count the elements, so that the output
+  is sized exactly before the elements are read with std::from_chars.
+*/
+
+#include <cstddef>
+#include <cstdint>
+
+namespace vector_text {
+
+/* Significant digits of the shortest round-trip form. */
+constexpr int shortest = 0;
+constexpr int max_digits = 9;
+
+/* The largest text of a vector of vec_dim floats. */
+constexpr size_t max_text_bytes(uint32_t vec_dim) {
+  /* -1.17549435e-38 and a comma per element, and the brackets. */
+  return 2 + size_t{vec_dim} * 16;
+}
+
+/*
+  Writes the vec_dim floats of `vec` as a JSON array to `out`, of room for
+  max_text_bytes(vec_dim), with `digits` significant digits (1 to
+  max_digits) or in the shortest form. Returns the length of the text, or
+  SIZE_MAX if an element is not finite.
+*/
+size_t format(uint32_t vec_dim, const char *vec, int digits, char *out);
+
+/*
+  Returns the number of elements of the JSON array of numbers `text`, or
+  UINT32_MAX if it is not one. The elements are then read by parse().
+*/
+uint32_t count(const char *text, size_t length);
+
+/*
+  Reads the `vec_dim` elements counted by count() of the JSON array `text`
+  into `out`. Returns true if the text is not an array of finite floats.
+*/
+bool parse(const char *text, size_t length, uint32_t vec_dim, char *out);
+
+}  // namespace vector_text
+
+#endif /* VECTOR_TEXT_H */